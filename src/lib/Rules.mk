@@ -2,10 +2,10 @@ d := $(dir $(lastword $(MAKEFILE_LIST)))
 
 SRCS += $(addprefix $(d), \
 	lookup3.cc message.cc memory.cc \
-	latency.cc configuration.cc transport.cc \
-	udptransport.cc tcptransport.cc simtransport.cc repltransport.cc \
+	latency.cc histogram.cc configuration.cc transport.cc frame.cc \
+	udptransport.cc tcptransport.cc iouringtransport.cc shmtransport.cc simtransport.cc repltransport.cc \
 	persistent_register.cc io_utils.cc crypto.cc keymanager.cc threadpool.cc \
-	crypto_bench.cc threadpool_test.cc batched_sigs.cc batched_sigs_test.cc blake3_test.cc)
+	crypto_bench.cc auth_bench.cc threadpool_test.cc batched_sigs.cc batched_sigs_test.cc blake3_test.cc)
 
 PROTOS += $(addprefix $(d), \
           latency-format.proto)
@@ -22,9 +22,11 @@ LIB-io-utils := $(o)io_utils.o
 
 LIB-latency := $(o)latency.o $(o)latency-format.o $(LIB-message)
 
+LIB-histogram := $(o)histogram.o
+
 LIB-configuration := $(o)configuration.o $(LIB-message)
 
-LIB-transport := $(o)transport.o $(o)threadpool.o $(LIB-message) $(LIB-configuration)
+LIB-transport := $(o)transport.o $(o)frame.o $(o)threadpool.o $(LIB-message) $(LIB-configuration)
 
 LIB-simtransport := $(o)simtransport.o $(LIB-transport)
 
@@ -34,6 +36,10 @@ LIB-udptransport := $(o)udptransport.o $(LIB-transport)
 
 LIB-tcptransport := $(o)tcptransport.o $(LIB-transport)
 
+LIB-iouringtransport := $(o)iouringtransport.o $(LIB-tcptransport)
+
+LIB-shmtransport := $(o)shmtransport.o $(LIB-transport)
+
 LIB-persistent_register := $(o)persistent_register.o $(LIB-message)
 
 LIB-crypto := $(LIB-message) $(o)crypto.o $(o)keymanager.o 
@@ -43,6 +49,8 @@ LIB-batched-sigs := $(LIB-crypto) $(o)batched_sigs.o
 
 $(d)crypto_bench: $(LIB-latency) $(LIB-crypto) $(LIB-batched-sigs) $(o)crypto_bench.o
 
+$(d)auth_bench: $(LIB-latency) $(LIB-crypto) $(LIB-batched-sigs) $(o)auth_bench.o
+
 $(d)threadpool_test: $(LIB-latency) $(LIB-crypto) $(LIB-batched-sigs) $(o)threadpool_test.o
 
 #$(d)threadpool_test: $(LIB-transport) $(o)threadpool_test.o
@@ -53,6 +61,6 @@ $(d)blake3_test: $(LIB-latency) $(LIB-crypto) $(LIB-batched-sigs) $(o)blake3_tes
 
 #$(d)ed25519_donna: $(o)ed25519.o
 
-BINS +=  $(d)crypto_bench $(d)threadpool_test $(d)batched_sigs_test $(d)blake3_test 
+BINS +=  $(d)crypto_bench $(d)auth_bench $(d)threadpool_test $(d)batched_sigs_test $(d)blake3_test 
 
 include $(d)tests/Rules.mk
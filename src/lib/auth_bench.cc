@@ -0,0 +1,155 @@
+/***********************************************************************
+ *
+ * Copyright 2021 Florian Suri-Payer <fsp@cs.cornell.edu>
+ *                Matthew Burke <matthelb@cs.cornell.edu>
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ **********************************************************************/
+#include "lib/latency.h"
+#include "lib/crypto.h"
+#include "lib/batched_sigs.h"
+#include "lib/message.h"
+
+#include <gflags/gflags.h>
+
+#include <algorithm>
+#include <random>
+#include <sstream>
+
+DEFINE_uint64(size, 256, "size of each authenticated message.");
+DEFINE_uint64(iterations, 1000, "number of iterations to measure.");
+DEFINE_uint64(group_size, 6, "number of recipients (session keys) per message.");
+DEFINE_string(batch_sizes, "1,4,16,64", "comma-separated list of signature batch sizes.");
+
+void GenerateRandomString(uint64_t size, std::random_device &rd, std::string &s) {
+  s.clear();
+  for (uint64_t i = 0; i < size; ++i) {
+    s.push_back(static_cast<char>(rd()));
+  }
+}
+
+// Reports the mean cost of authenticating one message, in ns.
+void Report(const char *name, uint64_t totalNs, uint64_t msgs) {
+  Notice("%-24s %8lu ns/message", name, totalNs / std::max<uint64_t>(msgs, 1));
+}
+
+int main(int argc, char *argv[]) {
+  gflags::SetUsageMessage("compare per-message cost of MACs and signatures.");
+	gflags::ParseCommandLineFlags(&argc, &argv, true);
+
+  std::random_device rd;
+
+  std::vector<std::string> keys(FLAGS_group_size);
+  for (auto &key : keys) {
+    GenerateRandomString(16, rd, key);
+  }
+  crypto::SessionMACs sha256(crypto::HMAC_SHA256, keys);
+  crypto::SessionMACs blake3(crypto::HMAC_BLAKE3, keys);
+
+  std::vector<uint64_t> batchSizes;
+  std::stringstream ss(FLAGS_batch_sizes);
+  std::string tok;
+  while (std::getline(ss, tok, ',')) {
+    batchSizes.push_back(std::stoull(tok));
+  }
+
+  Notice("===================================");
+  Notice("Authenticating %lu byte messages for %lu recipients, %lu iterations.",
+      FLAGS_size, FLAGS_group_size, FLAGS_iterations);
+
+  std::vector<std::string> msgs(FLAGS_iterations);
+  for (auto &m : msgs) {
+    GenerateRandomString(FLAGS_size, rd, m);
+  }
+
+  struct Latency_t lat;
+  _Latency_Init(&lat, "auth");
+  std::vector<std::string> macs;
+
+  // Previous path: one crypto::HMAC call per recipient.
+  uint64_t ns = 0;
+  for (const auto &m : msgs) {
+    Latency_Start(&lat);
+    for (const auto &key : keys) {
+      macs.push_back(crypto::HMAC(m, key));
+    }
+    ns += Latency_End(&lat);
+    macs.clear();
+  }
+  Report("hmac_sha256_serial", ns, msgs.size());
+
+  ns = 0;
+  for (const auto &m : msgs) {
+    Latency_Start(&lat);
+    sha256.MacAll(m, macs);
+    ns += Latency_End(&lat);
+  }
+  Report("hmac_sha256_batch", ns, msgs.size());
+
+  ns = 0;
+  for (const auto &m : msgs) {
+    Latency_Start(&lat);
+    blake3.MacAll(m, macs);
+    ns += Latency_End(&lat);
+  }
+  Report("mac_blake3_batch", ns, msgs.size());
+
+  std::vector<std::pair<const char *, crypto::KeyType>> algs = {
+    {"ed25519", crypto::ED25}, {"secp256k1", crypto::SECP}, {"donna", crypto::DONNA}
+  };
+  for (const auto &alg : algs) {
+    std::pair<crypto::PrivKey*, crypto::PubKey*> keypair =
+        crypto::GenerateKeypair(alg.second, true);
+
+    ns = 0;
+    for (const auto &m : msgs) {
+      Latency_Start(&lat);
+      std::string sig(crypto::Sign(keypair.first, m));
+      ns += Latency_End(&lat);
+    }
+    Report(alg.first, ns, msgs.size());
+
+    for (uint64_t batchSize : batchSizes) {
+      if (batchSize <= 1) {
+        continue;
+      }
+      std::vector<const std::string *> batch;
+      std::vector<std::string> sigs;
+      ns = 0;
+      uint64_t signedMsgs = 0;
+      for (size_t i = 0; i + batchSize <= msgs.size(); i += batchSize) {
+        batch.clear();
+        for (size_t j = i; j < i + batchSize; ++j) {
+          batch.push_back(&msgs[j]);
+        }
+        Latency_Start(&lat);
+        BatchedSigs::generateBatchedSignatures(batch, keypair.first, sigs);
+        ns += Latency_End(&lat);
+        signedMsgs += batchSize;
+      }
+      std::string name = std::string(alg.first) + "_batch_" + std::to_string(batchSize);
+      Report(name.c_str(), ns, signedMsgs);
+    }
+  }
+  Notice("===================================");
+  return 0;
+}
@@ -82,6 +82,80 @@ bool verifyHMAC(std::string message, std::string mac, std::string keystr) {
   }
 }
 
+SessionMACs::SessionMACs(HMACType t, const std::vector<std::string> &keys) :
+    t(t), keys(keys) {
+  if (t == HMAC_BLAKE3) {
+    // keyed BLAKE3 needs 32-byte keys; expand the session keys once here.
+    keyed.resize(keys.size());
+    for (size_t i = 0; i < keys.size(); ++i) {
+      blake3_hasher kdf;
+      blake3_hasher_init_derive_key(&kdf, "indicus session mac v1");
+      blake3_hasher_update(&kdf, keys[i].data(), keys[i].size());
+      uint8_t key[BLAKE3_KEY_LEN];
+      blake3_hasher_finalize(&kdf, key, BLAKE3_KEY_LEN);
+      blake3_hasher_init_keyed(&keyed[i], key);
+    }
+  }
+}
+
+void SessionMACs::Digest(const std::string &message, uint8_t *digest) const {
+  blake3_hasher h;
+  blake3_hasher_init(&h);
+  blake3_hasher_update(&h, message.data(), message.size());
+  blake3_hasher_finalize(&h, digest, BLAKE3_OUT_LEN);
+}
+
+void SessionMACs::MacDigest(const uint8_t *digest, size_t i,
+    std::string &mac) const {
+  blake3_hasher h = keyed[i];
+  blake3_hasher_update(&h, digest, BLAKE3_OUT_LEN);
+  mac.resize(BLAKE3_OUT_LEN);
+  blake3_hasher_finalize(&h, (uint8_t *) &mac[0], BLAKE3_OUT_LEN);
+}
+
+void SessionMACs::MacAll(const std::string &message,
+    std::vector<std::string> &macs) const {
+  macs.resize(keys.size());
+  if (t == HMAC_BLAKE3) {
+    uint8_t digest[BLAKE3_OUT_LEN];
+    Digest(message, digest);
+    for (size_t i = 0; i < keys.size(); ++i) {
+      MacDigest(digest, i, macs[i]);
+    }
+  } else {
+    for (size_t i = 0; i < keys.size(); ++i) {
+      macs[i] = Mac(message, i);
+    }
+  }
+}
+
+std::string SessionMACs::Mac(const std::string &message, size_t i) const {
+  std::string mac;
+  if (t == HMAC_BLAKE3) {
+    uint8_t digest[BLAKE3_OUT_LEN];
+    Digest(message, digest);
+    MacDigest(digest, i, mac);
+  } else {
+    CryptoPP::HMAC<CryptoPP::SHA256> hmac((const CryptoPP::byte *) keys[i].data(),
+        keys[i].size());
+    mac.resize(hmac.DigestSize());
+    hmac.CalculateDigest((CryptoPP::byte *) &mac[0],
+        (const CryptoPP::byte *) message.data(), message.size());
+  }
+  return mac;
+}
+
+bool SessionMACs::Verify(const std::string &message, const std::string &mac,
+    size_t i) const {
+  if (i >= keys.size()) {
+    return false;
+  }
+  std::string expected = Mac(message, i);
+  return expected.size() == mac.size() && CryptoPP::VerifyBufsEqual(
+      (const CryptoPP::byte *) expected.data(),
+      (const CryptoPP::byte *) mac.data(), mac.size());
+}
+
 //FS Use a different Hash? I.e. Blake for everything?
 string Hash(const string &message) {
   SHA256 hash;
@@ -47,6 +47,7 @@
 #include "lib/ed25519.h" // Donna ed25519 lib   https://github.com/justmoon/curvebench/tree/master/src/ed25519-donna
 
 #include <string>
+#include <vector>
 
 namespace crypto {
 
@@ -102,6 +103,34 @@ std::string HMAC(std::string message, std::string key);
 
 bool verifyHMAC(std::string message, std::string mac, std::string key);
 
+enum HMACType { HMAC_SHA256, HMAC_BLAKE3 };
+
+// MACs a message for every member of a group at once, with one session key
+// per member. HMAC_SHA256 produces the same MACs as HMAC() above.
+// HMAC_BLAKE3 hashes the message once and MACs the 32-byte digest under each
+// (pre-expanded) key with keyed BLAKE3, so every additional recipient costs
+// one compression instead of another pass over the message.
+class SessionMACs {
+ public:
+  SessionMACs(HMACType t, const std::vector<std::string> &keys);
+
+  // macs[i] is the MAC of message under keys[i].
+  void MacAll(const std::string &message, std::vector<std::string> &macs) const;
+  std::string Mac(const std::string &message, size_t i) const;
+  bool Verify(const std::string &message, const std::string &mac, size_t i) const;
+
+  inline HMACType type() const { return t; }
+  inline size_t size() const { return keys.size(); }
+
+ private:
+  void Digest(const std::string &message, uint8_t *digest) const;
+  void MacDigest(const uint8_t *digest, size_t i, std::string &mac) const;
+
+  const HMACType t;
+  const std::vector<std::string> keys;
+  std::vector<blake3_hasher> keyed;
+};
+
 void SavePublicKey(const string &filename, PubKey* key);
 
 void SavePrivateKey(const std::string &filename, PrivKey* key);
@@ -0,0 +1,282 @@
+// -*- mode: c++; c-file-style: "k&r"; c-basic-offset: 4 -*-
+/***********************************************************************
+ *
+ * frame.cc:
+ *   wire framing shared by the stream transports (TCP, io_uring and
+ *   shared memory)
+ *
+ * Copyright 2021 Florian Suri-Payer <fsp@cs.cornell.edu>
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ **********************************************************************/
+
+#include "lib/frame.h"
+
+#include "lib/assert.h"
+
+#include <event2/buffer.h>
+
+#include <algorithm>
+#include <cstring>
+
+FrameEncoder::FrameEncoder(
+    const std::vector<::google::protobuf::Message *> &m_list, bool batch)
+    : m_list(m_list), batch(batch)
+{
+    UW_ASSERT(batch || m_list.size() == 1);
+    types.reserve(m_list.size());
+    dataLens.reserve(m_list.size());
+    totalLen = FRAME_HEADER_LEN + (batch ? sizeof(size_t) : 0);
+    for (const ::google::protobuf::Message *m : m_list) {
+        types.push_back(m->GetTypeName());
+        // Also caches the sizes used by SerializeWithCachedSizesToArray.
+        dataLens.push_back(m->ByteSizeLong());
+        totalLen += sizeof(size_t) + types.back().length() +
+                    sizeof(size_t) + dataLens.back();
+    }
+}
+
+void
+FrameEncoder::Write(char *buf) const
+{
+    char *ptr = buf;
+    uint32_t magic = batch ? FRAME_BATCH_MAGIC : FRAME_MAGIC;
+    memcpy(ptr, &magic, sizeof(magic));
+    ptr += sizeof(magic);
+    memcpy(ptr, &totalLen, sizeof(totalLen));
+    ptr += sizeof(totalLen);
+    if (batch) {
+        size_t count = m_list.size();
+        memcpy(ptr, &count, sizeof(count));
+        ptr += sizeof(count);
+    }
+    for (size_t i = 0; i < m_list.size(); ++i) {
+        size_t typeLen = types[i].length();
+        memcpy(ptr, &typeLen, sizeof(typeLen));
+        ptr += sizeof(typeLen);
+        memcpy(ptr, types[i].c_str(), typeLen);
+        ptr += typeLen;
+        memcpy(ptr, &dataLens[i], sizeof(dataLens[i]));
+        ptr += sizeof(dataLens[i]);
+        m_list[i]->SerializeWithCachedSizesToArray((uint8_t *) ptr);
+        ptr += dataLens[i];
+    }
+    UW_ASSERT((size_t)(ptr - buf) == totalLen);
+}
+
+void
+FrameEncoder::Append(std::string &out) const
+{
+    size_t start = out.size();
+    out.resize(start + totalLen);
+    Write(&out[start]);
+}
+
+namespace {
+
+// Reads fields of a frame that is contiguous in memory.
+class FlatReader
+{
+public:
+    FlatReader(const char *buf) : buf(buf) { }
+
+    void Copy(size_t off, void *out, size_t len) {
+        memcpy(out, buf + off, len);
+    }
+    std::string_view Type(size_t off, size_t len) {
+        return std::string_view(buf + off, len);
+    }
+    MessageView Data(size_t off, size_t len) {
+        return MessageView(buf + off, len);
+    }
+
+private:
+    const char *buf;
+};
+
+// Reads fields of a frame buffered in an evbuffer. Fields are read in
+// order, so the position only ever moves forward from the last one.
+class EvbufferReader
+{
+public:
+    EvbufferReader(struct evbuffer *in, size_t base,
+                   std::deque<std::string> &scratch)
+        : in(in), scratch(scratch), at(0) {
+        int res = evbuffer_ptr_set(in, &pos, base, EVBUFFER_PTR_SET);
+        UW_ASSERT(res == 0);
+    }
+
+    void Copy(size_t off, void *out, size_t len) {
+        Seek(off);
+        ev_ssize_t copied = evbuffer_copyout_from(in, &pos, out, len);
+        UW_ASSERT(copied == (ev_ssize_t) len);
+    }
+    std::string_view Type(size_t off, size_t len) {
+        if (len == 0) {
+            return std::string_view();
+        }
+        Seek(off);
+        struct evbuffer_iovec vec;
+        if (evbuffer_peek(in, len, &pos, &vec, 1) == 1) {
+            return std::string_view((const char *) vec.iov_base, len);
+        }
+        scratch.emplace_back(len, '\0');
+        Copy(off, &scratch.back()[0], len);
+        return scratch.back();
+    }
+    MessageView Data(size_t off, size_t len) {
+        MessageView view;
+        if (len == 0) {
+            return view;
+        }
+        Seek(off);
+        struct evbuffer_iovec vecs[4];
+        struct evbuffer_iovec *v = vecs;
+        std::vector<struct evbuffer_iovec> more;
+        int n = evbuffer_peek(in, len, &pos, vecs, 4);
+        if (n > 4) {
+            more.resize(n);
+            evbuffer_peek(in, len, &pos, more.data(), n);
+            v = more.data();
+        }
+        size_t left = len;
+        for (int i = 0; i < n && left > 0; ++i) {
+            size_t take = std::min(left, v[i].iov_len);
+            view.Append(v[i].iov_base, take);
+            left -= take;
+        }
+        UW_ASSERT(left == 0);
+        return view;
+    }
+
+private:
+    void Seek(size_t off) {
+        UW_ASSERT(off >= at);
+        if (off > at) {
+            int res = evbuffer_ptr_set(in, &pos, off - at, EVBUFFER_PTR_ADD);
+            UW_ASSERT(res == 0);
+            at = off;
+        }
+    }
+
+    struct evbuffer *in;
+    std::deque<std::string> &scratch;
+    struct evbuffer_ptr pos;
+    size_t at;
+};
+
+// Reads a size_t field at off, failing if it would run past end.
+template <class Reader>
+bool
+ReadLen(Reader &r, size_t &off, size_t end, size_t &out)
+{
+    if (end - off < sizeof(out)) {
+        return false;
+    }
+    r.Copy(off, &out, sizeof(out));
+    off += sizeof(out);
+    return true;
+}
+
+template <class Reader>
+FrameStatus
+Parse(Reader &r, size_t len, size_t &frameLen,
+      std::vector<std::string_view> &types, std::vector<MessageView> &datas)
+{
+    if (len < FRAME_HEADER_LEN) {
+        return FRAME_INCOMPLETE;
+    }
+    uint32_t magic;
+    size_t totalLen;
+    r.Copy(0, &magic, sizeof(magic));
+    r.Copy(sizeof(magic), &totalLen, sizeof(totalLen));
+    if ((magic != FRAME_MAGIC && magic != FRAME_BATCH_MAGIC) ||
+        totalLen < FRAME_HEADER_LEN || totalLen >= MAX_FRAME_LEN) {
+        return FRAME_MALFORMED;
+    }
+    if (len < totalLen) {
+        return FRAME_INCOMPLETE;
+    }
+
+    size_t off = FRAME_HEADER_LEN;
+    size_t count = 1;
+    if (magic == FRAME_BATCH_MAGIC && !ReadLen(r, off, totalLen, count)) {
+        return FRAME_MALFORMED;
+    }
+    // Every entry takes at least its two length fields.
+    if (count > (totalLen - off) / (2 * sizeof(size_t))) {
+        return FRAME_MALFORMED;
+    }
+
+    size_t oldTypes = types.size();
+    size_t oldDatas = datas.size();
+    types.reserve(oldTypes + count);
+    datas.reserve(oldDatas + count);
+    for (size_t i = 0; i < count; ++i) {
+        size_t typeLen, dataLen;
+        if (!ReadLen(r, off, totalLen, typeLen) ||
+            typeLen > totalLen - off) {
+            break;
+        }
+        std::string_view type = r.Type(off, typeLen);
+        off += typeLen;
+        if (!ReadLen(r, off, totalLen, dataLen) ||
+            dataLen > totalLen - off) {
+            break;
+        }
+        types.push_back(type);
+        datas.push_back(r.Data(off, dataLen));
+        off += dataLen;
+    }
+    if (types.size() - oldTypes != count || off != totalLen) {
+        types.resize(oldTypes);
+        datas.resize(oldDatas);
+        return FRAME_MALFORMED;
+    }
+    frameLen = totalLen;
+    return FRAME_OK;
+}
+
+} // namespace
+
+FrameStatus
+ParseFrame(const char *buf, size_t len, size_t &frameLen,
+           std::vector<std::string_view> &types,
+           std::vector<MessageView> &datas)
+{
+    FlatReader r(buf);
+    return Parse(r, len, frameLen, types, datas);
+}
+
+FrameStatus
+ParseFrame(struct evbuffer *in, size_t off, size_t &frameLen,
+           std::vector<std::string_view> &types,
+           std::vector<MessageView> &datas,
+           std::deque<std::string> &scratch)
+{
+    size_t avail = evbuffer_get_length(in);
+    if (avail < off + FRAME_HEADER_LEN) {
+        return FRAME_INCOMPLETE;
+    }
+    EvbufferReader r(in, off, scratch);
+    return Parse(r, avail - off, frameLen, types, datas);
+}
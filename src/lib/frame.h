@@ -0,0 +1,102 @@
+// -*- mode: c++; c-file-style: "k&r"; c-basic-offset: 4 -*-
+/***********************************************************************
+ *
+ * frame.h:
+ *   wire framing shared by the stream transports (TCP, io_uring and
+ *   shared memory)
+ *
+ * Copyright 2021 Florian Suri-Payer <fsp@cs.cornell.edu>
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ **********************************************************************/
+
+#ifndef _LIB_FRAME_H_
+#define _LIB_FRAME_H_
+
+#include "lib/messageview.h"
+
+#include <google/protobuf/message.h>
+
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <string_view>
+#include <vector>
+
+struct evbuffer;
+
+// A single-message frame is [MAGIC][totalLen][typeLen][type][dataLen][data];
+// a batch frame is [BATCH_MAGIC][totalLen][count] followed by count entries
+// of [typeLen][type][dataLen][data]. totalLen covers the whole frame.
+const uint32_t FRAME_MAGIC = 0x06121983;
+const uint32_t FRAME_BATCH_MAGIC = 0x06121984;
+const size_t FRAME_HEADER_LEN = sizeof(uint32_t) + sizeof(size_t);
+// Larger totalLen values are taken to be garbage.
+const size_t MAX_FRAME_LEN = 1073741826;
+
+// Measures messages once and writes them as one frame: a single-message
+// frame, or a batch frame when batch is set.
+class FrameEncoder
+{
+public:
+    FrameEncoder(const std::vector<::google::protobuf::Message *> &m_list,
+                 bool batch);
+
+    size_t size() const { return totalLen; }
+    // Writes exactly size() bytes to buf, serializing each message in place.
+    void Write(char *buf) const;
+    // Appends the frame to out.
+    void Append(std::string &out) const;
+
+private:
+    const std::vector<::google::protobuf::Message *> &m_list;
+    bool batch;
+    std::vector<std::string> types;
+    std::vector<size_t> dataLens;
+    size_t totalLen;
+};
+
+enum FrameStatus {
+    FRAME_OK,
+    // Fewer than the frame's bytes are available yet.
+    FRAME_INCOMPLETE,
+    // Bad magic, or lengths that do not add up; the stream cannot be
+    // resynchronized.
+    FRAME_MALFORMED
+};
+
+// Parses the frame at the start of the len bytes at buf, appending views of
+// its messages to types/datas and setting frameLen on FRAME_OK. Nothing is
+// appended unless the whole frame checks out.
+FrameStatus ParseFrame(const char *buf, size_t len, size_t &frameLen,
+                       std::vector<std::string_view> &types,
+                       std::vector<MessageView> &datas);
+// The same for the frame starting off bytes into in, which may span several
+// of its chunks. Data views follow the chunks; the rare type name that
+// straddles two is copied into scratch. The views stay valid until in is
+// drained or written to.
+FrameStatus ParseFrame(struct evbuffer *in, size_t off, size_t &frameLen,
+                       std::vector<std::string_view> &types,
+                       std::vector<MessageView> &datas,
+                       std::deque<std::string> &scratch);
+
+#endif  // _LIB_FRAME_H_
@@ -0,0 +1,139 @@
+/***********************************************************************
+ *
+ * Copyright 2021 Florian Suri-Payer <fsp@cs.cornell.edu>
+ *                Matthew Burke <matthelb@cs.cornell.edu>
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ **********************************************************************/
+#include "lib/histogram.h"
+
+Histogram::Histogram() {
+  Reset();
+}
+
+Histogram::Histogram(const Histogram &other) {
+  Reset();
+  Merge(other);
+}
+
+Histogram &Histogram::operator=(const Histogram &other) {
+  if (this != &other) {
+    Reset();
+    Merge(other);
+  }
+  return *this;
+}
+
+void Histogram::Merge(const Histogram &other) {
+  for (size_t i = 0; i < NUM_BUCKETS; ++i) {
+    uint64_t c = other.counts[i].load(std::memory_order_relaxed);
+    if (c > 0) {
+      counts[i].fetch_add(c, std::memory_order_relaxed);
+    }
+  }
+  total.fetch_add(other.total.load(std::memory_order_relaxed),
+      std::memory_order_relaxed);
+  sum.fetch_add(other.sum.load(std::memory_order_relaxed),
+      std::memory_order_relaxed);
+}
+
+void Histogram::Subtract(const Histogram &other) {
+  for (size_t i = 0; i < NUM_BUCKETS; ++i) {
+    uint64_t c = other.counts[i].load(std::memory_order_relaxed);
+    if (c > 0) {
+      counts[i].fetch_sub(c, std::memory_order_relaxed);
+    }
+  }
+  total.fetch_sub(other.total.load(std::memory_order_relaxed),
+      std::memory_order_relaxed);
+  sum.fetch_sub(other.sum.load(std::memory_order_relaxed),
+      std::memory_order_relaxed);
+}
+
+void Histogram::Reset() {
+  for (auto &c : counts) {
+    c.store(0, std::memory_order_relaxed);
+  }
+  total.store(0, std::memory_order_relaxed);
+  sum.store(0, std::memory_order_relaxed);
+}
+
+double Histogram::Mean() const {
+  uint64_t n = Count();
+  return n == 0 ? 0.0 : static_cast<double>(sum.load(std::memory_order_relaxed)) / n;
+}
+
+uint64_t Histogram::Min() const {
+  for (size_t i = 0; i < NUM_BUCKETS; ++i) {
+    if (counts[i].load(std::memory_order_relaxed) > 0) {
+      return BucketLowerBound(i);
+    }
+  }
+  return 0;
+}
+
+uint64_t Histogram::Max() const {
+  for (size_t i = NUM_BUCKETS; i > 0; --i) {
+    if (counts[i - 1].load(std::memory_order_relaxed) > 0) {
+      return BucketUpperBound(i - 1);
+    }
+  }
+  return 0;
+}
+
+uint64_t Histogram::Percentile(double p) const {
+  uint64_t n = Count();
+  if (n == 0) {
+    return 0;
+  }
+  uint64_t target = static_cast<uint64_t>(p / 100.0 * n + 0.5);
+  if (target == 0) {
+    target = 1;
+  }
+  uint64_t seen = 0;
+  for (size_t i = 0; i < NUM_BUCKETS; ++i) {
+    seen += counts[i].load(std::memory_order_relaxed);
+    if (seen >= target) {
+      return BucketUpperBound(i);
+    }
+  }
+  return Max();
+}
+
+uint64_t Histogram::BucketLowerBound(size_t idx) {
+  if (idx < SUB_BUCKETS) {
+    return idx;
+  }
+  size_t off = idx - SUB_BUCKETS;
+  int shift = off / (SUB_BUCKETS / 2) + 1;
+  uint64_t sub = off % (SUB_BUCKETS / 2) + SUB_BUCKETS / 2;
+  return sub << shift;
+}
+
+uint64_t Histogram::BucketUpperBound(size_t idx) {
+  if (idx < SUB_BUCKETS) {
+    return idx;
+  }
+  size_t off = idx - SUB_BUCKETS;
+  int shift = off / (SUB_BUCKETS / 2) + 1;
+  return BucketLowerBound(idx) + ((1UL << shift) - 1);
+}
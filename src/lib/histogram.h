@@ -0,0 +1,93 @@
+/***********************************************************************
+ *
+ * Copyright 2021 Florian Suri-Payer <fsp@cs.cornell.edu>
+ *                Matthew Burke <matthelb@cs.cornell.edu>
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ **********************************************************************/
+#ifndef _LIB_HISTOGRAM_H_
+#define _LIB_HISTOGRAM_H_
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+/*
+ * Log-linear histogram of non-negative integer samples (typically latencies
+ * in ns), in the style of HdrHistogram: every power-of-two range is split
+ * into SUB_BUCKETS / 2 equal buckets, so each reported value is within
+ * 2 / SUB_BUCKETS of the recorded one regardless of magnitude.
+ *
+ * Record is wait-free (one relaxed increment per counter) and meant to be
+ * called by a single owning thread; readers may snapshot and merge
+ * concurrently.
+ */
+class Histogram {
+ public:
+  static constexpr int SUB_BUCKET_BITS = 7;
+  static constexpr uint64_t SUB_BUCKETS = 1UL << SUB_BUCKET_BITS;
+  static constexpr size_t NUM_BUCKETS = SUB_BUCKETS +
+      (64 - SUB_BUCKET_BITS) * (SUB_BUCKETS / 2);
+
+  Histogram();
+  Histogram(const Histogram &other);
+  Histogram &operator=(const Histogram &other);
+
+  inline void Record(uint64_t value) {
+    counts[BucketIndex(value)].fetch_add(1, std::memory_order_relaxed);
+    total.fetch_add(1, std::memory_order_relaxed);
+    sum.fetch_add(value, std::memory_order_relaxed);
+  }
+
+  void Merge(const Histogram &other);
+  // Removes the samples of an earlier snapshot of this histogram.
+  void Subtract(const Histogram &other);
+  void Reset();
+
+  uint64_t Count() const { return total.load(std::memory_order_relaxed); }
+  double Mean() const;
+  uint64_t Min() const;
+  uint64_t Max() const;
+  // Smallest recorded value v such that at least p percent of the samples
+  // are <= v, reported as the upper bound of v's bucket.
+  uint64_t Percentile(double p) const;
+
+  static inline size_t BucketIndex(uint64_t value) {
+    if (value < SUB_BUCKETS) {
+      return value;
+    }
+    int mag = 63 - __builtin_clzll(value);
+    int shift = mag - SUB_BUCKET_BITS + 1;
+    return SUB_BUCKETS + (mag - SUB_BUCKET_BITS) * (SUB_BUCKETS / 2) +
+        ((value >> shift) - SUB_BUCKETS / 2);
+  }
+  static uint64_t BucketLowerBound(size_t idx);
+  static uint64_t BucketUpperBound(size_t idx);
+
+ private:
+  std::array<std::atomic<uint64_t>, NUM_BUCKETS> counts;
+  std::atomic<uint64_t> total;
+  std::atomic<uint64_t> sum;
+};
+
+#endif  /* _LIB_HISTOGRAM_H_ */
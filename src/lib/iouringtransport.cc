@@ -0,0 +1,1034 @@
+// -*- mode: c++; c-file-style: "k&r"; c-basic-offset: 4 -*-
+/***********************************************************************
+ *
+ * iouringtransport.cc:
+ *   message-passing network interface over TCP that submits socket
+ *   sends and receives through io_uring
+ *
+ * Copyright 2021 Florian Suri-Payer <fsp@cs.cornell.edu>
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ **********************************************************************/
+
+#include "lib/assert.h"
+#include "lib/configuration.h"
+#include "lib/frame.h"
+#include "lib/message.h"
+#include "lib/iouringtransport.h"
+
+#include <google/protobuf/message.h>
+#include <event2/thread.h>
+#include <liburing.h>
+
+#include <cstdlib>
+#include <cstring>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netdb.h>
+#include <poll.h>
+#include <signal.h>
+
+const int SOCKET_BUF_SIZE = 1048576;
+
+const unsigned QUEUE_DEPTH = 4096;
+// Provided receive buffers, shared by all connections.
+const unsigned NUM_RECV_BUFS = 1024;
+const size_t RECV_BUF_SIZE = 65536;
+const int RECV_BUF_GROUP = 0;
+
+// user_data of a completion: the connection pointer, tagged with the op.
+const uint64_t OP_SEND = 1;
+const uint64_t OP_RECV = 2;
+// Waits for send space after the kernel returned EAGAIN.
+const uint64_t OP_POLL = 3;
+const uint64_t OP_MASK = 3;
+
+struct IOUringTransport::Ring
+{
+    struct io_uring ring;
+    // Null when the kernel cannot register buffer rings; each connection
+    // then receives into its own buffer, one recv at a time.
+    struct io_uring_buf_ring *bufRing;
+    char *bufs;
+    bool multishot;
+};
+
+static struct io_uring_sqe *
+GetSQE(struct io_uring *ring)
+{
+    struct io_uring_sqe *sqe = io_uring_get_sqe(ring);
+    if (sqe == nullptr) {
+        // Submission queue is full: hand what we have to the kernel.
+        io_uring_submit(ring);
+        sqe = io_uring_get_sqe(ring);
+        UW_ASSERT(sqe != nullptr);
+    }
+    return sqe;
+}
+
+static void
+RecycleBuffer(struct io_uring_buf_ring *br, char *bufs, int bid)
+{
+    io_uring_buf_ring_add(br, bufs + bid * RECV_BUF_SIZE, RECV_BUF_SIZE, bid,
+                          io_uring_buf_ring_mask(NUM_RECV_BUFS), 0);
+    io_uring_buf_ring_advance(br, 1);
+}
+
+static void
+SetSocketOptions(int fd)
+{
+    int n = 1;
+    if (setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, (char *)&n, sizeof(n)) < 0) {
+        PWarning("Failed to set TCP_NODELAY on TCP socket");
+    }
+
+    n = SOCKET_BUF_SIZE;
+    if (setsockopt(fd, SOL_SOCKET, SO_RCVBUF, (char *)&n, sizeof(n)) < 0) {
+        PWarning("Failed to set SO_RCVBUF on socket");
+    }
+
+    if (setsockopt(fd, SOL_SOCKET, SO_SNDBUF, (char *)&n, sizeof(n)) < 0) {
+        PWarning("Failed to set SO_SNDBUF on socket");
+    }
+}
+
+static void
+BindToPort(int fd, const string &host, const string &port)
+{
+    struct addrinfo hints;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family   = AF_INET;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_protocol = 0;
+    hints.ai_flags    = AI_PASSIVE;
+    struct addrinfo *ai;
+    int res;
+    if ((res = getaddrinfo(host.c_str(), port.c_str(), &hints, &ai))) {
+        Panic("Failed to resolve host/port %s:%s: %s",
+              host.c_str(), port.c_str(), gai_strerror(res));
+    }
+    if (ai->ai_addr->sa_family != AF_INET) {
+        Panic("getaddrinfo returned a non IPv4 address");
+    }
+    struct sockaddr_in sin = *(sockaddr_in *)ai->ai_addr;
+    freeaddrinfo(ai);
+
+    Debug("Binding to %s %d TCP \n", inet_ntoa(sin.sin_addr), htons(sin.sin_port));
+
+    if (bind(fd, (sockaddr *)&sin, sizeof(sin)) < 0) {
+        PPanic("Failed to bind to socket: %s:%d", inet_ntoa(sin.sin_addr),
+            htons(sin.sin_port));
+    }
+}
+
+IOUringTransport::IOUringTransport(double dropRate, double reorderRate,
+                                   int dscp, bool handleSignals,
+                                   int process_id, int total_processes,
+                                   bool hyperthreading, bool server)
+    : lastTimerId(0), flushScheduled(false)
+{
+    tp.start(process_id, total_processes, hyperthreading, server);
+
+    evthread_use_pthreads();
+    libeventBase = event_base_new();
+    evthread_make_base_notifiable(libeventBase);
+
+    if (handleSignals) {
+        signalEvents.push_back(evsignal_new(libeventBase, SIGTERM,
+                                            SignalCallback, this));
+        signalEvents.push_back(evsignal_new(libeventBase, SIGINT,
+                                            SignalCallback, this));
+        signalEvents.push_back(evsignal_new(libeventBase, SIGPIPE,
+                                            [](int fd, short what, void* arg){}, this));
+
+        for (event *x : signalEvents) {
+            event_add(x, NULL);
+        }
+    }
+
+    ring = new Ring();
+    int res = io_uring_queue_init(QUEUE_DEPTH, &ring->ring, 0);
+    if (res < 0) {
+        Panic("Failed to set up io_uring: %s", strerror(-res));
+    }
+
+    ring->bufRing = io_uring_setup_buf_ring(&ring->ring, NUM_RECV_BUFS,
+                                            RECV_BUF_GROUP, 0, &res);
+    ring->bufs = nullptr;
+    ring->multishot = ring->bufRing != nullptr;
+    if (ring->bufRing == nullptr) {
+        Warning("io_uring buffer rings unavailable (%s); receiving into"
+                " per-connection buffers", strerror(-res));
+    } else {
+        ring->bufs = (char *) aligned_alloc(4096, NUM_RECV_BUFS * RECV_BUF_SIZE);
+        UW_ASSERT(ring->bufs != nullptr);
+        for (unsigned i = 0; i < NUM_RECV_BUFS; ++i) {
+            io_uring_buf_ring_add(ring->bufRing, ring->bufs + i * RECV_BUF_SIZE,
+                                  RECV_BUF_SIZE, i,
+                                  io_uring_buf_ring_mask(NUM_RECV_BUFS), i);
+        }
+        io_uring_buf_ring_advance(ring->bufRing, NUM_RECV_BUFS);
+    }
+
+    completionFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (completionFd < 0) {
+        PPanic("Failed to create io_uring completion eventfd");
+    }
+    if ((res = io_uring_register_eventfd(&ring->ring, completionFd)) < 0) {
+        Panic("Failed to register io_uring eventfd: %s", strerror(-res));
+    }
+    completionEvent = event_new(libeventBase, completionFd, EV_READ | EV_PERSIST,
+                                CompletionCallback, this);
+    event_add(completionEvent, NULL);
+    flushEvent = event_new(libeventBase, -1, 0, FlushCallback, this);
+}
+
+IOUringTransport::~IOUringTransport()
+{
+    mtx.lock();
+    event_free(flushEvent);
+    event_free(completionEvent);
+    if (ring->bufRing != nullptr) {
+        io_uring_free_buf_ring(&ring->ring, ring->bufRing, NUM_RECV_BUFS,
+                               RECV_BUF_GROUP);
+    }
+    io_uring_queue_exit(&ring->ring);
+    close(completionFd);
+    if (ring->bufs != nullptr) {
+        free(ring->bufs);
+    }
+    delete ring;
+
+    for (Connection *conn : allConns) {
+        if (conn->fd >= 0) {
+            close(conn->fd);
+        }
+        delete conn;
+    }
+    conns.clear();
+    allConns.clear();
+    for (Listener *info : listeners) {
+        event_free(info->acceptEvent);
+        close(info->acceptFd);
+        delete info;
+    }
+    listeners.clear();
+    for (auto kv : timers) {
+        event_free(kv.second->ev);
+        delete kv.second;
+    }
+    timers.clear();
+    for (event *x : signalEvents) {
+        event_free(x);
+    }
+    mtx.unlock();
+    event_base_free(libeventBase);
+}
+
+TCPTransportAddress
+IOUringTransport::LookupAddress(const transport::ReplicaAddress &addr)
+{
+    int res;
+    struct addrinfo hints;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family   = AF_INET;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_protocol = 0;
+    hints.ai_flags    = 0;
+    struct addrinfo *ai;
+    if ((res = getaddrinfo(addr.host.c_str(), addr.port.c_str(),
+                           &hints, &ai))) {
+        Panic("Failed to resolve %s:%s: %s",
+              addr.host.c_str(), addr.port.c_str(), gai_strerror(res));
+    }
+    if (ai->ai_addr->sa_family != AF_INET) {
+        Panic("getaddrinfo returned a non IPv4 address");
+    }
+    TCPTransportAddress out =
+        TCPTransportAddress(*((sockaddr_in *)ai->ai_addr));
+    freeaddrinfo(ai);
+    return out;
+}
+
+TCPTransportAddress
+IOUringTransport::LookupAddress(const transport::Configuration &config,
+                                int groupIdx,
+                                int replicaIdx)
+{
+    return LookupAddress(config.replica(groupIdx, replicaIdx));
+}
+
+void
+IOUringTransport::Register(TransportReceiver *receiver,
+                           const transport::Configuration &config,
+                           int groupIdx, int replicaIdx)
+{
+    RegisterInternal(receiver, config, groupIdx, replicaIdx, false);
+}
+
+void
+IOUringTransport::Register_batch(TransportReceiver *receiver,
+                                 const transport::Configuration &config,
+                                 int groupIdx, int replicaIdx)
+{
+    RegisterInternal(receiver, config, groupIdx, replicaIdx, true);
+}
+
+void
+IOUringTransport::RegisterInternal(TransportReceiver *receiver,
+                                   const transport::Configuration &config,
+                                   int groupIdx, int replicaIdx, bool batch)
+{
+    UW_ASSERT(replicaIdx < config.n);
+
+    RegisterConfiguration(receiver, config, groupIdx, replicaIdx);
+
+    // Clients don't need to accept TCP connections
+    if (replicaIdx == -1) {
+        return;
+    }
+
+    int fd;
+    if ((fd = socket(AF_INET, SOCK_STREAM, 0)) < 0) {
+        PPanic("Failed to create socket to accept TCP connections");
+    }
+
+    // Only the listening socket is non-blocking; accepts stay on libevent.
+    if (fcntl(fd, F_SETFL, O_NONBLOCK, 1)) {
+        PWarning("Failed to set O_NONBLOCK");
+    }
+
+    int n = 1;
+    if (setsockopt(fd, SOL_SOCKET,
+                   SO_REUSEADDR, (char *)&n, sizeof(n)) < 0) {
+        PWarning("Failed to set SO_REUSEADDR on TCP listening socket");
+    }
+    SetSocketOptions(fd);
+
+    BindToPort(fd, config.replica(groupIdx, replicaIdx).host,
+               config.replica(groupIdx, replicaIdx).port);
+
+    if (listen(fd, 5) < 0) {
+        PPanic("Failed to listen for TCP connections\n");
+    }
+
+    Listener *info = new Listener();
+    info->transport = this;
+    info->receiver = receiver;
+    info->acceptFd = fd;
+    info->batch = batch;
+    info->acceptEvent = event_new(libeventBase, fd, EV_READ | EV_PERSIST,
+                                  AcceptCallback, (void *)info);
+    event_add(info->acceptEvent, NULL);
+    {
+        std::unique_lock<std::shared_mutex> lck(mtx);
+        listeners.push_back(info);
+    }
+
+    struct sockaddr_in sin;
+    socklen_t sinsize = sizeof(sin);
+    if (getsockname(fd, (sockaddr *) &sin, &sinsize) < 0) {
+        PPanic("Failed to get socket name");
+    }
+    receiver->SetAddress(new TCPTransportAddress(sin));
+
+    Debug("Accepting connections on TCP port %hu \n", ntohs(sin.sin_port));
+}
+
+bool
+IOUringTransport::OrderedMulticast(TransportReceiver *src,
+    const std::vector<int> &groups, const Message &m)
+{
+    Panic("Not implemented :(.");
+}
+
+IOUringTransport::Connection *
+IOUringTransport::GetConnection(TransportReceiver *src,
+                                const TCPTransportAddress &dst, bool batch)
+{
+    auto dstSrc = std::make_pair(dst, src);
+    {
+        std::shared_lock<std::shared_mutex> lck(mtx);
+        auto kv = conns.find(dstSrc);
+        if (kv != conns.end()) {
+            return kv->second;
+        }
+    }
+    std::unique_lock<std::shared_mutex> lck(mtx);
+    auto kv = conns.find(dstSrc);
+    if (kv != conns.end()) {
+        return kv->second;
+    }
+    return ConnectTCP(dstSrc, batch);
+}
+
+// Called with mtx held exclusively.
+IOUringTransport::Connection *
+IOUringTransport::ConnectTCP(const ConnKey &dstSrc, bool batch)
+{
+    Debug("Opening new TCP connection to %s:%d \n",
+          inet_ntoa(dstSrc.first.addr.sin_addr),
+          htons(dstSrc.first.addr.sin_port));
+
+    int fd;
+    if ((fd = socket(AF_INET, SOCK_STREAM, 0)) < 0) {
+        PPanic("Failed to create socket for outgoing TCP connection");
+    }
+    SetSocketOptions(fd);
+
+    // Start the handshake without blocking the sender; this also binds the
+    // local address handed to the receiver below.
+    if (fcntl(fd, F_SETFL, O_NONBLOCK, 1)) {
+        PWarning("Failed to set O_NONBLOCK on outgoing TCP socket");
+    }
+    if (connect(fd, (struct sockaddr *)&(dstSrc.first.addr),
+                sizeof(dstSrc.first.addr)) < 0 && errno != EINPROGRESS) {
+        PWarning("Failed to connect to server via TCP");
+    }
+    // io_uring hands EAGAIN back to us on O_NONBLOCK sockets instead of
+    // waiting for readiness itself, so the data path runs in blocking mode.
+    // Sends queued before the handshake completes wait for it in the kernel.
+    if (fcntl(fd, F_SETFL, 0)) {
+        PWarning("Failed to clear O_NONBLOCK on outgoing TCP socket");
+    }
+
+    Connection *conn = new Connection(fd, dstSrc.first, dstSrc.second, batch);
+    conns[dstSrc] = conn;
+    allConns.push_back(conn);
+
+    struct sockaddr_in sin;
+    socklen_t sinsize = sizeof(sin);
+    if (getsockname(fd, (sockaddr *) &sin, &sinsize) < 0) {
+        PPanic("Failed to get socket name");
+    }
+    if (dstSrc.second->GetAddress() == nullptr) {
+        dstSrc.second->SetAddress(new TCPTransportAddress(sin));
+    }
+
+    Debug("Opened TCP connection to %s:%d from %s:%d \n",
+          inet_ntoa(dstSrc.first.addr.sin_addr), htons(dstSrc.first.addr.sin_port),
+          inet_ntoa(sin.sin_addr), htons(sin.sin_port));
+
+    // The loop thread arms its receive on the next flush.
+    Schedule(conn);
+    return conn;
+}
+
+bool
+IOUringTransport::SendMessageInternal(TransportReceiver *src,
+                                      const TCPTransportAddress &dst,
+                                      const Message &m)
+{
+    Debug("Sending %s message over io_uring to %s:%d \n",
+        m.GetTypeName().c_str(), inet_ntoa(dst.addr.sin_addr),
+        htons(dst.addr.sin_port));
+
+    Connection *conn = GetConnection(src, dst, false);
+    bool schedule;
+    {
+        std::lock_guard<std::mutex> lck(conn->outMtx);
+        FrameEncoder({ const_cast<Message *>(&m) }, false).Append(conn->pending);
+        schedule = !conn->scheduled;
+        conn->scheduled = true;
+    }
+    if (schedule) {
+        Schedule(conn);
+    }
+    return true;
+}
+
+bool
+IOUringTransport::SendMessageInternal_batch(TransportReceiver *src,
+                                            const TCPTransportAddress &dst,
+                                            const std::vector<Message *> &m_list)
+{
+    if (m_list.empty()) {
+        return true;
+    }
+
+    Connection *conn = GetConnection(src, dst, true);
+    bool schedule;
+    {
+        std::lock_guard<std::mutex> lck(conn->outMtx);
+        FrameEncoder(m_list, true).Append(conn->pending);
+        schedule = !conn->scheduled;
+        conn->scheduled = true;
+    }
+    if (schedule) {
+        Schedule(conn);
+    }
+    return true;
+}
+
+void
+IOUringTransport::Schedule(Connection *conn)
+{
+    {
+        std::lock_guard<std::mutex> lck(flushMtx);
+        flushQueue.push_back(conn);
+    }
+    // Only the producer that flips flushScheduled wakes the loop.
+    if (!flushScheduled.exchange(true)) {
+        event_active(flushEvent, EV_TIMEOUT, 0);
+    }
+}
+
+void
+IOUringTransport::Flush()
+{
+    flushScheduled = false;
+    {
+        std::lock_guard<std::mutex> lck(flushMtx);
+        flushing.swap(flushQueue);
+    }
+    for (Connection *conn : flushing) {
+        if (conn->closed) {
+            continue;
+        }
+        if (!conn->recvArmed) {
+            ArmRecv(conn);
+        }
+        StartSend(conn);
+    }
+    flushing.clear();
+    // One io_uring_enter for every connection that became dirty since the
+    // last flush.
+    Submit();
+}
+
+void
+IOUringTransport::Submit()
+{
+    int res = io_uring_submit(&ring->ring);
+    if (res < 0 && res != -EBUSY && res != -EAGAIN) {
+        Warning("io_uring_submit failed: %s", strerror(-res));
+    }
+}
+
+void
+IOUringTransport::StartSend(Connection *conn)
+{
+    if (conn->sending || conn->closed) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lck(conn->outMtx);
+        conn->scheduled = false;
+        if (conn->pending.empty()) {
+            return;
+        }
+        conn->inflight.clear();
+        conn->inflight.swap(conn->pending);
+    }
+    conn->inflightOff = 0;
+    conn->sending = true;
+
+    struct io_uring_sqe *sqe = GetSQE(&ring->ring);
+    io_uring_prep_send(sqe, conn->fd, conn->inflight.data(),
+                       conn->inflight.size(), MSG_NOSIGNAL);
+    io_uring_sqe_set_data64(sqe, (uint64_t)(uintptr_t) conn | OP_SEND);
+    ++conn->opsInFlight;
+}
+
+void
+IOUringTransport::ArmRecv(Connection *conn)
+{
+    struct io_uring_sqe *sqe = GetSQE(&ring->ring);
+    if (ring->bufRing == nullptr) {
+        if (conn->recvBuf.empty()) {
+            conn->recvBuf.resize(RECV_BUF_SIZE);
+        }
+        io_uring_prep_recv(sqe, conn->fd, conn->recvBuf.data(),
+                           conn->recvBuf.size(), 0);
+    } else {
+        if (ring->multishot) {
+            io_uring_prep_recv_multishot(sqe, conn->fd, nullptr, 0, 0);
+        } else {
+            io_uring_prep_recv(sqe, conn->fd, nullptr, RECV_BUF_SIZE, 0);
+        }
+        sqe->flags |= IOSQE_BUFFER_SELECT;
+        sqe->buf_group = RECV_BUF_GROUP;
+    }
+    io_uring_sqe_set_data64(sqe, (uint64_t)(uintptr_t) conn | OP_RECV);
+    conn->recvArmed = true;
+    ++conn->opsInFlight;
+}
+
+void
+IOUringTransport::OnSend(Connection *conn, int res)
+{
+    --conn->opsInFlight;
+    if (res == -EAGAIN && !conn->closed) {
+        // The socket buffer is full: wait for room rather than resubmitting
+        // a send that would fail the same way.
+        struct io_uring_sqe *sqe = GetSQE(&ring->ring);
+        io_uring_prep_poll_add(sqe, conn->fd, POLLOUT);
+        io_uring_sqe_set_data64(sqe, (uint64_t)(uintptr_t) conn | OP_POLL);
+        ++conn->opsInFlight;
+        return;
+    } else if (res == -EINTR || res == -EAGAIN) {
+        res = 0;
+    } else if (res < 0) {
+        Warning("Error on TCP connection to %s:%d: %s",
+                inet_ntoa(conn->remote.addr.sin_addr),
+                htons(conn->remote.addr.sin_port), strerror(-res));
+        conn->sending = false;
+        CloseConnection(conn);
+        return;
+    }
+
+    conn->inflightOff += res;
+    if (conn->closed) {
+        conn->sending = false;
+        return;
+    }
+    if (conn->inflightOff < conn->inflight.size()) {
+        // Short write: send the rest before anything queued behind it.
+        SendRest(conn);
+        return;
+    }
+    conn->sending = false;
+    StartSend(conn);
+}
+
+void
+IOUringTransport::OnPoll(Connection *conn, int res)
+{
+    --conn->opsInFlight;
+    if (conn->closed) {
+        conn->sending = false;
+        return;
+    }
+    if (res < 0 && res != -EINTR) {
+        Warning("Error waiting on TCP connection to %s:%d: %s",
+                inet_ntoa(conn->remote.addr.sin_addr),
+                htons(conn->remote.addr.sin_port), strerror(-res));
+        conn->sending = false;
+        CloseConnection(conn);
+        return;
+    }
+    SendRest(conn);
+}
+
+void
+IOUringTransport::SendRest(Connection *conn)
+{
+    struct io_uring_sqe *sqe = GetSQE(&ring->ring);
+    io_uring_prep_send(sqe, conn->fd,
+                       conn->inflight.data() + conn->inflightOff,
+                       conn->inflight.size() - conn->inflightOff,
+                       MSG_NOSIGNAL);
+    io_uring_sqe_set_data64(sqe, (uint64_t)(uintptr_t) conn | OP_SEND);
+    ++conn->opsInFlight;
+}
+
+void
+IOUringTransport::OnRecv(Connection *conn, int res, uint32_t flags)
+{
+    if (!(flags & IORING_CQE_F_MORE)) {
+        // The kernel has retired this receive.
+        conn->recvArmed = false;
+        --conn->opsInFlight;
+    }
+
+    if (res > 0) {
+        if (flags & IORING_CQE_F_BUFFER) {
+            int bid = flags >> IORING_CQE_BUFFER_SHIFT;
+            if (!conn->closed) {
+                Deliver(conn, ring->bufs + bid * RECV_BUF_SIZE, res);
+            }
+            RecycleBuffer(ring->bufRing, ring->bufs, bid);
+        } else if (!conn->closed) {
+            Deliver(conn, conn->recvBuf.data(), res);
+        }
+    } else if (res == -EINVAL && ring->multishot) {
+        Warning("Kernel lacks multishot receive; receiving one buffer at a time");
+        ring->multishot = false;
+    } else if (res != -ENOBUFS && res != -EINTR && res != -EAGAIN) {
+        // EOF or a connection error. Our buffers are recycled above, so
+        // running out of them (ENOBUFS) only needs a re-arm.
+        if (res < 0) {
+            Debug("Error on TCP connection to %s:%d: %s",
+                  inet_ntoa(conn->remote.addr.sin_addr),
+                  htons(conn->remote.addr.sin_port), strerror(-res));
+        }
+        CloseConnection(conn);
+        return;
+    }
+
+    if (!conn->recvArmed && !conn->closed) {
+        ArmRecv(conn);
+    }
+}
+
+void
+IOUringTransport::Deliver(Connection *conn, const char *data, size_t len)
+{
+    // Frames are parsed in place in the kernel-filled buffer; only the tail
+    // of a frame that continues in the next buffer is copied.
+    const char *buf = data;
+    size_t avail = len;
+    if (!conn->in.empty()) {
+        conn->in.append(data, len);
+        buf = conn->in.data();
+        avail = conn->in.size();
+    }
+
+    std::vector<std::string_view> msgTypes;
+    std::vector<MessageView> msgs;
+    size_t used;
+    if (!ParseFrames(buf, avail, used, msgTypes, msgs)) {
+        // A garbled stream cannot be resynchronized: drop the connection,
+        // after delivering the frames that preceded the bad one.
+        Warning("Malformed frame on TCP connection from %s:%d; closing it",
+                inet_ntoa(conn->remote.addr.sin_addr),
+                htons(conn->remote.addr.sin_port));
+        DeliverViews(conn, msgTypes, msgs);
+        CloseConnection(conn);
+        return;
+    }
+    DeliverViews(conn, msgTypes, msgs);
+
+    if (conn->in.empty()) {
+        conn->in.assign(data + used, len - used);
+    } else {
+        conn->in.erase(0, used);
+    }
+}
+
+void
+IOUringTransport::DeliverViews(Connection *conn,
+                               const std::vector<std::string_view> &types,
+                               const std::vector<MessageView> &datas)
+{
+    if (types.empty()) {
+        return;
+    }
+    Debug("Received %lu messages, first %.*s.\n", types.size(),
+        (int) types[0].size(), types[0].data());
+    if (conn->batch) {
+        conn->receiver->ReceiveMessageView_batch(conn->remote, types,
+                                                 datas, nullptr);
+    } else {
+        for (size_t i = 0; i < types.size(); ++i) {
+            conn->receiver->ReceiveMessageView(conn->remote, types[i],
+                                               datas[i], nullptr);
+        }
+    }
+}
+
+bool
+IOUringTransport::ParseFrames(const char *buf, size_t len, size_t &used,
+                              std::vector<std::string_view> &types,
+                              std::vector<MessageView> &datas)
+{
+    used = 0;
+    while (true) {
+        size_t frameLen;
+        switch (ParseFrame(buf + used, len - used, frameLen, types, datas)) {
+        case FRAME_OK:
+            used += frameLen;
+            break;
+        case FRAME_INCOMPLETE:
+            return true;
+        case FRAME_MALFORMED:
+            return false;
+        }
+    }
+}
+
+void
+IOUringTransport::CloseConnection(Connection *conn)
+{
+    if (conn->closed.exchange(true)) {
+        return;
+    }
+    {
+        std::unique_lock<std::shared_mutex> lck(mtx);
+        auto kv = conns.find(std::make_pair(conn->remote, conn->receiver));
+        if (kv != conns.end() && kv->second == conn) {
+            conns.erase(kv);
+        }
+    }
+    {
+        std::lock_guard<std::mutex> lck(conn->outMtx);
+        conn->pending.clear();
+    }
+    conn->in.clear();
+    // Fails outstanding operations; the socket is closed once they are back.
+    shutdown(conn->fd, SHUT_RDWR);
+}
+
+void
+IOUringTransport::ReapCompletions()
+{
+    struct io_uring_cqe *cqe;
+    unsigned head;
+    unsigned count = 0;
+    io_uring_for_each_cqe(&ring->ring, head, cqe) {
+        ++count;
+        Connection *conn = (Connection *)(uintptr_t)(cqe->user_data & ~OP_MASK);
+        switch (cqe->user_data & OP_MASK) {
+        case OP_SEND:
+            OnSend(conn, cqe->res);
+            break;
+        case OP_RECV:
+            OnRecv(conn, cqe->res, cqe->flags);
+            break;
+        case OP_POLL:
+            OnPoll(conn, cqe->res);
+            break;
+        default:
+            NOT_REACHABLE();
+        }
+        if (conn->closed && conn->opsInFlight == 0 && conn->fd >= 0) {
+            close(conn->fd);
+            conn->fd = -1;
+        }
+    }
+    io_uring_cq_advance(&ring->ring, count);
+    // Re-arms and follow-up sends from this batch go out together.
+    Submit();
+}
+
+void
+IOUringTransport::Run()
+{
+    int ret = event_base_dispatch(libeventBase);
+    Debug("event_base_dispatch returned %d. \n", ret);
+}
+
+void
+IOUringTransport::Stop()
+{
+    tp.stop();
+    event_base_loopbreak(libeventBase);
+}
+
+void
+IOUringTransport::Close(TransportReceiver *receiver)
+{
+    // Runs off the loop thread: mark the connections closed so the loop
+    // neither sends on them nor delivers from them again, shut the sockets
+    // down, and let the loop retire them as their operations fail.
+    std::unique_lock<std::shared_mutex> lck(mtx);
+    for (auto itr = conns.begin(); itr != conns.end(); ) {
+        if (itr->first.second == receiver) {
+            Connection *conn = itr->second;
+            // Shut down before marking: the loop closes the socket only
+            // once the connection is marked closed.
+            shutdown(conn->fd, SHUT_RDWR);
+            if (!conn->closed.exchange(true)) {
+                std::lock_guard<std::mutex> outLck(conn->outMtx);
+                conn->pending.clear();
+            }
+            itr = conns.erase(itr);
+        } else {
+            ++itr;
+        }
+    }
+}
+
+int
+IOUringTransport::Timer(uint64_t ms, timer_callback_t cb)
+{
+    struct timeval tv;
+    tv.tv_sec = ms / 1000;
+    tv.tv_usec = (ms % 1000) * 1000;
+    return TimerInternal(tv, cb);
+}
+
+int
+IOUringTransport::TimerMicro(uint64_t us, timer_callback_t cb)
+{
+    struct timeval tv;
+    tv.tv_sec = us / 1000000UL;
+    tv.tv_usec = us % 1000000UL;
+    return TimerInternal(tv, cb);
+}
+
+int
+IOUringTransport::TimerInternal(struct timeval &tv, timer_callback_t cb)
+{
+    std::unique_lock<std::shared_mutex> lck(mtx);
+
+    TimerInfo *info = new TimerInfo();
+    ++lastTimerId;
+    info->transport = this;
+    info->id = lastTimerId;
+    info->cb = cb;
+    info->ev = event_new(libeventBase, -1, 0, TimerCallback, info);
+
+    timers[info->id] = info;
+    event_add(info->ev, &tv);
+
+    return info->id;
+}
+
+bool
+IOUringTransport::CancelTimer(int id)
+{
+    std::unique_lock<std::shared_mutex> lck(mtx);
+    auto kv = timers.find(id);
+    if (kv == timers.end()) {
+        return false;
+    }
+    TimerInfo *info = kv->second;
+    timers.erase(kv);
+    event_del(info->ev);
+    event_free(info->ev);
+    delete info;
+
+    return true;
+}
+
+void
+IOUringTransport::CancelAllTimers()
+{
+    mtx.lock();
+    while (!timers.empty()) {
+        int id = timers.begin()->first;
+        mtx.unlock();
+        CancelTimer(id);
+        mtx.lock();
+    }
+    mtx.unlock();
+}
+
+void
+IOUringTransport::OnTimer(TimerInfo *info)
+{
+    {
+        std::unique_lock<std::shared_mutex> lck(mtx);
+        timers.erase(info->id);
+        event_del(info->ev);
+        event_free(info->ev);
+    }
+
+    info->cb();
+
+    delete info;
+}
+
+void
+IOUringTransport::TimerCallback(evutil_socket_t fd, short what, void *arg)
+{
+    TimerInfo *info = (TimerInfo *)arg;
+    UW_ASSERT(what & EV_TIMEOUT);
+    info->transport->OnTimer(info);
+}
+
+void IOUringTransport::DispatchTP(job_task_t f, job_callback_t cb) {
+  tp.dispatch(std::move(f), std::move(cb), libeventBase);
+}
+
+void IOUringTransport::DispatchTP_local(job_task_t f, job_callback_t cb) {
+  tp.dispatch_local(std::move(f), std::move(cb));
+}
+
+void IOUringTransport::DispatchTP_noCB(job_task_t f) {
+  tp.detatch(std::move(f));
+}
+void IOUringTransport::DispatchTP_noCB_ptr(std::function<void*()> *f) {
+  tp.detatch_ptr(f);
+}
+void IOUringTransport::DispatchTP_main(job_task_t f) {
+  tp.detatch_main(std::move(f));
+}
+void IOUringTransport::IssueCB(job_callback_t cb, void* arg) {
+  tp.issueCallback(std::move(cb), arg, libeventBase);
+}
+
+uint64_t IOUringTransport::GraceToken() {
+  return tp.graceToken();
+}
+
+bool IOUringTransport::GraceExpired(uint64_t token) {
+  return tp.graceExpired(token);
+}
+
+void
+IOUringTransport::SignalCallback(evutil_socket_t fd, short what, void *arg)
+{
+    Debug("Terminating on SIGTERM/SIGINT");
+    IOUringTransport *transport = (IOUringTransport *)arg;
+    event_base_loopbreak(transport->libeventBase);
+}
+
+void
+IOUringTransport::AcceptCallback(evutil_socket_t fd, short what, void *arg)
+{
+    Listener *info = (Listener *)arg;
+    IOUringTransport *transport = info->transport;
+
+    if (!(what & EV_READ)) {
+        return;
+    }
+
+    int newfd;
+    struct sockaddr_in sin;
+    socklen_t sinLength = sizeof(sin);
+    // accept() leaves the new socket in blocking mode, as io_uring wants it.
+    if ((newfd = accept(fd, (struct sockaddr *)&sin, &sinLength)) < 0) {
+        PWarning("Failed to accept incoming TCP connection");
+        return;
+    }
+    SetSocketOptions(newfd);
+
+    TCPTransportAddress client = TCPTransportAddress(sin);
+    Connection *conn = new Connection(newfd, client, info->receiver,
+                                      info->batch);
+    {
+        std::unique_lock<std::shared_mutex> lck(transport->mtx);
+        transport->conns[std::make_pair(client, info->receiver)] = conn;
+        transport->allConns.push_back(conn);
+    }
+    transport->ArmRecv(conn);
+    transport->Submit();
+
+    Debug("Opened incoming TCP connection from %s:%d \n",
+          inet_ntoa(sin.sin_addr), htons(sin.sin_port));
+}
+
+void
+IOUringTransport::CompletionCallback(evutil_socket_t fd, short what, void *arg)
+{
+    IOUringTransport *transport = (IOUringTransport *)arg;
+    // Clear the counter first: completions posted from here on signal again.
+    uint64_t n;
+    if (read(fd, &n, sizeof(n)) < 0 && errno != EAGAIN) {
+        PWarning("Failed to read io_uring completion eventfd");
+    }
+    transport->ReapCompletions();
+}
+
+void
+IOUringTransport::FlushCallback(evutil_socket_t fd, short what, void *arg)
+{
+    ((IOUringTransport *)arg)->Flush();
+}
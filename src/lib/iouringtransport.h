@@ -0,0 +1,242 @@
+// -*- mode: c++; c-file-style: "k&r"; c-basic-offset: 4 -*-
+/***********************************************************************
+ *
+ * iouringtransport.h:
+ *   message-passing network interface over TCP that submits socket
+ *   sends and receives through io_uring
+ *
+ * Copyright 2021 Florian Suri-Payer <fsp@cs.cornell.edu>
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ **********************************************************************/
+
+#ifndef _LIB_IOURINGTRANSPORT_H_
+#define _LIB_IOURINGTRANSPORT_H_
+
+#include "lib/configuration.h"
+#include "lib/transport.h"
+#include "lib/transportcommon.h"
+#include "lib/tcptransport.h"
+#include "lib/threadpool.h"
+
+#include <event2/event.h>
+
+#include <atomic>
+#include <list>
+#include <map>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Drop-in alternative to TCPTransport for Linux. Addresses, framing, timers
+// and the DispatchTP* thread pool behave exactly as in TCPTransport; only
+// the socket I/O differs:
+//  - Senders on any thread append encoded frames to the connection's output
+//    buffer. The libevent loop then submits one send per dirty connection,
+//    for all connections at once, with a single io_uring_enter.
+//  - Each connection has one multishot receive that picks buffers from a
+//    ring registered with the kernel, so the kernel delivers data without a
+//    syscall per read. Complete frames are handed to the receiver in place.
+//  - Completions are signalled on an eventfd that the libevent loop watches.
+// Timers, accepts and thread pool callbacks stay on libevent.
+class IOUringTransport : public TransportCommon<TCPTransportAddress>
+{
+public:
+    IOUringTransport(double dropRate = 0.0, double reorderRate = 0.0,
+                     int dscp = 0, bool handleSignals = true,
+                     int process_id = 0, int total_processes = 1,
+                     bool hyperthreading = true, bool server = true);
+    virtual ~IOUringTransport();
+    virtual void Register(TransportReceiver *receiver,
+                  const transport::Configuration &config,
+                  int groupIdx,
+                  int replicaIdx) override;
+    virtual void Register_batch(TransportReceiver *receiver,
+                  const transport::Configuration &config,
+                  int groupIdx,
+                  int replicaIdx) override;
+    virtual bool OrderedMulticast(TransportReceiver *src,
+        const std::vector<int> &groups, const Message &m) override;
+
+    virtual void Run() override;
+    virtual void Stop() override;
+    virtual void Close(TransportReceiver *receiver) override;
+    virtual int Timer(uint64_t ms, timer_callback_t cb) override;
+    virtual int TimerMicro(uint64_t us, timer_callback_t cb) override;
+    virtual bool CancelTimer(int id) override;
+    virtual void CancelAllTimers() override;
+
+    void DispatchTP(job_task_t f, job_callback_t cb);
+    void DispatchTP_local(job_task_t f, job_callback_t cb);
+    void DispatchTP_noCB(job_task_t f);
+    void DispatchTP_noCB_ptr(std::function<void*()> *f);
+    void DispatchTP_main(job_task_t f);
+    void IssueCB(job_callback_t cb, void* arg);
+    virtual uint64_t GraceToken() override;
+    virtual bool GraceExpired(uint64_t token) override;
+
+    virtual TCPTransportAddress
+    LookupAddress(const transport::Configuration &config,
+                  int groupIdx,
+                  int replicaIdx) override;
+
+    TCPTransportAddress
+    LookupAddress(const transport::ReplicaAddress &addr);
+
+    // Parses the complete frames (see lib/frame.h) at the start of buf,
+    // appending views of their messages to types/datas and setting used to
+    // the number of bytes they span; the rest is an incomplete frame.
+    // Returns false if a malformed frame follows them.
+    static bool ParseFrames(const char *buf, size_t len, size_t &used,
+                            std::vector<std::string_view> &types,
+                            std::vector<MessageView> &datas);
+
+private:
+    struct Ring;
+
+    struct Connection
+    {
+        int fd;
+        TCPTransportAddress remote;
+        TransportReceiver *receiver;
+        // Deliver through ReceiveMessageView_batch rather than per message.
+        bool batch;
+
+        // Frames written by senders, not yet handed to the kernel.
+        std::mutex outMtx;
+        std::string pending;
+        // On the flush queue; protected by outMtx.
+        bool scheduled;
+
+        // Owned by the loop thread.
+        std::string inflight;
+        size_t inflightOff;
+        bool sending;
+        bool recvArmed;
+        // Also set by Close off the loop thread.
+        std::atomic_bool closed;
+        // Sends and receives the kernel still holds; the socket is only
+        // closed once they have all completed.
+        int opsInFlight;
+        // Tail of a frame that spans receive buffers.
+        std::string in;
+        // Receive buffer when the kernel has no provided buffer rings.
+        std::vector<char> recvBuf;
+
+        Connection(int fd, const TCPTransportAddress &remote,
+                   TransportReceiver *receiver, bool batch)
+            : fd(fd), remote(remote), receiver(receiver), batch(batch),
+              scheduled(false), inflightOff(0), sending(false),
+              recvArmed(false), closed(false), opsInFlight(0) { }
+    };
+
+    struct TimerInfo
+    {
+        IOUringTransport *transport;
+        timer_callback_t cb;
+        event *ev;
+        int id;
+    };
+
+    struct Listener
+    {
+        IOUringTransport *transport;
+        TransportReceiver *receiver;
+        int acceptFd;
+        bool batch;
+        event *acceptEvent;
+    };
+
+    typedef std::pair<TCPTransportAddress, TransportReceiver *> ConnKey;
+
+    std::shared_mutex mtx;
+    event_base *libeventBase;
+    std::vector<event *> signalEvents;
+    int lastTimerId;
+    std::map<int, TimerInfo *> timers;
+    std::list<Listener *> listeners;
+    std::map<ConnKey, Connection *> conns;
+    // Every connection ever opened. Completions may still name a closed
+    // connection, so they are only freed with the transport.
+    std::list<Connection *> allConns;
+    ThreadPool tp;
+
+    Ring *ring;
+    int completionFd;
+    event *completionEvent;
+    event *flushEvent;
+    std::atomic_bool flushScheduled;
+    std::mutex flushMtx;
+    std::vector<Connection *> flushQueue;
+    std::vector<Connection *> flushing;
+
+    virtual bool SendMessageInternal(TransportReceiver *src,
+                             const TCPTransportAddress &dst,
+                             const Message &m) override;
+    virtual bool SendMessageInternal_batch(TransportReceiver *src,
+                                  const TCPTransportAddress &dst,
+                                  const std::vector<Message *> &m_list) override;
+
+    virtual const TCPTransportAddress *
+    LookupMulticastAddress(const transport::Configuration *config) override {
+      return nullptr;
+    };
+
+    virtual const TCPTransportAddress *
+    LookupFCAddress(const transport::Configuration *cfg) override {
+      return nullptr;
+    }
+
+    void RegisterInternal(TransportReceiver *receiver,
+                          const transport::Configuration &config,
+                          int groupIdx, int replicaIdx, bool batch);
+    Connection *GetConnection(TransportReceiver *src,
+                              const TCPTransportAddress &dst, bool batch);
+    Connection *ConnectTCP(const ConnKey &dstSrc, bool batch);
+    void Schedule(Connection *conn);
+    void Flush();
+    void StartSend(Connection *conn);
+    void ArmRecv(Connection *conn);
+    void OnRecv(Connection *conn, int res, uint32_t flags);
+    void OnSend(Connection *conn, int res);
+    void OnPoll(Connection *conn, int res);
+    void SendRest(Connection *conn);
+    void Deliver(Connection *conn, const char *data, size_t len);
+    void DeliverViews(Connection *conn,
+                      const std::vector<std::string_view> &types,
+                      const std::vector<MessageView> &datas);
+    void CloseConnection(Connection *conn);
+    void ReapCompletions();
+    void Submit();
+    int TimerInternal(struct timeval &tv, timer_callback_t cb);
+    void OnTimer(TimerInfo *info);
+
+    static void TimerCallback(evutil_socket_t fd, short what, void *arg);
+    static void SignalCallback(evutil_socket_t fd, short what, void *arg);
+    static void AcceptCallback(evutil_socket_t fd, short what, void *arg);
+    static void CompletionCallback(evutil_socket_t fd, short what, void *arg);
+    static void FlushCallback(evutil_socket_t fd, short what, void *arg);
+};
+
+#endif  // _LIB_IOURINGTRANSPORT_H_
@@ -0,0 +1,147 @@
+// -*- mode: c++; c-file-style: "k&r"; c-basic-offset: 4 -*-
+/***********************************************************************
+ *
+ * messageview.h:
+ *   read-only, possibly non-contiguous view of a received message
+ *
+ * Copyright 2021 Florian Suri-Payer <fsp@cs.cornell.edu>
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ **********************************************************************/
+
+#ifndef _LIB_MESSAGEVIEW_H_
+#define _LIB_MESSAGEVIEW_H_
+
+#include <sys/uio.h>
+
+#include <string>
+#include <vector>
+
+#include <google/protobuf/message.h>
+#include <google/protobuf/io/zero_copy_stream.h>
+
+/*
+ * A message payload that still lives in the transport's receive buffer,
+ * as one or more (iovec) segments. A view does not own its memory: it is
+ * only valid until the receive upcall that handed it out returns, so
+ * anything that outlives the upcall must parse or copy it first.
+ */
+class MessageView
+{
+public:
+    MessageView() : first({nullptr, 0}), len(0) { }
+    MessageView(const char *data, size_t size)
+        : first({const_cast<char *>(data), size}), len(size) { }
+    MessageView(const std::string &data)
+        : MessageView(data.data(), data.size()) { }
+
+    void Append(const void *data, size_t size) {
+        if (size == 0) {
+            return;
+        }
+        if (first.iov_len == 0) {
+            first = {const_cast<void *>(data), size};
+        } else {
+            rest.push_back({const_cast<void *>(data), size});
+        }
+        len += size;
+    }
+
+    size_t size() const { return len; }
+    bool contiguous() const { return rest.empty(); }
+
+    // Parses msg straight out of the segments, without linearizing them.
+    bool ParseInto(::google::protobuf::Message *msg) const {
+        if (contiguous()) {
+            return msg->ParseFromArray(first.iov_base, first.iov_len);
+        }
+        InputStream in(*this);
+        return msg->ParseFromZeroCopyStream(&in);
+    }
+
+    std::string ToString() const {
+        std::string out;
+        out.reserve(len);
+        out.append((const char *) first.iov_base, first.iov_len);
+        for (const auto &seg : rest) {
+            out.append((const char *) seg.iov_base, seg.iov_len);
+        }
+        return out;
+    }
+
+private:
+    class InputStream : public ::google::protobuf::io::ZeroCopyInputStream
+    {
+    public:
+        InputStream(const MessageView &view)
+            : view(view), seg(0), off(0), total(0) { }
+
+        bool Next(const void **data, int *size) override {
+            while (seg <= view.rest.size()) {
+                const struct iovec &cur = Segment(seg);
+                if (off < cur.iov_len) {
+                    *data = (const char *) cur.iov_base + off;
+                    *size = cur.iov_len - off;
+                    total += cur.iov_len - off;
+                    off = cur.iov_len;
+                    return true;
+                }
+                ++seg;
+                off = 0;
+            }
+            return false;
+        }
+        void BackUp(int count) override {
+            off -= count;
+            total -= count;
+        }
+        bool Skip(int count) override {
+            const void *data;
+            int size;
+            while (count > 0 && Next(&data, &size)) {
+                if (size > count) {
+                    BackUp(size - count);
+                    size = count;
+                }
+                count -= size;
+            }
+            return count == 0;
+        }
+        int64_t ByteCount() const override { return total; }
+
+    private:
+        const struct iovec &Segment(size_t i) const {
+            return i == 0 ? view.first : view.rest[i - 1];
+        }
+
+        const MessageView &view;
+        size_t seg;
+        size_t off;
+        int64_t total;
+    };
+
+    struct iovec first;
+    std::vector<struct iovec> rest;
+    size_t len;
+};
+
+#endif  /* _LIB_MESSAGEVIEW_H_ */
@@ -0,0 +1,143 @@
+/***********************************************************************
+ *
+ * Copyright 2021 Florian Suri-Payer <fsp@cs.cornell.edu>
+ *                Matthew Burke <matthelb@cs.cornell.edu>
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ **********************************************************************/
+#ifndef _LIB_OBJECTPOOL_H_
+#define _LIB_OBJECTPOOL_H_
+
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <type_traits>
+#include <utility>
+
+#include "concurrentqueue/concurrentqueue.h"
+
+/*
+ * Recycles heap objects (protobuf messages, message buffers) across threads
+ * without taking a lock on the common path.
+ *
+ * Each thread keeps a small private cache of free objects per type T; Get()
+ * and Put() only touch that cache. When a thread's cache runs dry it refills
+ * a batch from the pool's lock-free global free list, and when it overflows
+ * it spills half of it back. The global list is capped at maxSize objects;
+ * anything beyond the cap is deleted so that a burst does not pin memory
+ * forever. Objects are reset (Clear()/clear()) when they are returned.
+ */
+template<class T>
+class ObjectPool {
+ public:
+  static constexpr size_t CACHE_SIZE = 64;
+  static constexpr size_t DEFAULT_MAX_SIZE = 1 << 16;
+
+  explicit ObjectPool(size_t maxSize = DEFAULT_MAX_SIZE) : maxSize(maxSize),
+      size(0UL) { }
+  ~ObjectPool() {
+    T *objs[CACHE_SIZE];
+    size_t n;
+    while ((n = freeList.try_dequeue_bulk(objs, CACHE_SIZE)) > 0) {
+      for (size_t i = 0; i < n; ++i) {
+        delete objs[i];
+      }
+    }
+  }
+
+  ObjectPool(const ObjectPool &) = delete;
+  ObjectPool &operator=(const ObjectPool &) = delete;
+
+  T *Get() {
+    ThreadCache &cache = LocalCache();
+    if (cache.count == 0) {
+      size_t n = freeList.try_dequeue_bulk(cache.objs, CACHE_SIZE / 2);
+      size.fetch_sub(n, std::memory_order_relaxed);
+      cache.count = n;
+      if (n == 0) {
+        return new T();
+      }
+    }
+    return cache.objs[--cache.count];
+  }
+
+  void Put(T *obj) {
+    Reset(obj);
+    ThreadCache &cache = LocalCache();
+    if (cache.count == CACHE_SIZE) {
+      Spill(cache);
+    }
+    cache.objs[cache.count++] = obj;
+  }
+
+ private:
+  struct ThreadCache {
+    ThreadCache() : count(0UL) { }
+    ~ThreadCache() {
+      for (size_t i = 0; i < count; ++i) {
+        delete objs[i];
+      }
+    }
+
+    T *objs[CACHE_SIZE];
+    size_t count;
+  };
+
+  // The cache is shared by all pools of the same type on a thread; objects
+  // of a given T are interchangeable, so it does not matter which pool they
+  // end up in.
+  static ThreadCache &LocalCache() {
+    static thread_local ThreadCache cache;
+    return cache;
+  }
+
+  void Spill(ThreadCache &cache) {
+    const size_t n = CACHE_SIZE / 2;
+    T **first = cache.objs + (cache.count - n);
+    // Reserve room under the cap before publishing so that a concurrent
+    // Get() never sees the counter go negative.
+    if (size.fetch_add(n, std::memory_order_relaxed) + n > maxSize ||
+        !freeList.enqueue_bulk(first, n)) {
+      size.fetch_sub(n, std::memory_order_relaxed);
+      for (size_t i = 0; i < n; ++i) {
+        delete first[i];
+      }
+    }
+    cache.count -= n;
+  }
+
+  template<class U>
+  static auto Reset(U *obj) -> decltype(obj->Clear(), void()) {
+    obj->Clear();
+  }
+
+  template<class U, class... Ignored>
+  static auto Reset(U *obj, Ignored...) -> decltype(obj->clear(), void()) {
+    obj->clear();
+  }
+
+  const size_t maxSize;
+  std::atomic<size_t> size;
+  moodycamel::ConcurrentQueue<T *> freeList;
+};
+
+#endif /* _LIB_OBJECTPOOL_H_ */
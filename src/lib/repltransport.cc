@@ -132,22 +132,22 @@ void ReplTransport::CancelAllTimers() {
     timers_.clear();
 }
 
-void ReplTransport::DispatchTP(std::function<void*()> f, std::function<void(void*)> cb) {
+void ReplTransport::DispatchTP(job_task_t f, job_callback_t cb) {
   Panic("Unimplemented");
 }
-void ReplTransport::DispatchTP_local(std::function<void*()> f, std::function<void(void*)> cb)  {
+void ReplTransport::DispatchTP_local(job_task_t f, job_callback_t cb)  {
   Panic("unimplemented");
 }
-void ReplTransport::DispatchTP_noCB(std::function<void*()> f) {
+void ReplTransport::DispatchTP_noCB(job_task_t f) {
   Panic("unimplemented");
 }
 void ReplTransport::DispatchTP_noCB_ptr(std::function<void*()> *f) {
   Panic("unimplemented");
 }
-void ReplTransport::DispatchTP_main(std::function<void*()> f) {
+void ReplTransport::DispatchTP_main(job_task_t f) {
   Panic("unimplemented");
 }
-void ReplTransport::IssueCB(std::function<void(void*)> cb, void* arg){
+void ReplTransport::IssueCB(job_callback_t cb, void* arg){
   Panic("unimplemented");
 }
 
@@ -219,12 +219,12 @@ public:
     virtual bool CancelTimer(int id) override;
     virtual void CancelAllTimers() override;
 
-    void DispatchTP(std::function<void*()> f, std::function<void(void*)> cb);
-    void DispatchTP_local(std::function<void*()> f, std::function<void(void*)> cb);
-    void DispatchTP_noCB(std::function<void*()> f);
+    void DispatchTP(job_task_t f, job_callback_t cb);
+    void DispatchTP_local(job_task_t f, job_callback_t cb);
+    void DispatchTP_noCB(job_task_t f);
     void DispatchTP_noCB_ptr(std::function<void*()> *f);
-    void DispatchTP_main(std::function<void*()> f);
-    void IssueCB(std::function<void(void*)> cb, void* arg);
+    void DispatchTP_main(job_task_t f);
+    void IssueCB(job_callback_t cb, void* arg);
 
     // DeliverMessage(addr, i) delivers the ith queued inbound message to the
     // receiver with address addr. It's possible to send a message to the
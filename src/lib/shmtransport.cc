@@ -0,0 +1,924 @@
+// -*- mode: c++; c-file-style: "k&r"; c-basic-offset: 4 -*-
+/***********************************************************************
+ *
+ * shmtransport.cc:
+ *   message-passing network interface between processes on one host,
+ *   over shared-memory ring buffers
+ *
+ * Copyright 2021 Florian Suri-Payer <fsp@cs.cornell.edu>
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ **********************************************************************/
+
+#include "lib/assert.h"
+#include "lib/configuration.h"
+#include "lib/frame.h"
+#include "lib/message.h"
+#include "lib/shmtransport.h"
+
+#include <google/protobuf/message.h>
+#include <event2/thread.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <signal.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <sys/un.h>
+
+// Frames use the layout in lib/frame.h. PAD_MAGIC marks the unused tail of
+// a ring before a wrap.
+const uint32_t PAD_MAGIC = 0x06121985;
+
+// Ring headers live in the first page of a segment, the two rings after it.
+const size_t SEGMENT_HEADER_LEN = 4096;
+// Rounds of draining before the loop thread yields to other events.
+const int MAX_DRAIN_ROUNDS = 16;
+
+struct ShmTransport::RingHeader
+{
+    // Written by the producer.
+    alignas(64) std::atomic<uint64_t> tail;
+    std::atomic<uint32_t> spaceWaiting;
+    // Written by the consumer.
+    alignas(64) std::atomic<uint64_t> head;
+    std::atomic<uint32_t> dataWaiting;
+
+    // The consumer starts out asleep, so the first frame wakes it.
+    RingHeader() : tail(0), spaceWaiting(0), head(0), dataWaiting(1) { }
+};
+
+// Sent by a client over the rendezvous socket, together with the memfd and
+// the eventfds of both rings.
+struct ShmHello
+{
+    uint64_t ringSize;
+    char name[64];
+};
+const int HELLO_FDS = 5;
+
+static inline size_t
+Align(size_t len)
+{
+    return (len + 7) & ~(size_t) 7;
+}
+
+static void
+Notify(int fd)
+{
+    uint64_t one = 1;
+    if (write(fd, &one, sizeof(one)) < 0 && errno != EAGAIN) {
+        PWarning("Failed to signal shared-memory peer");
+    }
+}
+
+static void
+ClearNotify(int fd)
+{
+    uint64_t n;
+    if (read(fd, &n, sizeof(n)) < 0 && errno != EAGAIN) {
+        PWarning("Failed to read shared-memory eventfd");
+    }
+}
+
+static socklen_t
+SocketName(const std::string &name, struct sockaddr_un *sun)
+{
+    // Abstract namespace: nothing is left behind in the file system.
+    std::string path = "basil-shm/" + name;
+    memset(sun, 0, sizeof(*sun));
+    sun->sun_family = AF_UNIX;
+    UW_ASSERT(path.size() + 1 < sizeof(sun->sun_path));
+    memcpy(sun->sun_path + 1, path.data(), path.size());
+    return offsetof(struct sockaddr_un, sun_path) + 1 + path.size();
+}
+
+ShmTransportAddress *
+ShmTransportAddress::clone() const
+{
+    return new ShmTransportAddress(*this);
+}
+
+bool operator==(const ShmTransportAddress &a, const ShmTransportAddress &b)
+{
+    return a.name == b.name;
+}
+
+bool operator!=(const ShmTransportAddress &a, const ShmTransportAddress &b)
+{
+    return !(a == b);
+}
+
+bool operator<(const ShmTransportAddress &a, const ShmTransportAddress &b)
+{
+    return a.name < b.name;
+}
+
+ShmTransport::ShmTransport(bool handleSignals, int process_id,
+                           int total_processes, bool hyperthreading,
+                           bool server, size_t ringSize)
+    : lastTimerId(0), lastConnId(0), ringSize(ringSize)
+{
+    // Ring positions are masked, not divided.
+    UW_ASSERT(ringSize > 0 && (ringSize & (ringSize - 1)) == 0);
+
+    tp.start(process_id, total_processes, hyperthreading, server);
+
+    evthread_use_pthreads();
+    libeventBase = event_base_new();
+    evthread_make_base_notifiable(libeventBase);
+
+    if (handleSignals) {
+        signalEvents.push_back(evsignal_new(libeventBase, SIGTERM,
+                                            SignalCallback, this));
+        signalEvents.push_back(evsignal_new(libeventBase, SIGINT,
+                                            SignalCallback, this));
+        signalEvents.push_back(evsignal_new(libeventBase, SIGPIPE,
+                                            [](int fd, short what, void* arg){}, this));
+
+        for (event *x : signalEvents) {
+            event_add(x, NULL);
+        }
+    }
+}
+
+ShmTransport::~ShmTransport()
+{
+    mtx.lock();
+    for (Connection *conn : allConns) {
+        if (!conn->closed) {
+            event_free(conn->sockEvent);
+            event_free(conn->dataEvent);
+            event_free(conn->spaceEvent);
+            close(conn->sock);
+            UnmapConnection(conn);
+        }
+        delete conn;
+    }
+    conns.clear();
+    allConns.clear();
+    for (Listener *info : listeners) {
+        event_free(info->acceptEvent);
+        close(info->acceptFd);
+        delete info;
+    }
+    listeners.clear();
+    for (auto kv : timers) {
+        event_free(kv.second->ev);
+        delete kv.second;
+    }
+    timers.clear();
+    for (event *x : signalEvents) {
+        event_free(x);
+    }
+    mtx.unlock();
+    event_base_free(libeventBase);
+}
+
+ShmTransportAddress
+ShmTransport::LookupAddress(const transport::ReplicaAddress &addr)
+{
+    return ShmTransportAddress(addr.host + ":" + addr.port);
+}
+
+ShmTransportAddress
+ShmTransport::LookupAddress(const transport::Configuration &config,
+                            int groupIdx,
+                            int replicaIdx)
+{
+    return LookupAddress(config.replica(groupIdx, replicaIdx));
+}
+
+void
+ShmTransport::Register(TransportReceiver *receiver,
+                       const transport::Configuration &config,
+                       int groupIdx, int replicaIdx)
+{
+    RegisterInternal(receiver, config, groupIdx, replicaIdx, false);
+}
+
+void
+ShmTransport::Register_batch(TransportReceiver *receiver,
+                             const transport::Configuration &config,
+                             int groupIdx, int replicaIdx)
+{
+    RegisterInternal(receiver, config, groupIdx, replicaIdx, true);
+}
+
+void
+ShmTransport::RegisterInternal(TransportReceiver *receiver,
+                               const transport::Configuration &config,
+                               int groupIdx, int replicaIdx, bool batch)
+{
+    UW_ASSERT(replicaIdx < config.n);
+
+    RegisterConfiguration(receiver, config, groupIdx, replicaIdx);
+
+    // Clients don't need to accept connections
+    if (replicaIdx == -1) {
+        return;
+    }
+
+    ShmTransportAddress addr = LookupAddress(config, groupIdx, replicaIdx);
+
+    int fd;
+    if ((fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC,
+                     0)) < 0) {
+        PPanic("Failed to create socket to accept shared-memory connections");
+    }
+    struct sockaddr_un sun;
+    socklen_t sunLen = SocketName(addr.GetName(), &sun);
+    if (bind(fd, (struct sockaddr *) &sun, sunLen) < 0) {
+        PPanic("Failed to bind to shared-memory endpoint %s",
+               addr.GetName().c_str());
+    }
+    if (listen(fd, 128) < 0) {
+        PPanic("Failed to listen for shared-memory connections");
+    }
+
+    Listener *info = new Listener();
+    info->transport = this;
+    info->receiver = receiver;
+    info->acceptFd = fd;
+    info->batch = batch;
+    info->acceptEvent = event_new(libeventBase, fd, EV_READ | EV_PERSIST,
+                                  AcceptCallback, (void *)info);
+    event_add(info->acceptEvent, NULL);
+    {
+        std::unique_lock<std::shared_mutex> lck(mtx);
+        listeners.push_back(info);
+    }
+
+    receiver->SetAddress(new ShmTransportAddress(addr));
+
+    Debug("Accepting shared-memory connections on %s", addr.GetName().c_str());
+}
+
+bool
+ShmTransport::OrderedMulticast(TransportReceiver *src,
+    const std::vector<int> &groups, const Message &m)
+{
+    Panic("Not implemented :(.");
+}
+
+ShmTransport::Connection *
+ShmTransport::MapConnection(int sock, int memfd, const int *efds,
+                            const ShmTransportAddress &remote,
+                            TransportReceiver *receiver, bool batch,
+                            bool client)
+{
+    size_t segmentLen = SEGMENT_HEADER_LEN + 2 * ringSize;
+    char *segment = (char *) mmap(nullptr, segmentLen, PROT_READ | PROT_WRITE,
+                                  MAP_SHARED, memfd, 0);
+    if (segment == MAP_FAILED) {
+        PWarning("Failed to map shared-memory segment");
+        return nullptr;
+    }
+
+    // Ring 0 carries client-to-replica traffic, ring 1 the replies.
+    Ring rings[2];
+    for (int i = 0; i < 2; ++i) {
+        rings[i].hdr = (RingHeader *)(segment + i * sizeof(RingHeader));
+        rings[i].data = segment + SEGMENT_HEADER_LEN + i * ringSize;
+        rings[i].size = ringSize;
+        rings[i].dataFd = efds[2 * i];
+        rings[i].spaceFd = efds[2 * i + 1];
+    }
+    if (client) {
+        new (rings[0].hdr) RingHeader();
+        new (rings[1].hdr) RingHeader();
+    }
+
+    Connection *conn = new Connection(this, remote, receiver, batch);
+    conn->sock = sock;
+    conn->segment = segment;
+    conn->segmentLen = segmentLen;
+    conn->out = rings[client ? 0 : 1];
+    conn->in = rings[client ? 1 : 0];
+
+    conn->sockEvent = event_new(libeventBase, sock, EV_READ | EV_PERSIST,
+                                SocketCallback, conn);
+    conn->dataEvent = event_new(libeventBase, conn->in.dataFd,
+                                EV_READ | EV_PERSIST, DataCallback, conn);
+    conn->spaceEvent = event_new(libeventBase, conn->out.spaceFd,
+                                 EV_READ | EV_PERSIST, SpaceCallback, conn);
+    event_add(conn->sockEvent, NULL);
+    event_add(conn->dataEvent, NULL);
+    event_add(conn->spaceEvent, NULL);
+    return conn;
+}
+
+ShmTransport::Connection *
+ShmTransport::GetConnection(TransportReceiver *src,
+                            const ShmTransportAddress &dst, bool batch)
+{
+    auto dstSrc = std::make_pair(dst, src);
+    {
+        std::shared_lock<std::shared_mutex> lck(mtx);
+        auto kv = conns.find(dstSrc);
+        if (kv != conns.end()) {
+            return kv->second;
+        }
+    }
+    std::unique_lock<std::shared_mutex> lck(mtx);
+    auto kv = conns.find(dstSrc);
+    if (kv != conns.end()) {
+        return kv->second;
+    }
+    return ConnectShm(dstSrc, batch);
+}
+
+// Called with mtx held exclusively.
+ShmTransport::Connection *
+ShmTransport::ConnectShm(const ConnKey &dstSrc, bool batch)
+{
+    const std::string &dstName = dstSrc.first.GetName();
+    Debug("Opening new shared-memory connection to %s", dstName.c_str());
+
+    int sock;
+    if ((sock = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0)) < 0) {
+        PPanic("Failed to create socket for shared-memory connection");
+    }
+    struct sockaddr_un sun;
+    socklen_t sunLen = SocketName(dstName, &sun);
+    if (connect(sock, (struct sockaddr *) &sun, sunLen) < 0) {
+        PWarning("Failed to connect to %s via shared memory", dstName.c_str());
+        close(sock);
+        return nullptr;
+    }
+
+    int memfd = memfd_create("basil-shm", MFD_CLOEXEC);
+    if (memfd < 0) {
+        PPanic("Failed to create shared-memory segment");
+    }
+    if (ftruncate(memfd, SEGMENT_HEADER_LEN + 2 * ringSize) < 0) {
+        PPanic("Failed to size shared-memory segment");
+    }
+    int efds[4];
+    for (int i = 0; i < 4; ++i) {
+        efds[i] = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if (efds[i] < 0) {
+            PPanic("Failed to create eventfd for shared-memory connection");
+        }
+    }
+
+    ShmHello hello;
+    memset(&hello, 0, sizeof(hello));
+    hello.ringSize = ringSize;
+    snprintf(hello.name, sizeof(hello.name), "shm:%d.%lu", getpid(),
+             ++lastConnId);
+    ShmTransportAddress local(hello.name);
+
+    // Map (and initialize) the rings before the replica can see them.
+    Connection *conn = MapConnection(sock, memfd, efds, dstSrc.first,
+                                     dstSrc.second, batch, true);
+    if (conn == nullptr) {
+        Panic("Failed to set up shared-memory connection");
+    }
+
+    int fds[HELLO_FDS] = { memfd, efds[0], efds[1], efds[2], efds[3] };
+    char control[CMSG_SPACE(sizeof(fds))];
+    memset(control, 0, sizeof(control));
+    struct iovec iov = { &hello, sizeof(hello) };
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+    struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(fds));
+    memcpy(CMSG_DATA(cmsg), fds, sizeof(fds));
+    if (sendmsg(sock, &msg, MSG_NOSIGNAL) != sizeof(hello)) {
+        PPanic("Failed to hand shared-memory segment to %s", dstName.c_str());
+    }
+    // The mapping and the peer keep the segment alive.
+    close(memfd);
+
+    conns[dstSrc] = conn;
+    allConns.push_back(conn);
+
+    if (dstSrc.second->GetAddress() == nullptr) {
+        dstSrc.second->SetAddress(new ShmTransportAddress(local));
+    }
+
+    Debug("Opened shared-memory connection to %s as %s", dstName.c_str(),
+          hello.name);
+    return conn;
+}
+
+bool
+ShmTransport::SendMessageInternal(TransportReceiver *src,
+                                  const ShmTransportAddress &dst,
+                                  const Message &m)
+{
+    return Send(src, dst, { const_cast<Message *>(&m) }, false);
+}
+
+bool
+ShmTransport::SendMessageInternal_batch(TransportReceiver *src,
+                                        const ShmTransportAddress &dst,
+                                        const std::vector<Message *> &m_list)
+{
+    if (m_list.empty()) {
+        return true;
+    }
+    return Send(src, dst, m_list, true);
+}
+
+bool
+ShmTransport::Send(TransportReceiver *src, const ShmTransportAddress &dst,
+                   const std::vector<Message *> &m_list, bool batch)
+{
+    Connection *conn = GetConnection(src, dst, batch);
+    if (conn == nullptr) {
+        return false;
+    }
+
+    FrameEncoder frame(m_list, batch);
+    // Any frame up to half the ring fits once the consumer catches up,
+    // whatever the wrap position.
+    if (Align(frame.size()) > ringSize / 2) {
+        Warning("Dropping %lu byte frame to %s: larger than half the"
+                " shared-memory ring", frame.size(), dst.GetName().c_str());
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lck(conn->outMtx);
+    if (conn->closed) {
+        return false;
+    }
+    if (conn->backlog.empty()) {
+        uint64_t next;
+        char *buf = Reserve(conn->out, frame.size(), &next);
+        if (buf != nullptr) {
+            frame.Write(buf);
+            Publish(conn->out, next);
+            return true;
+        }
+    }
+
+    size_t start = conn->backlog.size();
+    conn->backlog.resize(start + frame.size());
+    frame.Write(&conn->backlog[start]);
+    conn->out.hdr->spaceWaiting = 1;
+    // The consumer may have freed space before it saw the flag.
+    FlushBacklog(conn);
+    return true;
+}
+
+char *
+ShmTransport::Reserve(Ring &r, size_t len, uint64_t *next)
+{
+    uint64_t tail = r.hdr->tail.load(std::memory_order_relaxed);
+    uint64_t head = r.hdr->head.load();
+    size_t stride = Align(len);
+    uint64_t off = tail & (r.size - 1);
+    // Frames never wrap: skip the rest of the ring if this one would.
+    uint64_t skip = r.size - off < stride ? r.size - off : 0;
+    if (r.size - (tail - head) < skip + stride) {
+        return nullptr;
+    }
+    if (skip >= FRAME_HEADER_LEN) {
+        memcpy(r.data + off, &PAD_MAGIC, sizeof(PAD_MAGIC));
+        memcpy(r.data + off + sizeof(PAD_MAGIC), &skip, sizeof(size_t));
+    }
+    *next = tail + skip + stride;
+    return r.data + ((tail + skip) & (r.size - 1));
+}
+
+void
+ShmTransport::Publish(Ring &r, uint64_t next)
+{
+    r.hdr->tail = next;
+    if (r.hdr->dataWaiting.exchange(0)) {
+        Notify(r.dataFd);
+    }
+}
+
+// Called with conn->outMtx held. Returns whether the backlog is empty.
+bool
+ShmTransport::FlushBacklog(Connection *conn)
+{
+    size_t done = 0;
+    while (done < conn->backlog.size()) {
+        size_t len;
+        memcpy(&len, conn->backlog.data() + done + sizeof(uint32_t),
+               sizeof(len));
+        uint64_t next;
+        char *buf = Reserve(conn->out, len, &next);
+        if (buf == nullptr) {
+            break;
+        }
+        memcpy(buf, conn->backlog.data() + done, len);
+        Publish(conn->out, next);
+        done += len;
+    }
+    conn->backlog.erase(0, done);
+    if (conn->backlog.empty()) {
+        conn->out.hdr->spaceWaiting = 0;
+        return true;
+    }
+    return false;
+}
+
+void
+ShmTransport::Drain(Connection *conn)
+{
+    Ring &r = conn->in;
+    std::vector<std::string_view> msgTypes;
+    std::vector<MessageView> msgs;
+
+    for (int round = 0; round < MAX_DRAIN_ROUNDS; ++round) {
+        uint64_t head = r.hdr->head.load(std::memory_order_relaxed);
+        uint64_t tail = r.hdr->tail.load();
+        if (head == tail) {
+            // Announce that we are going to sleep, then look once more.
+            r.hdr->dataWaiting = 1;
+            if (r.hdr->tail.load() == head) {
+                return;
+            }
+            r.hdr->dataWaiting = 0;
+            continue;
+        }
+
+        msgTypes.clear();
+        msgs.clear();
+        uint64_t pos = head;
+        while (pos != tail) {
+            uint64_t off = pos & (r.size - 1);
+            if (r.size - off < FRAME_HEADER_LEN) {
+                pos += r.size - off;
+                continue;
+            }
+            uint32_t magic;
+            size_t totalLen;
+            memcpy(&magic, r.data + off, sizeof(magic));
+            memcpy(&totalLen, r.data + off + sizeof(magic), sizeof(totalLen));
+            if (magic == PAD_MAGIC && totalLen == r.size - off) {
+                pos += totalLen;
+                continue;
+            }
+            // Frames never wrap and are published whole.
+            size_t avail = std::min<uint64_t>(r.size - off, tail - pos);
+            if (ParseFrame(r.data + off, avail, totalLen, msgTypes,
+                           msgs) != FRAME_OK) {
+                Warning("Malformed frame from %s; closing the connection",
+                        conn->remote.GetName().c_str());
+                CloseConnection(conn);
+                return;
+            }
+            pos += Align(totalLen);
+        }
+
+        if (!msgTypes.empty()) {
+            Debug("Received %lu messages, first %.*s.\n", msgTypes.size(),
+                (int) msgTypes[0].size(), msgTypes[0].data());
+            if (conn->batch) {
+                conn->receiver->ReceiveMessageView_batch(conn->remote, msgTypes,
+                                                         msgs, nullptr);
+            } else {
+                for (size_t i = 0; i < msgTypes.size(); ++i) {
+                    conn->receiver->ReceiveMessageView(conn->remote, msgTypes[i],
+                                                       msgs[i], nullptr);
+                }
+            }
+        }
+
+        // The views are released: hand the space back to the producer.
+        r.hdr->head = tail;
+        if (r.hdr->spaceWaiting.exchange(0)) {
+            Notify(r.spaceFd);
+        }
+        if (conn->closed) {
+            return;
+        }
+    }
+    // Still busy: let timers and other connections run, then come back.
+    Notify(r.dataFd);
+}
+
+void
+ShmTransport::CloseConnection(Connection *conn)
+{
+    {
+        std::lock_guard<std::mutex> lck(conn->outMtx);
+        if (conn->closed) {
+            return;
+        }
+        conn->closed = true;
+        conn->backlog.clear();
+    }
+    {
+        std::unique_lock<std::shared_mutex> lck(mtx);
+        auto kv = conns.find(std::make_pair(conn->remote, conn->receiver));
+        if (kv != conns.end() && kv->second == conn) {
+            conns.erase(kv);
+        }
+    }
+    event_free(conn->sockEvent);
+    event_free(conn->dataEvent);
+    event_free(conn->spaceEvent);
+    close(conn->sock);
+    // Senders check closed under outMtx before they touch the rings, and
+    // the events that drained them are gone, so nothing reaches the segment
+    // any more.
+    UnmapConnection(conn);
+    Debug("Closed shared-memory connection to %s",
+          conn->remote.GetName().c_str());
+}
+
+void
+ShmTransport::UnmapConnection(Connection *conn)
+{
+    munmap(conn->segment, conn->segmentLen);
+    conn->segment = nullptr;
+    conn->in.hdr = conn->out.hdr = nullptr;
+    conn->in.data = conn->out.data = nullptr;
+    close(conn->in.dataFd);
+    close(conn->in.spaceFd);
+    close(conn->out.dataFd);
+    close(conn->out.spaceFd);
+    conn->in.dataFd = conn->in.spaceFd = -1;
+    conn->out.dataFd = conn->out.spaceFd = -1;
+}
+
+void
+ShmTransport::Run()
+{
+    int ret = event_base_dispatch(libeventBase);
+    Debug("event_base_dispatch returned %d. \n", ret);
+}
+
+void
+ShmTransport::Stop()
+{
+    tp.stop();
+    event_base_loopbreak(libeventBase);
+}
+
+void
+ShmTransport::Close(TransportReceiver *receiver)
+{
+    // Shutting the socket down ends the connection on both sides; the loop
+    // retires it when it sees the EOF.
+    std::unique_lock<std::shared_mutex> lck(mtx);
+    for (auto itr = conns.begin(); itr != conns.end(); ) {
+        if (itr->first.second == receiver) {
+            shutdown(itr->second->sock, SHUT_RDWR);
+            itr = conns.erase(itr);
+        } else {
+            ++itr;
+        }
+    }
+}
+
+int
+ShmTransport::Timer(uint64_t ms, timer_callback_t cb)
+{
+    struct timeval tv;
+    tv.tv_sec = ms / 1000;
+    tv.tv_usec = (ms % 1000) * 1000;
+    return TimerInternal(tv, cb);
+}
+
+int
+ShmTransport::TimerMicro(uint64_t us, timer_callback_t cb)
+{
+    struct timeval tv;
+    tv.tv_sec = us / 1000000UL;
+    tv.tv_usec = us % 1000000UL;
+    return TimerInternal(tv, cb);
+}
+
+int
+ShmTransport::TimerInternal(struct timeval &tv, timer_callback_t cb)
+{
+    std::unique_lock<std::shared_mutex> lck(mtx);
+
+    TimerInfo *info = new TimerInfo();
+    ++lastTimerId;
+    info->transport = this;
+    info->id = lastTimerId;
+    info->cb = cb;
+    info->ev = event_new(libeventBase, -1, 0, TimerCallback, info);
+
+    timers[info->id] = info;
+    event_add(info->ev, &tv);
+
+    return info->id;
+}
+
+bool
+ShmTransport::CancelTimer(int id)
+{
+    std::unique_lock<std::shared_mutex> lck(mtx);
+    auto kv = timers.find(id);
+    if (kv == timers.end()) {
+        return false;
+    }
+    TimerInfo *info = kv->second;
+    timers.erase(kv);
+    event_del(info->ev);
+    event_free(info->ev);
+    delete info;
+
+    return true;
+}
+
+void
+ShmTransport::CancelAllTimers()
+{
+    mtx.lock();
+    while (!timers.empty()) {
+        int id = timers.begin()->first;
+        mtx.unlock();
+        CancelTimer(id);
+        mtx.lock();
+    }
+    mtx.unlock();
+}
+
+void
+ShmTransport::OnTimer(TimerInfo *info)
+{
+    {
+        std::unique_lock<std::shared_mutex> lck(mtx);
+        timers.erase(info->id);
+        event_del(info->ev);
+        event_free(info->ev);
+    }
+
+    info->cb();
+
+    delete info;
+}
+
+void
+ShmTransport::TimerCallback(evutil_socket_t fd, short what, void *arg)
+{
+    TimerInfo *info = (TimerInfo *)arg;
+    UW_ASSERT(what & EV_TIMEOUT);
+    info->transport->OnTimer(info);
+}
+
+void ShmTransport::DispatchTP(job_task_t f, job_callback_t cb) {
+  tp.dispatch(std::move(f), std::move(cb), libeventBase);
+}
+
+void ShmTransport::DispatchTP_local(job_task_t f, job_callback_t cb) {
+  tp.dispatch_local(std::move(f), std::move(cb));
+}
+
+void ShmTransport::DispatchTP_noCB(job_task_t f) {
+  tp.detatch(std::move(f));
+}
+void ShmTransport::DispatchTP_noCB_ptr(std::function<void*()> *f) {
+  tp.detatch_ptr(f);
+}
+void ShmTransport::DispatchTP_main(job_task_t f) {
+  tp.detatch_main(std::move(f));
+}
+void ShmTransport::IssueCB(job_callback_t cb, void* arg) {
+  tp.issueCallback(std::move(cb), arg, libeventBase);
+}
+
+uint64_t ShmTransport::GraceToken() {
+  return tp.graceToken();
+}
+
+bool ShmTransport::GraceExpired(uint64_t token) {
+  return tp.graceExpired(token);
+}
+
+void
+ShmTransport::SignalCallback(evutil_socket_t fd, short what, void *arg)
+{
+    Debug("Terminating on SIGTERM/SIGINT");
+    ShmTransport *transport = (ShmTransport *)arg;
+    event_base_loopbreak(transport->libeventBase);
+}
+
+void
+ShmTransport::AcceptCallback(evutil_socket_t fd, short what, void *arg)
+{
+    Listener *info = (Listener *)arg;
+    ShmTransport *transport = info->transport;
+
+    int sock = accept4(fd, nullptr, nullptr, SOCK_CLOEXEC);
+    if (sock < 0) {
+        PWarning("Failed to accept shared-memory connection");
+        return;
+    }
+
+    // The client sends its hello right after connecting, so this does not
+    // wait in practice.
+    ShmHello hello;
+    int fds[HELLO_FDS];
+    char control[CMSG_SPACE(sizeof(fds))];
+    struct iovec iov = { &hello, sizeof(hello) };
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+    ssize_t n = recvmsg(sock, &msg, MSG_WAITALL | MSG_CMSG_CLOEXEC);
+    struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+    if (n != sizeof(hello) || cmsg == nullptr ||
+        cmsg->cmsg_type != SCM_RIGHTS ||
+        cmsg->cmsg_len != CMSG_LEN(sizeof(fds))) {
+        Warning("Malformed shared-memory connection request");
+        close(sock);
+        return;
+    }
+    memcpy(fds, CMSG_DATA(cmsg), sizeof(fds));
+    if (hello.ringSize != transport->ringSize) {
+        Warning("Rejecting shared-memory connection with %lu byte rings;"
+                " expected %lu", hello.ringSize, transport->ringSize);
+        for (int fd : fds) {
+            close(fd);
+        }
+        close(sock);
+        return;
+    }
+    hello.name[sizeof(hello.name) - 1] = '\0';
+
+    ShmTransportAddress client(hello.name);
+    Connection *conn = transport->MapConnection(sock, fds[0], fds + 1,
+                                                client, info->receiver,
+                                                info->batch, false);
+    close(fds[0]);
+    if (conn == nullptr) {
+        for (int i = 1; i < HELLO_FDS; ++i) {
+            close(fds[i]);
+        }
+        close(sock);
+        return;
+    }
+    {
+        std::unique_lock<std::shared_mutex> lck(transport->mtx);
+        transport->conns[std::make_pair(client, info->receiver)] = conn;
+        transport->allConns.push_back(conn);
+    }
+
+    Debug("Opened incoming shared-memory connection from %s", hello.name);
+}
+
+void
+ShmTransport::DataCallback(evutil_socket_t fd, short what, void *arg)
+{
+    Connection *conn = (Connection *)arg;
+    ClearNotify(fd);
+    conn->transport->Drain(conn);
+}
+
+void
+ShmTransport::SpaceCallback(evutil_socket_t fd, short what, void *arg)
+{
+    Connection *conn = (Connection *)arg;
+    ClearNotify(fd);
+    std::lock_guard<std::mutex> lck(conn->outMtx);
+    if (!conn->closed && !conn->backlog.empty()) {
+        conn->out.hdr->spaceWaiting = 1;
+        conn->transport->FlushBacklog(conn);
+    }
+}
+
+void
+ShmTransport::SocketCallback(evutil_socket_t fd, short what, void *arg)
+{
+    Connection *conn = (Connection *)arg;
+    char c;
+    ssize_t n = recv(fd, &c, sizeof(c), MSG_DONTWAIT);
+    if (n == 0 || (n < 0 && errno != EAGAIN && errno != EINTR)) {
+        conn->transport->CloseConnection(conn);
+    }
+}
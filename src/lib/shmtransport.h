@@ -0,0 +1,259 @@
+// -*- mode: c++; c-file-style: "k&r"; c-basic-offset: 4 -*-
+/***********************************************************************
+ *
+ * shmtransport.h:
+ *   message-passing network interface between processes on one host,
+ *   over shared-memory ring buffers
+ *
+ * Copyright 2021 Florian Suri-Payer <fsp@cs.cornell.edu>
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ **********************************************************************/
+
+#ifndef _LIB_SHMTRANSPORT_H_
+#define _LIB_SHMTRANSPORT_H_
+
+#include "lib/configuration.h"
+#include "lib/transport.h"
+#include "lib/transportcommon.h"
+#include "lib/threadpool.h"
+
+#include <event2/event.h>
+
+#include <atomic>
+#include <list>
+#include <map>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Replicas are named by the host:port of their configuration entry; each
+// outgoing connection gets a process-unique name.
+class ShmTransportAddress : public TransportAddress
+{
+public:
+    ShmTransportAddress(const std::string &name) : name(name) { }
+    virtual ShmTransportAddress * clone() const;
+    virtual ~ShmTransportAddress() {}
+    const std::string &GetName() const { return name; }
+private:
+    std::string name;
+
+    friend bool operator==(const ShmTransportAddress &a,
+                           const ShmTransportAddress &b);
+    friend bool operator!=(const ShmTransportAddress &a,
+                           const ShmTransportAddress &b);
+    friend bool operator<(const ShmTransportAddress &a,
+                          const ShmTransportAddress &b);
+};
+
+// Transport for processes on the same machine. Every connection is a
+// memfd holding two single-producer/single-consumer byte rings, one per
+// direction, plus an eventfd per ring for "data available" and one for
+// "space available". Wakeups are only written when the other side has
+// announced that it is about to sleep, so a busy peer costs no syscalls.
+//
+// A replica listens on an abstract unix socket named after its host:port.
+// A client connects to it once, passes the memfd and eventfds over it,
+// and afterwards only uses the socket to notice the peer going away.
+//
+// Messages use TCPTransport's frame layout and are serialized straight
+// into the ring. Receivers get views into the shared ring, released once
+// the upcall returns. Frames that do not fit into a full ring wait in a
+// local backlog, so a sender never blocks on a slow peer.
+class ShmTransport : public TransportCommon<ShmTransportAddress>
+{
+public:
+    static const size_t DEFAULT_RING_SIZE = 1 << 22;
+
+    ShmTransport(bool handleSignals = true,
+                 int process_id = 0, int total_processes = 1,
+                 bool hyperthreading = true, bool server = true,
+                 size_t ringSize = DEFAULT_RING_SIZE);
+    virtual ~ShmTransport();
+    virtual void Register(TransportReceiver *receiver,
+                  const transport::Configuration &config,
+                  int groupIdx,
+                  int replicaIdx) override;
+    virtual void Register_batch(TransportReceiver *receiver,
+                  const transport::Configuration &config,
+                  int groupIdx,
+                  int replicaIdx) override;
+    virtual bool OrderedMulticast(TransportReceiver *src,
+        const std::vector<int> &groups, const Message &m) override;
+
+    virtual void Run() override;
+    virtual void Stop() override;
+    virtual void Close(TransportReceiver *receiver) override;
+    virtual int Timer(uint64_t ms, timer_callback_t cb) override;
+    virtual int TimerMicro(uint64_t us, timer_callback_t cb) override;
+    virtual bool CancelTimer(int id) override;
+    virtual void CancelAllTimers() override;
+
+    void DispatchTP(job_task_t f, job_callback_t cb);
+    void DispatchTP_local(job_task_t f, job_callback_t cb);
+    void DispatchTP_noCB(job_task_t f);
+    void DispatchTP_noCB_ptr(std::function<void*()> *f);
+    void DispatchTP_main(job_task_t f);
+    void IssueCB(job_callback_t cb, void* arg);
+    virtual uint64_t GraceToken() override;
+    virtual bool GraceExpired(uint64_t token) override;
+
+    virtual ShmTransportAddress
+    LookupAddress(const transport::Configuration &config,
+                  int groupIdx,
+                  int replicaIdx) override;
+
+    ShmTransportAddress
+    LookupAddress(const transport::ReplicaAddress &addr);
+
+private:
+    struct RingHeader;
+
+    // One direction of a connection, as mapped into this process.
+    struct Ring
+    {
+        RingHeader *hdr;
+        char *data;
+        uint64_t size;
+        // Signalled by the producer when it publishes to a sleeping
+        // consumer, and by the consumer when it frees space for a waiting
+        // producer.
+        int dataFd;
+        int spaceFd;
+    };
+
+    struct Connection
+    {
+        ShmTransport *transport;
+        ShmTransportAddress remote;
+        TransportReceiver *receiver;
+        // Deliver through ReceiveMessageView_batch rather than per message.
+        bool batch;
+        int sock;
+        char *segment;
+        size_t segmentLen;
+        Ring out;
+        Ring in;
+
+        // Producer side of out; senders may run on any thread.
+        std::mutex outMtx;
+        // Frames that did not fit into out, in order.
+        std::string backlog;
+        // Set under outMtx; read without it on the event loop.
+        std::atomic_bool closed;
+
+        event *sockEvent;
+        event *dataEvent;
+        event *spaceEvent;
+
+        Connection(ShmTransport *transport, const ShmTransportAddress &remote,
+                   TransportReceiver *receiver, bool batch)
+            : transport(transport), remote(remote), receiver(receiver),
+              batch(batch), sock(-1), segment(nullptr), segmentLen(0),
+              closed(false),
+              sockEvent(nullptr), dataEvent(nullptr), spaceEvent(nullptr) { }
+    };
+
+    struct TimerInfo
+    {
+        ShmTransport *transport;
+        timer_callback_t cb;
+        event *ev;
+        int id;
+    };
+
+    struct Listener
+    {
+        ShmTransport *transport;
+        TransportReceiver *receiver;
+        int acceptFd;
+        bool batch;
+        event *acceptEvent;
+    };
+
+    typedef std::pair<ShmTransportAddress, TransportReceiver *> ConnKey;
+
+    std::shared_mutex mtx;
+    event_base *libeventBase;
+    std::vector<event *> signalEvents;
+    int lastTimerId;
+    std::map<int, TimerInfo *> timers;
+    std::list<Listener *> listeners;
+    std::map<ConnKey, Connection *> conns;
+    // Every connection ever opened; senders may still hold a closed one, so
+    // they are only freed with the transport. The segment and eventfds of a
+    // connection are released as soon as it closes.
+    std::list<Connection *> allConns;
+    uint64_t lastConnId;
+    const size_t ringSize;
+    ThreadPool tp;
+
+    virtual bool SendMessageInternal(TransportReceiver *src,
+                             const ShmTransportAddress &dst,
+                             const Message &m) override;
+    virtual bool SendMessageInternal_batch(TransportReceiver *src,
+                                  const ShmTransportAddress &dst,
+                                  const std::vector<Message *> &m_list) override;
+
+    virtual const ShmTransportAddress *
+    LookupMulticastAddress(const transport::Configuration *config) override {
+      return nullptr;
+    };
+
+    virtual const ShmTransportAddress *
+    LookupFCAddress(const transport::Configuration *cfg) override {
+      return nullptr;
+    }
+
+    void RegisterInternal(TransportReceiver *receiver,
+                          const transport::Configuration &config,
+                          int groupIdx, int replicaIdx, bool batch);
+    bool Send(TransportReceiver *src, const ShmTransportAddress &dst,
+              const std::vector<Message *> &m_list, bool batch);
+    Connection *GetConnection(TransportReceiver *src,
+                              const ShmTransportAddress &dst, bool batch);
+    Connection *ConnectShm(const ConnKey &dstSrc, bool batch);
+    Connection *MapConnection(int sock, int memfd, const int *efds,
+                              const ShmTransportAddress &remote,
+                              TransportReceiver *receiver, bool batch,
+                              bool client);
+    bool FlushBacklog(Connection *conn);
+    void Drain(Connection *conn);
+    void CloseConnection(Connection *conn);
+    static void UnmapConnection(Connection *conn);
+    static char *Reserve(Ring &r, size_t len, uint64_t *next);
+    static void Publish(Ring &r, uint64_t next);
+    int TimerInternal(struct timeval &tv, timer_callback_t cb);
+    void OnTimer(TimerInfo *info);
+
+    static void TimerCallback(evutil_socket_t fd, short what, void *arg);
+    static void SignalCallback(evutil_socket_t fd, short what, void *arg);
+    static void AcceptCallback(evutil_socket_t fd, short what, void *arg);
+    static void DataCallback(evutil_socket_t fd, short what, void *arg);
+    static void SpaceCallback(evutil_socket_t fd, short what, void *arg);
+    static void SocketCallback(evutil_socket_t fd, short what, void *arg);
+};
+
+#endif  // _LIB_SHMTRANSPORT_H_
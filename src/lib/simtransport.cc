@@ -294,22 +294,22 @@ SimulatedTransport::Stop() {
 void UDPTransport::Close(TransportReceiver *receiver) {
 }
 
-void SimulatedTransport::DispatchTP(std::function<void*()> f, std::function<void(void*)> cb)  {
+void SimulatedTransport::DispatchTP(job_task_t f, job_callback_t cb)  {
   Panic("Unimplemented");
 }
-void SimulatedTransport::DispatchTP_local(std::function<void*()> f, std::function<void(void*)> cb)  {
+void SimulatedTransport::DispatchTP_local(job_task_t f, job_callback_t cb)  {
   Panic("unimplemented");
 }
-void SimulatedTransport::DispatchTP_noCB(std::function<void*()> f) {
+void SimulatedTransport::DispatchTP_noCB(job_task_t f) {
   Panic("unimplemented");
 }
 void SimulatedTransport::DispatchTP_noCB_ptr(std::function<void*()> *f) {
   Panic("unimplemented");
 }
-void SimulatedTransport::DispatchTP_main(std::function<void*()> f) {
+void SimulatedTransport::DispatchTP_main(job_task_t f) {
   Panic("unimplemented");
 }
-void SimulatedTransport::IssueCB(std::function<void(void*)> cb, void* arg){
+void SimulatedTransport::IssueCB(job_callback_t cb, void* arg){
   Panic("unimplemented");
 }
 
@@ -0,0 +1,171 @@
+/***********************************************************************
+ *
+ * Copyright 2021 Florian Suri-Payer <fsp@cs.cornell.edu>
+ *                Matthew Burke <matthelb@cs.cornell.edu>
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ **********************************************************************/
+#ifndef _LIB_TASK_H_
+#define _LIB_TASK_H_
+
+#include <cstddef>
+#include <functional>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+// Move-only callable with inline storage. Callables that fit into
+// INLINE_SIZE bytes (the common case: a few pointers and a shared_ptr or
+// string) live inside the task itself, so passing a job to the ThreadPool
+// does not allocate; larger ones fall back to the heap. Converts implicitly
+// from lambdas and std::function so that call sites stay unchanged. An empty
+// std::function (or nullptr) yields an empty task.
+template <typename Sig> class InlineTask;
+
+template <typename R, typename... Args>
+class InlineTask<R(Args...)> {
+ public:
+  static const size_t INLINE_SIZE = 48;
+
+  InlineTask() : ops(nullptr) { }
+  InlineTask(std::nullptr_t) : ops(nullptr) { }
+
+  template <typename F, typename T = std::decay_t<F>,
+      typename = std::enable_if_t<!std::is_same<T, InlineTask>::value &&
+          std::is_invocable_r<R, T&, Args...>::value>>
+  InlineTask(F &&f) : ops(nullptr) {
+    if (IsEmpty(f)) {
+      return;
+    }
+    if constexpr (StoredInline<T>()) {
+      new (&storage) T(std::forward<F>(f));
+      ops = &InlineOps<T>::ops;
+    } else {
+      *reinterpret_cast<T **>(&storage) = new T(std::forward<F>(f));
+      ops = &HeapOps<T>::ops;
+    }
+  }
+
+  InlineTask(InlineTask &&other) noexcept : ops(other.ops) {
+    if (ops != nullptr) {
+      ops->move(&other.storage, &storage);
+      other.ops = nullptr;
+    }
+  }
+
+  InlineTask &operator=(InlineTask &&other) noexcept {
+    if (this != &other) {
+      Reset();
+      if (other.ops != nullptr) {
+        other.ops->move(&other.storage, &storage);
+        ops = other.ops;
+        other.ops = nullptr;
+      }
+    }
+    return *this;
+  }
+
+  InlineTask &operator=(std::nullptr_t) {
+    Reset();
+    return *this;
+  }
+
+  InlineTask(const InlineTask &) = delete;
+  InlineTask &operator=(const InlineTask &) = delete;
+
+  ~InlineTask() { Reset(); }
+
+  explicit operator bool() const { return ops != nullptr; }
+
+  R operator()(Args... args) {
+    return ops->invoke(&storage, std::forward<Args>(args)...);
+  }
+
+  // Whether a callable of type F is kept without a heap allocation.
+  template <typename F>
+  static constexpr bool StoredInline() {
+    return sizeof(F) <= INLINE_SIZE &&
+        alignof(F) <= alignof(std::max_align_t) &&
+        std::is_nothrow_move_constructible<F>::value;
+  }
+
+ private:
+  struct Ops {
+    R (*invoke)(void *storage, Args&&... args);
+    // Move-constructs into dst and destroys the source.
+    void (*move)(void *src, void *dst);
+    void (*destroy)(void *storage);
+  };
+
+  template <typename T>
+  struct InlineOps {
+    static R Invoke(void *s, Args&&... args) {
+      return (*reinterpret_cast<T *>(s))(std::forward<Args>(args)...);
+    }
+    static void Move(void *src, void *dst) {
+      T *t = reinterpret_cast<T *>(src);
+      new (dst) T(std::move(*t));
+      t->~T();
+    }
+    static void Destroy(void *s) {
+      reinterpret_cast<T *>(s)->~T();
+    }
+    static constexpr Ops ops = {Invoke, Move, Destroy};
+  };
+
+  template <typename T>
+  struct HeapOps {
+    static R Invoke(void *s, Args&&... args) {
+      return (**reinterpret_cast<T **>(s))(std::forward<Args>(args)...);
+    }
+    static void Move(void *src, void *dst) {
+      *reinterpret_cast<T **>(dst) = *reinterpret_cast<T **>(src);
+    }
+    static void Destroy(void *s) {
+      delete *reinterpret_cast<T **>(s);
+    }
+    static constexpr Ops ops = {Invoke, Move, Destroy};
+  };
+
+  template <typename F>
+  static bool IsEmpty(const F &f) { return false; }
+  template <typename S>
+  static bool IsEmpty(const std::function<S> &f) { return !f; }
+  template <typename T>
+  static bool IsEmpty(T *f) { return f == nullptr; }
+
+  void Reset() {
+    if (ops != nullptr) {
+      ops->destroy(&storage);
+      ops = nullptr;
+    }
+  }
+
+  const Ops *ops;
+  alignas(std::max_align_t) unsigned char storage[INLINE_SIZE];
+};
+
+// Jobs and completion callbacks handed to the ThreadPool.
+typedef InlineTask<void *()> job_task_t;
+typedef InlineTask<void (void *)> job_callback_t;
+
+#endif  // _LIB_TASK_H_
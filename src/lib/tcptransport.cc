@@ -31,6 +31,7 @@
 
 #include "lib/assert.h"
 #include "lib/configuration.h"
+#include "lib/frame.h"
 #include "lib/message.h"
 #include "lib/tcptransport.h"
 
@@ -38,6 +39,7 @@
 #include <event2/thread.h>
 #include <event2/bufferevent_struct.h>
 
+#include <algorithm>
 #include <cstdio>
 #include <netinet/tcp.h>
 #include <arpa/inet.h>
@@ -52,7 +54,6 @@
 //#include "lib/threadpool.cc"
 
 const size_t MAX_TCP_SIZE = 100; // XXX
-const uint32_t MAGIC = 0x06121983;
 const int SOCKET_BUF_SIZE = 1048576;
 //const int MAX_EVBUFFER_SIZE = 8192;
 
@@ -682,7 +683,7 @@ TCPTransport::SendMessageInternal(TransportReceiver *src,
     char *ptr = buf;
 
     // buf[0]にMAGICを代入している
-    *((uint32_t *) ptr) = MAGIC;
+    *((uint32_t *) ptr) = FRAME_MAGIC;
     //ポインタが指すアドレスを変更
     ptr += sizeof(uint32_t);
     UW_ASSERT((size_t)(ptr-buf) < totalLen);
@@ -745,17 +746,10 @@ bool
 TCPTransport::SendMessageInternal_batch(TransportReceiver *src,
                                   const TCPTransportAddress &dst,
                                   const std::vector<Message *> &m_list)
-{  
-
-    int message_size = m_list.size();
-
-    /*
-    for (int i = 0; i < message_size; i++){
-        Debug("Sending %s message over TCP to %s:%d \n",
-        (*m_list[i]).GetTypeName().c_str(), inet_ntoa(dst.addr.sin_addr),
-        htons(dst.addr.sin_port));
+{
+    if (m_list.empty()) {
+        return true;
     }
-    */
 
     auto dstSrc = std::make_pair(dst, src);
     mtx.lock();
@@ -771,135 +765,43 @@ TCPTransport::SendMessageInternal_batch(TransportReceiver *src,
 
     UW_ASSERT(ev != NULL);
 
-    size_t maxTotalLen = 0;
-    size_t maxDataLen = 0;
-    
-    // maxTotalLenとmaxDataLenを調べる。
-    for(int i = 0; i < message_size; i++){
-
-
-        string data;
-        UW_ASSERT((*m_list[i]).SerializeToString(&data));
-        string type = (*m_list[i]).GetTypeName();
-        size_t typeLen = type.length();
-        //printf("typeLen :%d", typeLen);
-        size_t dataLen = data.length();
-        //printf("dataLen :%d", dataLen);
-        
-        if (dataLen > maxDataLen){
-            //printf("change");
-            maxDataLen = dataLen;
-        }
-        //printf("dataLen :%d\n", dataLen);
-        size_t totalLen = (typeLen + sizeof(typeLen) +
-                       dataLen + sizeof(dataLen) +
-                       sizeof(totalLen) +
-                       sizeof(uint32_t));
-
-        //printf("totalLen :%d\n", totalLen);
-        if (totalLen > maxTotalLen){
-            //printf("change");
-            maxTotalLen = totalLen;
-        }
-    }
-
-    //buf_batchの雛形を作成
-    char buf_batch[message_size][maxTotalLen];
-
-    for(int i = 0; i < message_size; ++i){
-
-        string data;
-        UW_ASSERT((*m_list[i]).SerializeToString(&data));
-        string type = (*m_list[i]).GetTypeName();
-        size_t typeLen = type.length();
-        size_t dataLen = maxDataLen;
-        size_t totalLen = maxTotalLen;
-        
-        char buf[totalLen];
-
-        // bufの中身を初期化
-        for (int i = 0; i < totalLen; i++){
-            buf[i] = ' ';
-        }
-
-        char *ptr = buf;
-
-        *((uint32_t *) ptr) = MAGIC;
-        ptr += sizeof(uint32_t);
-        UW_ASSERT((size_t)(ptr-buf) < totalLen);
-
-        *((size_t *) ptr) = totalLen;
-        ptr += sizeof(size_t);
-        UW_ASSERT((size_t)(ptr-buf) < totalLen);
-
-        *((size_t *) ptr) = typeLen;
-        ptr += sizeof(size_t);
-        UW_ASSERT((size_t)(ptr-buf) < totalLen);
-
-        UW_ASSERT((size_t)(ptr+typeLen-buf) < totalLen);
-        memcpy(ptr, type.c_str(), typeLen);
-        ptr += typeLen;
-        *((size_t *) ptr) = dataLen;
-        ptr += sizeof(size_t);
-
-        UW_ASSERT((size_t)(ptr-buf) < totalLen);
-        UW_ASSERT((size_t)(ptr+dataLen-buf) == totalLen);
-        memcpy(ptr, data.c_str(), data.length());
-        ptr += dataLen;
-
-        for(int j = 0; j < totalLen; j++){
-            buf_batch[i][j] = buf[j];
-        }
-
-
-    }
-
-    /*
-    int buf_message_size = 0;
-    
-    for(auto itr = totalLens.begin(); itr != totalLens.end(); ++itr){
-        buf_message_size += *itr;
-    }
-    */
-
-
-    int buf_message_size = message_size * maxTotalLen;
-
-    Debug("buf_batch_size : %d\n", buf_message_size);
-
-    //mtx.lock();
-    //evbuffer_lock(ev);
-
-    //二番目の項目は、配列の先頭のアドレスが入る。
-    //三番目の項目は、配列の大きさが入る。
-    if (bufferevent_write(ev, buf_batch, buf_message_size) < 0) { 
+    size_t written = EncodeBatchFrame(bufferevent_get_output(ev), m_list);
+    if (written == 0) {
         Warning("Failed to write to TCP buffer");
         fprintf(stderr, "tcp write failed\n");
-        //evbuffer_unlock(ev);
-        //mtx.unlock();
         return false;
     }
-    
-    //evbuffer_unlock(ev);
-    //mtx.unlock();
-    //Latency_Start(&sockWriteLat);
-    
-    /*
-    // レプリカのソケットにbuf_batchから、buf_message_sizeバイト分書き込む。
-    if (write(ev->ev_write.ev_fd, buf_batch, buf_message_size) < 0) {
-      Warning("Failed to write to TCP buffer");
-      fprintf(stderr, "tcp write failed\n");
-      return false;
-    }
-    */
-    
-    
-    //Latency_End(&sockWriteLat);
-    Debug("SendMessageInternal_batch end\n");
+
+    Debug("SendMessageInternal_batch: %lu messages, %lu bytes\n",
+        m_list.size(), written);
     return true;
 }
 
-
+size_t
+TCPTransport::EncodeBatchFrame(struct evbuffer *out,
+                               const std::vector<Message *> &m_list)
+{
+    FrameEncoder frame(m_list, true);
+    size_t totalLen = frame.size();
+
+    // Reserve a single contiguous extent so the whole frame is committed
+    // at once and cannot interleave with other writers on this buffer.
+    struct evbuffer_iovec vec;
+    evbuffer_lock(out);
+    if (evbuffer_reserve_space(out, totalLen, &vec, 1) != 1) {
+        evbuffer_unlock(out);
+        return 0;
+    }
+    frame.Write((char *) vec.iov_base);
+
+    vec.iov_len = totalLen;
+    if (evbuffer_commit_space(out, &vec, 1) < 0) {
+        evbuffer_unlock(out);
+        return 0;
+    }
+    evbuffer_unlock(out);
+    return totalLen;
+}
 
 // void TCPTransport::Flush() {
 //   event_base_loop(libeventBase, EVLOOP_NONBLOCK);
@@ -958,6 +860,7 @@ TCPTransport::Stop()
 
   tp.stop();
   event_base_dump_events(libeventBase, stderr);
+  event_base_loopbreak(libeventBase);
 
   //mtx.unlock();
 }
@@ -1075,28 +978,36 @@ TCPTransport::TimerCallback(evutil_socket_t fd, short what, void *arg)
     info->transport->OnTimer(info);
 }
 
-void TCPTransport::DispatchTP(std::function<void*()> f, std::function<void(void*)> cb)  {
+void TCPTransport::DispatchTP(job_task_t f, job_callback_t cb)  {
   tp.dispatch(std::move(f), std::move(cb), libeventBase);
 }
 
-void TCPTransport::DispatchTP_local(std::function<void*()> f, std::function<void(void*)> cb)  {
+void TCPTransport::DispatchTP_local(job_task_t f, job_callback_t cb)  {
   tp.dispatch_local(std::move(f), std::move(cb));
 }
 
-void TCPTransport::DispatchTP_noCB(std::function<void*()> f) {
+void TCPTransport::DispatchTP_noCB(job_task_t f) {
   tp.detatch(std::move(f));
 }
 void TCPTransport::DispatchTP_noCB_ptr(std::function<void*()> *f) {
   tp.detatch_ptr(f);
 }
-void TCPTransport::DispatchTP_main(std::function<void*()> f) {
+void TCPTransport::DispatchTP_main(job_task_t f) {
   tp.detatch_main(std::move(f));
 }
-void TCPTransport::IssueCB(std::function<void(void*)> cb, void* arg){
+void TCPTransport::IssueCB(job_callback_t cb, void* arg){
   //std::unique_lock<std::shared_mutex> lck(mtx);
   tp.issueCallback(std::move(cb), arg, libeventBase);
 }
 
+uint64_t TCPTransport::GraceToken() {
+  return tp.graceToken();
+}
+
+bool TCPTransport::GraceExpired(uint64_t token) {
+  return tp.graceExpired(token);
+}
+
 void
 TCPTransport::LogCallback(int severity, const char *msg)
 {
@@ -1251,75 +1162,37 @@ TCPTransport::TCPReadableCallback(struct bufferevent *bev, void *arg)
     TCPTransport *transport = info->transport;
     struct evbuffer *evbuf = bufferevent_get_input(bev);
 
-    while (evbuffer_get_length(evbuf) > 0) {
-        uint32_t *magic;
-        magic = (uint32_t *)evbuffer_pullup(evbuf, sizeof(*magic));
-        if (magic == NULL) {
-            return;
-        }
-        UW_ASSERT(*magic == MAGIC);
-
-        size_t *sz;
-        unsigned char *x = evbuffer_pullup(evbuf, sizeof(*magic) + sizeof(*sz));
-
-        sz = (size_t *) (x + sizeof(*magic));
-        if (x == NULL) {
-            return;
-        }
-        size_t totalSize = *sz;
-        UW_ASSERT(totalSize < 1073741826);
-
-        if (evbuffer_get_length(evbuf) < totalSize) {
-            Debug("Don't have %ld bytes for a message yet, only %ld",totalSize, evbuffer_get_length(evbuf));
-            return;
-        }
-        // Debug("Receiving %ld byte message", totalSize);
-
-        char buf[totalSize];
-        size_t copied = evbuffer_remove(evbuf, buf, totalSize);
-        UW_ASSERT(copied == totalSize);
-
-        // Parse message
-        char *ptr = buf + sizeof(*sz) + sizeof(*magic);
-
-        size_t typeLen = *((size_t *)ptr);
-        ptr += sizeof(size_t);
-        UW_ASSERT((size_t)(ptr-buf) < totalSize);
-
-        UW_ASSERT((size_t)(ptr+typeLen-buf) < totalSize);
-        string msgType(ptr, typeLen);
-        ptr += typeLen;
-
-        size_t msgLen = *((size_t *)ptr);
-        ptr += sizeof(size_t);
-        UW_ASSERT((size_t)(ptr-buf) < totalSize);
-
-        UW_ASSERT((size_t)(ptr+msgLen-buf) <= totalSize);
-        string msg(ptr, msgLen);
-        ptr += msgLen;
-
+    std::vector<std::string_view> msgTypes;
+    std::vector<MessageView> msgs;
+    std::deque<std::string> scratch;
+    size_t totalSize;
+    FrameStatus status;
+    // Handlers see the frame in place; it is drained only once they return.
+    while ((status = ParseFrame(evbuf, 0, totalSize, msgTypes, msgs,
+                                scratch)) == FRAME_OK) {
         transport->mtx.lock_shared();
         auto addr = transport->tcpAddresses.find(bev);
-        TCPTransportAddress &ad = addr->second.first; //Note: if address was removed from map, ref could still be in "use" by server
-        // transport->mtx.unlock();
-        // UW_ASSERT(addr != transport->tcpAddresses.end());
-        //
-        // // Dispatch
-        //
-        // info->receiver->ReceiveMessage(ad, msgType, msg, nullptr);
-        // Debug("Done processing large %s message", msgType.c_str());
-
         if (addr == transport->tcpAddresses.end()) {
          Warning("Received message for closed connection.");
          transport->mtx.unlock_shared();
        } else {
-         // Dispatch //ここでメッセージを受け取っている ReceiveMessage → ReceiveMessageInternal
+         TCPTransportAddress &ad = addr->second.first; //Note: if address was removed from map, ref could still be in "use" by server
          transport->mtx.unlock_shared();
-         Debug("Received %lu bytes %s message.\n", totalSize, msgType.c_str());
+         Debug("Received %lu bytes %.*s message.\n", totalSize,
+             (int) msgTypes[0].size(), msgTypes[0].data());
          //indicusstore/shardclient.ccのReceiveMessageを呼び出す。
-         info->receiver->ReceiveMessage(ad, msgType, msg, nullptr);
-         //Debug("Done processing large %s message", msgType.c_str());
+         for (size_t i = 0; i < msgTypes.size(); ++i) {
+           info->receiver->ReceiveMessageView(ad, msgTypes[i], msgs[i], nullptr);
+         }
        }
+        msgTypes.clear();
+        msgs.clear();
+        scratch.clear();
+        evbuffer_drain(evbuf, totalSize);
+    }
+    if (status == FRAME_MALFORMED) {
+        Warning("Malformed frame on TCP connection; closing it.");
+        transport->CloseConnection(info, bev);
     }
 }
 
@@ -1335,114 +1208,40 @@ TCPTransport::TCPReadableCallback_batch(struct bufferevent *bev, void *arg)
     //bevにリモートサーバから送られてきた、データが格納されている。
     struct evbuffer *evbuf = bufferevent_get_input(bev);
 
-    size_t totalSize;
-    std::vector<std::string> msgTypes;
-    std::vector<std::string> msgs;
-
-    int first_loop = true;
-
-    while (evbuffer_get_length(evbuf) > 0) {
-        Debug("evbuffer_get_length(evbuf) :%d \n", evbuffer_get_length(evbuf));
-
-        //もしかしたらmagicが指す空間がヘッダーかも
-        uint32_t *magic;
-        // データを連続したものにする
-        magic = (uint32_t *)evbuffer_pullup(evbuf, sizeof(*magic));
-        if (magic == NULL) {
-            Debug("magic == NULL");
-            if (first_loop == true){
-                return;
-            }
-            else {
-                break;
-            }
-        }
-
-        if (*magic != MAGIC){
-            if (first_loop == true){
-                return;
-            }
-            else {
-                break;
-            }
-        }
-
-        //szが指す領域がメッセージ
-        size_t *sz;
-        unsigned char *x = evbuffer_pullup(evbuf, sizeof(*magic) + sizeof(*sz));
+    std::vector<std::string_view> msgTypes;
+    std::vector<MessageView> msgs;
+    std::deque<std::string> scratch;
 
-        sz = (size_t *) (x + sizeof(*magic));
-        if (x == NULL) {
-            Debug("x == NULL");
-            if (first_loop == true){
-                return;
-            }
-            else {
-                break;
-            }
-        }
-        totalSize = *sz;
-        if (totalSize >= 1073741826){
-            if (first_loop == true){
-                return;
-            }
-            else {
-                break;
-            }
-        }
+    // Accepts both single frames and variable-length batch frames. Handlers
+    // see every buffered frame in place; they are drained only once the
+    // receiver returns.
+    size_t buffered = 0;
+    size_t frameLen;
+    FrameStatus status;
+    while ((status = ParseFrame(evbuf, buffered, frameLen, msgTypes, msgs,
+                                scratch)) == FRAME_OK) {
+        buffered += frameLen;
+    }
 
-        if (evbuffer_get_length(evbuf) < totalSize) {
-            Debug("evbuffer_get_length(evbuf) : %d\n", evbuffer_get_length(evbuf));
-            Debug("totalSize: %d\n", totalSize);
-            Debug("evbuffer_get_length(evbuf) < totalSize");
-            Debug("Don't have %ld bytes for a message yet, only %ld", totalSize, evbuffer_get_length(evbuf));
-            if (first_loop == true){
-                return;
-            }
-            else {
-                break;
-            }   
+    if (!msgTypes.empty()) {
+        transport->mtx.lock_shared();
+        auto addr = transport->tcpAddresses.find(bev);
+        if (addr == transport->tcpAddresses.end()) {
+             Warning("Received message for closed connection.");
+             transport->mtx.unlock_shared();
+        } else {
+             TCPTransportAddress &ad = addr->second.first;
+             transport->mtx.unlock_shared();
+             Debug("Received %lu messages, first %.*s.\n", msgTypes.size(),
+                 (int) msgTypes[0].size(), msgTypes[0].data());
+             info->receiver->ReceiveMessageView_batch(ad, msgTypes, msgs, nullptr);
         }
-        // Debug("Receiving %ld byte message", totalSize);
-        char buf[totalSize];
-        size_t copied = evbuffer_remove(evbuf, buf, totalSize);
-        UW_ASSERT(copied == totalSize);
-
-        // Parse message
-        char *ptr = buf + sizeof(*sz) + sizeof(*magic);
-
-        size_t typeLen = *((size_t *)ptr);
-        ptr += sizeof(size_t);
-        UW_ASSERT((size_t)(ptr-buf) < totalSize);
-
-        UW_ASSERT((size_t)(ptr+typeLen-buf) < totalSize);
-        string messageType(ptr, typeLen);
-        ptr += typeLen;
-
-        size_t msgLen = *((size_t *)ptr);
-        ptr += sizeof(size_t);
-        UW_ASSERT((size_t)(ptr-buf) < totalSize);
-
-        UW_ASSERT((size_t)(ptr+msgLen-buf) <= totalSize);
-        string msg(ptr, msgLen);
-        ptr += msgLen;
-
-        msgTypes.push_back(messageType);
-        msgs.push_back(msg);
-        first_loop = false;
+        evbuffer_drain(evbuf, buffered);
     }
-    
-    transport->mtx.lock_shared();
-    auto addr = transport->tcpAddresses.find(bev);
-    TCPTransportAddress &ad = addr->second.first; 
-    if (addr == transport->tcpAddresses.end()) {
-         Warning("Received message for closed connection.");
-         transport->mtx.unlock_shared();
-    } else {
-         transport->mtx.unlock_shared();
-         Debug("Received %lu bytes %s message.\n", totalSize, msgTypes[0].c_str());
-         info->receiver->ReceiveMessage_batch(ad, msgTypes, msgs, nullptr);
-         Debug("Done processing large %s message", msgTypes[0].c_str());
+    // The frames before a malformed one are still delivered.
+    if (status == FRAME_MALFORMED) {
+        Warning("Malformed frame on TCP connection; closing it.");
+        transport->CloseConnection(info, bev);
     }
 }
 
@@ -1484,7 +1283,7 @@ TCPTransport::TCPReadableCallback_batch(struct bufferevent *bev, void *arg)
             Debug("magic == NULL");
             return;
         }
-        if (*magic != MAGIC){
+        if (*magic != FRAME_MAGIC){
             Debug("*magic == MAGIC");
             return;
         }
@@ -1569,7 +1368,7 @@ TCPTransport::TCPReadableCallback_batch(struct bufferevent *bev, void *arg)
                 Debug("magic == NULL");
                 break;
             }
-            if (*magic != MAGIC){
+            if (*magic != FRAME_MAGIC){
                 Debug("*magic == MAGIC");
                 return;
             }
@@ -1659,6 +1458,24 @@ TCPTransport::TCPReadableCallback_batch(struct bufferevent *bev, void *arg)
 */
 
 
+void
+TCPTransport::CloseConnection(TCPTransportTCPListener *info,
+                              struct bufferevent *bev)
+{
+    mtx.lock();
+    auto addr = tcpAddresses.find(bev);
+    if (addr != tcpAddresses.end()) {
+        auto out = tcpOutgoing.find(addr->second);
+        if (out != tcpOutgoing.end() && out->second == bev) {
+            tcpOutgoing.erase(out);
+        }
+        tcpAddresses.erase(addr);
+    }
+    mtx.unlock();
+    info->connectionEvents.remove(bev);
+    bufferevent_free(bev);
+}
+
 void
 TCPTransport::TCPIncomingEventCallback(struct bufferevent *bev,
                                        short what, void *arg)
@@ -43,6 +43,7 @@
 #include <event2/buffer.h>
 #include <event2/bufferevent.h>
 
+#include <deque>
 #include <map>
 #include <unordered_map>
 #include <list>
@@ -50,6 +51,7 @@
 #include <mutex>
 #include <shared_mutex>
 #include <netinet/in.h>
+#include <string_view>
 
 class TCPTransportAddress : public TransportAddress
 {
@@ -61,6 +63,7 @@ private:
     TCPTransportAddress(const sockaddr_in &addr);
 
     friend class TCPTransport;
+    friend class IOUringTransport;
     friend bool operator==(const TCPTransportAddress &a,
                            const TCPTransportAddress &b);
     friend bool operator!=(const TCPTransportAddress &a,
@@ -97,12 +100,14 @@ public:
     virtual void CancelAllTimers() override;
     //virtual void Flush() override;
 
-    void DispatchTP(std::function<void*()> f, std::function<void(void*)> cb);
-    void DispatchTP_local(std::function<void*()> f, std::function<void(void*)> cb);
-    void DispatchTP_noCB(std::function<void*()> f);
+    void DispatchTP(job_task_t f, job_callback_t cb);
+    void DispatchTP_local(job_task_t f, job_callback_t cb);
+    void DispatchTP_noCB(job_task_t f);
     void DispatchTP_noCB_ptr(std::function<void*()> *f);
-    void DispatchTP_main(std::function<void*()> f);
-    void IssueCB(std::function<void(void*)> cb, void* arg);
+    void DispatchTP_main(job_task_t f);
+    void IssueCB(job_callback_t cb, void* arg);
+    virtual uint64_t GraceToken() override;
+    virtual bool GraceExpired(uint64_t token) override;
 
     TCPTransportAddress
     LookupAddress(const transport::Configuration &cfg,
@@ -116,6 +121,12 @@ public:
     TCPTransportAddress
     LookupAddress(const transport::ReplicaAddress &addr);
 
+    // Batch framing: [BATCH_MAGIC][totalLen][count] followed by count
+    // entries of [typeLen][type][dataLen][data], each at its own length.
+    // Serializes every message exactly once, straight into out. Returns
+    // the number of bytes appended (0 on failure).
+    static size_t EncodeBatchFrame(struct evbuffer *out,
+                                   const std::vector<Message *> &m_list);
 
 private:
     int TimerInternal(struct timeval &tv, timer_callback_t cb);
@@ -174,6 +185,9 @@ private:
     }
 
     void ConnectTCP(const std::pair<TCPTransportAddress, TransportReceiver *> &dstSrc);
+    // Drops a connection whose stream cannot be parsed any more.
+    void CloseConnection(TCPTransportTCPListener *info,
+                         struct bufferevent *bev);
     //追加
     void ConnectTCP_batch(const std::pair<TCPTransportAddress, TransportReceiver *> &dstSrc);
     void OnTimer(TCPTransportTimerInfo *info);
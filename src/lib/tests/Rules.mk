@@ -5,7 +5,14 @@ d := $(dir $(lastword $(MAKEFILE_LIST)))
 #
 GTEST_SRCS += $(addprefix $(d), \
 		configuration-test.cc \
-	        simtransport-test.cc)
+	        simtransport-test.cc \
+		objectpool-test.cc \
+		messageview-test.cc \
+		frame-test.cc \
+		iouringtransport-test.cc \
+		shmtransport-test.cc \
+		histogram-test.cc \
+		task-test.cc)
 
 PROTOS += $(d)simtransport-testmessage.proto
 
@@ -16,3 +23,32 @@ $(d)configuration-test: $(o)configuration-test.o $(LIB-configuration) $(GTEST_MA
 $(d)simtransport-test: $(o)simtransport-test.o $(LIB-simtransport) $(o)simtransport-testmessage.o $(GTEST_MAIN)
 
 # TEST_BINS += $(d)simtransport-test
+
+$(d)objectpool-test: $(o)objectpool-test.o $(GTEST_MAIN)
+
+TEST_BINS += $(d)objectpool-test
+
+$(d)messageview-test: $(o)messageview-test.o $(GTEST_MAIN)
+
+TEST_BINS += $(d)messageview-test
+
+$(d)frame-test: $(o)frame-test.o $(LIB-transport) $(GTEST_MAIN)
+
+TEST_BINS += $(d)frame-test
+
+$(d)iouringtransport-test: $(o)iouringtransport-test.o $(LIB-iouringtransport) $(GTEST_MAIN)
+$(call add-LDFLAGS,$(d)iouringtransport-test,$(LIBURING_LDFLAGS))
+
+TEST_BINS += $(d)iouringtransport-test
+
+$(d)shmtransport-test: $(o)shmtransport-test.o $(LIB-shmtransport) $(GTEST_MAIN)
+
+TEST_BINS += $(d)shmtransport-test
+
+$(d)histogram-test: $(o)histogram-test.o $(LIB-histogram) $(GTEST_MAIN)
+
+TEST_BINS += $(d)histogram-test
+
+$(d)task-test: $(o)task-test.o $(GTEST_MAIN)
+
+TEST_BINS += $(d)task-test
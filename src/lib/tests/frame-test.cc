@@ -0,0 +1,155 @@
+// -*- mode: c++; c-file-style: "k&r"; c-basic-offset: 4 -*-
+/***********************************************************************
+ *
+ * frame-test.cc:
+ *   test cases for parsing frames out of an evbuffer
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ **********************************************************************/
+
+#include "lib/frame.h"
+#include "lib/messageview.h"
+
+#include <event2/buffer.h>
+
+#include <algorithm>
+#include <cstring>
+#include <deque>
+#include <string>
+#include <vector>
+
+#include <google/protobuf/wrappers.pb.h>
+#include <gtest/gtest.h>
+
+static std::string
+Encode(const std::vector<::google::protobuf::Message *> &m_list, bool batch)
+{
+    std::string out;
+    FrameEncoder(m_list, batch).Append(out);
+    return out;
+}
+
+// Appends wire to buf in pieces of at most step bytes, so that every field
+// can end up split across evbuffer chunks.
+static void
+AddChunked(struct evbuffer *buf, const std::string &wire, size_t step)
+{
+    for (size_t i = 0; i < wire.size(); i += step) {
+        evbuffer_add(buf, wire.data() + i, std::min(step, wire.size() - i));
+    }
+}
+
+TEST(Frame, ParseChunkedEvbuffer)
+{
+    google::protobuf::StringValue a, b, out;
+    a.set_value("first");
+    b.set_value(std::string(3000, 'y'));
+    std::string single = Encode({&a}, false);
+    std::string batch = Encode({&a, &b}, true);
+
+    for (size_t step : {1ul, 3ul, 7ul, 64ul, 4096ul}) {
+        struct evbuffer *buf = evbuffer_new();
+        AddChunked(buf, single + batch, step);
+
+        std::vector<std::string_view> types;
+        std::vector<MessageView> datas;
+        std::deque<std::string> scratch;
+        size_t frameLen;
+        ASSERT_EQ(ParseFrame(buf, 0, frameLen, types, datas, scratch),
+                  FRAME_OK);
+        EXPECT_EQ(frameLen, single.size());
+        ASSERT_EQ(ParseFrame(buf, frameLen, frameLen, types, datas, scratch),
+                  FRAME_OK);
+        EXPECT_EQ(frameLen, batch.size());
+
+        ASSERT_EQ(types.size(), 3u);
+        EXPECT_EQ(types[0], a.GetTypeName());
+        EXPECT_EQ(types[2], b.GetTypeName());
+        EXPECT_TRUE(datas[0].ParseInto(&out));
+        EXPECT_EQ(out.value(), "first");
+        EXPECT_TRUE(datas[1].ParseInto(&out));
+        EXPECT_EQ(out.value(), "first");
+        EXPECT_TRUE(datas[2].ParseInto(&out));
+        EXPECT_EQ(out.value(), b.value());
+        evbuffer_free(buf);
+    }
+}
+
+TEST(Frame, EvbufferIncompleteFrame)
+{
+    google::protobuf::StringValue a;
+    a.set_value("one");
+    std::string wire = Encode({&a}, true);
+
+    for (size_t cut = 0; cut < wire.size(); ++cut) {
+        struct evbuffer *buf = evbuffer_new();
+        AddChunked(buf, wire.substr(0, cut), 5);
+        std::vector<std::string_view> types;
+        std::vector<MessageView> datas;
+        std::deque<std::string> scratch;
+        size_t frameLen;
+        EXPECT_EQ(ParseFrame(buf, 0, frameLen, types, datas, scratch),
+                  FRAME_INCOMPLETE);
+        EXPECT_TRUE(types.empty());
+        EXPECT_TRUE(datas.empty());
+        evbuffer_free(buf);
+    }
+}
+
+TEST(Frame, EvbufferMalformedFrame)
+{
+    google::protobuf::StringValue a;
+    a.set_value("two");
+    std::string wire = Encode({&a}, true);
+
+    std::vector<std::string> bad;
+    // Bad magic.
+    bad.push_back(wire);
+    bad.back()[0] ^= 0x1;
+    // A total length past MAX_FRAME_LEN.
+    bad.push_back(wire);
+    size_t totalLen = MAX_FRAME_LEN + 1;
+    memcpy(&bad.back()[sizeof(uint32_t)], &totalLen, sizeof(totalLen));
+    // A count that the frame cannot hold.
+    bad.push_back(wire);
+    size_t count = 1000;
+    memcpy(&bad.back()[FRAME_HEADER_LEN], &count, sizeof(count));
+    // A type length running past the end of the frame.
+    bad.push_back(wire);
+    size_t typeLen = wire.size();
+    memcpy(&bad.back()[FRAME_HEADER_LEN + sizeof(size_t)], &typeLen,
+           sizeof(typeLen));
+
+    for (const std::string &frame : bad) {
+        struct evbuffer *buf = evbuffer_new();
+        AddChunked(buf, frame, 4);
+        std::vector<std::string_view> types;
+        std::vector<MessageView> datas;
+        std::deque<std::string> scratch;
+        size_t frameLen;
+        EXPECT_EQ(ParseFrame(buf, 0, frameLen, types, datas, scratch),
+                  FRAME_MALFORMED);
+        EXPECT_TRUE(types.empty());
+        EXPECT_TRUE(datas.empty());
+        evbuffer_free(buf);
+    }
+}
@@ -0,0 +1,79 @@
+// -*- mode: c++; c-file-style: "k&r"; c-basic-offset: 4 -*-
+/***********************************************************************
+ *
+ * objectpool-test.cc:
+ *   test cases for ObjectPool
+ *
+ * Copyright 2021 Florian Suri-Payer <fsp@cs.cornell.edu>
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ **********************************************************************/
+
+#include "lib/histogram.h"
+
+#include <cmath>
+
+#include <gtest/gtest.h>
+
+TEST(Histogram, BucketBounds)
+{
+    for (uint64_t v : {0UL, 1UL, 127UL, 128UL, 1000UL, 123456789UL, ~0UL}) {
+        size_t idx = Histogram::BucketIndex(v);
+        ASSERT_LT(idx, Histogram::NUM_BUCKETS);
+        EXPECT_LE(Histogram::BucketLowerBound(idx), v);
+        EXPECT_GE(Histogram::BucketUpperBound(idx), v);
+    }
+}
+
+TEST(Histogram, Percentiles)
+{
+    Histogram h;
+    for (uint64_t v = 1; v <= 100000; ++v) {
+        h.Record(v * 1000);
+    }
+    EXPECT_EQ(h.Count(), 100000UL);
+    // Log-linear buckets keep every value within 2 / SUB_BUCKETS.
+    double err = 2.0 / Histogram::SUB_BUCKETS;
+    EXPECT_NEAR(h.Percentile(50), 50000000.0, 50000000.0 * err);
+    EXPECT_NEAR(h.Percentile(99), 99000000.0, 99000000.0 * err);
+    EXPECT_NEAR(h.Percentile(99.9), 99900000.0, 99900000.0 * err);
+    EXPECT_NEAR(h.Mean(), 50000500.0, 1.0);
+}
+
+TEST(Histogram, MergeAndSubtract)
+{
+    Histogram a;
+    Histogram b;
+    a.Record(10);
+    b.Record(1000000);
+    b.Record(1000000);
+
+    Histogram merged(a);
+    merged.Merge(b);
+    EXPECT_EQ(merged.Count(), 3UL);
+    EXPECT_EQ(merged.Min(), 10UL);
+    EXPECT_GE(merged.Max(), 1000000UL);
+
+    merged.Subtract(a);
+    EXPECT_EQ(merged.Count(), 2UL);
+    EXPECT_GE(merged.Percentile(1), 1000000UL * (1.0 - 2.0 / Histogram::SUB_BUCKETS));
+}
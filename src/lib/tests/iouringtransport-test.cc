@@ -0,0 +1,225 @@
+// -*- mode: c++; c-file-style: "k&r"; c-basic-offset: 4 -*-
+/***********************************************************************
+ *
+ * iouringtransport-test.cc:
+ *   test cases for IOUringTransport
+ *
+ * Copyright 2021 Florian Suri-Payer <fsp@cs.cornell.edu>
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ **********************************************************************/
+
+#include "lib/messageview.h"
+#include "lib/configuration.h"
+#include "lib/iouringtransport.h"
+#include "lib/tcptransport.h"
+
+#include <event2/buffer.h>
+#include <unistd.h>
+
+#include <cstring>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <google/protobuf/wrappers.pb.h>
+#include <gtest/gtest.h>
+
+// Encodes m_list with TCPTransport's batch framing and returns the bytes.
+static std::string
+EncodeBatch(const std::vector<::google::protobuf::Message *> &m_list)
+{
+    struct evbuffer *buf = evbuffer_new();
+    size_t len = TCPTransport::EncodeBatchFrame(buf, m_list);
+    EXPECT_GT(len, 0u);
+    std::string out(len, '\0');
+    evbuffer_remove(buf, &out[0], len);
+    evbuffer_free(buf);
+    return out;
+}
+
+TEST(IOUringTransport, ParseTCPTransportBatch)
+{
+    google::protobuf::StringValue a, b, out;
+    a.set_value("first");
+    b.set_value(std::string(3000, 'y'));
+    std::string wire = EncodeBatch({&a, &b});
+
+    std::vector<std::string_view> types;
+    std::vector<MessageView> datas;
+    size_t used;
+    EXPECT_TRUE(IOUringTransport::ParseFrames(wire.data(), wire.size(), used,
+                                              types, datas));
+    EXPECT_EQ(used, wire.size());
+    ASSERT_EQ(types.size(), 2u);
+    EXPECT_EQ(types[0], a.GetTypeName());
+    EXPECT_TRUE(datas[0].ParseInto(&out));
+    EXPECT_EQ(out.value(), "first");
+    EXPECT_TRUE(datas[1].ParseInto(&out));
+    EXPECT_EQ(out.value(), b.value());
+}
+
+TEST(IOUringTransport, StopsAtIncompleteFrame)
+{
+    google::protobuf::StringValue a, b;
+    a.set_value("one");
+    b.set_value("two");
+    std::string first = EncodeBatch({&a});
+    std::string wire = first + EncodeBatch({&b});
+
+    // Every cut inside the second frame leaves exactly the first parsed.
+    for (size_t cut = first.size(); cut < wire.size(); ++cut) {
+        std::vector<std::string_view> types;
+        std::vector<MessageView> datas;
+        size_t used;
+        EXPECT_TRUE(IOUringTransport::ParseFrames(wire.data(), cut, used,
+                                                  types, datas));
+        EXPECT_EQ(used, first.size());
+        EXPECT_EQ(types.size(), 1u);
+    }
+}
+
+TEST(IOUringTransport, RejectsMalformedFrames)
+{
+    google::protobuf::StringValue a, b;
+    a.set_value("one");
+    b.set_value("two");
+    std::string first = EncodeBatch({&a});
+    std::string second = EncodeBatch({&b});
+
+    std::vector<std::string> bad;
+    // Bad magic.
+    bad.push_back(second);
+    bad.back()[0] ^= 0x1;
+    // A count that the frame cannot hold.
+    bad.push_back(second);
+    size_t count = 1000;
+    memcpy(&bad.back()[sizeof(uint32_t) + sizeof(size_t)], &count,
+           sizeof(count));
+    // A type length running past the end of the frame.
+    bad.push_back(second);
+    size_t typeLen = second.size();
+    memcpy(&bad.back()[sizeof(uint32_t) + 2 * sizeof(size_t)], &typeLen,
+           sizeof(typeLen));
+
+    for (const std::string &frame : bad) {
+        std::string wire = first + frame;
+        std::vector<std::string_view> types;
+        std::vector<MessageView> datas;
+        size_t used;
+        EXPECT_FALSE(IOUringTransport::ParseFrames(wire.data(), wire.size(),
+                                                   used, types, datas));
+        // The frame ahead of the bad one is still handed back.
+        EXPECT_EQ(used, first.size());
+        EXPECT_EQ(types.size(), 1u);
+        EXPECT_EQ(datas.size(), 1u);
+    }
+}
+
+// Echoes every message back over the connection it came in on.
+class EchoReplica : public TransportReceiver
+{
+public:
+    EchoReplica(Transport *transport) : transport(transport) { }
+
+    void ReceiveMessage(const TransportAddress &remote,
+                        const std::string &type, const std::string &data,
+                        void *meta_data) override {
+        google::protobuf::StringValue m;
+        EXPECT_TRUE(m.ParseFromString(data));
+        transport->SendMessage(this, remote, m);
+    }
+    void ReceiveMessage_batch(const TransportAddress &remote,
+                              const std::vector<std::string> &types,
+                              const std::vector<std::string> &datas,
+                              void *meta_data) override {
+        for (size_t i = 0; i < types.size(); ++i) {
+            ReceiveMessage(remote, types[i], datas[i], meta_data);
+        }
+    }
+
+    Transport *transport;
+};
+
+class Client : public TransportReceiver
+{
+public:
+    Client(Transport *transport, size_t expected)
+        : transport(transport), expected(expected) { }
+
+    void ReceiveMessage(const TransportAddress &remote,
+                        const std::string &type, const std::string &data,
+                        void *meta_data) override {
+        google::protobuf::StringValue m;
+        EXPECT_TRUE(m.ParseFromString(data));
+        replies.push_back(m.value());
+        if (replies.size() == expected) {
+            transport->Stop();
+        }
+    }
+    void ReceiveMessage_batch(const TransportAddress &remote,
+                              const std::vector<std::string> &types,
+                              const std::vector<std::string> &datas,
+                              void *meta_data) override { }
+
+    Transport *transport;
+    size_t expected;
+    std::vector<std::string> replies;
+};
+
+static transport::Configuration
+TestConfig(int port)
+{
+    std::stringstream ss;
+    ss << "f 0\nreplica 127.0.0.1:" << port << "\n";
+    return transport::Configuration(ss);
+}
+
+TEST(IOUringTransport, LoopbackRoundTrip)
+{
+    IOUringTransport transport(0.0, 0.0, 0, false, 0, 1, true, false);
+    transport::Configuration config = TestConfig(20000 + getpid() % 20000);
+    EchoReplica replica(&transport);
+    Client client(&transport, 3);
+    transport.Register(&replica, config, 0, 0);
+    transport.Register(&client, config, -1, -1);
+
+    // Larger than a receive buffer, so it arrives split across several.
+    std::string big(200000, 'z');
+    transport.Timer(0, [&]() {
+        google::protobuf::StringValue m;
+        m.set_value("ping");
+        EXPECT_TRUE(transport.SendMessageToReplica(&client, 0, m));
+        m.set_value(big);
+        EXPECT_TRUE(transport.SendMessageToReplica(&client, 0, m));
+        m.set_value("pong");
+        EXPECT_TRUE(transport.SendMessageToReplica(&client, 0, m));
+    });
+    // Fails the test instead of hanging if replies stop coming.
+    transport.Timer(10000, [&]() { transport.Stop(); });
+    transport.Run();
+
+    ASSERT_EQ(client.replies.size(), 3u);
+    EXPECT_EQ(client.replies[0], "ping");
+    EXPECT_EQ(client.replies[1], big);
+    EXPECT_EQ(client.replies[2], "pong");
+}
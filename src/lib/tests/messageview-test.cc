@@ -0,0 +1,69 @@
+// -*- mode: c++; c-file-style: "k&r"; c-basic-offset: 4 -*-
+/***********************************************************************
+ *
+ * messageview-test.cc:
+ *   test cases for MessageView
+ *
+ * Copyright 2021 Florian Suri-Payer <fsp@cs.cornell.edu>
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ **********************************************************************/
+
+#include "lib/messageview.h"
+
+#include <algorithm>
+#include <string>
+
+#include <google/protobuf/wrappers.pb.h>
+#include <gtest/gtest.h>
+
+TEST(MessageView, ParseContiguous)
+{
+    google::protobuf::StringValue in, out;
+    in.set_value("hello");
+    std::string wire = in.SerializeAsString();
+
+    MessageView view(wire);
+    EXPECT_TRUE(view.contiguous());
+    EXPECT_EQ(view.size(), wire.size());
+    EXPECT_TRUE(view.ParseInto(&out));
+    EXPECT_EQ(out.value(), "hello");
+    EXPECT_EQ(view.ToString(), wire);
+}
+
+TEST(MessageView, ParseAcrossSegments)
+{
+    google::protobuf::StringValue in, out;
+    in.set_value(std::string(5000, 'x') + "end");
+    std::string wire = in.SerializeAsString();
+
+    // Split the payload the way an evbuffer chain would.
+    MessageView view;
+    for (size_t i = 0; i < wire.size(); i += 7) {
+        view.Append(wire.data() + i, std::min<size_t>(7, wire.size() - i));
+    }
+    EXPECT_FALSE(view.contiguous());
+    EXPECT_EQ(view.size(), wire.size());
+    EXPECT_TRUE(view.ParseInto(&out));
+    EXPECT_EQ(out.value(), in.value());
+    EXPECT_EQ(view.ToString(), wire);
+}
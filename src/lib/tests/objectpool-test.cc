@@ -0,0 +1,115 @@
+// -*- mode: c++; c-file-style: "k&r"; c-basic-offset: 4 -*-
+/***********************************************************************
+ *
+ * objectpool-test.cc:
+ *   test cases for ObjectPool
+ *
+ * Copyright 2021 Florian Suri-Payer <fsp@cs.cornell.edu>
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ **********************************************************************/
+
+#include "lib/objectpool.h"
+
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+TEST(ObjectPool, ReusesAndClears)
+{
+    ObjectPool<std::string> pool;
+
+    std::string *s = pool.Get();
+    s->assign("hello");
+    pool.Put(s);
+
+    std::string *t = pool.Get();
+    EXPECT_EQ(t, s);
+    EXPECT_TRUE(t->empty());
+    pool.Put(t);
+}
+
+TEST(ObjectPool, SpillsAcrossThreads)
+{
+    ObjectPool<std::string> pool;
+    const size_t n = 4 * ObjectPool<std::string>::CACHE_SIZE;
+
+    std::vector<std::string *> objs;
+    std::thread producer([&]() {
+        for (size_t i = 0; i < n; ++i) {
+            objs.push_back(pool.Get());
+        }
+        for (auto obj : objs) {
+            pool.Put(obj);
+        }
+    });
+    producer.join();
+
+    // The producer's thread cache is gone, but everything it spilled must
+    // be handed out again here before any new allocation.
+    std::set<std::string *> spilled(objs.begin(), objs.end());
+    size_t reused = 0;
+    std::vector<std::string *> got;
+    for (size_t i = 0; i < n; ++i) {
+        std::string *s = pool.Get();
+        reused += spilled.count(s);
+        got.push_back(s);
+    }
+    EXPECT_GE(reused, n - ObjectPool<std::string>::CACHE_SIZE);
+    for (auto s : got) {
+        pool.Put(s);
+    }
+}
+
+TEST(ObjectPool, RespectsCap)
+{
+    const size_t cache = ObjectPool<std::string>::CACHE_SIZE;
+    ObjectPool<std::string> pool(cache / 2);
+
+    std::vector<std::string *> objs;
+    std::thread producer([&]() {
+        for (size_t i = 0; i < 4 * cache; ++i) {
+            objs.push_back(pool.Get());
+        }
+        for (auto obj : objs) {
+            pool.Put(obj);
+        }
+    });
+    producer.join();
+
+    // Only one spill fits under the cap; the rest were deleted.
+    std::set<std::string *> spilled(objs.begin(), objs.end());
+    std::vector<std::string *> got;
+    size_t reused = 0;
+    for (size_t i = 0; i < 4 * cache; ++i) {
+        std::string *s = pool.Get();
+        reused += spilled.count(s);
+        got.push_back(s);
+    }
+    EXPECT_LE(reused, cache / 2);
+    for (auto s : got) {
+        pool.Put(s);
+    }
+}
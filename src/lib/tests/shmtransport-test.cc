@@ -0,0 +1,244 @@
+// -*- mode: c++; c-file-style: "k&r"; c-basic-offset: 4 -*-
+/***********************************************************************
+ *
+ * shmtransport-test.cc:
+ *   test cases for ShmTransport
+ *
+ * Copyright 2021 Florian Suri-Payer <fsp@cs.cornell.edu>
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ **********************************************************************/
+
+#include "lib/messageview.h"
+#include "lib/configuration.h"
+#include "lib/shmtransport.h"
+
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <dirent.h>
+
+#include <google/protobuf/wrappers.pb.h>
+#include <gtest/gtest.h>
+
+// Echoes every message back, or only counts them when quiet.
+class EchoReplica : public TransportReceiver
+{
+public:
+    EchoReplica(Transport *transport, bool quiet)
+        : transport(transport), quiet(quiet), received(0) { }
+
+    void ReceiveMessage(const TransportAddress &remote,
+                        const std::string &type, const std::string &data,
+                        void *meta_data) override {
+        ++received;
+        if (!quiet) {
+            google::protobuf::StringValue m;
+            EXPECT_TRUE(m.ParseFromString(data));
+            transport->SendMessage(this, remote, m);
+        }
+    }
+    void ReceiveMessage_batch(const TransportAddress &remote,
+                              const std::vector<std::string> &types,
+                              const std::vector<std::string> &datas,
+                              void *meta_data) override {
+        for (size_t i = 0; i < types.size(); ++i) {
+            ReceiveMessage(remote, types[i], datas[i], meta_data);
+        }
+    }
+
+    Transport *transport;
+    bool quiet;
+    size_t received;
+};
+
+class Client : public TransportReceiver
+{
+public:
+    Client(Transport *transport, size_t expected)
+        : transport(transport), expected(expected) { }
+
+    void ReceiveMessage(const TransportAddress &remote,
+                        const std::string &type, const std::string &data,
+                        void *meta_data) override {
+        google::protobuf::StringValue m;
+        EXPECT_TRUE(m.ParseFromString(data));
+        replies.push_back(m.value());
+        if (replies.size() == expected) {
+            transport->Stop();
+        }
+    }
+    void ReceiveMessage_batch(const TransportAddress &remote,
+                              const std::vector<std::string> &types,
+                              const std::vector<std::string> &datas,
+                              void *meta_data) override { }
+
+    Transport *transport;
+    size_t expected;
+    std::vector<std::string> replies;
+};
+
+// Open file descriptors and mapped shared-memory segments of this process.
+static size_t
+OpenFds()
+{
+    size_t n = 0;
+    DIR *dir = opendir("/proc/self/fd");
+    while (readdir(dir) != nullptr) {
+        ++n;
+    }
+    closedir(dir);
+    return n;
+}
+
+static size_t
+MappedSegments()
+{
+    std::ifstream maps("/proc/self/maps");
+    size_t n = 0;
+    for (std::string line; std::getline(maps, line); ) {
+        if (line.find("basil-shm") != std::string::npos) {
+            ++n;
+        }
+    }
+    return n;
+}
+
+static transport::Configuration
+TestConfig(int port)
+{
+    std::stringstream ss;
+    ss << "f 0\nreplica localhost:" << port << "\n";
+    return transport::Configuration(ss);
+}
+
+TEST(ShmTransport, RoundTrip)
+{
+    ShmTransport transport(false, 0, 1, true, false, 1 << 16);
+    transport::Configuration config = TestConfig(getpid());
+    EchoReplica replica(&transport, false);
+    Client client(&transport, 2);
+    transport.Register(&replica, config, 0, 0);
+    transport.Register(&client, config, -1, -1);
+
+    transport.Timer(0, [&]() {
+        google::protobuf::StringValue m;
+        m.set_value("ping");
+        EXPECT_TRUE(transport.SendMessageToReplica(&client, 0, m));
+        m.set_value(std::string(10000, 'z'));
+        EXPECT_TRUE(transport.SendMessageToReplica(&client, 0, m));
+    });
+    transport.Run();
+
+    ASSERT_EQ(client.replies.size(), 2u);
+    EXPECT_EQ(client.replies[0], "ping");
+    EXPECT_EQ(client.replies[1], std::string(10000, 'z'));
+}
+
+TEST(ShmTransport, BacklogWhenRingIsFull)
+{
+    // 200 frames of ~4KB through a 64KB ring: most of them go through the
+    // sender's backlog and wait for space.
+    ShmTransport transport(false, 0, 1, true, false, 1 << 16);
+    transport::Configuration config = TestConfig(getpid() + 1);
+    EchoReplica replica(&transport, true);
+    Client client(&transport, 0);
+    transport.Register(&replica, config, 0, 0);
+    transport.Register(&client, config, -1, -1);
+
+    const size_t count = 200;
+    transport.Timer(0, [&]() {
+        google::protobuf::StringValue m;
+        m.set_value(std::string(4000, 'q'));
+        for (size_t i = 0; i < count; ++i) {
+            EXPECT_TRUE(transport.SendMessageToReplica(&client, 0, m));
+        }
+    });
+    std::function<void()> check = [&]() {
+        if (replica.received == count) {
+            transport.Stop();
+        } else {
+            transport.Timer(1, check);
+        }
+    };
+    transport.Timer(1, check);
+    transport.Run();
+
+    EXPECT_EQ(replica.received, count);
+}
+
+TEST(ShmTransport, RejectsOversizedFrame)
+{
+    ShmTransport transport(false, 0, 1, true, false, 1 << 16);
+    transport::Configuration config = TestConfig(getpid() + 2);
+    EchoReplica replica(&transport, true);
+    Client client(&transport, 0);
+    transport.Register(&replica, config, 0, 0);
+    transport.Register(&client, config, -1, -1);
+
+    google::protobuf::StringValue m;
+    m.set_value(std::string(1 << 15, 'x'));
+    EXPECT_FALSE(transport.SendMessageToReplica(&client, 0, m));
+}
+
+TEST(ShmTransport, ReleasesClosedConnection)
+{
+    ShmTransport transport(false, 0, 1, true, false, 1 << 16);
+    transport::Configuration config = TestConfig(getpid() + 3);
+    EchoReplica replica(&transport, false);
+    Client client(&transport, 0);
+    transport.Register(&replica, config, 0, 0);
+    transport.Register(&client, config, -1, -1);
+    const size_t fds = OpenFds();
+    const size_t segments = MappedSegments();
+
+    transport.Timer(0, [&]() {
+        google::protobuf::StringValue m;
+        m.set_value("ping");
+        EXPECT_TRUE(transport.SendMessageToReplica(&client, 0, m));
+    });
+    // Once the reply is in, close the client's connection and wait for both
+    // ends to give back their segment mappings and eventfds.
+    bool closed = false;
+    int rounds = 0;
+    std::function<void()> check = [&]() {
+        if (!closed && client.replies.size() == 1) {
+            EXPECT_GT(MappedSegments(), segments);
+            transport.Close(&client);
+            closed = true;
+        }
+        if ((closed && OpenFds() == fds && MappedSegments() == segments) ||
+            ++rounds == 1000) {
+            transport.Stop();
+        } else {
+            transport.Timer(1, check);
+        }
+    };
+    transport.Timer(1, check);
+    transport.Run();
+
+    EXPECT_TRUE(closed);
+    EXPECT_EQ(OpenFds(), fds);
+    EXPECT_EQ(MappedSegments(), segments);
+}
@@ -0,0 +1,95 @@
+// -*- mode: c++; c-file-style: "k&r"; c-basic-offset: 4 -*-
+/***********************************************************************
+ *
+ * objectpool-test.cc:
+ *   test cases for ObjectPool
+ *
+ * Copyright 2021 Florian Suri-Payer <fsp@cs.cornell.edu>
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ **********************************************************************/
+
+#include "lib/task.h"
+
+#include <array>
+#include <functional>
+#include <memory>
+#include <string>
+
+#include <gtest/gtest.h>
+
+TEST(InlineTask, SmallClosureStaysInline)
+{
+    int calls = 0;
+    std::string s("captured");
+    auto small = [&calls, s]() -> void * { ++calls; return nullptr; };
+    EXPECT_TRUE(job_task_t::StoredInline<decltype(small)>());
+
+    job_task_t t(small);
+    ASSERT_TRUE(t);
+    t();
+    EXPECT_EQ(calls, 1);
+}
+
+TEST(InlineTask, LargeClosureFallsBackToHeap)
+{
+    std::array<char, 2 * job_task_t::INLINE_SIZE> big{};
+    big[0] = 42;
+    auto large = [big]() -> void * { return (void *) (intptr_t) big[0]; };
+    EXPECT_FALSE(job_task_t::StoredInline<decltype(large)>());
+
+    job_task_t t(large);
+    job_task_t u(std::move(t));
+    EXPECT_FALSE(t);
+    EXPECT_EQ(u(), (void *) 42);
+}
+
+TEST(InlineTask, MoveTransfersOwnership)
+{
+    auto p = std::make_shared<int>(7);
+    job_callback_t cb([p](void *arg) { *static_cast<int *>(arg) = *p; });
+    EXPECT_EQ(p.use_count(), 2);
+
+    job_callback_t other;
+    other = std::move(cb);
+    EXPECT_FALSE(cb);
+    EXPECT_EQ(p.use_count(), 2);
+
+    int out = 0;
+    other(&out);
+    EXPECT_EQ(out, 7);
+
+    other = nullptr;
+    EXPECT_EQ(p.use_count(), 1);
+}
+
+TEST(InlineTask, EmptyFunctionIsEmptyTask)
+{
+    std::function<void(void *)> empty;
+    job_callback_t cb(empty);
+    EXPECT_FALSE(cb);
+
+    std::function<void *()> f = []() -> void * { return nullptr; };
+    job_task_t t(f);
+    EXPECT_TRUE(t);
+    EXPECT_TRUE(f);
+}
@@ -31,120 +31,67 @@
 #include <utility>
 #include <iostream>
 
-//TODO: make is so that all but the first core are used.
-ThreadPool::ThreadPool() {
-
+// Worker the current thread runs, if any; jobs it submits stay local.
+static thread_local ThreadPool *currentPool = nullptr;
+static thread_local size_t currentWorker = 0;
+// Round-robin position of threads outside the pool.
+static thread_local size_t nextWorker = 0;
+
+ThreadPool::ThreadPool() : running(false), graceEpoch(1), mainEpoch(GRACE_IDLE) {
+  // Always have one queue so that jobs dispatched before start() are kept.
+  workers.push_back(new Worker());
+  for (size_t i = 0; i < MAX_EVENT_BASES; ++i) {
+    completions[i] = nullptr;
+  }
 }
 
 void ThreadPool::start(int process_id, int total_processes, bool hyperthreading, bool server){
   //printf("starting threadpool \n");
-  //could pre-allocate some Events and EventInfos for a Hotstart
   if(server){
     fprintf(stderr, "starting server threadpool\n");
     fprintf(stderr, "process_id: %d, total_processes: %d \n", process_id, total_processes);
-    //TODO: add config param for hyperthreading
-    //bool hyperthreading = true;
     // サーバのCPUの数をここに記載する
-    int num_cpus = std::thread::hardware_concurrency(); ///(2-hyperthreading);
+    // Hyperthread siblings are numbered i and i + num_cpus/2, so without
+    // hyperthreading only the lower half of the cpus is used.
+    int num_cpus = std::thread::hardware_concurrency() / (2 - hyperthreading);
     fprintf(stderr, "Num_cpus: %d \n", num_cpus);
     num_cpus /= total_processes;
     int offset = process_id * num_cpus;
     Debug("num cpus %d", num_cpus);
     uint32_t num_threads = (uint32_t) std::max(1, num_cpus);
-    // Currently: First CPU = MainThread.
+    // Currently: First CPU = MainThread, second CPU = second main thread
+    // (detatch_main), all others run a worker each.
+    for (uint32_t i = 3; i < num_threads; i++) {
+      workers.push_back(new Worker());
+    }
     running = true;
     for (uint32_t i = 1; i < num_threads; i++) {
-      //if(i % 2 == 0) continue;
       std::thread *t;
       //Mainthread
       if(i==1){
         t = new std::thread([this, i] {
           while (true) {
-            std::function<void*()> job;
-            {
-              // only acquire the lock in this block so that the
-              // std::function execution is not holding the lock
-              Debug("Thread %d running on CPU %d.", i, sched_getcpu());
-
-              test_main_worklist.wait_dequeue(job);
-              //while(!test_main_worklist.try_dequeue(job)) {};
-
-              // std::unique_lock<std::mutex> lock(this->main_worklistMutex);
-              // cv_main.wait(lock, [this] { return this->main_worklist.size() > 0 || !running; });
-              if (!running) {
-                break;
-              }
-              // if (this->main_worklist.size() == 0) {
-              //   continue;
-              // }
-              // job = std::move(this->main_worklist.front());
-              // this->main_worklist.pop_front();
+            job_task_t job;
+            Debug("Thread %d running on CPU %d.", i, sched_getcpu());
+            test_main_worklist.wait_dequeue(job);
+            if (!running) {
+              break;
             }
+            mainEpoch = graceEpoch.load();
             job();
+            mainEpoch.store(GRACE_IDLE, std::memory_order_release);
           }
         });
       }
       //Cryptothread
       else{
-      t = new std::thread([this, i] {
-        while (true) {
-          std::pair<std::function<void*()>, EventInfo*> job;
-          //std::function<void*()> job;
-          {
-            // only acquire the lock in this block so that the
-            // std::function execution is not holding the lock
-            Debug("Thread %d running on CPU %d.", i, sched_getcpu());
-
-            //std::unique_lock<std::mutex> lock(this->worklistMutex);                    //STABLE_VERSION
-            //cv.wait(lock, [this] { return this->worklist.size() > 0 || !running; });   //STABLE_VERSION
-
-            test_worklist.wait_dequeue(job);
-            //while(!test_worklist.try_dequeue(job)) {};
-
-            //std::shared_lock lock(this->dummyMutex);
-            //cv.wait(lock, [this, &job] { return this->testlist.try_pop(job) || !running; });
-            //while(!testlist.try_pop(job) || !running) {}
-            Debug("popped job on CPU %d.", i);
-            if (!running) {
-              break;
-            }
-            // if (this->worklist.size() == 0) {                                        //STABLE_VERSION
-            //   continue;
-            // }
-            // job = std::move(this->worklist.front());                                 //STABLE_VERSION
-            // this->worklist.pop_front();                                              //STABLE_VERSION
-          }
-          //job();
-
-          if(job.second){
-              job.second->r = job.first();
-          // This _should_ be thread safe
-              event_active(job.second->ev, 0, 0);
-          }
-          else{
-            job.first();
-          }
-
-        }
-      });
-    }
-      // Create a cpu_set_t object representing a set of CPUs. Clear it and mark
-      // only CPU i as set.
-      cpu_set_t cpuset;
-      CPU_ZERO(&cpuset);
-      CPU_SET(i+offset, &cpuset);
-      if(i+offset > 7) return; //XXX This is a hack to support the non-crypto experiment that does not actually use multiple cores 
-      std::cerr << "Trying to pin to core: " << i << " + " << offset << std::endl;
-      int rc = pthread_setaffinity_np(t->native_handle(),
-                                      sizeof(cpu_set_t), &cpuset);
-      
-      if (rc != 0) {
-          Panic("Error calling pthread_setaffinity_np: %d", rc);
+        t = new std::thread([this, i] {
+          RunWorker(i - 2);
+        });
       }
-      
-      Debug("MainThread running on CPU %d.", sched_getcpu());
+      std::cerr << "Trying to pin to core: " << i << " + " << offset << std::endl;
+      PinThread(t, i + offset);
       threads.push_back(t);
-      t->detach();
     }
   }
   else{
@@ -156,50 +103,16 @@ void ThreadPool::start(int process_id, int total_processes, bool hyperthreading,
     //int offset = process_id * num_cpus;
     Debug("num cpus %d", num_cpus);
     uint32_t num_threads = (uint32_t) std::max(1, num_cpus);
+    for (uint32_t i = 1; i < num_threads; i++) {
+      workers.push_back(new Worker());
+    }
     running = true;
     for (uint32_t i = 0; i < num_threads; i++) {
-      std::thread *t;
-      t = new std::thread([this, i] {
-        while (true) {
-          std::pair<std::function<void*()>, EventInfo*> job;
-          {
-            Debug("Thread %d running on CPU %d.", i, sched_getcpu());
-
-            test_worklist.wait_dequeue(job);
-            //while(!test_worklist.try_dequeue(job)) {};
-
-            // std::unique_lock<std::mutex> lock(this->worklistMutex);
-            // cv.wait(lock, [this] { return this->worklist.size() > 0 || !running; });
-            if (!running) {
-              break;
-            }
-            // if (this->worklist.size() == 0) {
-            //   continue;
-            // }
-            // job = std::move(this->worklist.front());
-            // this->worklist.pop_front();
-          }
-          if(job.second){
-              job.second->r = job.first();
-              event_active(job.second->ev, 0, 0);
-          }
-          else{
-            job.first();
-          }
-        }
+      std::thread *t = new std::thread([this, i] {
+        RunWorker(i);
       });
-      cpu_set_t cpuset; //cpuset : CPU集合を表す変数
-      CPU_ZERO(&cpuset); //cpusetの初期化
-      CPU_SET(i, &cpuset); //i(スレッドの) : 使用するCPU
-      int rc = pthread_setaffinity_np(t->native_handle(),
-                                      sizeof(cpu_set_t), &cpuset);
-      if (rc != 0) {
-          //ここに注意、必ず何が起きているか理解すること
-          Panic("Error calling pthread_setaffinity_np: %d", rc);
-      }
-      Debug("MainThread running on CPU %d.", sched_getcpu());
+      PinThread(t, i);
       threads.push_back(t);
-      t->detach();
     }
   }
 }
@@ -207,120 +120,182 @@ void ThreadPool::start(int process_id, int total_processes, bool hyperthreading,
 ThreadPool::~ThreadPool()
 {
   stop();
-  // delete test_worklistMutex;
-  // delete test_cv;
+  // Workers and completion queues are not freed: a thread that stopped the
+  // pool itself and the event loops may outlive the pool.
 }
 
 void ThreadPool::stop() {
-  running = false;
-  cv.notify_all();
-  cv_main.notify_all();
- // for(auto t: threads){
- //    t->join();
- //    delete t;
- // }
+  if (!running.exchange(false)) {
+    return;
+  }
+  pending.signal(threads.size());
+  test_main_worklist.enqueue(nullptr);
+  // Once stop() returns no job is running anymore. A pool thread that stops
+  // the pool cannot wait for itself and is left to exit on its own.
+  for (auto t : threads) {
+    if (t->get_id() == std::this_thread::get_id()) {
+      t->detach();
+    } else {
+      t->join();
+    }
+    delete t;
+  }
+  threads.clear();
 }
 
-
-void ThreadPool::EventCallback(evutil_socket_t fd, short what, void *arg) {
-  // we want to run the callback in the main event loop
-  EventInfo* info = (EventInfo*) arg;
-  info->cb(info->r);
-
-  info->tp->FreeEvent(info->ev);
-    //event_free(info->ev);
-  info->tp->FreeEventInfo(info);
-    //delete info;
+void ThreadPool::PinThread(std::thread *t, int cpu) {
+  // Create a cpu_set_t object representing a set of CPUs. Clear it and mark
+  // only the given CPU as set.
+  cpu_set_t cpuset;
+  CPU_ZERO(&cpuset);
+  CPU_SET(cpu, &cpuset);
+  int rc = pthread_setaffinity_np(t->native_handle(),
+                                  sizeof(cpu_set_t), &cpuset);
+  if (rc != 0) {
+      Panic("Error calling pthread_setaffinity_np: %d", rc);
+  }
 }
 
+void ThreadPool::RunWorker(size_t idx) {
+  currentPool = this;
+  currentWorker = idx;
+  Debug("Worker %lu running on CPU %d.", idx, sched_getcpu());
 
-void ThreadPool::dispatch(std::function<void*()> f, std::function<void(void*)> cb, event_base* libeventBase) {
-  //EventInfo* info = new EventInfo(this);
-  EventInfo* info = GetUnusedEventInfo();
-  info->cb = std::move(cb);
-  //info->ev = event_new(libeventBase, -1, 0, ThreadPool::EventCallback, info);
-  info->ev = GetUnusedEvent(libeventBase, info);
-  event_add(info->ev, NULL);
-
-  //safe to moveinfo? dont expect it to do anything though, since its just a pointer
-//  std::pair<std::function<void*()>, EventInfo*> job(std::move(f), std::move(info));
-
-  // std::lock_guard<std::mutex> lk(worklistMutex);
-  // //worklist.push_back(std::move(job));
-  // worklist.emplace_back(std::move(f), std::move(info));
-
-  test_worklist.enqueue(std::make_pair(std::move(f), info));
-
-  cv.notify_one();
+  Job job;
+  while (true) {
+    pending.wait();
+    if (!running) {
+      break;
+    }
+    // A job is queued somewhere: look at the own queue first, then steal.
+    size_t n = workers.size();
+    for (size_t k = 0; !workers[(idx + k) % n]->jobs.try_dequeue(job); ++k) { }
+    RunJob(job, workers[idx]->epoch);
+  }
 }
 
-void* ThreadPool::combiner(std::function<void*()> f, std::function<void(void*)> cb){
-  cb(f());
-  return nullptr;
+void ThreadPool::RunJob(Job &job, std::atomic<uint64_t> &epoch) {
+  // Announce before the job can look at shared state.
+  epoch = graceEpoch.load();
+  void *r = job.f();
+  if (job.completions != nullptr) {
+    Complete(job.completions, std::move(job.cb), r);
+  } else if (job.cb) {
+    job.cb(r);
+  }
+  // release captured state now rather than when the slot is reused
+  job.f = nullptr;
+  job.cb = nullptr;
+  epoch.store(GRACE_IDLE, std::memory_order_release);
 }
 
-void ThreadPool::dispatch_local(std::function<void*()> f, std::function<void(void*)> cb){
-  EventInfo* info = nullptr;
-  auto combination = [f = std::move(f), cb = std::move(cb)](){cb(f()); return nullptr;};
-  //std::function<void*()> combination(std::bind(ThreadPool::combiner, std::move(f), std::move(cb)));
-  //std::pair<std::function<void*()>, EventInfo*> job(std::move(combination), info);
+uint64_t ThreadPool::graceToken() {
+  return graceEpoch.fetch_add(1) + 1;
+}
 
+bool ThreadPool::graceExpired(uint64_t token) {
+  if (mainEpoch.load() < token) {
+    return false;
+  }
+  for (const auto w : workers) {
+    if (w->epoch.load() < token) {
+      return false;
+    }
+  }
+  return true;
+}
 
-  // std::lock_guard<std::mutex> lk(worklistMutex);               //STABLE_VERSION
-  // worklist.emplace_back(std::move(combination), info);         //STABLE_VERSION
+void ThreadPool::Submit(Job &&job) {
+  size_t idx = currentPool == this ? currentWorker : nextWorker++ % workers.size();
+  workers[idx]->jobs.enqueue(std::move(job));
+  pending.signal();
+}
 
-  test_worklist.enqueue(std::make_pair(std::move(combination), info));
+ThreadPool::CompletionQueue *ThreadPool::GetCompletionQueue(event_base *libeventBase) {
+  for (size_t i = 0; i < MAX_EVENT_BASES; ++i) {
+    CompletionQueue *c = completions[i].load(std::memory_order_acquire);
+    if (c == nullptr) {
+      break;
+    }
+    if (c->base == libeventBase) {
+      return c;
+    }
+  }
 
-  // std::pair<std::function<void*()>, EventInfo*> job(std::move(combination), info);
-  // testlist.push(job);
+  std::unique_lock<std::mutex> lock(completionsMutex);
+  size_t i = 0;
+  for (; i < MAX_EVENT_BASES; ++i) {
+    CompletionQueue *c = completions[i].load(std::memory_order_acquire);
+    if (c == nullptr) {
+      break;
+    }
+    if (c->base == libeventBase) {
+      return c;
+    }
+  }
+  if (i == MAX_EVENT_BASES) {
+    Panic("ThreadPool supports at most %lu event bases.", MAX_EVENT_BASES);
+  }
+  CompletionQueue *c = new CompletionQueue();
+  c->base = libeventBase;
+  c->scheduled = false;
+  c->ev = event_new(libeventBase, -1, 0, ThreadPool::CompletionCallback, c);
+  completions[i].store(c, std::memory_order_release);
+  return c;
+}
 
-  //worklist2.push_back(std::move(combination));
-  //worklist.push_back(std::move(job));
-  cv.notify_one();
+void ThreadPool::Complete(CompletionQueue *completions, job_callback_t cb, void *r) {
+  completions->done.enqueue(std::make_pair(std::move(cb), r));
+  // This _should_ be thread safe
+  if (!completions->scheduled.exchange(true)) {
+    event_active(completions->ev, 0, 0);
+  }
 }
 
-void ThreadPool::detatch(std::function<void*()> f){
-  EventInfo* info = nullptr;
-  //std::pair<std::function<void*()>, EventInfo*> job(std::move(f), info);
+void ThreadPool::CompletionCallback(evutil_socket_t fd, short what, void *arg) {
+  // we want to run the callbacks in the main event loop
+  CompletionQueue *c = (CompletionQueue *) arg;
+  // Everything enqueued before this exchange is drained below; later
+  // producers activate the event again.
+  c->scheduled.exchange(false);
+
+  std::pair<job_callback_t, void*> batch[COMPLETION_BATCH];
+  // Bound the work per activation so that the loop still serves sockets.
+  for (int rounds = 0; rounds < 16; ++rounds) {
+    size_t n = c->done.try_dequeue_bulk(batch, COMPLETION_BATCH);
+    if (n == 0) {
+      return;
+    }
+    for (size_t i = 0; i < n; ++i) {
+      batch[i].first(batch[i].second);
+      batch[i].first = nullptr;
+    }
+  }
+  if (!c->scheduled.exchange(true)) {
+    event_active(c->ev, 0, 0);
+  }
+}
 
-  // std::lock_guard<std::mutex> lk(worklistMutex);               //STABLE_VERSION
-  // worklist.emplace_back(std::move(f), info);                   //STABLE_VERSION
 
-  test_worklist.enqueue(std::make_pair(std::move(f), info));
+void ThreadPool::dispatch(job_task_t f, job_callback_t cb, event_base* libeventBase) {
+  Submit(Job{std::move(f), std::move(cb), GetCompletionQueue(libeventBase)});
+}
 
-  // std::pair<std::function<void*()>, EventInfo*> job(std::move(f), info);
-  // testlist.push(job);
+void ThreadPool::dispatch_local(job_task_t f, job_callback_t cb){
+  // cb runs right after f on the same worker
+  Submit(Job{std::move(f), std::move(cb), nullptr});
+}
 
-  //worklist2.push_back(std::move(f));
-  cv.notify_one();
+void ThreadPool::detatch(job_task_t f){
+  Submit(Job{std::move(f), nullptr, nullptr});
 }
 
 void ThreadPool::detatch_ptr(std::function<void*()> *f){
-  EventInfo* info = nullptr;
-  //std::pair<std::function<void*()>, EventInfo*> job(std::move(f), info);
-
-  // std::lock_guard<std::mutex> lk(worklistMutex);               //STABLE_VERSION
-  // worklist.emplace_back(std::move(*f), info);                  //STABLE_VERSION
-
-  test_worklist.enqueue(std::make_pair(std::move(*f), info));
-
-  // std::pair<std::function<void*()>, EventInfo*> job(std::move(*f), info);
-  // testlist.push(job);
-
-  //worklist2.push_back(std::move(*f));
-  cv.notify_one();
+  Submit(Job{std::move(*f), nullptr, nullptr});
 }
 
-void ThreadPool::detatch_main(std::function<void*()> f){
-  EventInfo* info = nullptr;
-
-  // std::lock_guard<std::mutex> lk(main_worklistMutex);
-  // main_worklist.push_back(std::move(f));
-
+void ThreadPool::detatch_main(job_task_t f){
   test_main_worklist.enqueue(std::move(f));
-  //test_worklist.enqueue(std::make_pair(std::move(f), info));
-
-  cv_main.notify_one();
 }
 
 ////////////////////////////////
@@ -330,51 +305,6 @@ void ThreadPool::detatch_main(std::function<void*()> f){
 //could make f purely void, if I refactored a bunch
 //lazy solution:
 // transport->Timer(0, [](){f(new bool(true));})
-void ThreadPool::issueCallback(std::function<void(void*)> cb, void* arg, event_base* libeventBase){
-  EventInfo* info = GetUnusedEventInfo(); //new EventInfo(this);
-  info->cb = std::move(cb);
-  info->r = arg;
-  //info->ev = event_new(libeventBase, -1, 0, ThreadPool::EventCallback, info);
-  info->ev = GetUnusedEvent(libeventBase, info);
-  event_add(info->ev, NULL);
-  event_active(info->ev, 0, 0);
-}
-
-////////////////////////////////////////
-
-
-ThreadPool::EventInfo* ThreadPool::GetUnusedEventInfo() {
-  std::unique_lock<std::mutex> lock(EventInfoMutex);
-  EventInfo *info;
-  if (eventInfos.size() > 0) {
-    info = eventInfos.back();
-    eventInfos.pop_back();
-  } else {
-    info = new EventInfo(this);
-  }
-  return info;
-}
-
-void ThreadPool::FreeEventInfo(EventInfo *info) {
-  std::unique_lock<std::mutex> lock(EventInfoMutex);
-  eventInfos.push_back(info);
-}
-
-event* ThreadPool::GetUnusedEvent(event_base* libeventBase, EventInfo* info) {
-  std::unique_lock<std::mutex> lock(EventMutex);
-  event* event;
-  if (events.size() > 0) {
-    event = events.back();
-    events.pop_back();
-    event_assign(event, libeventBase, -1, 0, ThreadPool::EventCallback, info);
-  } else {
-    event = event_new(libeventBase, -1, 0, ThreadPool::EventCallback, info);
-  }
-  return event;
-}
-
-void ThreadPool::FreeEvent(event* event) {
-  std::unique_lock<std::mutex> lock(EventMutex);
-  event_del(event);
-  events.push_back(event);
+void ThreadPool::issueCallback(job_callback_t cb, void* arg, event_base* libeventBase){
+  Complete(GetCompletionQueue(libeventBase), std::move(cb), arg);
 }
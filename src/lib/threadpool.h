@@ -28,20 +28,27 @@
 #define _LIB_THREADPOOL_H_
 
 #include "assert.h"
+#include "lib/task.h"
+#include <atomic>
+#include <cstdint>
 #include <list>
 #include <mutex>
 #include <shared_mutex>
 #include <functional>
 #include <condition_variable>
 #include <thread>
+#include <vector>
 #include <event2/event.h>
 #include <deque>
 #include "concurrentqueue/concurrentqueue.h"
 #include "concurrentqueue/blockingconcurrentqueue.h"
-//#include "tbb/concurrent_queue.h"
-
-//using namespace tbb;
+#include "concurrentqueue/lightweightsemaphore.h"
 
+// Work-stealing executor. Every worker owns a job queue; jobs submitted from a
+// worker stay on that worker's queue, jobs submitted from other threads are
+// spread round-robin. An idle worker first drains its own queue and then
+// steals from the others. Results of dispatch() are handed back to the
+// libevent loop in batches through one event per event_base.
 class ThreadPool {
 
 public:
@@ -54,56 +61,73 @@ public:
   void start(int process_id=0, int total_processes=1, bool hyperthreading =  true, bool server = true);
   void stop();
 
-  void dispatch(std::function<void*()> f, std::function<void(void*)> cb, event_base* libeventBase);
-  void dispatch_local(std::function<void*()> f, std::function<void(void*)> cb);
-  void detatch(std::function<void*()> f);
+  void dispatch(job_task_t f, job_callback_t cb, event_base* libeventBase);
+  void dispatch_local(job_task_t f, job_callback_t cb);
+  void detatch(job_task_t f);
   void detatch_ptr(std::function<void*()> *f);
-  void detatch_main(std::function<void*()> f);
-  void issueCallback(std::function<void(void*)> cb, void* arg, event_base* libeventBase);
+  void detatch_main(job_task_t f);
+  void issueCallback(job_callback_t cb, void* arg, event_base* libeventBase);
+
+  // Grace periods for deferred reclamation. Every pool thread announces the
+  // epoch in which it started its current job. Objects unlinked before
+  // graceToken() may be freed once graceExpired(token): no pool thread is
+  // still inside a job that could have seen them.
+  uint64_t graceToken();
+  bool graceExpired(uint64_t token);
 
 private:
+  static const uint64_t GRACE_IDLE = UINT64_MAX;
+
+  // Callbacks waiting to run on one libevent loop. The event is activated
+  // once per batch: only the producer that flips scheduled activates it.
+  struct CompletionQueue {
+    event_base *base;
+    event *ev;
+    std::atomic_bool scheduled;
+    moodycamel::ConcurrentQueue<std::pair<job_callback_t, void*>> done;
+  };
 
-  struct EventInfo {
-      EventInfo(ThreadPool* tp): tp(tp) {}
+  // Jobs are moved through the queues by value; small closures are stored
+  // inline in the tasks, so dispatching them does not allocate.
+  struct Job {
+    job_task_t f;
+    job_callback_t cb;
+    // cb runs on this loop; if nullptr, cb (if any) runs on the worker.
+    CompletionQueue *completions;
+  };
 
-      event* ev;
-      std::function<void(void*)> cb;
-      void* r;
-      ThreadPool* tp;
+  struct Worker {
+    moodycamel::ConcurrentQueue<Job> jobs;
+    std::atomic<uint64_t> epoch{GRACE_IDLE};
   };
 
-  static void EventCallback(evutil_socket_t fd, short what, void *arg);
-  static void* combiner(std::function<void*()> f, std::function<void(void*)> cb);
+  static const size_t MAX_EVENT_BASES = 8;
+  static const size_t COMPLETION_BATCH = 64;
 
-  EventInfo* GetUnusedEventInfo();
-  void FreeEventInfo(EventInfo *info);
-  event* GetUnusedEvent(event_base* libeventBase, EventInfo* info);
-  void FreeEvent(event* event);
+  static void CompletionCallback(evutil_socket_t fd, short what, void *arg);
 
+  CompletionQueue *GetCompletionQueue(event_base *libeventBase);
+  void Complete(CompletionQueue *completions, job_callback_t cb, void *r);
+  void Submit(Job &&job);
+  void RunJob(Job &job, std::atomic<uint64_t> &epoch);
+  void RunWorker(size_t idx);
+  void PinThread(std::thread *t, int cpu);
 
-  std::mutex worklistMutex;
-  std::mutex EventInfoMutex;
-  std::mutex EventMutex;
-  std::condition_variable cv;
-  std::vector<EventInfo*> eventInfos;
-  std::vector<event*> events;
-  std::deque<std::pair<std::function<void*()>, EventInfo*> > worklist;
-  std::deque <std::function<void*()>> worklist2; //try with deque
-  bool running;
+  std::atomic_bool running;
   std::vector<std::thread*> threads;
 
-  std::deque <std::function<void*()>> main_worklist;
+  std::vector<Worker *> workers;
+  // Counts queued jobs; a worker that acquires it is owed exactly one job.
+  moodycamel::LightweightSemaphore pending;
+
+  std::atomic<uint64_t> graceEpoch;
+  // Announced epoch of the second main thread (detatch_main).
+  std::atomic<uint64_t> mainEpoch;
 
-  moodycamel::BlockingConcurrentQueue<std::pair<std::function<void*()>, EventInfo*>> test_worklist;
-  moodycamel::BlockingConcurrentQueue<std::function<void*()>> test_main_worklist;
+  std::mutex completionsMutex;
+  std::atomic<CompletionQueue *> completions[MAX_EVENT_BASES];
 
-  //tbb::concurrent_queue <std::pair<std::function<void*()>, EventInfo*>> testlist;
-  //std::shared_mutex dummyMutex;
-  //testlist.push()
-  //testlist.try_pop(&job)
-  //testlist.size_type
-  std::mutex main_worklistMutex;
-  std::condition_variable cv_main;
+  moodycamel::BlockingConcurrentQueue<job_task_t> test_main_worklist;
 };
 
 #endif  // _LIB_THREADPOOL_H_
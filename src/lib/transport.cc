@@ -50,6 +50,32 @@ TransportReceiver::GetAddress()
     return this->myAddress;
 }
 
+void
+TransportReceiver::ReceiveMessageView(const TransportAddress &remote,
+                                      std::string_view type,
+                                      const MessageView &data,
+                                      void *meta_data)
+{
+    ReceiveMessage(remote, std::string(type), data.ToString(), meta_data);
+}
+
+void
+TransportReceiver::ReceiveMessageView_batch(const TransportAddress &remote,
+                                            const std::vector<std::string_view> &types,
+                                            const std::vector<MessageView> &datas,
+                                            void *meta_data)
+{
+    std::vector<std::string> typeCopies;
+    std::vector<std::string> dataCopies;
+    typeCopies.reserve(types.size());
+    dataCopies.reserve(datas.size());
+    for (size_t i = 0; i < types.size(); ++i) {
+        typeCopies.emplace_back(types[i]);
+        dataCopies.emplace_back(datas[i].ToString());
+    }
+    ReceiveMessage_batch(remote, typeCopies, dataCopies, meta_data);
+}
+
 Timeout::Timeout(Transport *transport, uint64_t ms, timer_callback_t cb)
     : transport(transport), ms(ms), cb(cb)
 {
@@ -32,11 +32,14 @@
 #define _LIB_TRANSPORT_H_
 
 #include "lib/configuration.h"
+#include "lib/messageview.h"
+#include "lib/task.h"
 
 #include <google/protobuf/message.h>
 #include <functional>
 #include <list>
 #include <map>
+#include <string_view>
 #include <unordered_map>
 
 class TransportAddress
@@ -67,6 +70,19 @@ public:
                                 const std::vector<std::string> &datas,
                                 void * meta_data) = 0;
 
+    // Zero-copy receive: type and data point into the transport's receive
+    // buffer and are only valid until the call returns. The defaults copy
+    // them and forward to the std::string variants above.
+    virtual void ReceiveMessageView(const TransportAddress &remote,
+                                    std::string_view type,
+                                    const MessageView &data,
+                                    void * meta_data);
+
+    virtual void ReceiveMessageView_batch(const TransportAddress &remote,
+                                    const std::vector<std::string_view> &types,
+                                    const std::vector<MessageView> &datas,
+                                    void * meta_data);
+
 protected:
     const TransportAddress *myAddress;
 };
@@ -163,12 +179,20 @@ public:
     /* Dispatch function f to the thread pool
      * handle the result in cb
      */
-    virtual void DispatchTP(std::function<void*()> f, std::function<void(void*)> cb) = 0;
-    virtual void DispatchTP_local(std::function<void*()> f, std::function<void(void*)> cb) = 0;
-    virtual void DispatchTP_noCB(std::function<void*()> f) = 0;
+    virtual void DispatchTP(job_task_t f, job_callback_t cb) = 0;
+    virtual void DispatchTP_local(job_task_t f, job_callback_t cb) = 0;
+    virtual void DispatchTP_noCB(job_task_t f) = 0;
     virtual void DispatchTP_noCB_ptr(std::function<void*()> *f) = 0;
-    virtual void DispatchTP_main(std::function<void*()> f) = 0;
-    virtual void IssueCB(std::function<void(void*)> cb, void* arg) = 0;
+    virtual void DispatchTP_main(job_task_t f) = 0;
+    virtual void IssueCB(job_callback_t cb, void* arg) = 0;
+
+    /* Grace periods for deferred reclamation across the thread pool:
+     * objects unlinked before GraceToken() may be freed once
+     * GraceExpired(token). Transports without a pool run everything on
+     * the event loop, which the caller is on.
+     */
+    virtual uint64_t GraceToken() { return 0; }
+    virtual bool GraceExpired(uint64_t token) { return true; }
 };
 
 class Timeout
@@ -1082,25 +1082,33 @@ UDPTransport::OnTimer(UDPTransportTimerInfo *info)
     delete info;
 }
 
-void UDPTransport::DispatchTP(std::function<void*()> f, std::function<void(void*)> cb) {
+void UDPTransport::DispatchTP(job_task_t f, job_callback_t cb) {
   tp.dispatch(std::move(f), std::move(cb), libeventBase);
 }
-void UDPTransport::DispatchTP_local(std::function<void*()> f, std::function<void(void*)> cb)  {
+void UDPTransport::DispatchTP_local(job_task_t f, job_callback_t cb)  {
   tp.dispatch_local(std::move(f), std::move(cb));
 }
-void UDPTransport::DispatchTP_noCB(std::function<void*()> f) {
+void UDPTransport::DispatchTP_noCB(job_task_t f) {
   tp.detatch(std::move(f));
 }
 void UDPTransport::DispatchTP_noCB_ptr(std::function<void*()> *f) {
   tp.detatch_ptr(f);
 }
-void UDPTransport::DispatchTP_main(std::function<void*()> f) {
+void UDPTransport::DispatchTP_main(job_task_t f) {
   tp.detatch_main(std::move(f));
 }
-void UDPTransport::IssueCB(std::function<void(void*)> cb, void* arg){
+void UDPTransport::IssueCB(job_callback_t cb, void* arg){
   tp.issueCallback(std::move(cb), arg, libeventBase);
 }
 
+uint64_t UDPTransport::GraceToken() {
+  return tp.graceToken();
+}
+
+bool UDPTransport::GraceExpired(uint64_t token) {
+  return tp.graceExpired(token);
+}
+
 
 void
 UDPTransport::SocketCallback(evutil_socket_t fd, short what, void *arg)
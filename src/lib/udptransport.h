@@ -91,12 +91,14 @@ public:
     virtual void Close(TransportReceiver *receiver) override;
     //virtual void Flush();
 
-    virtual void DispatchTP(std::function<void*()> f, std::function<void(void*)> cb) override;
-    virtual void DispatchTP_local(std::function<void*()> f, std::function<void(void*)> cb) override;
-    virtual void DispatchTP_noCB(std::function<void*()> f) override;
+    virtual void DispatchTP(job_task_t f, job_callback_t cb) override;
+    virtual void DispatchTP_local(job_task_t f, job_callback_t cb) override;
+    virtual void DispatchTP_noCB(job_task_t f) override;
     virtual void DispatchTP_noCB_ptr(std::function<void*()> *f) override;
-    virtual void DispatchTP_main(std::function<void*()> f) override;
-    virtual void IssueCB(std::function<void(void*)> cb, void* arg) override;
+    virtual void DispatchTP_main(job_task_t f) override;
+    virtual void IssueCB(job_callback_t cb, void* arg) override;
+    virtual uint64_t GraceToken() override;
+    virtual bool GraceExpired(uint64_t token) override;
 
 private:
     int TimerInternal(struct timeval &tv, timer_callback_t cb);
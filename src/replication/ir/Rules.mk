@@ -10,6 +10,8 @@ OBJS-ir-client :=  $(o)ir-proto.o $(o)client.o \
                    $(OBJS-client) $(LIB-message) \
                    $(LIB-configuration)
 
+LIB-ir-record := $(o)record.o $(o)ir-proto.o $(LIB-request) $(LIB-message)
+
 OBJS-ir-replica := $(o)record.o $(o)replica.o $(o)ir-proto.o \
                    $(OBJS-replica) $(LIB-message) \
                    $(LIB-configuration) $(LIB-persistent_register)
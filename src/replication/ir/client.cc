@@ -48,7 +48,7 @@ IRClient::IRClient(const transport::Configuration &config,
                    Transport *transport, int group,
                    uint64_t clientid)
     : Client(config, transport, group, clientid),
-      lastReqId(0)
+      lastReqId(0), lastUnloggedReqId(0)
 {
 
 }
@@ -58,6 +58,9 @@ IRClient::~IRClient()
     for (auto kv : pendingReqs) {
 	delete kv.second;
     }
+    for (auto kv : pendingUnloggedReqs) {
+	delete kv.second;
+    }
 }
 
 void
@@ -166,7 +169,7 @@ IRClient::InvokeUnlogged(int replicaIdx,
                          error_continuation_t error_continuation,
                          uint32_t timeout)
 {
-    uint64_t reqId = ++lastReqId;
+    uint64_t reqId = ++lastUnloggedReqId;
     auto timer = std::unique_ptr<Timeout>(new Timeout(
         transport, timeout,
         [this, reqId]() { UnloggedRequestTimeoutCallback(reqId); }));
@@ -185,7 +188,7 @@ IRClient::InvokeUnlogged(int replicaIdx,
 
     if (transport->SendMessageToReplica(this, group, replicaIdx, reqMsg)) {
 	req->timer->Start();
-	pendingReqs[reqId] = req;
+	pendingUnloggedReqs[reqId] = req;
     } else {
         Warning("Could not send unlogged request to replica");
 	delete req;
@@ -195,7 +198,7 @@ IRClient::InvokeUnlogged(int replicaIdx,
 void IRClient::InvokeUnloggedAll(const string &request,
     continuation_t continuation, error_continuation_t error_continuation,
     uint32_t timeout) {
-  uint64_t reqId = ++lastReqId;
+  uint64_t reqId = ++lastUnloggedReqId;
   auto timer = std::unique_ptr<Timeout>(new Timeout(transport, timeout,
         [this, reqId]() { UnloggedRequestTimeoutCallback(reqId); }));
 
@@ -209,7 +212,7 @@ void IRClient::InvokeUnloggedAll(const string &request,
 
   if (transport->SendMessageToGroup(this, group, reqMsg)) {
     req->timer->Reset();
-    pendingReqs[reqId] = req;
+    pendingUnloggedReqs[reqId] = req;
   } else {
     Warning("Could not send unlogged request to replica");
     delete req;
@@ -640,8 +643,8 @@ IRClient::HandleUnloggedReply(const TransportAddress &remote,
                               const proto::UnloggedReplyMessage &msg)
 {
     uint64_t reqId = msg.clientreqid();
-    auto it = pendingReqs.find(reqId);
-    if (it == pendingReqs.end()) {
+    auto it = pendingUnloggedReqs.find(reqId);
+    if (it == pendingUnloggedReqs.end()) {
         Debug("Received reply when no request was pending %lu", reqId);
         return;
     }
@@ -652,7 +655,7 @@ IRClient::HandleUnloggedReply(const TransportAddress &remote,
       // delete timer event
       req->timer->Stop();
       // remove from pending list
-      pendingReqs.erase(it);
+      pendingUnloggedReqs.erase(it);
       // invoke application callback
       delete req;
     }
@@ -661,14 +664,13 @@ IRClient::HandleUnloggedReply(const TransportAddress &remote,
 void
 IRClient::UnloggedRequestTimeoutCallback(const uint64_t reqId)
 {
-    auto it = pendingReqs.find(reqId);
-    if (it == pendingReqs.end()) {
+    auto it = pendingUnloggedReqs.find(reqId);
+    if (it == pendingUnloggedReqs.end()) {
         Debug("Received timeout when no request was pending");
         return;
     }
 
-    PendingUnloggedRequest *req = static_cast<PendingUnloggedRequest *>(it->second);
-    UW_ASSERT(req != NULL);
+    PendingUnloggedRequest *req = it->second;
 
     Warning("Unlogged request %lu:%lu timed out: %s",
         clientid, reqId, req->request.c_str());
@@ -676,7 +678,7 @@ IRClient::UnloggedRequestTimeoutCallback(const uint64_t reqId)
     // delete timer event
     req->timer->Stop();
     // remove from pending list
-    pendingReqs.erase(it);
+    pendingUnloggedReqs.erase(it);
     // invoke application callback
     if (req->error_continuation) {
         req->error_continuation(req->request, ErrorCode::TIMEOUT);
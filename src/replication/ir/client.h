@@ -182,6 +182,11 @@ protected:
 
     uint64_t lastReqId;
     std::unordered_map<uint64_t, PendingRequest *> pendingReqs;
+    // Unlogged requests never reach the replicas' records, so they take
+    // their ids from a separate counter. Otherwise every read would leave a
+    // gap in the logged ids that holds back the compaction watermark.
+    uint64_t lastUnloggedReqId;
+    std::unordered_map<uint64_t, PendingUnloggedRequest *> pendingUnloggedReqs;
 
     void SendInconsistent(const PendingInconsistentRequest *req);
     void ResendInconsistent(const uint64_t reqId);
@@ -30,6 +30,7 @@
 
 #include "replication/ir/record.h"
 
+#include <algorithm>
 #include <utility>
 
 #include "lib/assert.h"
@@ -51,6 +52,7 @@ Record::Record(const proto::RecordProto &record_proto) {
         const std::string& result = entry_proto.result();
         Add(view, opid, request, state, type, result);
     }
+    MergeCompacted(record_proto);
 }
 
 RecordEntry &
@@ -140,6 +142,12 @@ Record::Empty() const
     return entries.empty();
 }
 
+size_t
+Record::Size() const
+{
+    return entries.size();
+}
+
 void
 Record::ToProto(proto::RecordProto *proto) const
 {
@@ -155,11 +163,110 @@ Record::ToProto(proto::RecordProto *proto) const
         entry_proto->set_op(entry.request.op());
         entry_proto->set_result(entry.result);
     }
+    for (const std::pair<const uint64_t, CompactedIds> &c : compacted) {
+        if (c.second.watermark > 0) {
+            proto::OpID *watermark = proto->add_watermark();
+            watermark->set_clientid(c.first);
+            watermark->set_clientreqid(c.second.watermark);
+        }
+        for (uint64_t clientreqid : c.second.above) {
+            proto::OpID *opid = proto->add_compacted();
+            opid->set_clientid(c.first);
+            opid->set_clientreqid(clientreqid);
+        }
+    }
 }
 
 const std::map<opid_t, RecordEntry> &Record::Entries() const {
     return entries;
 }
 
+bool
+Record::Compact(opid_t opid)
+{
+    auto itr = entries.find(opid);
+    if (itr == entries.end() ||
+        itr->second.state != proto::RECORD_STATE_FINALIZED) {
+        return false;
+    }
+
+    entries.erase(itr);
+    MarkCompacted(opid);
+    return true;
+}
+
+bool
+Record::Compacted(opid_t opid) const
+{
+    auto itr = compacted.find(opid.first);
+    if (itr == compacted.end() || entries.count(opid) > 0) {
+        return false;
+    }
+    return opid.second <= itr->second.watermark ||
+        itr->second.above.count(opid.second) > 0;
+}
+
+// Moves the watermark over the ids above it that now continue it.
+static void
+Advance(uint64_t &watermark, std::set<uint64_t> &above)
+{
+    auto itr = above.begin();
+    while (itr != above.end() && *itr <= watermark + 1) {
+        watermark = std::max(watermark, *itr);
+        itr = above.erase(itr);
+    }
+}
+
+void
+Record::MarkCompacted(opid_t opid)
+{
+    CompactedIds &c = compacted[opid.first];
+    if (opid.second <= c.watermark) {
+        return;
+    }
+    c.above.insert(opid.second);
+    Advance(c.watermark, c.above);
+}
+
+void
+Record::RaiseWatermark(uint64_t clientid, uint64_t clientreqid)
+{
+    CompactedIds &c = compacted[clientid];
+    if (clientreqid <= c.watermark) {
+        return;
+    }
+    c.watermark = clientreqid;
+    Advance(c.watermark, c.above);
+}
+
+void
+Record::MergeCompacted(const Record &other)
+{
+    for (const std::pair<const uint64_t, CompactedIds> &c : other.compacted) {
+        RaiseWatermark(c.first, c.second.watermark);
+        for (uint64_t clientreqid : c.second.above) {
+            MarkCompacted(std::make_pair(c.first, clientreqid));
+        }
+    }
+}
+
+void
+Record::MergeCompacted(const proto::RecordProto &proto)
+{
+    for (const proto::OpID &watermark : proto.watermark()) {
+        RaiseWatermark(watermark.clientid(), watermark.clientreqid());
+    }
+    for (const proto::OpID &opid : proto.compacted()) {
+        MarkCompacted(std::make_pair(opid.clientid(), opid.clientreqid()));
+    }
+}
+
+uint64_t
+Record::Watermark(uint64_t clientid) const
+{
+    auto itr = compacted.find(clientid);
+    return itr == compacted.end() ? 0 : itr->second.watermark;
+}
+
 } // namespace ir
 } // namespace replication
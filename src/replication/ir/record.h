@@ -32,6 +32,7 @@
 #define _IR_RECORD_H_
 
 #include <map>
+#include <set>
 #include <string>
 #include <utility>
 
@@ -94,6 +95,7 @@ public:
     }
     friend void swap(Record &x, Record &y) {
         std::swap(x.entries, y.entries);
+        std::swap(x.compacted, y.compacted);
     }
 
     RecordEntry &Add(const RecordEntry& entry);
@@ -109,11 +111,38 @@ public:
     bool SetRequest(opid_t opid, const Request &req);
     void Remove(opid_t opid);
     bool Empty() const;
+    size_t Size() const;
     void ToProto(proto::RecordProto *proto) const;
     const std::map<opid_t, RecordEntry> &Entries() const;
 
+    // Truncate a finalized entry that the app has applied. The entry is
+    // dropped and its id remembered as compacted.
+    bool Compact(opid_t opid);
+    // Whether opid was compacted, here or in a record merged into this
+    // one, and is not (back) in the record.
+    bool Compacted(opid_t opid) const;
+    void MarkCompacted(opid_t opid);
+    // Marks every request of clientid up to clientreqid compacted.
+    void RaiseWatermark(uint64_t clientid, uint64_t clientreqid);
+    // Marks everything compacted in other compacted here too.
+    void MergeCompacted(const Record &other);
+    void MergeCompacted(const proto::RecordProto &proto);
+    // The highest request id of clientid up to which every request is
+    // compacted; 0 if none is (client request ids start at 1).
+    uint64_t Watermark(uint64_t clientid) const;
+
 private:
+    struct CompactedIds {
+        uint64_t watermark = 0;
+        // Compacted ids above the watermark. The watermark only advances
+        // over a contiguous run, so an id that is not compacted yet holds
+        // back every id after it. IRClient numbers its unlogged requests
+        // separately so that they leave no such gaps.
+        std::set<uint64_t> above;
+    };
+
     std::map<opid_t, RecordEntry> entries;
+    std::map<uint64_t, CompactedIds> compacted;
 };
 
 }      // namespace ir
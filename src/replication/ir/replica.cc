@@ -19,7 +19,8 @@ using namespace std;
 using namespace proto;
 
 IRReplica::IRReplica(transport::Configuration config, int groupIdx, int myIdx,
-                     Transport *transport, IRAppReplica *app)
+                     Transport *transport, IRAppReplica *app,
+                     uint64_t compactInterval)
     : config(std::move(config)), groupIdx(groupIdx), myIdx(myIdx),
     transport(transport), app(app),
       status(STATUS_NORMAL), view(0), latest_normal_view(0),
@@ -29,7 +30,8 @@ IRReplica::IRReplica(transport::Configuration config, int groupIdx, int myIdx,
                            std::to_string(myIdx) + ".bin"),
       // Note that a leader waits for DO-VIEW-CHANGE messages from f other
       // replicas (as opposed to f + 1) for a total of f + 1 replicas.
-      do_view_change_quorum(config.f)
+      do_view_change_quorum(config.f),
+      compact_interval(compactInterval), compaction_floor(0)
 {
     transport->Register(this, config, groupIdx, myIdx);
 
@@ -131,6 +133,14 @@ IRReplica::HandleProposeInconsistent(const TransportAddress &remote,
 
     opid_t opid = make_pair(clientid, clientreqid);
 
+    if (record.Compacted(opid)) {
+        // Finalized and applied long ago, or too late to be of use; the
+        // client does not need this replica's reply either way.
+        Debug("Op %lu:%lu was compacted.", clientid,
+              clientreqid);
+        return;
+    }
+
     // Check record if we've already handled this request
     RecordEntry *entry = record.Find(opid);
     ReplyInconsistentMessage reply;
@@ -188,6 +198,8 @@ IRReplica::HandleFinalizeInconsistent(const TransportAddress &remote,
         *reply.mutable_opid() = msg.opid();
 
         transport->SendMessage(this, remote, reply);
+
+        TryCompact(opid);
     } else {
         // Ignore?
     }
@@ -204,6 +216,12 @@ IRReplica::HandleProposeConsensus(const TransportAddress &remote,
 
     opid_t opid = make_pair(clientid, clientreqid);
 
+    if (record.Compacted(opid)) {
+        Debug("Op %lu:%lu was compacted.", clientid,
+              clientreqid);
+        return;
+    }
+
     // Check record if we've already handled this request
     RecordEntry *entry = record.Find(opid);
     ReplyConsensusMessage reply;
@@ -275,6 +293,11 @@ IRReplica::HandleFinalizeConsensus(const TransportAddress &remote,
         } else {
           Warning("%lu:%lu Failed to send confirm message", clientid, clientreqid);
         }
+
+        TryCompact(opid);
+    } else if (record.Compacted(opid)) {
+        Debug("%lu:%lu Finalize for compacted consensus op", clientid,
+              clientreqid);
     } else {
         // Ignore?
         Warning("Finalize request for unknown consensus operation");
@@ -375,6 +398,8 @@ IRReplica::HandleDoViewChange(const TransportAddress &remote,
     if (!success) {
         Warning("Could not send StartViewMessage.");
     }
+
+    QueueFinalized();
 }
 
 void
@@ -405,9 +430,14 @@ IRReplica::HandleStartView(const TransportAddress &remote,
     UW_ASSERT((msg.new_view() >= view) ||
            (msg.new_view() == view && status != STATUS_NORMAL));
 
-    // Throw away our record for the new master record and call sync.
-    record = Record(msg.record());
+    // Throw away our record for the new master record and call sync. We
+    // keep what we compacted ourselves: it is applied here, even if no
+    // replica in the view change quorum had compacted it.
+    Record master(msg.record());
+    master.MergeCompacted(record);
+    record = std::move(master);
     app->Sync(record.Entries());
+    QueueFinalized();
 
     status = STATUS_NORMAL;
     view = msg.new_view();
@@ -516,6 +546,17 @@ IRReplica::IrMergeRecords(const std::map<int, DoViewChangeMessage>& records) {
             std::max(max_latest_normal_view, msg.latest_normal_view());
     }
 
+    // An entry some replica compacted was finalized and applied there, so
+    // the master record does not need to decide it again. Collect what the
+    // whole quorum compacted, not just latest_records.
+    Record R;
+    for (const std::pair<const int, DoViewChangeMessage>& p : records) {
+        const DoViewChangeMessage& msg = p.second;
+        UW_ASSERT(msg.has_record());
+        R.MergeCompacted(msg.record());
+    }
+    R.MergeCompacted(record);
+
     // Collect the records with largest latest_normal_view.
     std::vector<Record> latest_records;
     for (const std::pair<const int, DoViewChangeMessage>& p : records) {
@@ -532,7 +573,6 @@ IRReplica::IrMergeRecords(const std::map<int, DoViewChangeMessage>& records) {
     // Group together all the entries from all the records in latest_records.
     // We'll use this to build d and u. Simultaneously populate R.
     // TODO: Avoid redundant copies.
-    Record R;
     std::map<opid_t, RecordEntryVec> entries_by_opid;
     for (const Record &r : latest_records) {
         for (const std::pair<const opid_t, RecordEntry> &p : r.Entries()) {
@@ -551,6 +591,13 @@ IRReplica::IrMergeRecords(const std::map<int, DoViewChangeMessage>& records) {
                     R.Add(entry);
                 }
                 entries_by_opid.erase(opid);
+            } else if (R.Compacted(opid)) {
+                // Someone compacted it, so it was finalized and the app no
+                // longer cares about its result. Keep it so that replicas
+                // which still hold it tentatively get it finalized by Sync.
+                RecordEntry &finalized = R.Add(entry);
+                finalized.state = RECORD_STATE_FINALIZED;
+                entries_by_opid.erase(opid);
             } else {
                 UW_ASSERT(entry.type == RECORD_TYPE_CONSENSUS &&
                        entry.state == RECORD_STATE_TENTATIVE);
@@ -635,5 +682,61 @@ IRReplica::IrMergeRecords(const std::map<int, DoViewChangeMessage>& records) {
     return R;
 }
 
+void IRReplica::TryCompact(opid_t opid) {
+    if (compact_interval == 0) {
+        return;
+    }
+
+    RecordEntry *entry = record.Find(opid);
+    if (entry == NULL || entry->state != RECORD_STATE_FINALIZED) {
+        return;
+    }
+    if (app->Compactable(*entry)) {
+        record.Compact(opid);
+    } else {
+        compaction_queue.push_back(opid);
+    }
+
+    if (compaction_queue.size() >= std::max(compaction_floor * 2,
+            compaction_floor + compact_interval)) {
+        CompactRecord();
+    }
+}
+
+void IRReplica::CompactRecord() {
+    size_t queued = compaction_queue.size();
+    for (size_t i = 0; i < queued; ++i) {
+        opid_t opid = compaction_queue.front();
+        compaction_queue.pop_front();
+
+        RecordEntry *entry = record.Find(opid);
+        if (entry == NULL || entry->state != RECORD_STATE_FINALIZED) {
+            continue;
+        }
+        if (app->Compactable(*entry)) {
+            record.Compact(opid);
+        } else {
+            compaction_queue.push_back(opid);
+        }
+    }
+    compaction_floor = compaction_queue.size();
+    Debug("Compacted record down to %lu entries, %lu waiting on the app.",
+          record.Size(), compaction_floor);
+}
+
+void IRReplica::QueueFinalized() {
+    if (compact_interval == 0) {
+        return;
+    }
+
+    compaction_queue.clear();
+    for (const std::pair<const opid_t, RecordEntry> &p : record.Entries()) {
+        if (p.second.state == RECORD_STATE_FINALIZED) {
+            compaction_queue.push_back(p.first);
+        }
+    }
+    CompactRecord();
+}
+
 } // namespace ir
 } // namespace replication
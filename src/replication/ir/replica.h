@@ -9,6 +9,7 @@
 #ifndef _IR_REPLICA_H_
 #define _IR_REPLICA_H_
 
+#include <deque>
 #include <memory>
 
 #include "lib/assert.h"
@@ -46,6 +47,9 @@ public:
         const std::map<opid_t, std::string> &majority_results_in_d) {
         return {};
     };
+    // Whether a finalized entry has been applied for good and no longer
+    // needs to take part in a view change, so it can be compacted.
+    virtual bool Compactable(const RecordEntry &entry) { return false; };
 
 };
 
@@ -53,8 +57,14 @@ public:
 class IRReplica : public TransportReceiver
 {
 public:
+    static const uint64_t DEFAULT_COMPACT_INTERVAL = 1024;
+
+    // Every compactInterval finalized entries that could not be compacted
+    // right away, the replica asks the app again. A compactInterval of 0
+    // disables compaction.
     IRReplica(transport::Configuration config, int groupIdx, int myIdx,
-              Transport *transport, IRAppReplica *app);
+              Transport *transport, IRAppReplica *app,
+              uint64_t compactInterval = DEFAULT_COMPACT_INTERVAL);
     ~IRReplica();
 
     // Message handlers.
@@ -85,6 +95,9 @@ public:
     void HandleViewChangeTimeout();
 
 private:
+    friend class IrMergeRecordsTest;
+    friend class IrCompactionTest;
+
     // Persist `view` and `latest_normal_view` to disk using
     // `persistent_view_info`.
     void PersistViewInfo();
@@ -101,6 +114,14 @@ private:
     Record IrMergeRecords(
         const std::map<int, proto::DoViewChangeMessage> &records);
 
+    // Compact the finalized entry opid if the app is done with it, and
+    // otherwise queue it for a later CompactRecord.
+    void TryCompact(opid_t opid);
+    // Retry the queued entries.
+    void CompactRecord();
+    // Queue every finalized entry of a freshly installed record.
+    void QueueFinalized();
+
     transport::Configuration config;
     int groupIdx;
     int myIdx; // Replica index into config.
@@ -127,6 +148,14 @@ private:
     // v, we should be able to garbage collect all quorums for views less than
     // v.
     QuorumSet<view_t, proto::DoViewChangeMessage> do_view_change_quorum;
+
+    // Finalized entries the app could not release yet, oldest first.
+    // CompactRecord runs once the queue has grown by compact_interval
+    // entries and doubled since the last run, so apps that never compact
+    // pay amortized constant time per entry.
+    const uint64_t compact_interval;
+    std::deque<opid_t> compaction_queue;
+    size_t compaction_floor;
 };
 
 } // namespace ir
@@ -1,6 +1,8 @@
 d := $(dir $(lastword $(MAKEFILE_LIST)))
 
-GTEST_SRCS += $(d)ir-test.cc
+GTEST_SRCS += $(d)ir-test.cc $(d)record-test.cc
+
+SRCS += $(d)record-bench.cc
 
 $(d)ir-test: $(o)ir-test.o \
 	$(OBJS-ir-replica) $(OBJS-ir-client) \
@@ -8,3 +10,12 @@ $(d)ir-test: $(o)ir-test.o \
 	$(GTEST_MAIN)
 
 # TEST_BINS += $(d)ir-test
+
+$(d)record-test: $(o)record-test.o $(OBJS-ir-replica) $(OBJS-ir-client) \
+	$(LIB-repltransport) $(GTEST_MAIN)
+
+TEST_BINS += $(d)record-test
+
+$(d)record-bench: $(o)record-bench.o $(LIB-ir-record)
+
+BINS += $(d)record-bench
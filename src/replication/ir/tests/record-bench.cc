@@ -0,0 +1,161 @@
+/***********************************************************************
+ *
+ * Copyright 2021 Florian Suri-Payer <fsp@cs.cornell.edu>
+ *                Matthew Burke <matthelb@cs.cornell.edu>
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ **********************************************************************/
+#include "lib/message.h"
+#include "replication/ir/ir-proto.pb.h"
+#include "replication/ir/record.h"
+
+#include <gflags/gflags.h>
+
+#include <chrono>
+#include <map>
+#include <sstream>
+#include <vector>
+
+DEFINE_string(record_sizes, "10000,100000,1000000", "comma-separated list of"
+    " record sizes in entries.");
+DEFINE_uint64(clients, 64, "number of clients the entries are spread over.");
+DEFINE_uint64(op_size, 128, "size of each operation in bytes.");
+DEFINE_double(live_fraction, 0.01, "fraction of the newest entries that are"
+    " still tentative and survive compaction.");
+DEFINE_uint64(quorum, 2, "number of records the view change leader merges"
+    " (f + 1).");
+
+using namespace replication;
+using namespace replication::ir;
+
+typedef std::chrono::high_resolution_clock Clock;
+
+static uint64_t UsSince(const Clock::time_point &start) {
+  return std::chrono::duration_cast<std::chrono::microseconds>(
+      Clock::now() - start).count();
+}
+
+// Every client alternates a consensus prepare and an inconsistent commit.
+// All but the newest live_fraction of the entries are finalized.
+static Record BuildRecord(uint64_t size, bool compact) {
+  Record record;
+  const std::string op(FLAGS_op_size, 'x');
+  const uint64_t finalized = size - static_cast<uint64_t>(
+      size * FLAGS_live_fraction);
+  for (uint64_t i = 0; i < size; ++i) {
+    opid_t opid = std::make_pair(i % FLAGS_clients, i / FLAGS_clients);
+    Request request;
+    request.set_op(op);
+    request.set_clientid(opid.first);
+    request.set_clientreqid(opid.second);
+    proto::RecordEntryType type = opid.second % 2 == 0 ?
+        proto::RECORD_TYPE_CONSENSUS : proto::RECORD_TYPE_INCONSISTENT;
+    proto::RecordEntryState state = i < finalized ?
+        proto::RECORD_STATE_FINALIZED : proto::RECORD_STATE_TENTATIVE;
+    record.Add(0, opid, request, state, type, "result");
+    if (compact) {
+      record.Compact(opid);
+    }
+  }
+  return record;
+}
+
+// Ships the record of every quorum member to the leader, groups the entries
+// by opid as IrMergeRecords does, and ships the master record back.
+static void ViewChange(const Record &record, uint64_t &us, uint64_t &bytes) {
+  bytes = 0;
+  Clock::time_point start = Clock::now();
+
+  std::vector<Record> records;
+  for (uint64_t i = 0; i < FLAGS_quorum; ++i) {
+    proto::DoViewChangeMessage msg;
+    msg.set_replicaidx(i);
+    msg.set_new_view(1);
+    msg.set_latest_normal_view(0);
+    record.ToProto(msg.mutable_record());
+    std::string wire;
+    msg.SerializeToString(&wire);
+    bytes += wire.size();
+
+    proto::DoViewChangeMessage received;
+    received.ParseFromString(wire);
+    records.push_back(Record(received.record()));
+  }
+
+  std::map<opid_t, std::vector<RecordEntry>> entries_by_opid;
+  Record master;
+  for (const Record &r : records) {
+    for (const auto &p : r.Entries()) {
+      entries_by_opid[p.first].push_back(p.second);
+    }
+    master.MergeCompacted(r);
+  }
+  for (const auto &p : entries_by_opid) {
+    RecordEntry &entry = master.Add(p.second[0]);
+    entry.state = proto::RECORD_STATE_FINALIZED;
+  }
+
+  proto::StartViewMessage startView;
+  master.ToProto(startView.mutable_record());
+  startView.set_new_view(1);
+  std::string wire;
+  startView.SerializeToString(&wire);
+  bytes += wire.size();
+  proto::StartViewMessage received;
+  received.ParseFromString(wire);
+  Record installed(received.record());
+
+  us = UsSince(start);
+}
+
+int main(int argc, char *argv[]) {
+  gflags::SetUsageMessage("benchmark IR view change against record size.");
+  gflags::ParseCommandLineFlags(&argc, &argv, true);
+
+  std::vector<uint64_t> sizes;
+  std::stringstream ss(FLAGS_record_sizes);
+  std::string tok;
+  while (std::getline(ss, tok, ',')) {
+    sizes.push_back(std::stoull(tok));
+  }
+
+  Notice("===================================");
+  Notice("Running IR record view change bench: %lu clients, %lu B ops,"
+      " %.3f live, quorum of %lu.", FLAGS_clients, FLAGS_op_size,
+      FLAGS_live_fraction, FLAGS_quorum);
+
+  for (uint64_t size : sizes) {
+    Record full = BuildRecord(size, false);
+    Record compacted = BuildRecord(size, true);
+
+    uint64_t fullUs, fullBytes, compactedUs, compactedBytes;
+    ViewChange(full, fullUs, fullBytes);
+    ViewChange(compacted, compactedUs, compactedBytes);
+
+    Notice("%lu entries: full %lu entries %.3f ms %lu KB, compacted %lu"
+        " entries %.3f ms %lu KB.", size, full.Size(), fullUs / 1000.0,
+        fullBytes / 1024, compacted.Size(), compactedUs / 1000.0,
+        compactedBytes / 1024);
+  }
+  Notice("===================================");
+  return 0;
+}
@@ -0,0 +1,318 @@
+/***********************************************************************
+ *
+ * Copyright 2021 Florian Suri-Payer <fsp@cs.cornell.edu>
+ *                Matthew Burke <matthelb@cs.cornell.edu>
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ **********************************************************************/
+#include "lib/configuration.h"
+#include "lib/repltransport.h"
+#include "replication/ir/client.h"
+#include "replication/ir/ir-proto.pb.h"
+#include "replication/ir/record.h"
+#include "replication/ir/replica.h"
+
+#include <gtest/gtest.h>
+
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace replication {
+namespace ir {
+
+static RecordEntry
+Entry(uint64_t clientid, uint64_t clientreqid, proto::RecordEntryState state,
+      proto::RecordEntryType type, const std::string &result)
+{
+    Request request;
+    request.set_op("op");
+    request.set_clientid(clientid);
+    request.set_clientreqid(clientreqid);
+    return RecordEntry(0, std::make_pair(clientid, clientreqid), state, type,
+                       request, result);
+}
+
+TEST(Record, CompactOnlyFinalized)
+{
+    Record record;
+    record.Add(Entry(1, 1, proto::RECORD_STATE_FINALIZED,
+                     proto::RECORD_TYPE_CONSENSUS, "r"));
+    record.Add(Entry(1, 2, proto::RECORD_STATE_TENTATIVE,
+                     proto::RECORD_TYPE_CONSENSUS, "r"));
+
+    EXPECT_FALSE(record.Compact(std::make_pair(1, 2)));
+    EXPECT_FALSE(record.Compact(std::make_pair(1, 3)));
+    EXPECT_TRUE(record.Compact(std::make_pair(1, 1)));
+    EXPECT_EQ(record.Size(), 1u);
+    EXPECT_TRUE(record.Compacted(std::make_pair(1, 1)));
+    EXPECT_FALSE(record.Compacted(std::make_pair(1, 2)));
+    EXPECT_EQ(record.Watermark(1), 1u);
+}
+
+TEST(Record, WatermarkStopsAtGaps)
+{
+    Record record;
+    for (uint64_t id : {2, 3, 5}) {
+        record.Add(Entry(1, id, proto::RECORD_STATE_FINALIZED,
+                         proto::RECORD_TYPE_INCONSISTENT, ""));
+        EXPECT_TRUE(record.Compact(std::make_pair(1, id)));
+    }
+    // Request 1 is not compacted, so neither is anything counted below the
+    // highest compacted id.
+    EXPECT_EQ(record.Watermark(1), 0u);
+    EXPECT_FALSE(record.Compacted(std::make_pair(1, 1)));
+    EXPECT_TRUE(record.Compacted(std::make_pair(1, 2)));
+    EXPECT_TRUE(record.Compacted(std::make_pair(1, 3)));
+    EXPECT_FALSE(record.Compacted(std::make_pair(1, 4)));
+    EXPECT_TRUE(record.Compacted(std::make_pair(1, 5)));
+    EXPECT_FALSE(record.Compacted(std::make_pair(2, 2)));
+
+    record.Add(Entry(1, 1, proto::RECORD_STATE_FINALIZED,
+                     proto::RECORD_TYPE_INCONSISTENT, ""));
+    EXPECT_TRUE(record.Compact(std::make_pair(1, 1)));
+    EXPECT_EQ(record.Watermark(1), 3u);
+    EXPECT_FALSE(record.Compacted(std::make_pair(1, 4)));
+
+    // An entry that is back in the record is not compacted.
+    record.Add(Entry(1, 5, proto::RECORD_STATE_FINALIZED,
+                     proto::RECORD_TYPE_INCONSISTENT, ""));
+    EXPECT_FALSE(record.Compacted(std::make_pair(1, 5)));
+}
+
+TEST(Record, CompactedSurvivesProto)
+{
+    Record record;
+    for (uint64_t id : {1, 2, 4}) {
+        record.Add(Entry(1, id, proto::RECORD_STATE_FINALIZED,
+                         proto::RECORD_TYPE_INCONSISTENT, ""));
+        record.Compact(std::make_pair(1, id));
+    }
+    record.Add(Entry(1, 3, proto::RECORD_STATE_TENTATIVE,
+                     proto::RECORD_TYPE_CONSENSUS, ""));
+
+    proto::RecordProto recordProto;
+    record.ToProto(&recordProto);
+    Record copy(recordProto);
+    EXPECT_EQ(copy.Size(), 1u);
+    EXPECT_EQ(copy.Watermark(1), 2u);
+    EXPECT_FALSE(copy.Compacted(std::make_pair(1, 3)));
+    EXPECT_TRUE(copy.Compacted(std::make_pair(1, 4)));
+
+    // Merging fills the gap at 3 and moves the watermark over 4.
+    Record other;
+    other.RaiseWatermark(1, 3);
+    copy.Remove(std::make_pair(1, 3));
+    copy.MergeCompacted(other);
+    EXPECT_EQ(copy.Watermark(1), 4u);
+}
+
+// Decides every operation with the result of its first entry.
+class FirstResultApp : public IRAppReplica
+{
+public:
+    std::map<opid_t, std::string> Merge(
+        const std::map<opid_t, std::vector<RecordEntry>> &d,
+        const std::map<opid_t, std::vector<RecordEntry>> &u,
+        const std::map<opid_t, std::string> &majority_results_in_d) override {
+        std::map<opid_t, std::string> results;
+        for (const auto &p : d) {
+            results[p.first] = p.second[0].result;
+        }
+        for (const auto &p : u) {
+            results[p.first] = "merged";
+        }
+        return results;
+    }
+};
+
+class IrMergeRecordsTest : public ::testing::Test
+{
+protected:
+    IrMergeRecordsTest() {
+        std::stringstream configSS;
+        configSS << "f 1\n"
+                 << "replica localhost:51731\n"
+                 << "replica localhost:51732\n"
+                 << "replica localhost:51733\n";
+        config = new transport::Configuration(configSS);
+        replica = new IRReplica(*config, 0, 0, &transport, &app);
+    }
+
+    virtual ~IrMergeRecordsTest() {
+        delete replica;
+        delete config;
+    }
+
+    Record Merge(const std::map<int, proto::DoViewChangeMessage> &records) {
+        return replica->IrMergeRecords(records);
+    }
+
+    static proto::DoViewChangeMessage DoViewChange(int replicaIdx,
+                                                   const Record &record) {
+        proto::DoViewChangeMessage msg;
+        msg.set_replicaidx(replicaIdx);
+        msg.set_new_view(1);
+        msg.set_latest_normal_view(0);
+        record.ToProto(msg.mutable_record());
+        return msg;
+    }
+
+    ReplTransport transport;
+    FirstResultApp app;
+    transport::Configuration *config;
+    IRReplica *replica;
+};
+
+TEST_F(IrMergeRecordsTest, OnlyCompactedIdsCountAsFinalized)
+{
+    // Replica 1 compacted requests 1 and 3 of client 7, but not 2.
+    Record compacted;
+    for (uint64_t id : {1, 3}) {
+        compacted.Add(Entry(7, id, proto::RECORD_STATE_FINALIZED,
+                            proto::RECORD_TYPE_CONSENSUS, "ok"));
+        compacted.Compact(std::make_pair(7, id));
+    }
+    // Replica 2 still holds 2 and 3 tentatively.
+    Record tentative;
+    for (uint64_t id : {2, 3}) {
+        tentative.Add(Entry(7, id, proto::RECORD_STATE_TENTATIVE,
+                            proto::RECORD_TYPE_CONSENSUS, "ok"));
+    }
+
+    std::map<int, proto::DoViewChangeMessage> records;
+    records[1] = DoViewChange(1, compacted);
+    records[2] = DoViewChange(2, tentative);
+    Record R = Merge(records);
+
+    // 3 was applied at replica 1 and comes back finalized with its result.
+    const RecordEntry *three = R.Find(std::make_pair(7, 3));
+    ASSERT_NE(three, nullptr);
+    EXPECT_EQ(three->state, proto::RECORD_STATE_FINALIZED);
+    EXPECT_EQ(three->result, "ok");
+    // 2 was never compacted, so it still goes through Merge.
+    const RecordEntry *two = R.Find(std::make_pair(7, 2));
+    ASSERT_NE(two, nullptr);
+    EXPECT_EQ(two->state, proto::RECORD_STATE_FINALIZED);
+    EXPECT_EQ(two->result, "merged");
+    // Only the contiguous prefix is summarized by the watermark.
+    EXPECT_EQ(R.Watermark(7), 1u);
+    EXPECT_TRUE(R.Compacted(std::make_pair(7, 1)));
+    EXPECT_FALSE(R.Compacted(std::make_pair(7, 2)));
+}
+
+// Compacts every entry as soon as it is finalized.
+class CompactingApp : public IRAppReplica
+{
+public:
+    bool Compactable(const RecordEntry &entry) override { return true; }
+};
+
+// One client and three replicas, with every message delivered by hand.
+class IrCompactionTest : public ::testing::Test
+{
+protected:
+    static const uint64_t CLIENT_ID = 7;
+
+    IrCompactionTest() {
+        std::stringstream configSS;
+        configSS << "f 1\n"
+                 << "replica localhost:51741\n"
+                 << "replica localhost:51742\n"
+                 << "replica localhost:51743\n";
+        config = new transport::Configuration(configSS);
+        for (int i = 0; i < config->n; ++i) {
+            replicas.push_back(new IRReplica(*config, 0, i, &transport, &app,
+                                             1));
+        }
+        client = new IRClient(*config, &transport, 0, CLIENT_ID);
+    }
+
+    virtual ~IrCompactionTest() {
+        delete client;
+        for (IRReplica *replica : replicas) {
+            delete replica;
+        }
+        delete config;
+    }
+
+    static ReplTransportAddress Replica(int idx) {
+        return ReplTransportAddress("localhost", std::to_string(51741 + idx));
+    }
+
+    void Deliver(const ReplTransportAddress &addr, int begin, int end) {
+        for (int i = begin; i < end; ++i) {
+            ASSERT_TRUE(transport.DeliverMessage(addr, i));
+        }
+    }
+
+    const Record &RecordOf(int idx) { return replicas[idx]->record; }
+
+    ReplTransport transport;
+    CompactingApp app;
+    transport::Configuration *config;
+    std::vector<IRReplica *> replicas;
+    IRClient *client;
+};
+
+TEST_F(IrCompactionTest, UnloggedRequestsLeaveNoGaps)
+{
+    // Every write is preceded by a read, as TAPIR's Gets are.
+    const int n = 16;
+    int reads = 0;
+    int writes = 0;
+    for (int i = 0; i < n; ++i) {
+        client->InvokeUnlogged(0, "get",
+            [&reads](const std::string &, const std::string &) {
+                ++reads;
+                return true;
+            });
+        client->InvokeInconsistent("put",
+            [&writes](const std::string &, const std::string &) {
+                ++writes;
+                return true;
+            });
+    }
+
+    // Replica 0 got both the reads and the writes, the others the writes.
+    Deliver(Replica(0), 0, 2 * n);
+    Deliver(Replica(1), 0, n);
+    Deliver(Replica(2), 0, n);
+    // Two replies per write and per replica 0 read reach the client, which
+    // finalizes each write once it has a quorum.
+    Deliver(ReplTransportAddress("client", "0"), 0, 4 * n);
+    EXPECT_EQ(reads, n);
+    EXPECT_EQ(writes, n);
+    Deliver(Replica(0), 2 * n, 3 * n);
+
+    const Record &record = RecordOf(0);
+    EXPECT_EQ(record.Size(), 0u);
+    EXPECT_EQ(record.Watermark(CLIENT_ID), static_cast<uint64_t>(n));
+    proto::RecordProto recordProto;
+    record.ToProto(&recordProto);
+    EXPECT_EQ(recordProto.watermark_size(), 1);
+    EXPECT_EQ(recordProto.compacted_size(), 0);
+}
+
+} // namespace ir
+} // namespace replication
@@ -0,0 +1,32 @@
+#!/bin/bash
+# Compares round-trip latency and messages/sec of the TCP loopback and
+# shared-memory transports between two processes on this host.
+# Run from src/ after building store/benchmark/ping_{client,server}.
+
+MESSAGES=100000
+SIZE=512
+PORT=8123
+
+while getopts n:s:p: option; do
+case "${option}" in
+n) MESSAGES=${OPTARG};;
+s) SIZE=${OPTARG};;
+p) PORT=${OPTARG};;
+esac;
+done
+
+CONFIG=$(mktemp)
+printf "f 0\nreplica localhost:%s\n" "$PORT" > "$CONFIG"
+
+for TRANS in tcp shm; do
+  echo "== $TRANS =="
+  store/benchmark/ping_server --config_path "$CONFIG" --trans_protocol $TRANS > /dev/null 2>&1 &
+  SERVER=$!
+  sleep 1
+  store/benchmark/ping_client --config_path "$CONFIG" --trans_protocol $TRANS \
+    --num_messages $MESSAGES --message_size $SIZE 2>&1 | grep -E "Median|99th|Throughput"
+  kill $SERVER
+  wait $SERVER 2> /dev/null
+done
+
+rm -f "$CONFIG"
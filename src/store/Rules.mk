@@ -1,10 +1,12 @@
 d := $(dir $(lastword $(MAKEFILE_LIST)))
 
-SRCS += $(addprefix $(d), server.cc)
+SRCS += $(addprefix $(d), server.cc bulkloader.cc)
 
 $(d)server: $(LIB-tapir-store) $(LIB-strong-store) $(LIB-weak-store) \
-	$(LIB-udptransport) $(LIB-tcptransport) $(LIB-morty-store) $(o)server.o \
+	$(LIB-udptransport) $(LIB-tcptransport) $(LIB-iouringtransport) $(LIB-shmtransport) $(LIB-morty-store) $(o)server.o $(o)bulkloader.o \
 	$(LIB-janus-store) $(LIB-io-utils) $(LIB-store-common-stats) \
 	$(LIB-indicus-store) $(LIB-pbft-store) $(LIB-hotstuff-store) $(LIB-tpcc) $(LIB-store-backend)
 
+$(call add-LDFLAGS,$(d)server,$(LIBURING_LDFLAGS))
+
 BINS += $(d)server
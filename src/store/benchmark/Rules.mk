@@ -1,12 +1,15 @@
 d := $(dir $(lastword $(MAKEFILE_LIST)))
 
-SRCS += $(addprefix $(d), ping_server.cc ping_client.cc)
+SRCS += $(addprefix $(d), ping_server.cc ping_client.cc prepare_bench.cc)
 
 PROTOS += $(addprefix $(d), ping-proto.proto)
 
-$(d)ping_client: $(o)ping_client.o $(LIB-tcptransport) $(o)ping-proto.o $(LIB-latency)
+$(d)ping_client: $(o)ping_client.o $(LIB-tcptransport) $(LIB-shmtransport) $(o)ping-proto.o $(LIB-latency)
 
-$(d)ping_server: $(o)ping_server.o $(LIB-tcptransport) $(o)ping-proto.o $(LIB-latency)
+$(d)ping_server: $(o)ping_server.o $(LIB-tcptransport) $(LIB-shmtransport) $(o)ping-proto.o $(LIB-latency)
 
-BINS += $(d)ping_server $(d)ping_client 
+$(d)prepare_bench: $(o)prepare_bench.o $(LIB-latency) $(LIB-store-common) \
+	$(LIB-store-backend) $(LIB-tapir-backend) $(LIB-strong-backend)
+
+BINS += $(d)ping_server $(d)ping_client $(d)prepare_bench
 
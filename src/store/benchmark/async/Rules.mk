@@ -12,6 +12,8 @@ LIB-bench-client := $(o)benchmark.o $(o)bench_client.o \
 OBJS-all-bench-clients := $(LIB-retwis) $(LIB-tpcc) $(LIB-sync-tpcc) $(LIB-async-tpcc) \
 	$(LIB-smallbank) $(LIB-rw)  $(LIB-ycsb)
 
-$(d)benchmark: $(LIB-key-selector) $(LIB-bench-client) $(LIB-latency) $(LIB-tcptransport) $(LIB-udptransport) $(OBJS-all-store-clients) $(OBJS-all-bench-clients) $(LIB-bench-client) $(LIB-store-common)
+$(d)benchmark: $(LIB-key-selector) $(LIB-bench-client) $(LIB-latency) $(LIB-tcptransport) $(LIB-iouringtransport) $(LIB-shmtransport) $(LIB-udptransport) $(OBJS-all-store-clients) $(OBJS-all-bench-clients) $(LIB-bench-client) $(LIB-store-common)
+
+$(call add-LDFLAGS,$(d)benchmark,$(LIBURING_LDFLAGS))
 
 BINS +=  $(d)benchmark
@@ -171,10 +171,10 @@ void BenchmarkClient::OnReply(int result) {
   }
 }
 
-void BenchmarkClient::OnReplyBig(int result, int batchSize, bool includeRetryTx) {
+void BenchmarkClient::OnReplyBig(int result, int batchSize, uint64_t retriedTxs) {
   Debug("BenchmarkClient::OnReplyBig");
 
-  IncrementSentBig(result, batchSize, includeRetryTx);
+  IncrementSentBig(result, batchSize, retriedTxs);
 
   if (done) {
     return;
@@ -241,7 +241,7 @@ void BenchmarkClient::IncrementSent(int result) {
   n++;
 }
 
-void BenchmarkClient::IncrementSentBig(int result, int batchSize, bool includeRetryTx) {
+void BenchmarkClient::IncrementSentBig(int result, int batchSize, uint64_t retriedTxs) {
   if (started) {
     Debug("IncrementSentBig is called, cooldownStarted: %d, result: %d \n", cooldownStarted, result);
     // record latency
@@ -260,14 +260,10 @@ void BenchmarkClient::IncrementSentBig(int result, int batchSize, bool includeRe
         }
         uint64_t currNanos = curr.tv_sec * 1000000000ULL + curr.tv_nsec;
 
+        // transactions deferred from the previous batch also waited for it
         for (int i = 0; i < batchSize; i++){
-          if (i == 0){
-            if (includeRetryTx == true){
-              latencies.push_back(ns + previousTxLatency);
-            }
-            else {
-              latencies.push_back(ns);
-            }
+          if (static_cast<uint64_t>(i) < retriedTxs){
+            latencies.push_back(ns + previousTxLatency);
           }
           else {
             latencies.push_back(ns);
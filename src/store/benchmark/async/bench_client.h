@@ -47,13 +47,13 @@ class BenchmarkClient {
   void Start(bench_done_callback bdcb, bool batchOptimization);
   void OnReply(int result);
 
-  void OnReplyBig(int result, int batchSize, bool includeRetryTx);
+  void OnReplyBig(int result, int batchSize, uint64_t retriedTxs);
 
   void StartLatency();
   virtual void SendNext() = 0;
   virtual void SendNext_batch() = 0;
   void IncrementSent(int result);
-  void IncrementSentBig(int result, int batchSize, bool includeRetryTx);
+  void IncrementSentBig(int result, int batchSize, uint64_t retriedTxs);
   inline bool IsFullyDone() { return done; }
 
   struct Latency_t latency;
@@ -37,6 +37,8 @@
 #include "lib/latency.h"
 #include "lib/timeval.h"
 #include "lib/tcptransport.h"
+#include "lib/iouringtransport.h"
+#include "lib/shmtransport.h"
 #include "store/common/truetime.h"
 #include "store/common/stats.h"
 #include "store/common/partitioner.h"
@@ -104,6 +106,8 @@ enum transmode_t {
 	TRANS_UNKNOWN,
   TRANS_UDP,
   TRANS_TCP,
+  TRANS_IOURING,
+  TRANS_SHM,
 };
 
 enum read_quorum_t {
@@ -253,6 +257,10 @@ DEFINE_uint64(indicus_batch_verification_timeout, 5, "batch verification timeout
 
 DEFINE_bool(pbft_order_commit, false, "order commit writebacks as well");
 DEFINE_bool(pbft_validate_abort, false, "validate abort writebacks as well"); 
+DEFINE_uint64(pbft_client_batch, 1, "number of messages a PBFT shard client"
+    " coalesces into one batched send (1 disables client batching)");
+DEFINE_uint64(pbft_client_batch_timeout, 1, "ms a PBFT shard client waits to"
+    " fill a batch");
 
 DEFINE_bool(indicus_parallel_CCC, true, "sort read/write set for parallel CCC locking at server");
 
@@ -264,6 +272,15 @@ DEFINE_bool(indicus_all_to_all_fb, false, "use the all to all view change method
 DEFINE_uint64(indicus_relayP1_timeout, 1, "time (ms) after which to send RelayP1");
 //DEFINE_bool(indicus_batch_optimization, true, "if true batch optimization, false no batch optimization");
 DEFINE_uint64(indicus_batch_size, 2, "number of transaction in batch");
+DEFINE_bool(indicus_adjust_batch_size, false, "adapt the number of transactions"
+    " in a batch to the commit latency, starting from indicus_batch_size and"
+    " within indicus_batch_size_{min,max}");
+DEFINE_uint64(indicus_batch_size_min, 1, "smallest batch with"
+    " indicus_adjust_batch_size");
+DEFINE_uint64(indicus_batch_size_max, 32, "largest batch with"
+    " indicus_adjust_batch_size");
+DEFINE_uint64(indicus_batch_adjust_interval_ms, 100, "interval between two"
+    " batch size adjustments with indicus_adjust_batch_size");
 //DEFINE_uint64(indicus_num_ops, FLAGS_num_ops, "number of operations in transaction");
 
 const std::string if_args[] = {
@@ -299,12 +316,16 @@ DEFINE_bool(debug_stats, false, "record stats related to debugging");
 
 const std::string trans_args[] = {
   "udp",
-	"tcp"
+	"tcp",
+	"iouring",
+	"shm"
 };
 
 const transmode_t transmodes[] {
   TRANS_UDP,
-	TRANS_TCP
+	TRANS_TCP,
+	TRANS_IOURING,
+	TRANS_SHM
 };
 static bool ValidateTransMode(const char* flagname,
     const std::string &value) {
@@ -429,6 +450,8 @@ DEFINE_uint64(delay, 0, "simulated communication delay");
 DEFINE_int32(clock_skew, 0, "difference between real clock and TrueTime");
 DEFINE_int32(clock_error, 0, "maximum error for clock");
 DEFINE_string(stats_file, "", "path to output stats file.");
+DEFINE_uint64(stats_dump_interval_ms, 0, "log latency histogram percentiles"
+    " for each interval of this length (0 disables)");
 DEFINE_uint64(abort_backoff, 100, "sleep exponentially increasing amount after abort.");
 DEFINE_bool(retry_aborted, true, "retry aborted transactions.");
 DEFINE_int64(max_attempts, -1, "max number of attempts per transaction (or -1"
@@ -570,6 +593,7 @@ Partitioner *part;
 
 void Cleanup(int signal);
 void FlushStats();
+void DumpStats();
 
 int main(int argc, char **argv) {
 
@@ -744,6 +768,12 @@ int main(int argc, char **argv) {
       // TCPTransportクラスのオブジェクトが作成されるタイミングでthreadpool::startが呼び出される
       tport = new TCPTransport(0.0, 0.0, 0, false, 0, 1, FLAGS_indicus_hyper_threading, false);
       break;
+    case TRANS_IOURING:
+      tport = new IOUringTransport(0.0, 0.0, 0, false, 0, 1, FLAGS_indicus_hyper_threading, false);
+      break;
+    case TRANS_SHM:
+      tport = new ShmTransport(false, 0, 1, FLAGS_indicus_hyper_threading, false);
+      break;
     case TRANS_UDP:
       tport = new UDPTransport(0.0, 0.0, 0, nullptr);
       break;
@@ -855,6 +885,15 @@ int main(int argc, char **argv) {
     return 1;
   }
 
+  const BatchControllerConfig batchControl(FLAGS_indicus_batch_size_min,
+      FLAGS_indicus_batch_size_max, 0, 0,
+      FLAGS_indicus_batch_adjust_interval_ms * 1000);
+  // With indicus_adjust_batch_size a batch can grow past
+  // indicus_batch_size, so the generators have to cover the largest one.
+  const uint64_t genBatchSize = AsyncAdapterClient::GeneratorBatchSize(
+      FLAGS_indicus_batch_size, FLAGS_indicus_adjust_batch_size,
+      batchControl);
+
   for (size_t i = 0; i < FLAGS_num_clients; i++) {
     Client *client = nullptr;
     AsyncClient *asyncClient = nullptr;
@@ -987,7 +1026,8 @@ int main(int argc, char **argv) {
                                        FLAGS_indicus_sign_messages, FLAGS_indicus_validate_proofs,
                                        keyManager,
 																			 FLAGS_pbft_order_commit, FLAGS_pbft_validate_abort,
-																			 TrueTime(FLAGS_clock_skew, FLAGS_clock_error));
+																			 TrueTime(FLAGS_clock_skew, FLAGS_clock_error),
+																			 FLAGS_pbft_client_batch, FLAGS_pbft_client_batch_timeout);
         break;
     }
 
@@ -1028,7 +1068,8 @@ int main(int argc, char **argv) {
       case BENCH_YCSB:
         if (asyncClient == nullptr) {
           UW_ASSERT(client != nullptr);
-          asyncClient = new AsyncAdapterClient(client, FLAGS_message_timeout);
+          asyncClient = new AsyncAdapterClient(client, FLAGS_message_timeout,
+              FLAGS_indicus_adjust_batch_size, batchControl);
         }
         break;
       case BENCH_SMALLBANK_SYNC:
@@ -1099,7 +1140,7 @@ int main(int argc, char **argv) {
             FLAGS_num_requests, FLAGS_exp_duration, FLAGS_delay,
             FLAGS_warmup_secs, FLAGS_cooldown_secs, FLAGS_tput_interval,
             FLAGS_abort_backoff, FLAGS_retry_aborted, FLAGS_max_backoff,
-            FLAGS_max_attempts, FLAGS_batch_optimization, FLAGS_indicus_batch_size);
+            FLAGS_max_attempts, FLAGS_batch_optimization, genBatchSize);
         break;
       case BENCH_YCSB:
         UW_ASSERT(asyncClient != nullptr);
@@ -1108,7 +1149,8 @@ int main(int argc, char **argv) {
             FLAGS_num_requests, FLAGS_exp_duration, FLAGS_delay,
             FLAGS_warmup_secs, FLAGS_cooldown_secs, FLAGS_tput_interval,
             FLAGS_abort_backoff, FLAGS_retry_aborted, FLAGS_max_backoff,
-            FLAGS_max_attempts, FLAGS_batch_optimization, FLAGS_indicus_batch_size, FLAGS_read_ratio);
+            FLAGS_max_attempts, FLAGS_batch_optimization, genBatchSize,
+            FLAGS_read_ratio);
         break;
       default:
         NOT_REACHABLE();
@@ -1166,6 +1208,9 @@ int main(int argc, char **argv) {
   }
 
   tport->Timer(FLAGS_exp_duration * 1000 - 1000, FlushStats);
+  if (FLAGS_stats_dump_interval_ms > 0) {
+    tport->Timer(FLAGS_stats_dump_interval_ms, DumpStats);
+  }
 
   std::signal(SIGKILL, Cleanup);
   std::signal(SIGTERM, Cleanup);
@@ -1244,6 +1289,14 @@ void Cleanup(int signal) {
   delete part;
 }
 
+void DumpStats() {
+  for (unsigned int i = 0; i < clients.size(); i++) {
+    Notice("Client %u latency histograms:", i);
+    clients[i]->GetStats().DumpHistograms();
+  }
+  tport->Timer(FLAGS_stats_dump_interval_ms, DumpStats);
+}
+
 void FlushStats() {
   /*
   if (FLAGS_stats_file.size() > 0) {
@@ -31,6 +31,7 @@
 #include "lib/configuration.h"
 #include "lib/latency.h"
 #include "lib/tcptransport.h"
+#include "lib/shmtransport.h"
 #include "store/benchmark/ping-proto.pb.h"
 
 class PingClient : public TransportReceiver {
@@ -43,12 +44,14 @@ class PingClient : public TransportReceiver {
       messageSizeVariance(messageSizeVariance),
       dist(messageSize / (1 - static_cast<double>(messageSizeVariance) / messageSize),
           1 - static_cast<double>(messageSizeVariance) / messageSize),
-      gen(0), receivedMessages(0UL) {
+      gen(0), receivedMessages(0UL), start(0UL), end(0UL) {
     transport->Register(this, config, -1, -1);
     _Latency_Init(&rtt, "rtt");
   }
 
-  virtual ~PingClient() {
+  virtual ~PingClient() { }
+
+  void Report() {
     char buf[1024];
     Notice("Finished cooldown period.");
 
@@ -89,6 +92,10 @@ class PingClient : public TransportReceiver {
     LatencyFmtNS(ns, buf);
     Notice("99th percentile latency is %ld ns (%s)", ns, buf);
 
+    uint64_t elapsed = end - start;
+    Notice("Throughput is %.1f messages/sec",
+        latencies.size() * 1e9 / std::max<uint64_t>(elapsed, 1));
+
     Latency_Dump(&rtt);
   }
 
@@ -103,6 +110,7 @@ class PingClient : public TransportReceiver {
   }
 
   void Start() {
+    start = Now();
     GenerateMessageData(pm.mutable_data());
     Latency_Start(&rtt);
     transport->SendMessageToReplica(this, 0, pm);
@@ -119,6 +127,8 @@ class PingClient : public TransportReceiver {
       Latency_Start(&rtt);
       transport->SendMessageToReplica(this, 0, pm);    
     } else {
+      end = Now();
+      Report();
       transport->Stop();
     }
   }
@@ -141,6 +151,12 @@ class PingClient : public TransportReceiver {
   }
 
  private:
+  static uint64_t Now() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000UL + ts.tv_nsec;
+  }
+
   const transport::Configuration &config;
   Transport *transport;
   const uint64_t numMessages;
@@ -153,6 +169,8 @@ class PingClient : public TransportReceiver {
   PingMessage pm;
   Latency_t rtt;
   std::vector<uint64_t> latencies;
+  uint64_t start;
+  uint64_t end;
 };
 
 DEFINE_string(config_path, "", "path to shard configuration file");
@@ -160,6 +178,8 @@ DEFINE_uint64(num_messages, 100, "number of messages to send and receive.");
 DEFINE_uint64(message_size, 1024, "number of bytes in each message.");
 DEFINE_string(latency_path, "", "path to latency output file");
 DEFINE_uint64(message_size_variance, 0, "variance of message size in bytes");
+DEFINE_string(trans_protocol, "tcp", "transport to ping over: tcp (loopback)"
+    " or shm (shared memory, server on the same host)");
 
 int main(int argc, char **argv) {
   gflags::SetUsageMessage("pings a simple ping server to measure rtt times.");
@@ -172,13 +192,22 @@ int main(int argc, char **argv) {
   }
 
   transport::Configuration config(configStream);
-  TCPTransport transport(0.0, 0.0, 0, false);
-  PingClient *client = new PingClient(config, &transport, FLAGS_num_messages,
+  Transport *transport;
+  if (FLAGS_trans_protocol == "shm") {
+    transport = new ShmTransport(false);
+  } else if (FLAGS_trans_protocol == "tcp") {
+    transport = new TCPTransport(0.0, 0.0, 0, false);
+  } else {
+    std::cerr << "Unknown transport protocol." << std::endl;
+    return 1;
+  }
+  PingClient *client = new PingClient(config, transport, FLAGS_num_messages,
       FLAGS_message_size, FLAGS_latency_path, FLAGS_message_size_variance);
-  transport.Timer(0, [client]() { client->Start(); });
+  transport->Timer(0, [client]() { client->Start(); });
 
-  transport.Run();
+  transport->Run();
   delete client;
+  delete transport;
   return 0;
 }
 
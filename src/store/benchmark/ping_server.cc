@@ -30,6 +30,7 @@
 
 #include "lib/configuration.h"
 #include "lib/tcptransport.h"
+#include "lib/shmtransport.h"
 #include "store/benchmark/ping-proto.pb.h"
 
 class PingServer : public TransportReceiver {
@@ -65,6 +66,8 @@ class PingServer : public TransportReceiver {
 };
 
 DEFINE_string(config_path, "", "path to shard configuration file");
+DEFINE_string(trans_protocol, "tcp", "transport to serve pings over: tcp or"
+    " shm (shared memory)");
 
 void Cleanup(int signal);
 
@@ -83,14 +86,22 @@ int main(int argc, char **argv) {
 
   transport::Configuration config(configStream);
 
-  TCPTransport transport(0.0, 0.0, 0);
+  Transport *transport;
+  if (FLAGS_trans_protocol == "shm") {
+    transport = new ShmTransport();
+  } else if (FLAGS_trans_protocol == "tcp") {
+    transport = new TCPTransport(0.0, 0.0, 0);
+  } else {
+    std::cerr << "Unknown transport protocol." << std::endl;
+    return 1;
+  }
 
-  server = new PingServer(config, &transport);
+  server = new PingServer(config, transport);
 
   std::signal(SIGKILL, Cleanup);
   std::signal(SIGTERM, Cleanup);
   std::signal(SIGINT, Cleanup);
-  transport.Run();
+  transport->Run();
   return 0;
 }
 
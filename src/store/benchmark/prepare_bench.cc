@@ -0,0 +1,143 @@
+/***********************************************************************
+ *
+ * Copyright 2021 Florian Suri-Payer <fsp@cs.cornell.edu>
+ *                Matthew Burke <matthelb@cs.cornell.edu>
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ **********************************************************************/
+#include "lib/latency.h"
+#include "lib/message.h"
+#include "store/common/timestamp.h"
+#include "store/common/transaction.h"
+#include "store/strongstore/occstore.h"
+#include "store/tapirstore/store.h"
+
+#include <gflags/gflags.h>
+
+#include <random>
+#include <sstream>
+
+DEFINE_string(prepared_txns, "16,256,1024,4096", "comma-separated list of concurrently prepared transactions.");
+DEFINE_uint64(read_set_size, 4, "number of reads per transaction.");
+DEFINE_uint64(write_set_size, 4, "number of writes per transaction.");
+DEFINE_uint64(num_keys, 100000, "number of distinct keys in the store.");
+DEFINE_uint64(num_prepares, 100000, "number of Prepares measured per configuration.");
+
+namespace {
+
+std::string Key(uint64_t k) {
+  return "key" + std::to_string(k);
+}
+
+// Background transactions touch disjoint keys so they can all stay prepared;
+// probes pick their keys uniformly and may conflict with them.
+Transaction MakeTxn(uint64_t firstKey, std::mt19937_64 *rng) {
+  Transaction txn;
+  std::uniform_int_distribution<uint64_t> keyDist(0, FLAGS_num_keys - 1);
+  for (uint64_t i = 0; i < FLAGS_read_set_size + FLAGS_write_set_size; ++i) {
+    uint64_t k = rng == nullptr ? firstKey + i : keyDist(*rng);
+    if (i < FLAGS_read_set_size) {
+      txn.addReadSet(Key(k), Timestamp(1));
+    } else {
+      txn.addWriteSet(Key(k), "value");
+    }
+  }
+  return txn;
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+  gflags::SetUsageMessage("benchmark TAPIR and OCC Prepare against many"
+      " prepared transactions.");
+  gflags::ParseCommandLineFlags(&argc, &argv, true);
+
+  std::vector<uint64_t> preparedTxns;
+  std::stringstream ss(FLAGS_prepared_txns);
+  std::string tok;
+  while (std::getline(ss, tok, ',')) {
+    preparedTxns.push_back(std::stoull(tok));
+  }
+  uint64_t txnKeys = FLAGS_read_set_size + FLAGS_write_set_size;
+
+  Notice("===================================");
+  Notice("Running Prepare bench: %lu keys, %lu reads and %lu writes per txn.",
+      FLAGS_num_keys, FLAGS_read_set_size, FLAGS_write_set_size);
+
+  for (uint64_t numPrepared : preparedTxns) {
+    if (numPrepared * txnKeys > FLAGS_num_keys) {
+      Warning("Skipping %lu prepared txns: needs more than %lu keys.",
+          numPrepared, FLAGS_num_keys);
+      continue;
+    }
+    std::mt19937_64 rng(0);
+
+    tapirstore::Store tapir(false);
+    strongstore::OCCStore occ;
+    for (uint64_t k = 0; k < FLAGS_num_keys; ++k) {
+      tapir.Load(Key(k), "value", Timestamp(1));
+      occ.Load(Key(k), "value", Timestamp(1));
+    }
+
+    uint64_t id = 0;
+    for (; id < numPrepared; ++id) {
+      Transaction txn = MakeTxn(id * txnKeys, nullptr);
+      Timestamp proposed;
+      UW_ASSERT(tapir.Prepare(id, txn, Timestamp(id + 2, id), proposed) ==
+          REPLY_OK);
+      UW_ASSERT(occ.Prepare(id, txn) == REPLY_OK);
+    }
+
+    struct Latency_t tapirLat;
+    struct Latency_t occLat;
+    _Latency_Init(&tapirLat, "tapir_prepare");
+    _Latency_Init(&occLat, "occ_prepare");
+    uint64_t tapirNs = 0;
+    uint64_t occNs = 0;
+    uint64_t tapirOk = 0;
+    uint64_t occOk = 0;
+
+    for (uint64_t p = 0; p < FLAGS_num_prepares; ++p, ++id) {
+      Transaction txn = MakeTxn(0, &rng);
+      Timestamp proposed;
+
+      Latency_Start(&tapirLat);
+      int status = tapir.Prepare(id, txn, Timestamp(id + 2, id), proposed);
+      tapirNs += Latency_End(&tapirLat);
+      tapirOk += status == REPLY_OK;
+      tapir.Abort(id);
+
+      Latency_Start(&occLat);
+      status = occ.Prepare(id, txn);
+      occNs += Latency_End(&occLat);
+      occOk += status == REPLY_OK;
+      occ.Abort(id);
+    }
+
+    Notice("%lu prepared: tapir %.0f ns/Prepare (%lu ok), occ %.0f ns/Prepare"
+        " (%lu ok).", numPrepared,
+        static_cast<double>(tapirNs) / FLAGS_num_prepares, tapirOk,
+        static_cast<double>(occNs) / FLAGS_num_prepares, occOk);
+  }
+  Notice("===================================");
+  return 0;
+}
@@ -0,0 +1,168 @@
+/***********************************************************************
+ *
+ * Copyright 2021 Florian Suri-Payer <fsp@cs.cornell.edu>
+ *                Matthew Burke <matthelb@cs.cornell.edu>
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ **********************************************************************/
+#include "store/bulkloader.h"
+
+#include "lib/message.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstring>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace {
+
+// Records handed to Server::LoadBatch at once.
+const size_t LOAD_BATCH_SIZE = 4096;
+
+typedef std::vector<std::pair<std::string, std::string>> KVBatch;
+
+// Reads one length-prefixed field starting at *pos. Returns false if the
+// field runs past end.
+inline bool NextField(const char *&pos, const char *end, const char *&data,
+    uint32_t &len) {
+  if (static_cast<size_t>(end - pos) < sizeof(uint32_t)) {
+    return false;
+  }
+  std::memcpy(&len, pos, sizeof(uint32_t));
+  pos += sizeof(uint32_t);
+  if (static_cast<size_t>(end - pos) < len) {
+    return false;
+  }
+  data = pos;
+  pos += len;
+  return true;
+}
+
+} // namespace
+
+bool BulkLoadDataFile(const std::string &path, Server *server,
+    Partitioner *part, uint64_t numShards, int groupIdx, uint64_t numGroups,
+    size_t numThreads, BulkLoadResult &result) {
+  result.loaded = 0;
+  result.stored = 0;
+
+  int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    return false;
+  }
+  struct stat st;
+  if (fstat(fd, &st) < 0) {
+    close(fd);
+    return false;
+  }
+  size_t size = st.st_size;
+  if (size == 0) {
+    close(fd);
+    return true;
+  }
+  void *addr = mmap(nullptr, size, PROT_READ, MAP_PRIVATE | MAP_POPULATE, fd, 0);
+  close(fd);
+  if (addr == MAP_FAILED) {
+    return false;
+  }
+  madvise(addr, size, MADV_SEQUENTIAL);
+  const char *begin = static_cast<const char *>(addr);
+  const char *end = begin + size;
+
+  // Record boundaries are only known by walking the length prefixes.
+  std::vector<const char *> records;
+  const char *pos = begin;
+  while (pos < end) {
+    const char *record = pos;
+    const char *data;
+    uint32_t len;
+    if (!NextField(pos, end, data, len) || !NextField(pos, end, data, len)) {
+      Warning("Ignoring truncated record at offset %lu of %s.",
+          static_cast<size_t>(record - begin), path.c_str());
+      break;
+    }
+    records.push_back(record);
+  }
+  result.loaded = records.size();
+
+  numThreads = std::max<size_t>(1, std::min(numThreads, records.size()));
+  std::vector<std::vector<KVBatch>> owned(numThreads);
+  std::vector<size_t> ownedCounts(numThreads, 0);
+  std::vector<std::thread> threads;
+  for (size_t t = 0; t < numThreads; ++t) {
+    threads.emplace_back([&, t]() {
+      size_t first = records.size() * t / numThreads;
+      size_t last = records.size() * (t + 1) / numThreads;
+      std::vector<int> txnGroups;
+      std::vector<KVBatch> &batches = owned[t];
+      for (size_t i = first; i < last; ++i) {
+        const char *pos = records[i];
+        const char *keyData;
+        const char *valData;
+        uint32_t keyLen;
+        uint32_t valLen;
+        NextField(pos, end, keyData, keyLen);
+        NextField(pos, end, valData, valLen);
+        std::string key(keyData, keyLen);
+        if ((*part)(key, numShards, groupIdx, txnGroups) % numGroups !=
+            static_cast<uint64_t>(groupIdx)) {
+          continue;
+        }
+        if (batches.empty() || batches.back().size() == LOAD_BATCH_SIZE) {
+          batches.emplace_back();
+          batches.back().reserve(LOAD_BATCH_SIZE);
+        }
+        batches.back().emplace_back(std::move(key), std::string(valData, valLen));
+        ++ownedCounts[t];
+      }
+    });
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  threads.clear();
+  munmap(addr, size);
+
+  for (size_t count : ownedCounts) {
+    result.stored += count;
+  }
+  server->ReserveLoad(result.stored);
+
+  for (size_t t = 0; t < numThreads; ++t) {
+    threads.emplace_back([&, t]() {
+      for (auto &batch : owned[t]) {
+        server->LoadBatch(batch, Timestamp());
+        KVBatch().swap(batch);
+      }
+    });
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  return true;
+}
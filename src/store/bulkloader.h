@@ -0,0 +1,50 @@
+/***********************************************************************
+ *
+ * Copyright 2021 Florian Suri-Payer <fsp@cs.cornell.edu>
+ *                Matthew Burke <matthelb@cs.cornell.edu>
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ **********************************************************************/
+#ifndef STORE_BULKLOADER_H
+#define STORE_BULKLOADER_H
+
+#include "store/common/partitioner.h"
+#include "store/server.h"
+
+#include <string>
+
+struct BulkLoadResult {
+  size_t loaded;  // records in the file
+  size_t stored;  // records owned by this group and handed to the server
+};
+
+// Loads a file of length-prefixed key/value records, as written by
+// WriteBytesToStream, into server. The file is memory-mapped and its record
+// boundaries found in one pass; numThreads threads then decode their share of
+// the records, keep the keys part assigns to groupIdx, and insert them through
+// Server::LoadBatch. part must be safe to call concurrently. Returns false if
+// the file cannot be read.
+bool BulkLoadDataFile(const std::string &path, Server *server,
+    Partitioner *part, uint64_t numShards, int groupIdx, uint64_t numGroups,
+    size_t numThreads, BulkLoadResult &result);
+
+#endif /* STORE_BULKLOADER_H */
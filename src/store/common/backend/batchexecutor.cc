@@ -0,0 +1,149 @@
+/***********************************************************************
+ *
+ * Copyright 2021 Florian Suri-Payer <fsp@cs.cornell.edu>
+ *                Matthew Burke <matthelb@cs.cornell.edu>
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ **********************************************************************/
+#include "store/common/backend/batchexecutor.h"
+
+#include <algorithm>
+#include <unordered_map>
+
+BatchExecutor::BatchExecutor(size_t numThreads) : generation(0),
+    stopping(false) {
+  for (size_t i = 1; i < numThreads; ++i) {
+    workers.emplace_back(&BatchExecutor::RunWorker, this);
+  }
+}
+
+BatchExecutor::~BatchExecutor() {
+  {
+    std::lock_guard<std::mutex> lock(mtx);
+    stopping = true;
+  }
+  workCv.notify_all();
+  for (auto &worker : workers) {
+    worker.join();
+  }
+}
+
+void BatchExecutor::Schedule(const std::vector<BatchOp> &ops,
+    std::vector<std::vector<size_t>> &waves) {
+  waves.clear();
+  // wave after the last one that touched the key
+  std::unordered_map<std::string, size_t> nextWave;
+  // wave after the last barrier
+  size_t floor = 0;
+  for (size_t i = 0; i < ops.size(); ++i) {
+    size_t w = floor;
+    if (ops[i].barrier) {
+      w = std::max(w, waves.size());
+      floor = w + 1;
+    } else {
+      for (const auto &key : ops[i].keys) {
+        auto itr = nextWave.find(key);
+        if (itr != nextWave.end()) {
+          w = std::max(w, itr->second);
+        }
+      }
+      for (const auto &key : ops[i].keys) {
+        nextWave[key] = w + 1;
+      }
+    }
+    if (w >= waves.size()) {
+      waves.resize(w + 1);
+    }
+    waves[w].push_back(i);
+  }
+}
+
+void BatchExecutor::Execute(const std::vector<BatchOp> &ops,
+    const std::function<void(size_t)> &check,
+    const std::function<void(size_t)> &apply) {
+  std::vector<std::vector<size_t>> waves;
+  Schedule(ops, waves);
+  for (const auto &wave : waves) {
+    RunParallel(wave, check);
+    for (size_t i : wave) {
+      apply(i);
+    }
+  }
+}
+
+void BatchExecutor::RunParallel(const std::vector<size_t> &ops,
+    const std::function<void(size_t)> &fn) {
+  if (workers.empty() || ops.size() < 2) {
+    for (size_t i : ops) {
+      fn(i);
+    }
+    return;
+  }
+
+  auto wave = std::make_shared<Wave>();
+  wave->ops = &ops;
+  wave->fn = &fn;
+  wave->count = ops.size();
+  wave->next = 0;
+  wave->remaining = ops.size();
+  {
+    std::lock_guard<std::mutex> lock(mtx);
+    current = wave;
+    generation++;
+  }
+  workCv.notify_all();
+
+  Work(*wave);
+
+  std::unique_lock<std::mutex> lock(mtx);
+  doneCv.wait(lock, [&wave]() { return wave->remaining == 0; });
+  current.reset();
+}
+
+void BatchExecutor::Work(Wave &wave) {
+  for (size_t k = wave.next++; k < wave.count; k = wave.next++) {
+    (*wave.fn)((*wave.ops)[k]);
+    if (--wave.remaining == 0) {
+      std::lock_guard<std::mutex> lock(mtx);
+      doneCv.notify_one();
+    }
+  }
+}
+
+void BatchExecutor::RunWorker() {
+  uint64_t seen = 0;
+  while (true) {
+    std::shared_ptr<Wave> wave;
+    {
+      std::unique_lock<std::mutex> lock(mtx);
+      workCv.wait(lock, [this, seen]() {
+        return stopping || (generation != seen && current != nullptr);
+      });
+      if (stopping) {
+        return;
+      }
+      seen = generation;
+      wave = current;
+    }
+    Work(*wave);
+  }
+}
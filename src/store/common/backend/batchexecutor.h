@@ -0,0 +1,99 @@
+/***********************************************************************
+ *
+ * Copyright 2021 Florian Suri-Payer <fsp@cs.cornell.edu>
+ *                Matthew Burke <matthelb@cs.cornell.edu>
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ **********************************************************************/
+#ifndef _BATCH_EXECUTOR_H_
+#define _BATCH_EXECUTOR_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// One operation of an ordered batch, described by the keys it touches.
+struct BatchOp {
+  std::vector<std::string> keys;
+  // runs on its own, after every earlier and before every later operation
+  bool barrier = false;
+};
+
+// Deterministic parallel execution of an ordered batch.
+//
+// The batch is split into waves: an operation lands in the first wave after
+// every earlier operation it shares a key with, so the operations of a wave
+// touch disjoint keys. For each wave the executor runs check(i) for all of
+// its operations on the worker threads, then apply(i) for them one by one in
+// batch order. As long as check only reads state of its operation's keys and
+// apply only writes it, every replica ends up with the results of executing
+// the batch serially, whatever the number of threads.
+class BatchExecutor {
+ public:
+  // numThreads counts the calling thread; with 1 everything runs inline.
+  explicit BatchExecutor(size_t numThreads);
+  ~BatchExecutor();
+
+  // Fills waves with the indexes of ops, in batch order within each wave.
+  static void Schedule(const std::vector<BatchOp> &ops,
+      std::vector<std::vector<size_t>> &waves);
+
+  void Execute(const std::vector<BatchOp> &ops,
+      const std::function<void(size_t)> &check,
+      const std::function<void(size_t)> &apply);
+
+  inline size_t NumThreads() const { return workers.size() + 1; }
+
+ private:
+  // One wave handed to the workers. Workers that wake up late may still
+  // hold a finished wave, so each wave gets its own counters. ops and fn
+  // are gone by then; a worker may only follow them after claiming an
+  // index below count.
+  struct Wave {
+    const std::vector<size_t> *ops;
+    const std::function<void(size_t)> *fn;
+    size_t count;
+    std::atomic<size_t> next;
+    std::atomic<size_t> remaining;
+  };
+
+  void RunParallel(const std::vector<size_t> &ops,
+      const std::function<void(size_t)> &fn);
+  void Work(Wave &wave);
+  void RunWorker();
+
+  std::vector<std::thread> workers;
+  std::mutex mtx;
+  std::condition_variable workCv;
+  std::condition_variable doneCv;
+  std::shared_ptr<Wave> current;
+  uint64_t generation;
+  bool stopping;
+};
+
+#endif /* _BATCH_EXECUTOR_H_ */
@@ -0,0 +1,371 @@
+/***********************************************************************
+ *
+ * Copyright 2021 Florian Suri-Payer <fsp@cs.cornell.edu>
+ *                Matthew Burke <matthelb@cs.cornell.edu>
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ **********************************************************************/
+#include "store/common/backend/snapshot.h"
+
+#include "lib/message.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <thread>
+#include <unordered_map>
+
+namespace {
+
+const char SNAPSHOT_MAGIC[8] = {'B', 'F', 'T', 'S', 'N', 'A', 'P', '\0'};
+// Chunks are cut once they reach this size.
+const size_t SNAPSHOT_CHUNK_BYTES = 4 << 20;
+
+struct SnapshotHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t reserved;
+  uint64_t formatTag;
+  uint64_t tableOffset;
+  uint64_t numChunks;
+  uint64_t tableChecksum;
+};
+
+inline uint64_t Rotl(uint64_t x, int r) {
+  return (x << r) | (x >> (64 - r));
+}
+
+// Runs fn(i) for i in [0, n) on up to numThreads threads.
+void ParallelFor(size_t n, size_t numThreads,
+    const std::function<void(size_t)> &fn) {
+  numThreads = std::max<size_t>(1, std::min(numThreads, n));
+  std::atomic<size_t> next(0);
+  auto work = [&]() {
+    for (size_t i = next++; i < n; i = next++) {
+      fn(i);
+    }
+  };
+  std::vector<std::thread> threads;
+  for (size_t t = 1; t < numThreads; ++t) {
+    threads.emplace_back(work);
+  }
+  work();
+  for (auto &thread : threads) {
+    thread.join();
+  }
+}
+
+} // namespace
+
+uint64_t SnapshotChecksum(const char *data, size_t len) {
+  const uint64_t k1 = 0x9E3779B97F4A7C15ULL;
+  const uint64_t k2 = 0xBF58476D1CE4E5B9ULL;
+  uint64_t h = len * k1;
+  size_t i = 0;
+  for (; i + sizeof(uint64_t) <= len; i += sizeof(uint64_t)) {
+    uint64_t w;
+    std::memcpy(&w, data + i, sizeof(uint64_t));
+    h = Rotl(h ^ (w * k1), 31) * k2;
+  }
+  uint64_t tail = 0;
+  for (size_t j = 0; i < len; ++i, ++j) {
+    tail |= static_cast<uint64_t>(static_cast<unsigned char>(data[i])) << (8 * j);
+  }
+  h = Rotl(h ^ (tail * k1), 31) * k2;
+  h ^= h >> 30;
+  h *= k2;
+  h ^= h >> 27;
+  h *= 0x94D049BB133111EBULL;
+  return h ^ (h >> 31);
+}
+
+SnapshotWriter::SnapshotWriter(const std::string &path, uint64_t formatTag) :
+    path(path), tmpPath(path + ".tmp"), formatTag(formatTag), failed(false),
+    offset(sizeof(SnapshotHeader)), section(0), bufRecords(0) {
+  fd = open(tmpPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0) {
+    Warning("Could not create snapshot file %s.", tmpPath.c_str());
+    failed = true;
+    return;
+  }
+  // The header is rewritten by Finish once the chunk table is known.
+  SnapshotHeader header;
+  std::memset(&header, 0, sizeof(header));
+  Write(&header, sizeof(header));
+  buf.reserve(SNAPSHOT_CHUNK_BYTES + (64 << 10));
+}
+
+SnapshotWriter::~SnapshotWriter() {
+  if (fd >= 0) {
+    close(fd);
+    unlink(tmpPath.c_str());
+  }
+}
+
+void SnapshotWriter::Write(const void *data, size_t len) {
+  const char *p = static_cast<const char *>(data);
+  while (!failed && len > 0) {
+    ssize_t n = write(fd, p, len);
+    if (n < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      Warning("Failed writing snapshot file %s: %s.", tmpPath.c_str(),
+          strerror(errno));
+      failed = true;
+      return;
+    }
+    p += n;
+    len -= n;
+  }
+}
+
+void SnapshotWriter::BeginSection(uint32_t section) {
+  FlushChunk();
+  this->section = section;
+}
+
+void SnapshotWriter::PutU32(uint32_t v) {
+  buf.append(reinterpret_cast<const char *>(&v), sizeof(v));
+}
+
+void SnapshotWriter::PutU64(uint64_t v) {
+  buf.append(reinterpret_cast<const char *>(&v), sizeof(v));
+}
+
+void SnapshotWriter::PutBytes(const char *data, size_t len) {
+  PutU32(static_cast<uint32_t>(len));
+  buf.append(data, len);
+}
+
+void SnapshotWriter::EndRecord() {
+  ++bufRecords;
+  if (buf.size() >= SNAPSHOT_CHUNK_BYTES) {
+    FlushChunk();
+  }
+}
+
+void SnapshotWriter::FlushChunk() {
+  if (bufRecords == 0) {
+    buf.clear();
+    return;
+  }
+  SnapshotChunkEntry entry;
+  entry.section = section;
+  entry.reserved = 0;
+  entry.offset = offset;
+  entry.length = buf.size();
+  entry.numRecords = bufRecords;
+  entry.checksum = SnapshotChecksum(buf.data(), buf.size());
+  chunks.push_back(entry);
+  Write(buf.data(), buf.size());
+  offset += buf.size();
+  buf.clear();
+  bufRecords = 0;
+}
+
+bool SnapshotWriter::Finish() {
+  FlushChunk();
+  if (failed) {
+    return false;
+  }
+
+  const char *table = reinterpret_cast<const char *>(chunks.data());
+  size_t tableLen = chunks.size() * sizeof(SnapshotChunkEntry);
+  SnapshotHeader header;
+  std::memset(&header, 0, sizeof(header));
+  std::memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic));
+  header.version = SNAPSHOT_VERSION;
+  header.formatTag = formatTag;
+  header.tableOffset = offset;
+  header.numChunks = chunks.size();
+  header.tableChecksum = SnapshotChecksum(table, tableLen);
+  Write(table, tableLen);
+  if (!failed && pwrite(fd, &header, sizeof(header), 0) != sizeof(header)) {
+    failed = true;
+  }
+  if (!failed && fsync(fd) != 0) {
+    failed = true;
+  }
+  close(fd);
+  fd = -1;
+  if (failed || rename(tmpPath.c_str(), path.c_str()) != 0) {
+    Warning("Failed writing snapshot file %s.", path.c_str());
+    unlink(tmpPath.c_str());
+    return false;
+  }
+  return true;
+}
+
+bool SnapshotReader::Cursor::GetU32(uint32_t &v) {
+  if (static_cast<size_t>(end - pos) < sizeof(v)) {
+    return false;
+  }
+  std::memcpy(&v, pos, sizeof(v));
+  pos += sizeof(v);
+  return true;
+}
+
+bool SnapshotReader::Cursor::GetU64(uint64_t &v) {
+  if (static_cast<size_t>(end - pos) < sizeof(v)) {
+    return false;
+  }
+  std::memcpy(&v, pos, sizeof(v));
+  pos += sizeof(v);
+  return true;
+}
+
+bool SnapshotReader::Cursor::GetBytes(const char *&data, uint32_t &len) {
+  if (!GetU32(len) || static_cast<size_t>(end - pos) < len) {
+    return false;
+  }
+  data = pos;
+  pos += len;
+  return true;
+}
+
+bool SnapshotReader::Cursor::GetBytes(std::string &s) {
+  const char *data;
+  uint32_t len;
+  if (!GetBytes(data, len)) {
+    return false;
+  }
+  s.assign(data, len);
+  return true;
+}
+
+SnapshotReader::SnapshotReader() : addr(nullptr), size(0) {
+}
+
+SnapshotReader::~SnapshotReader() {
+  if (addr != nullptr) {
+    munmap(addr, size);
+  }
+}
+
+bool SnapshotReader::Open(const std::string &path, uint64_t formatTag,
+    size_t numThreads) {
+  int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    return false;
+  }
+  struct stat st;
+  if (fstat(fd, &st) < 0 || static_cast<size_t>(st.st_size) < sizeof(SnapshotHeader)) {
+    close(fd);
+    Warning("Snapshot %s is too short.", path.c_str());
+    return false;
+  }
+  size = st.st_size;
+  addr = mmap(nullptr, size, PROT_READ, MAP_PRIVATE | MAP_POPULATE, fd, 0);
+  close(fd);
+  if (addr == MAP_FAILED) {
+    addr = nullptr;
+    return false;
+  }
+  const char *base = static_cast<const char *>(addr);
+
+  SnapshotHeader header;
+  std::memcpy(&header, base, sizeof(header));
+  if (std::memcmp(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic)) != 0) {
+    Warning("%s is not a snapshot.", path.c_str());
+    return false;
+  }
+  if (header.version != SNAPSHOT_VERSION || header.formatTag != formatTag) {
+    Warning("Snapshot %s has version %u and format %lx, expected %u and %lx.",
+        path.c_str(), header.version, header.formatTag, SNAPSHOT_VERSION,
+        formatTag);
+    return false;
+  }
+  size_t tableLen = header.numChunks * sizeof(SnapshotChunkEntry);
+  if (header.tableOffset > size || size - header.tableOffset != tableLen ||
+      SnapshotChecksum(base + header.tableOffset, tableLen) != header.tableChecksum) {
+    Warning("Snapshot %s has a corrupt chunk table.", path.c_str());
+    return false;
+  }
+
+  std::vector<SnapshotChunkEntry> entries(header.numChunks);
+  std::memcpy(entries.data(), base + header.tableOffset, tableLen);
+  std::unordered_map<uint32_t, uint64_t> sectionRecords;
+  chunks.clear();
+  for (const auto &entry : entries) {
+    if (entry.offset < sizeof(SnapshotHeader) || entry.offset > header.tableOffset ||
+        header.tableOffset - entry.offset < entry.length) {
+      Warning("Snapshot %s has a chunk out of bounds.", path.c_str());
+      return false;
+    }
+    Chunk chunk;
+    chunk.section = entry.section;
+    chunk.firstRecord = sectionRecords[entry.section];
+    chunk.numRecords = entry.numRecords;
+    chunk.data = base + entry.offset;
+    chunk.length = entry.length;
+    sectionRecords[entry.section] += entry.numRecords;
+    chunks.push_back(chunk);
+  }
+
+  std::atomic<bool> corrupt(false);
+  ParallelFor(chunks.size(), numThreads, [&](size_t i) {
+    if (SnapshotChecksum(chunks[i].data, chunks[i].length) != entries[i].checksum) {
+      corrupt = true;
+    }
+  });
+  if (corrupt) {
+    Warning("Snapshot %s failed checksum verification.", path.c_str());
+    chunks.clear();
+    return false;
+  }
+  return true;
+}
+
+uint64_t SnapshotReader::NumRecords(uint32_t section) const {
+  uint64_t n = 0;
+  for (const auto &chunk : chunks) {
+    if (chunk.section == section) {
+      n += chunk.numRecords;
+    }
+  }
+  return n;
+}
+
+bool SnapshotReader::ForEachChunk(uint32_t section, size_t numThreads,
+    const std::function<bool(const Chunk &)> &fn) const {
+  std::vector<const Chunk *> sectionChunks;
+  for (const auto &chunk : chunks) {
+    if (chunk.section == section) {
+      sectionChunks.push_back(&chunk);
+    }
+  }
+  std::atomic<bool> ok(true);
+  ParallelFor(sectionChunks.size(), numThreads, [&](size_t i) {
+    if (!fn(*sectionChunks[i])) {
+      ok = false;
+    }
+  });
+  return ok;
+}
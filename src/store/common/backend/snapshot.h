@@ -0,0 +1,134 @@
+/***********************************************************************
+ *
+ * Copyright 2021 Florian Suri-Payer <fsp@cs.cornell.edu>
+ *                Matthew Burke <matthelb@cs.cornell.edu>
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ **********************************************************************/
+#ifndef _SNAPSHOT_H_
+#define _SNAPSHOT_H_
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+// Versioned, checksummed binary snapshot files.
+//
+// A snapshot is a header, a sequence of chunk bodies and a chunk table. A
+// chunk holds whole records of one section and carries its own checksum, so
+// chunks can be verified and decoded by several threads straight out of the
+// mapped file. Records are opaque to this layer: stores encode them with the
+// Put* helpers and decode them with SnapshotReader::Cursor.
+
+const uint32_t SNAPSHOT_VERSION = 1;
+
+uint64_t SnapshotChecksum(const char *data, size_t len);
+
+// On-disk chunk table entry.
+struct SnapshotChunkEntry {
+  uint32_t section;
+  uint32_t reserved;
+  uint64_t offset;
+  uint64_t length;
+  uint64_t numRecords;
+  uint64_t checksum;
+};
+
+class SnapshotWriter {
+ public:
+  // formatTag identifies the store layout so that a snapshot is never loaded
+  // by a store that encodes its records differently.
+  SnapshotWriter(const std::string &path, uint64_t formatTag);
+  ~SnapshotWriter();
+
+  void BeginSection(uint32_t section);
+  void PutU32(uint32_t v);
+  void PutU64(uint64_t v);
+  void PutBytes(const char *data, size_t len);
+  inline void PutBytes(const std::string &s) { PutBytes(s.data(), s.size()); }
+  // Ends the current record. Records never straddle chunks.
+  void EndRecord();
+  // Writes the chunk table and header and atomically moves the file into
+  // place. Returns false if any write failed.
+  bool Finish();
+
+ private:
+  void FlushChunk();
+  void Write(const void *data, size_t len);
+
+  const std::string path;
+  const std::string tmpPath;
+  const uint64_t formatTag;
+  int fd;
+  bool failed;
+  uint64_t offset;
+  uint32_t section;
+  std::string buf;
+  uint64_t bufRecords;
+  std::vector<SnapshotChunkEntry> chunks;
+};
+
+class SnapshotReader {
+ public:
+  struct Chunk {
+    uint32_t section;
+    uint64_t firstRecord;  // index of the chunk's first record in its section
+    uint64_t numRecords;
+    const char *data;
+    size_t length;
+  };
+
+  class Cursor {
+   public:
+    Cursor(const Chunk &chunk) : pos(chunk.data), end(chunk.data + chunk.length) { }
+    bool GetU32(uint32_t &v);
+    bool GetU64(uint64_t &v);
+    // Points data into the mapped file; valid until the reader is destroyed.
+    bool GetBytes(const char *&data, uint32_t &len);
+    bool GetBytes(std::string &s);
+    inline bool Done() const { return pos == end; }
+
+   private:
+    const char *pos;
+    const char *end;
+  };
+
+  SnapshotReader();
+  ~SnapshotReader();
+
+  // Maps path and checks its magic, version and format tag, then verifies
+  // every chunk checksum using numThreads threads.
+  bool Open(const std::string &path, uint64_t formatTag, size_t numThreads);
+  uint64_t NumRecords(uint32_t section) const;
+  // Runs fn on every chunk of section using numThreads threads. Returns false
+  // if fn returns false for any chunk.
+  bool ForEachChunk(uint32_t section, size_t numThreads,
+      const std::function<bool(const Chunk &)> &fn) const;
+
+ private:
+  void *addr;
+  size_t size;
+  std::vector<Chunk> chunks;
+};
+
+#endif /* _SNAPSHOT_H_ */
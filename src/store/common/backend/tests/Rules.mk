@@ -6,7 +6,11 @@ d := $(dir $(lastword $(MAKEFILE_LIST)))
 GTEST_SRCS += $(addprefix $(d), \
 		kvstore-test.cc \
 		versionstore-test.cc \
-		lockserver-test.cc)
+		lockserver-test.cc \
+		snapshot-test.cc \
+		batchexecutor-test.cc)
+
+SRCS += $(d)versionstore-bench.cc $(d)snapshot-bench.cc
 
 $(d)kvstore-test: $(o)kvstore-test.o $(LIB-transport) $(LIB-store-common) $(LIB-store-backend) $(GTEST_MAIN)
 
@@ -19,3 +23,19 @@ TEST_BINS += $(d)versionstore-test
 $(d)lockserver-test: $(o)lockserver-test.o $(LIB-transport) $(LIB-store-common) $(LIB-store-backend) $(GTEST_MAIN)
 
 TEST_BINS += $(d)lockserver-test
+
+$(d)snapshot-test: $(o)snapshot-test.o $(LIB-store-common) $(LIB-store-backend) $(GTEST_MAIN)
+
+TEST_BINS += $(d)snapshot-test
+
+$(d)batchexecutor-test: $(o)batchexecutor-test.o $(LIB-store-backend) $(GTEST_MAIN)
+
+TEST_BINS += $(d)batchexecutor-test
+
+$(d)versionstore-bench: $(o)versionstore-bench.o $(LIB-store-common) $(LIB-store-backend)
+
+BINS += $(d)versionstore-bench
+
+$(d)snapshot-bench: $(o)snapshot-bench.o $(LIB-io-utils) $(LIB-store-common) $(LIB-store-backend)
+
+BINS += $(d)snapshot-bench
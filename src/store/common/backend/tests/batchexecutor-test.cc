@@ -0,0 +1,162 @@
+/***********************************************************************
+ *
+ * Copyright 2021 Florian Suri-Payer <fsp@cs.cornell.edu>
+ *                Matthew Burke <matthelb@cs.cornell.edu>
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ **********************************************************************/
+#include "store/common/backend/batchexecutor.h"
+
+#include <gtest/gtest.h>
+
+#include <map>
+#include <random>
+
+static BatchOp Op(std::vector<std::string> keys)
+{
+    BatchOp op;
+    op.keys = std::move(keys);
+    return op;
+}
+
+static BatchOp Barrier()
+{
+    BatchOp op;
+    op.barrier = true;
+    return op;
+}
+
+TEST(BatchExecutor, ScheduleSeparatesConflicts)
+{
+    std::vector<BatchOp> ops = {
+        Op({"a"}), Op({"b"}), Op({"a", "c"}), Op({"d"}), Op({"c", "b"}),
+    };
+    std::vector<std::vector<size_t>> waves;
+    BatchExecutor::Schedule(ops, waves);
+
+    std::vector<std::vector<size_t>> expected = {{0, 1, 3}, {2}, {4}};
+    EXPECT_EQ(expected, waves);
+}
+
+TEST(BatchExecutor, ScheduleBarrier)
+{
+    std::vector<BatchOp> ops = {
+        Op({"a"}), Op({"a"}), Barrier(), Op({"b"}), Barrier(), Barrier(),
+        Op({"a"}),
+    };
+    std::vector<std::vector<size_t>> waves;
+    BatchExecutor::Schedule(ops, waves);
+
+    std::vector<std::vector<size_t>> expected = {{0}, {1}, {2}, {3}, {4}, {5},
+        {6}};
+    EXPECT_EQ(expected, waves);
+}
+
+static std::vector<BatchOp> MakeOps()
+{
+    std::mt19937 rng(42);
+    std::vector<BatchOp> ops;
+    for (size_t i = 0; i < 2000; ++i) {
+        if (rng() % 100 == 0) {
+            ops.push_back(Barrier());
+            continue;
+        }
+        std::vector<std::string> keys;
+        size_t n = 1 + rng() % 3;
+        for (size_t k = 0; k < n; ++k) {
+            keys.push_back("key" + std::to_string(rng() % 200));
+        }
+        ops.push_back(Op(keys));
+    }
+    return ops;
+}
+
+// Every op reads the current values of its keys in Check and writes a
+// function of them back in Apply.
+struct Workload {
+    explicit Workload(const std::vector<BatchOp> &ops)
+        : ops(ops), observed(ops.size(), 0), barriers(0)
+    {
+        // pre-create every key so that Check never inserts into the map
+        for (size_t k = 0; k < 200; ++k) {
+            state["key" + std::to_string(k)] = k;
+        }
+    }
+
+    void Check(size_t i)
+    {
+        uint64_t sum = barriers;
+        for (const auto &key : ops[i].keys) {
+            sum = sum * 31 + state.at(key);
+        }
+        observed[i] = sum;
+    }
+
+    void Apply(size_t i)
+    {
+        if (ops[i].barrier) {
+            barriers++;
+        }
+        for (const auto &key : ops[i].keys) {
+            state[key] = observed[i] + i;
+        }
+    }
+
+    const std::vector<BatchOp> &ops;
+    std::map<std::string, uint64_t> state;
+    std::vector<uint64_t> observed;
+    uint64_t barriers;
+};
+
+// The final state and the values each op observed must be those of
+// executing the batch one op at a time, whatever the number of threads.
+TEST(BatchExecutor, ParallelMatchesSerial)
+{
+    std::vector<BatchOp> ops = MakeOps();
+    Workload serial(ops);
+    for (size_t i = 0; i < ops.size(); ++i) {
+        serial.Check(i);
+        serial.Apply(i);
+    }
+
+    for (size_t threads : {1, 2, 4, 8}) {
+        Workload parallel(ops);
+        BatchExecutor executor(threads);
+        executor.Execute(ops, [&](size_t i) { parallel.Check(i); },
+                         [&](size_t i) { parallel.Apply(i); });
+        EXPECT_EQ(serial.state, parallel.state);
+        EXPECT_EQ(serial.observed, parallel.observed);
+    }
+}
+
+// Workers that wake up after a wave has finished must not touch it; run
+// many short waves back to back to give them the chance.
+TEST(BatchExecutor, ManyShortBatches)
+{
+    BatchExecutor executor(8);
+    for (size_t round = 0; round < 2000; ++round) {
+        std::vector<BatchOp> ops = {Op({"a"}), Op({"b"}), Op({"c"})};
+        std::vector<int> checked(ops.size(), 0);
+        executor.Execute(ops, [&](size_t i) { checked[i]++; },
+                         [&](size_t i) { EXPECT_EQ(checked[i], 1); });
+    }
+}
@@ -0,0 +1,182 @@
+/***********************************************************************
+ *
+ * Copyright 2021 Florian Suri-Payer <fsp@cs.cornell.edu>
+ *                Matthew Burke <matthelb@cs.cornell.edu>
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ **********************************************************************/
+#include "lib/io_utils.h"
+#include "lib/message.h"
+#include "store/common/timestamp.h"
+#include "store/common/backend/snapshot.h"
+#include "store/common/backend/versionstore_safe.h"
+
+#include <gflags/gflags.h>
+
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <sstream>
+#include <thread>
+
+DEFINE_string(num_keys, "1000000,10000000", "comma-separated list of store sizes in keys.");
+DEFINE_uint64(value_size, 100, "size of each value in bytes.");
+DEFINE_uint64(threads, 0, "snapshot load threads (0 = one per hardware thread).");
+DEFINE_string(dir, "/tmp", "directory for the data and snapshot files.");
+
+typedef std::chrono::high_resolution_clock Clock;
+typedef VersionedKVStore<Timestamp, std::string> Store;
+
+static const uint64_t BENCH_FORMAT = 0x68636e6562ULL;
+
+static uint64_t MsSince(const Clock::time_point &start) {
+  return std::chrono::duration_cast<std::chrono::milliseconds>(
+      Clock::now() - start).count();
+}
+
+static std::string Key(uint64_t i) {
+  return std::to_string(i);
+}
+
+// Previous restart path: read length-prefixed key/value pairs one by one.
+static uint64_t LoadBytes(const std::string &path, Store &store) {
+  std::ifstream in(path, std::ios::binary);
+  uint64_t n = 0;
+  while (!in.eof()) {
+    std::string key;
+    std::string value;
+    if (ReadBytesFromStream(&in, key) == 0) {
+      ReadBytesFromStream(&in, value);
+      store.put(key, value, Timestamp());
+      ++n;
+    }
+  }
+  return n;
+}
+
+static uint64_t LoadSnapshot(const std::string &path, Store &store,
+    size_t threads) {
+  SnapshotReader reader;
+  if (!reader.Open(path, BENCH_FORMAT, threads)) {
+    Panic("Could not open snapshot %s.", path.c_str());
+  }
+  store.KVStore_Reserve(reader.NumRecords(1));
+  reader.ForEachChunk(1, threads, [&](const SnapshotReader::Chunk &chunk) {
+    SnapshotReader::Cursor cursor(chunk);
+    std::string key;
+    std::string value;
+    uint64_t t;
+    uint64_t id;
+    for (uint64_t i = 0; i < chunk.numRecords; ++i) {
+      if (!cursor.GetBytes(key) || !cursor.GetU64(t) || !cursor.GetU64(id) ||
+          !cursor.GetBytes(value)) {
+        return false;
+      }
+      store.put(key, value, Timestamp(t, id));
+    }
+    return true;
+  });
+  return reader.NumRecords(1);
+}
+
+int main(int argc, char *argv[]) {
+  gflags::SetUsageMessage("benchmark store restart from a snapshot against"
+      " regenerating or reloading the dataset.");
+  gflags::ParseCommandLineFlags(&argc, &argv, true);
+
+  size_t threads = FLAGS_threads;
+  if (threads == 0) {
+    threads = std::max(1U, std::thread::hardware_concurrency());
+  }
+  std::string value(FLAGS_value_size, 'v');
+  std::string dataPath = FLAGS_dir + "/snapshot-bench-" + std::to_string(getpid()) + ".dat";
+  std::string snapPath = FLAGS_dir + "/snapshot-bench-" + std::to_string(getpid()) + ".snap";
+
+  std::vector<uint64_t> sizes;
+  std::stringstream ss(FLAGS_num_keys);
+  std::string tok;
+  while (std::getline(ss, tok, ',')) {
+    sizes.push_back(std::stoull(tok));
+  }
+
+  Notice("===================================");
+  Notice("Running snapshot restart bench: %lu-byte values, %lu threads.",
+      FLAGS_value_size, threads);
+  for (uint64_t numKeys : sizes) {
+    {
+      std::ofstream out(dataPath, std::ios::binary);
+      for (uint64_t i = 0; i < numKeys; ++i) {
+        WriteBytesToStream(&out, Key(i));
+        WriteBytesToStream(&out, value);
+      }
+    }
+
+    uint64_t regenMs;
+    {
+      Store store;
+      auto start = Clock::now();
+      for (uint64_t i = 0; i < numKeys; ++i) {
+        store.put(Key(i), value, Timestamp());
+      }
+      regenMs = MsSince(start);
+
+      SnapshotWriter writer(snapPath, BENCH_FORMAT);
+      writer.BeginSection(1);
+      store.forEachVersion([&](const std::string &key, const Timestamp &ts,
+            const std::string &val) {
+        writer.PutBytes(key);
+        writer.PutU64(ts.getTimestamp());
+        writer.PutU64(ts.getID());
+        writer.PutBytes(val);
+        writer.EndRecord();
+      });
+      if (!writer.Finish()) {
+        Panic("Could not write snapshot %s.", snapPath.c_str());
+      }
+    }
+
+    uint64_t bytesMs;
+    {
+      Store store;
+      auto start = Clock::now();
+      UW_ASSERT(LoadBytes(dataPath, store) == numKeys);
+      bytesMs = MsSince(start);
+    }
+
+    uint64_t snapMs;
+    {
+      Store store;
+      auto start = Clock::now();
+      UW_ASSERT(LoadSnapshot(snapPath, store, threads) == numKeys);
+      snapMs = MsSince(start);
+    }
+
+    Notice("%lu keys: regenerate %lu ms, bytes file %lu ms, snapshot %lu ms.",
+        numKeys, regenMs, bytesMs, snapMs);
+  }
+  unlink(dataPath.c_str());
+  unlink(snapPath.c_str());
+  Notice("===================================");
+  return 0;
+}
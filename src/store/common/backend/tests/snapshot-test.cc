@@ -0,0 +1,139 @@
+// -*- mode: c++; c-file-style: "k&r"; c-basic-offset: 4 -*-
+/***********************************************************************
+ *
+ * store/common/backend/tests/versionstore-test.cc
+ *   test cases for simple versioned key-value store class
+ *
+ * Copyright 2015 Irene Zhang  <iyzhang@cs.washington.edu>
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ **********************************************************************/
+
+#include "store/common/backend/snapshot.h"
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <cstdio>
+#include <fstream>
+#include <mutex>
+#include <set>
+#include <unistd.h>
+
+static const uint64_t TEST_FORMAT = 0x7465737431ULL;
+
+static std::string SnapshotPath(const char *name)
+{
+    return std::string("/tmp/snapshot-test-") + name + "-" +
+        std::to_string(getpid());
+}
+
+// Writes n records of (key, i) into section 1 and one record into section 2.
+static void WriteTestSnapshot(const std::string &path, uint64_t n)
+{
+    SnapshotWriter writer(path, TEST_FORMAT);
+    writer.BeginSection(1);
+    for (uint64_t i = 0; i < n; ++i) {
+        writer.PutBytes("key" + std::to_string(i));
+        writer.PutU64(i);
+        writer.EndRecord();
+    }
+    writer.BeginSection(2);
+    writer.PutU32(42);
+    writer.EndRecord();
+    ASSERT_TRUE(writer.Finish());
+}
+
+TEST(Snapshot, RoundTrip)
+{
+    std::string path = SnapshotPath("roundtrip");
+    // enough records to span several chunks
+    const uint64_t n = 500000;
+    WriteTestSnapshot(path, n);
+
+    SnapshotReader reader;
+    ASSERT_TRUE(reader.Open(path, TEST_FORMAT, 4));
+    EXPECT_EQ(n, reader.NumRecords(1));
+    EXPECT_EQ(1UL, reader.NumRecords(2));
+
+    std::mutex mtx;
+    std::set<uint64_t> seen;
+    EXPECT_TRUE(reader.ForEachChunk(1, 4, [&](const SnapshotReader::Chunk &chunk) {
+        SnapshotReader::Cursor cursor(chunk);
+        std::set<uint64_t> local;
+        for (uint64_t r = 0; r < chunk.numRecords; ++r) {
+            std::string key;
+            uint64_t i;
+            if (!cursor.GetBytes(key) || !cursor.GetU64(i)) {
+                return false;
+            }
+            if (key != "key" + std::to_string(i) || i != chunk.firstRecord + r) {
+                return false;
+            }
+            local.insert(i);
+        }
+        std::lock_guard<std::mutex> lock(mtx);
+        seen.insert(local.begin(), local.end());
+        return cursor.Done();
+    }));
+    EXPECT_EQ(n, seen.size());
+
+    uint32_t v = 0;
+    EXPECT_TRUE(reader.ForEachChunk(2, 1, [&](const SnapshotReader::Chunk &chunk) {
+        SnapshotReader::Cursor cursor(chunk);
+        return cursor.GetU32(v) && cursor.Done();
+    }));
+    EXPECT_EQ(42U, v);
+    unlink(path.c_str());
+}
+
+TEST(Snapshot, RejectsCorruption)
+{
+    std::string path = SnapshotPath("corrupt");
+    WriteTestSnapshot(path, 1000);
+
+    {
+        std::fstream f(path, std::ios::in | std::ios::out | std::ios::binary);
+        f.seekp(100);
+        char c = 0;
+        f.seekg(100);
+        f.read(&c, 1);
+        c ^= 0x1;
+        f.seekp(100);
+        f.write(&c, 1);
+    }
+    SnapshotReader reader;
+    EXPECT_FALSE(reader.Open(path, TEST_FORMAT, 2));
+    unlink(path.c_str());
+}
+
+TEST(Snapshot, RejectsOtherFormat)
+{
+    std::string path = SnapshotPath("format");
+    WriteTestSnapshot(path, 10);
+
+    SnapshotReader reader;
+    EXPECT_FALSE(reader.Open(path, TEST_FORMAT + 1, 1));
+    SnapshotReader missing;
+    EXPECT_FALSE(missing.Open(path + ".missing", TEST_FORMAT, 1));
+    unlink(path.c_str());
+}
@@ -0,0 +1,119 @@
+/***********************************************************************
+ *
+ * Copyright 2021 Florian Suri-Payer <fsp@cs.cornell.edu>
+ *                Matthew Burke <matthelb@cs.cornell.edu>
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ **********************************************************************/
+#include "lib/message.h"
+#include "store/common/timestamp.h"
+#include "store/common/backend/versionstore.h"
+#include "store/common/backend/versionstore_flat.h"
+
+#include <gflags/gflags.h>
+
+#include <chrono>
+#include <random>
+
+DEFINE_uint64(num_keys, 1000000, "number of keys to load (e.g. 1000000 or 10000000).");
+DEFINE_uint64(versions_per_key, 3, "number of versions written per key.");
+DEFINE_uint64(ops, 1000000, "number of operations measured per operation type.");
+
+typedef std::chrono::high_resolution_clock Clock;
+
+static double MopsSince(const Clock::time_point &start, uint64_t ops) {
+  double us = std::chrono::duration_cast<std::chrono::microseconds>(
+      Clock::now() - start).count();
+  return us > 0 ? ops / us : 0.0;
+}
+
+template<class S>
+void RunBench(const char *name, const std::vector<std::string> &keys) {
+  S *store = new S();
+  store->KVStore_Reserve(keys.size());
+  std::mt19937_64 gen(0);
+  std::uniform_int_distribution<uint64_t> keyDist(0, keys.size() - 1);
+  std::uniform_int_distribution<uint64_t> tsDist(1, FLAGS_versions_per_key);
+  std::string value(64, 'v');
+
+  auto start = Clock::now();
+  for (uint64_t v = 1; v <= FLAGS_versions_per_key; ++v) {
+    for (const std::string &key : keys) {
+      store->put(key, value, Timestamp(v));
+    }
+  }
+  double putMops = MopsSince(start, keys.size() * FLAGS_versions_per_key);
+
+  std::pair<Timestamp, std::string> val;
+  uint64_t found = 0;
+  start = Clock::now();
+  for (uint64_t i = 0; i < FLAGS_ops; ++i) {
+    found += store->get(keys[keyDist(gen)], val);
+  }
+  double getMops = MopsSince(start, FLAGS_ops);
+
+  start = Clock::now();
+  for (uint64_t i = 0; i < FLAGS_ops; ++i) {
+    found += store->get(keys[keyDist(gen)], Timestamp(tsDist(gen)), val);
+  }
+  double getTsMops = MopsSince(start, FLAGS_ops);
+
+  std::pair<Timestamp, Timestamp> range;
+  start = Clock::now();
+  for (uint64_t i = 0; i < FLAGS_ops; ++i) {
+    found += store->getRange(keys[keyDist(gen)], Timestamp(tsDist(gen)), range);
+  }
+  double rangeMops = MopsSince(start, FLAGS_ops);
+
+  std::vector<std::pair<Timestamp, std::string>> values;
+  start = Clock::now();
+  for (uint64_t i = 0; i < FLAGS_ops; ++i) {
+    values.clear();
+    found += store->getCommittedAfter(keys[keyDist(gen)], Timestamp(tsDist(gen)),
+        values);
+  }
+  double afterMops = MopsSince(start, FLAGS_ops);
+
+  Notice("%s: put %.3f, get %.3f, get(ts) %.3f, getRange %.3f, "
+      "getCommittedAfter %.3f Mops/s (%lu hits).", name, putMops, getMops,
+      getTsMops, rangeMops, afterMops, found);
+  delete store;
+}
+
+int main(int argc, char *argv[]) {
+  gflags::SetUsageMessage("benchmark versioned key-value store layouts.");
+  gflags::ParseCommandLineFlags(&argc, &argv, true);
+
+  std::vector<std::string> keys;
+  keys.reserve(FLAGS_num_keys);
+  for (uint64_t i = 0; i < FLAGS_num_keys; ++i) {
+    keys.push_back("key" + std::to_string(i));
+  }
+
+  Notice("===================================");
+  Notice("Running versionstore bench with %lu keys, %lu versions per key.",
+      FLAGS_num_keys, FLAGS_versions_per_key);
+  RunBench<VersionedKVStore<Timestamp, std::string>>("set", keys);
+  RunBench<FlatVersionedKVStore<Timestamp, std::string>>("flat", keys);
+  Notice("===================================");
+  return 0;
+}
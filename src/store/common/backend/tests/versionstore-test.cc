@@ -29,6 +29,7 @@
  **********************************************************************/
 
 #include "store/common/backend/versionstore.h"
+#include "store/common/backend/versionstore_flat.h"
 
 #include <gtest/gtest.h>
 
@@ -55,3 +56,110 @@ TEST(VersionedKVStore, Get)
     EXPECT_TRUE(store.get("test1", Timestamp(10), val));
     EXPECT_EQ(val.second, "abc");
 }
+
+TEST(FlatVersionedKVStore, Get)
+{
+    FlatVersionedKVStore<Timestamp, std::string> store;
+    std::pair<Timestamp, std::string> val;
+
+    store.put("test1", "abc", Timestamp(10));
+    EXPECT_TRUE(store.get("test1", val));
+    EXPECT_EQ(val.second, "abc");
+    EXPECT_EQ(Timestamp(10), val.first);
+
+    store.put("test2", "def", Timestamp(10));
+    EXPECT_TRUE(store.get("test2", val));
+    EXPECT_EQ(val.second, "def");
+    EXPECT_EQ(Timestamp(10), val.first);
+
+    store.put("test1", "xyz", Timestamp(11));
+    EXPECT_TRUE(store.get("test1", val));
+    EXPECT_EQ(val.second, "xyz");
+    EXPECT_EQ(Timestamp(11), val.first);
+
+    EXPECT_TRUE(store.get("test1", Timestamp(10), val));
+    EXPECT_EQ(val.second, "abc");
+    EXPECT_FALSE(store.get("test1", Timestamp(9), val));
+    EXPECT_FALSE(store.get("test3", val));
+}
+
+TEST(FlatVersionedKVStore, OutOfOrderPut)
+{
+    FlatVersionedKVStore<Timestamp, std::string> store;
+    std::pair<Timestamp, std::string> val;
+    std::pair<Timestamp, Timestamp> range;
+
+    store.put("test1", "c", Timestamp(30));
+    store.put("test1", "a", Timestamp(10));
+    store.put("test1", "b", Timestamp(20));
+    store.put("test1", "dup", Timestamp(20));
+
+    EXPECT_TRUE(store.get("test1", val));
+    EXPECT_EQ(val.second, "c");
+    EXPECT_TRUE(store.get("test1", Timestamp(25), val));
+    EXPECT_EQ(val.second, "b");
+
+    EXPECT_TRUE(store.getRange("test1", Timestamp(15), range));
+    EXPECT_EQ(Timestamp(10), range.first);
+    EXPECT_EQ(Timestamp(20), range.second);
+
+    Timestamp upper;
+    EXPECT_TRUE(store.getUpperBound("test1", Timestamp(20), upper));
+    EXPECT_EQ(Timestamp(30), upper);
+    EXPECT_FALSE(store.getUpperBound("test1", Timestamp(30), upper));
+
+    std::vector<std::pair<Timestamp, std::string>> values;
+    EXPECT_TRUE(store.getCommittedAfter("test1", Timestamp(10), values));
+    ASSERT_EQ(2, values.size());
+    EXPECT_EQ(values[0].second, "b");
+    EXPECT_EQ(values[1].second, "c");
+}
+
+TEST(FlatVersionedKVStore, Prune)
+{
+    FlatVersionedKVStore<Timestamp, std::string> store;
+    std::pair<Timestamp, std::string> val;
+    std::vector<std::pair<Timestamp, std::string>> pruned;
+
+    store.put("test1", "a", Timestamp(10));
+    store.put("test1", "b", Timestamp(20));
+    store.put("test1", "c", Timestamp(30));
+
+    // nothing is shadowed below the oldest version
+    store.prune("test1", Timestamp(15), pruned);
+    EXPECT_EQ(0, pruned.size());
+
+    store.prune("test1", Timestamp(25), pruned);
+    ASSERT_EQ(1, pruned.size());
+    EXPECT_EQ(Timestamp(10), pruned[0].first);
+
+    EXPECT_TRUE(store.get("test1", Timestamp(25), val));
+    EXPECT_EQ(val.second, "b");
+    EXPECT_FALSE(store.get("test1", Timestamp(15), val));
+
+    pruned.clear();
+    store.prune("test1", Timestamp(40), pruned);
+    ASSERT_EQ(1, pruned.size());
+    EXPECT_TRUE(store.get("test1", val));
+    EXPECT_EQ(val.second, "c");
+    store.prune("test2", Timestamp(40), pruned);
+    EXPECT_EQ(1, pruned.size());
+}
+
+TEST(FlatVersionedKVStore, PutBatch)
+{
+    FlatVersionedKVStore<Timestamp, std::string> store;
+    std::pair<Timestamp, std::string> val;
+
+    store.put("test1", "b", Timestamp(20));
+    std::vector<std::pair<Timestamp, std::string>> versions = {
+        { Timestamp(10), "a" }, { Timestamp(20), "dup" }, { Timestamp(30), "c" } };
+    store.putBatch("test1", versions);
+
+    EXPECT_TRUE(store.get("test1", val));
+    EXPECT_EQ(val.second, "c");
+    EXPECT_TRUE(store.get("test1", Timestamp(25), val));
+    EXPECT_EQ(val.second, "b");
+    EXPECT_TRUE(store.get("test1", Timestamp(15), val));
+    EXPECT_EQ(val.second, "a");
+}
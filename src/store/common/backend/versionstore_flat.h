@@ -0,0 +1,340 @@
+/***********************************************************************
+ *
+ * Copyright 2021 Florian Suri-Payer <fsp@cs.cornell.edu>
+ *                Matthew Burke <matthelb@cs.cornell.edu>
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ **********************************************************************/
+
+/*
+ * Drop-in alternative to VersionedKVStore (same template interface).
+ * Each key maps to a small contiguous vector of versions sorted by write
+ * timestamp, newest at the back, and every operation performs exactly one
+ * hash lookup. Reads of the newest version are O(1); reads of older
+ * versions binary search the chain.
+ */
+
+#ifndef _FLAT_VERSIONED_KV_STORE_H_
+#define _FLAT_VERSIONED_KV_STORE_H_
+
+#include "lib/assert.h"
+#include "lib/message.h"
+#include "store/common/timestamp.h"
+
+#include <algorithm>
+#include <vector>
+#include "tbb/concurrent_hash_map.h"
+
+template<class T, class V>
+class FlatVersionedKVStore {
+ public:
+  FlatVersionedKVStore();
+  ~FlatVersionedKVStore();
+
+  long int lock_time;
+  int KVStore_size();
+  void KVStore_Reserve(int size);
+  int ReadStore_size();
+
+  bool get(const std::string &key, std::pair<T, V> &value);
+  bool get(const std::string &key, const T &t, std::pair<T, V> &value);
+  bool getRange(const std::string &key, const T &t, std::pair<T, T> &range);
+  bool getLastRead(const std::string &key, T &readTime);
+  bool getLastRead(const std::string &key, const T &t, T &readTime);
+  bool getCommittedAfter(const std::string &key, const T &t,
+      std::vector<std::pair<T, V>> &values);
+  void put(const std::string &key, const V &v, const T &t);
+  // Inserts all versions of key under a single lock. Values are moved out
+  // of versions.
+  void putBatch(const std::string &key, std::vector<std::pair<T, V>> &versions);
+  void commitGet(const std::string &key, const T &readTime, const T &commit);
+  bool getUpperBound(const std::string& key, const T& t, T& result);
+  void prune(const std::string &key, const T &t,
+      std::vector<std::pair<T, V>> &pruned);
+
+ private:
+  struct VersionedValue {
+    T write;
+    V value;
+    // Replaces the per-key lastReads map of the set-based store.
+    T lastRead;
+    bool hasLastRead;
+
+    VersionedValue(const T &commit, const V &val) : write(commit), value(val),
+        hasLastRead(false) { };
+    VersionedValue(const T &commit, V &&val) : write(commit),
+        value(std::move(val)), hasLastRead(false) { };
+  };
+
+  // Sorted by write timestamp, newest version at the back.
+  typedef std::vector<VersionedValue> VersionChain;
+  typedef tbb::concurrent_hash_map<std::string, VersionChain> storeMap;
+  storeMap store;
+
+  template<class U>
+  static void insertVersion(VersionChain &chain, const T &t, U &&value);
+  // Index of the newest version with write <= t, or chain.size() if none.
+  static size_t findVersion(const VersionChain &chain, const T &t);
+  // Index of the oldest version with write > t, or chain.size() if none.
+  static size_t findAfter(const VersionChain &chain, const T &t);
+};
+
+template<class T, class V>
+FlatVersionedKVStore<T, V>::FlatVersionedKVStore() : lock_time(0) { }
+
+template<class T, class V>
+FlatVersionedKVStore<T, V>::~FlatVersionedKVStore() { }
+
+template<class T, class V>
+int FlatVersionedKVStore<T, V>::KVStore_size() {
+  return store.size();
+}
+
+template<class T, class V>
+void FlatVersionedKVStore<T, V>::KVStore_Reserve(int size) {
+  store.rehash(size);
+}
+
+template<class T, class V>
+int FlatVersionedKVStore<T, V>::ReadStore_size() {
+  // Not safe against concurrent writers; only used for exit statistics.
+  int count = 0;
+  for (const auto &kv : store) {
+    for (const VersionedValue &v : kv.second) {
+      if (v.hasLastRead) {
+        count++;
+        break;
+      }
+    }
+  }
+  return count;
+}
+
+template<class T, class V>
+size_t FlatVersionedKVStore<T, V>::findAfter(const VersionChain &chain,
+    const T &t) {
+  // Fast path: most lookups target the newest version.
+  if (chain.empty() || chain.back().write <= t) {
+    return chain.size();
+  }
+  auto it = std::upper_bound(chain.begin(), chain.end(), t,
+      [](const T &ts, const VersionedValue &v) { return ts < v.write; });
+  return it - chain.begin();
+}
+
+template<class T, class V>
+size_t FlatVersionedKVStore<T, V>::findVersion(const VersionChain &chain,
+    const T &t) {
+  size_t after = findAfter(chain, t);
+  // if there is no valid version at this timestamp
+  return after == 0 ? chain.size() : after - 1;
+}
+
+/* Returns the most recent value and timestamp for given key.
+ * Error if key does not exist. */
+template<class T, class V>
+bool FlatVersionedKVStore<T, V>::get(const std::string &key,
+    std::pair<T, V> &value) {
+  typename storeMap::const_accessor a;
+  if (!store.find(a, key) || a->second.empty()) {
+    return false;
+  }
+  const VersionedValue &v = a->second.back();
+  value = std::make_pair(v.write, v.value);
+  return true;
+}
+
+/* Returns the value valid at given timestamp.
+ * Error if key did not exist at the timestamp. */
+template<class T, class V>
+bool FlatVersionedKVStore<T, V>::get(const std::string &key, const T &t,
+    std::pair<T, V> &value) {
+  typename storeMap::const_accessor a;
+  if (!store.find(a, key)) {
+    return false;
+  }
+  size_t i = findVersion(a->second, t);
+  if (i == a->second.size()) {
+    return false;
+  }
+  value = std::make_pair(a->second[i].write, a->second[i].value);
+  return true;
+}
+
+template<class T, class V>
+bool FlatVersionedKVStore<T, V>::getRange(const std::string &key, const T &t,
+    std::pair<T, T> &range) {
+  typename storeMap::const_accessor a;
+  if (!store.find(a, key)) {
+    return false;
+  }
+  size_t i = findVersion(a->second, t);
+  if (i == a->second.size()) {
+    return false;
+  }
+  range.first = a->second[i].write;
+  if (i + 1 < a->second.size()) {
+    range.second = a->second[i + 1].write;
+  }
+  return true;
+}
+
+template<class T, class V>
+bool FlatVersionedKVStore<T, V>::getUpperBound(const std::string& key,
+    const T& t, T& result) {
+  typename storeMap::const_accessor a;
+  if (!store.find(a, key)) {
+    return false;
+  }
+  size_t i = findAfter(a->second, t);
+  if (i == a->second.size()) {
+    return false;
+  }
+  result = a->second[i].write;
+  return true;
+}
+
+template<class T, class V>
+template<class U>
+void FlatVersionedKVStore<T, V>::insertVersion(VersionChain &chain,
+    const T &t, U &&value) {
+  // Versions almost always arrive in timestamp order.
+  if (chain.empty() || chain.back().write < t) {
+    chain.emplace_back(t, std::forward<U>(value));
+    return;
+  }
+  auto it = std::lower_bound(chain.begin(), chain.end(), t,
+      [](const VersionedValue &v, const T &ts) { return v.write < ts; });
+  // Like std::set::insert, an existing version at t is left untouched.
+  if (it == chain.end() || it->write != t) {
+    chain.emplace(it, t, std::forward<U>(value));
+  }
+}
+
+template<class T, class V>
+void FlatVersionedKVStore<T, V>::put(const std::string &key, const V &value,
+    const T &t) {
+  typename storeMap::accessor a;
+  store.insert(a, key);
+  insertVersion(a->second, t, value);
+}
+
+template<class T, class V>
+void FlatVersionedKVStore<T, V>::putBatch(const std::string &key,
+    std::vector<std::pair<T, V>> &versions) {
+  typename storeMap::accessor a;
+  store.insert(a, key);
+  VersionChain &chain = a->second;
+  chain.reserve(chain.size() + versions.size());
+  for (auto &version : versions) {
+    insertVersion(chain, version.first, std::move(version.second));
+  }
+}
+
+/*
+ * Commit a read by updating the timestamp of the latest read txn for
+ * the version of the key that the txn read.
+ */
+template<class T, class V>
+void FlatVersionedKVStore<T, V>::commitGet(const std::string &key,
+    const T &readTime, const T &commit) {
+  typename storeMap::accessor a;
+  if (!store.find(a, key)) {
+    return;
+  }
+  size_t i = findVersion(a->second, readTime);
+  if (i == a->second.size()) {
+    return;
+  }
+  // figure out if anyone has read this version before (as in
+  // VersionedKVStore, only already recorded reads are advanced)
+  VersionedValue &v = a->second[i];
+  if (v.hasLastRead && v.lastRead < commit) {
+    v.lastRead = commit;
+  }
+}
+
+template<class T, class V>
+bool FlatVersionedKVStore<T, V>::getLastRead(const std::string &key,
+    T &lastRead) {
+  typename storeMap::const_accessor a;
+  if (!store.find(a, key) || a->second.empty() ||
+      !a->second.back().hasLastRead) {
+    return false;
+  }
+  lastRead = a->second.back().lastRead;
+  return true;
+}
+
+/*
+ * Get the latest read for the write valid at timestamp t
+ */
+template<class T, class V>
+bool FlatVersionedKVStore<T, V>::getLastRead(const std::string &key,
+    const T &t, T &lastRead) {
+  typename storeMap::const_accessor a;
+  if (!store.find(a, key)) {
+    return false;
+  }
+  size_t i = findVersion(a->second, t);
+  if (i == a->second.size() || !a->second[i].hasLastRead) {
+    return false;
+  }
+  lastRead = a->second[i].lastRead;
+  return true;
+}
+
+template<class T, class V>
+bool FlatVersionedKVStore<T, V>::getCommittedAfter(const std::string &key,
+    const T &t, std::vector<std::pair<T, V>> &values) {
+  typename storeMap::const_accessor a;
+  if (!store.find(a, key)) {
+    return false;
+  }
+  for (size_t i = findAfter(a->second, t); i < a->second.size(); ++i) {
+    values.push_back(std::make_pair(a->second[i].write, a->second[i].value));
+  }
+  return true;
+}
+
+/*
+ * Drop every version of key that is shadowed by a newer version at or below
+ * t. The dropped versions are appended to pruned.
+ */
+template<class T, class V>
+void FlatVersionedKVStore<T, V>::prune(const std::string &key, const T &t,
+    std::vector<std::pair<T, V>> &pruned) {
+  typename storeMap::accessor a;
+  if (!store.find(a, key)) {
+    return;
+  }
+  size_t keep = findVersion(a->second, t);
+  if (keep == a->second.size() || keep == 0) {
+    return;
+  }
+  for (size_t i = 0; i < keep; ++i) {
+    pruned.push_back(std::make_pair(a->second[i].write, a->second[i].value));
+  }
+  a->second.erase(a->second.begin(), a->second.begin() + keep);
+}
+
+#endif  /* _FLAT_VERSIONED_KV_STORE_H_ */
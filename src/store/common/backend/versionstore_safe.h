@@ -64,8 +64,20 @@ class VersionedKVStore {
   bool getCommittedAfter(const std::string &key, const T &t,
       std::vector<std::pair<T, V>> &values);
   void put(const std::string &key, const V &v, const T &t);
+  // Inserts all versions of key under a single lock. Values are moved out
+  // of versions.
+  void putBatch(const std::string &key, std::vector<std::pair<T, V>> &versions);
+  // Inserts one version per key at time t. Values are moved out of kvs. Safe
+  // to call from several threads at once.
+  void loadBatch(std::vector<std::pair<std::string, V>> &kvs, const T &t);
+  // Calls f(key, t, v) for every version, each key's versions in timestamp
+  // order. Not safe against concurrent writers.
+  template<class F>
+  void forEachVersion(F f) const;
   void commitGet(const std::string &key, const T &readTime, const T &commit);
   bool getUpperBound(const std::string& key, const T& t, T& result);
+  void prune(const std::string &key, const T &t,
+      std::vector<std::pair<T, V>> &pruned);
 
  private:
   struct VersionedValue {
@@ -74,6 +86,7 @@ class VersionedKVStore {
 
     VersionedValue(const T &commit) : write(commit) { };
     VersionedValue(const T &commit, const V &val) : write(commit), value(val) { };
+    VersionedValue(const T &commit, V &&val) : write(commit), value(std::move(val)) { };
 
     friend bool operator> (const VersionedValue &v1, const VersionedValue &v2) {
         return v1.write > v2.write;
@@ -93,7 +106,7 @@ class VersionedKVStore {
   lastReadsMap lastReads;
 
   bool inStore(const std::string &key);
-  void getValue(const std::string &key, const T &t,
+  void getValue(const typename storeMap::const_accessor &a, const T &t,
       typename std::set<VersionedKVStore<T, V>::VersionedValue>::iterator &it);
 };
 
@@ -112,8 +125,8 @@ int VersionedKVStore<T, V>::KVStore_size() {
 
  template<class T, class V>
  void VersionedKVStore<T, V>::KVStore_Reserve(int size) {
-     //store.reserve(size);
-     return;
+     // Not safe against concurrent access; call before loading.
+     store.rehash(size);
   }
 
 
@@ -131,12 +144,12 @@ bool VersionedKVStore<T, V>::inStore(const std::string &key) {
 }
 
 template<class T, class V>
-void VersionedKVStore<T, V>::getValue(const std::string &key, const T &t,
+void VersionedKVStore<T, V>::getValue(const typename storeMap::const_accessor &a,
+    const T &t,
     typename std::set<VersionedKVStore<T, V>::VersionedValue>::iterator &it) {
   //std::shared_lock lock(storeMutex);
+  // The caller must keep holding a while using it: prune may erase versions.
   VersionedKVStore<T, V>::VersionedValue v(t);
-  typename storeMap::const_accessor a;
-  bool inStore = store.find(a, key);
   it = a->second.upper_bound(v);
 
   // if there is no valid version at this timestamp
@@ -170,11 +183,11 @@ bool VersionedKVStore<T, V>::get(const std::string &key, const T &t,
     std::pair<T, V> &value) {
 
   if (inStore(key)) {
+    typename storeMap::const_accessor a;
+    store.find(a, key);
     typename std::set<VersionedKVStore<T, V>::VersionedValue>::iterator it;
-    getValue(key, t, it);
+    getValue(a, t, it);
 
-    typename storeMap::const_accessor a;
-    bool inStore = store.find(a, key);
     if (it != a->second.end()) {
       value = std::make_pair((*it).write, (*it).value);
       return true;
@@ -188,11 +201,11 @@ bool VersionedKVStore<T, V>::getRange(const std::string &key, const T &t,
     std::pair<T, T> &range) {
 
   if (inStore(key)) {
+    typename storeMap::const_accessor a;
+    store.find(a, key);
     typename std::set<VersionedKVStore<T, V>::VersionedValue>::iterator it;
-    getValue(key, t, it);
+    getValue(a, t, it);
 
-    typename storeMap::const_accessor a;
-    bool inStore = store.find(a, key);
     if (it != a->second.end()) {
       range.first = (*it).write;
       it++;
@@ -232,6 +245,39 @@ void VersionedKVStore<T, V>::put(const std::string &key, const V &value,
   a->second.insert(VersionedKVStore<T, V>::VersionedValue(t, value));
 }
 
+template<class T, class V>
+void VersionedKVStore<T, V>::putBatch(const std::string &key,
+    std::vector<std::pair<T, V>> &versions) {
+  typename storeMap::accessor a;
+  store.insert(a, key);
+  for (auto &version : versions) {
+    // Batches are usually sorted, so hint at the newest end.
+    a->second.emplace_hint(a->second.end(), version.first,
+        std::move(version.second));
+  }
+}
+
+template<class T, class V>
+void VersionedKVStore<T, V>::loadBatch(
+    std::vector<std::pair<std::string, V>> &kvs, const T &t) {
+  typename storeMap::accessor a;
+  for (auto &kv : kvs) {
+    store.insert(a, kv.first);
+    a->second.emplace_hint(a->second.end(), t, std::move(kv.second));
+    a.release();
+  }
+}
+
+template<class T, class V>
+template<class F>
+void VersionedKVStore<T, V>::forEachVersion(F f) const {
+  for (auto itr = store.begin(); itr != store.end(); ++itr) {
+    for (const auto &version : itr->second) {
+      f(itr->first, version.write, version.value);
+    }
+  }
+}
+
 /*
  * Commit a read by updating the timestamp of the latest read txn for
  * the version of the key that the txn read.
@@ -241,11 +287,11 @@ void VersionedKVStore<T, V>::commitGet(const std::string &key,
     const T &readTime, const T &commit) {
   // Hmm ... could read a key we don't have if we are behind ... do we commit this or wait for the log update?
   if (inStore(key)) {
+    typename storeMap::const_accessor a;
+    store.find(a, key);
     typename std::set<VersionedKVStore<T, V>::VersionedValue>::iterator it;
-    getValue(key, readTime, it);
+    getValue(a, readTime, it);
 
-    typename storeMap::const_accessor a;
-    bool inStore = store.find(a, key);
     if (it != a->second.end()) {
       // figure out if anyone has read this version before
       typename lastReadsMap::accessor b;
@@ -285,8 +331,10 @@ bool VersionedKVStore<T, V>::getLastRead(const std::string &key, const T &t,
     T &lastRead) {
 
   if (inStore(key)) {
+    typename storeMap::const_accessor a;
+    store.find(a, key);
     typename std::set<VersionedKVStore<T, V>::VersionedValue>::iterator it;
-    getValue(key, t, it);
+    getValue(a, t, it);
 
     // TODO: this ASSERT seems incorrect. Why should we expect to find a value
     //    at given time t? There is no constraint on t, so we have no guarantee
@@ -323,4 +371,39 @@ bool VersionedKVStore<T, V>::getCommittedAfter(const std::string &key,
 }
 
 
+/*
+ * Drop every version of key that is shadowed by a newer version at or below
+ * t. Reads at any timestamp >= t observe the same value afterwards. The
+ * dropped versions are appended to pruned.
+ */
+template<class T, class V>
+void VersionedKVStore<T, V>::prune(const std::string &key, const T &t,
+    std::vector<std::pair<T, V>> &pruned) {
+
+  VersionedKVStore<T, V>::VersionedValue v(t);
+  typename storeMap::accessor a;
+  if (!store.find(a, key)) {
+    return;
+  }
+  auto keep = a->second.upper_bound(v);
+  if (keep == a->second.begin()) {
+    return;
+  }
+  keep--;
+  if (keep == a->second.begin()) {
+    return;
+  }
+
+  typename lastReadsMap::accessor b;
+  bool inLastReads = lastReads.find(b, key);
+  for (auto itr = a->second.begin(); itr != keep; ++itr) {
+    pruned.push_back(std::make_pair(itr->write, itr->value));
+    if (inLastReads) {
+      b->second.erase(itr->write);
+    }
+  }
+  a->second.erase(a->second.begin(), keep);
+}
+
+
 #endif  /* _VERSIONED_KV_STORE_H_ */
@@ -0,0 +1,156 @@
+/***********************************************************************
+ *
+ * Copyright 2021 Florian Suri-Payer <fsp@cs.cornell.edu>
+ *                Matthew Burke <matthelb@cs.cornell.edu>
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ **********************************************************************/
+#include "store/common/batchcontroller.h"
+
+#include "lib/message.h"
+
+#include <algorithm>
+
+BatchController::BatchController(const std::string &name, Stats &stats,
+    const BatchControllerConfig &config, uint64_t initialSize,
+    uint64_t initialTimeoutUs) : name(name), stats(stats), config(config),
+    arrivals(0UL), flushes(0UL), flushedItems(0UL), queueDelaySumUs(0UL),
+    completions(0UL), completedItems(0UL), latencySumUs(0UL),
+    bestLatencyUs(0.0), prevThroughput(0.0) {
+  size = std::min(std::max(initialSize, config.minSize), config.maxSize);
+  timeout = std::min(std::max(initialTimeoutUs, config.minTimeoutUs),
+      config.maxTimeoutUs);
+  batchSize = static_cast<uint64_t>(size);
+  timeoutUs = static_cast<uint64_t>(timeout);
+  // The first observation starts the first interval.
+  intervalStartUs = 0UL;
+  nextUpdateUs = 0UL;
+}
+
+void BatchController::Arrival(uint64_t count, uint64_t nowUs) {
+  arrivals.fetch_add(count, std::memory_order_relaxed);
+  if (nowUs >= nextUpdateUs.load(std::memory_order_relaxed)) {
+    std::unique_lock<std::mutex> lock(mtx);
+    MaybeUpdate(nowUs);
+  }
+}
+
+void BatchController::Flush(uint64_t size, uint64_t queueDelayUs,
+    uint64_t nowUs) {
+  std::unique_lock<std::mutex> lock(mtx);
+  flushes++;
+  flushedItems += size;
+  queueDelaySumUs += queueDelayUs;
+  MaybeUpdate(nowUs);
+}
+
+void BatchController::Complete(uint64_t count, uint64_t latencyUs,
+    uint64_t nowUs) {
+  std::unique_lock<std::mutex> lock(mtx);
+  completions++;
+  completedItems += count;
+  latencySumUs += latencyUs;
+  MaybeUpdate(nowUs);
+}
+
+void BatchController::MaybeUpdate(uint64_t nowUs) {
+  if (nowUs < nextUpdateUs.load(std::memory_order_relaxed)) {
+    return;
+  }
+  if (intervalStartUs > 0) {
+    Update(nowUs);
+  }
+  intervalStartUs = nowUs;
+  nextUpdateUs = nowUs + config.intervalUs;
+}
+
+void BatchController::Update(uint64_t nowUs) {
+  double elapsedUs = std::max<uint64_t>(nowUs - intervalStartUs, 1UL);
+  uint64_t arrived = arrivals.exchange(0UL, std::memory_order_relaxed);
+  if (arrived == 0 && flushes == 0 && completions == 0) {
+    return;
+  }
+
+  double rate = arrived / elapsedUs;  // items per microsecond
+  double throughput = completedItems / elapsedUs;
+  double avgFlush = flushes > 0 ? static_cast<double>(flushedItems) / flushes : 0.0;
+  double queueDelay = flushes > 0 ?
+      static_cast<double>(queueDelaySumUs) / flushes : 0.0;
+  double latency = completions > 0 ?
+      static_cast<double>(latencySumUs) / completions : 0.0;
+
+  bool congested = false;
+  if (completions > 0) {
+    // The best latency slowly forgets, so that a permanent change of the
+    // workload eventually becomes the new reference.
+    if (bestLatencyUs == 0.0 || latency < bestLatencyUs) {
+      bestLatencyUs = latency;
+    } else {
+      bestLatencyUs *= 1.01;
+    }
+    congested = latency > bestLatencyUs * (1.0 + config.slack) &&
+        throughput <= prevThroughput * (1.0 + config.slack / 2);
+    prevThroughput = throughput;
+  }
+
+  if (congested && (queueDelay >= latency / 2 || config.maxTimeoutUs == 0)) {
+    // Waiting to fill batches (or, for a closed-loop batcher, the batch
+    // itself) is what costs latency: back off.
+    size *= 0.75;
+    timeout *= 0.5;
+  } else if (congested) {
+    // Items mostly wait behind earlier batches: amortize more per batch, and
+    // wait long enough for the larger batches to fill.
+    size += std::max(1.0, size / 4);
+    timeout += std::max(1.0, (config.maxTimeoutUs - config.minTimeoutUs) / 8.0);
+  } else if (flushes > 0 && avgFlush < size / 2) {
+    // Batches leave on the timer: waiting for them to fill only adds latency.
+    size = std::max(avgFlush, rate * timeout);
+    timeout *= 0.75;
+  } else {
+    size += std::max(1.0, size / 4);
+    timeout += std::max(1.0, (config.maxTimeoutUs - config.minTimeoutUs) / 8.0);
+  }
+  size = std::min(std::max(size, static_cast<double>(config.minSize)),
+      static_cast<double>(config.maxSize));
+  timeout = std::min(std::max(timeout, static_cast<double>(config.minTimeoutUs)),
+      static_cast<double>(config.maxTimeoutUs));
+  batchSize = static_cast<uint64_t>(size);
+  timeoutUs = static_cast<uint64_t>(timeout);
+
+  stats.Add(name + "_size", batchSize);
+  stats.Add(name + "_timeout_us", timeoutUs);
+  stats.Add(name + "_arrival_rate", static_cast<int64_t>(rate * 1e6));
+  stats.Add(name + "_queue_delay_us", static_cast<int64_t>(queueDelay));
+  stats.Add(name + "_latency_us", static_cast<int64_t>(latency));
+  Debug("%s: %lu arrivals/s, %.0fus latency (best %.0fus), avg flush %.1f%s;"
+      " size %lu, timeout %luus.", name.c_str(),
+      static_cast<uint64_t>(rate * 1e6), latency, bestLatencyUs, avgFlush,
+      congested ? ", congested" : "", BatchSize(), TimeoutMicro());
+
+  flushes = 0;
+  flushedItems = 0;
+  queueDelaySumUs = 0;
+  completions = 0;
+  completedItems = 0;
+  latencySumUs = 0;
+}
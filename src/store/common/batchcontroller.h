@@ -0,0 +1,127 @@
+/***********************************************************************
+ *
+ * Copyright 2021 Florian Suri-Payer <fsp@cs.cornell.edu>
+ *                Matthew Burke <matthelb@cs.cornell.edu>
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ **********************************************************************/
+#ifndef _BATCH_CONTROLLER_H_
+#define _BATCH_CONTROLLER_H_
+
+#include "store/common/stats.h"
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <string>
+
+// Bounds of a BatchController. Timeouts are in microseconds; a batcher that
+// does not wait for arrivals (e.g. a closed-loop client) sets both to 0.
+struct BatchControllerConfig {
+  BatchControllerConfig() : minSize(1), maxSize(64), minTimeoutUs(0),
+      maxTimeoutUs(0), intervalUs(100000), slack(0.2) { }
+  BatchControllerConfig(uint64_t minSize, uint64_t maxSize,
+      uint64_t minTimeoutUs, uint64_t maxTimeoutUs, uint64_t intervalUs,
+      double slack = 0.2) : minSize(minSize), maxSize(maxSize),
+      minTimeoutUs(minTimeoutUs), maxTimeoutUs(maxTimeoutUs),
+      intervalUs(intervalUs), slack(slack) { }
+
+  uint64_t minSize;
+  uint64_t maxSize;
+  uint64_t minTimeoutUs;
+  uint64_t maxTimeoutUs;
+  // Length of the observation window between two adjustments.
+  uint64_t intervalUs;
+  // Latency increase over the best latency seen that counts as congestion.
+  double slack;
+};
+
+// Feedback controller for the size and timeout of a batcher. The batcher
+// reports arrivals, the size and queueing delay of each batch it flushes, and
+// the latency until its items complete. Once per interval the controller
+//  - if latency rose by more than slack over the best seen without a
+//    matching rise in throughput, backs off (size *3/4, timeout /2) when the
+//    time spent filling batches dominates, or grows size and timeout when
+//    items mostly wait behind earlier batches. Closed-loop batchers (no timeout)
+//    always back off;
+//  - otherwise shrinks the size to what actually arrives per batch if
+//    batches leave less than half full, and waits less;
+//  - otherwise grows size and timeout additively to amortize more per batch.
+// Each decision is appended to the Stats lists <name>_size, <name>_timeout_us,
+// <name>_arrival_rate, <name>_queue_delay_us and <name>_latency_us.
+class BatchController {
+ public:
+  BatchController(const std::string &name, Stats &stats,
+      const BatchControllerConfig &config, uint64_t initialSize,
+      uint64_t initialTimeoutUs);
+
+  inline uint64_t BatchSize() const {
+    return batchSize.load(std::memory_order_relaxed);
+  }
+  inline uint64_t TimeoutMicro() const {
+    return timeoutUs.load(std::memory_order_relaxed);
+  }
+
+  void Arrival(uint64_t count = 1) { Arrival(count, NowUs()); }
+  void Flush(uint64_t size, uint64_t queueDelayUs) {
+    Flush(size, queueDelayUs, NowUs());
+  }
+  void Complete(uint64_t count, uint64_t latencyUs) {
+    Complete(count, latencyUs, NowUs());
+  }
+
+  // Variants with an explicit clock, for simulation.
+  void Arrival(uint64_t count, uint64_t nowUs);
+  void Flush(uint64_t size, uint64_t queueDelayUs, uint64_t nowUs);
+  void Complete(uint64_t count, uint64_t latencyUs, uint64_t nowUs);
+
+  static inline uint64_t NowUs() { return Stats::NowNs() / 1000; }
+
+ private:
+  // Requires mtx.
+  void MaybeUpdate(uint64_t nowUs);
+  void Update(uint64_t nowUs);
+
+  const std::string name;
+  Stats &stats;
+  const BatchControllerConfig config;
+
+  std::atomic<uint64_t> batchSize;
+  std::atomic<uint64_t> timeoutUs;
+  std::atomic<uint64_t> arrivals;
+  std::atomic<uint64_t> nextUpdateUs;
+
+  std::mutex mtx;
+  double size;
+  double timeout;
+  uint64_t intervalStartUs;
+  uint64_t flushes;
+  uint64_t flushedItems;
+  uint64_t queueDelaySumUs;
+  uint64_t completions;
+  uint64_t completedItems;
+  uint64_t latencySumUs;
+  double bestLatencyUs;
+  double prevThroughput;
+};
+
+#endif /* _BATCH_CONTROLLER_H_ */
@@ -26,13 +26,21 @@
  **********************************************************************/
 #include "store/common/frontend/async_adapter_client.h"
 
-AsyncAdapterClient::AsyncAdapterClient(Client *client, uint32_t timeout) :
-    client(client), timeout(100000UL), outstandingOpCount(0UL), finishedOpCount(0UL) {
+AsyncAdapterClient::AsyncAdapterClient(Client *client, uint32_t timeout,
+    bool adjustBatchSize, const BatchControllerConfig &batchControl) :
+    client(client), timeout(100000UL), outstandingOpCount(0UL), finishedOpCount(0UL),
+    adjustBatchSize(adjustBatchSize), batchControl(batchControl) {
 }
 
 AsyncAdapterClient::~AsyncAdapterClient() {
 }
 
+uint64_t AsyncAdapterClient::GeneratorBatchSize(uint64_t batchSize,
+    bool adjustBatchSize, const BatchControllerConfig &batchControl) {
+  // The controller keeps the size within its bounds, whatever it starts at.
+  return adjustBatchSize ? batchControl.maxSize : batchSize;
+}
+
 void AsyncAdapterClient::Execute(AsyncTransaction *txn,
     execute_callback ecb, bool retry) {
   currEcb = ecb;
@@ -56,223 +64,85 @@ void AsyncAdapterClient::Execute_batch(AsyncTransaction *txn,
 }
 
 void AsyncAdapterClient::ReconstructTransaction(uint64_t txNum, uint64_t txSize, uint64_t batchSize){
-
-  bool tx_conflict_finish = false;
-  bool op_conflict_finish = false;
-  int OpCount = 0;
-  bool duplicate = false;
+  if (adjustBatchSize) {
+    // The configured batch size is the starting point.
+    if (!batchController) {
+      batchController.reset(new BatchController("client_batch",
+          client->GetStats(), batchControl, batchSize, 0UL));
+    }
+    batchSize = batchController->BatchSize();
+    batchStartUs = BatchController::NowUs();
+  }
   batch_size = batchSize;
-  
+
   //Initialize
   tx_num = 0;
-  read_set.clear(); 
-  readOpNum = 0;
-  write_set.clear();
-  writeOpNum = 0;
+  retriedTxs = 0;
   writeread = false;
   readwrite = false;
-  includeRetryTx = false;
-
-  Debug("ReconstructTransaction: txNum: %d, txSize: %d, batchSize: %d\n", txNum, txSize, batchSize);
-
-
-  //前回のバッチに入れなかったトランザクションを再度バッチに入れる
-  if (retry_tx.size() != 0) {
-    for (auto op = retry_tx.begin(); op != retry_tx.end(); ++op){
-      switch (op->type) {
-        case GET: {
-          for (auto itr = pre_read_set.begin(); itr != pre_read_set.end(); ++itr){
-            if ((*itr).key == op->key){
-              duplicate = true;
-              break;
-            }
-          }
-          if (duplicate == true){
-            Debug("read key is duplicated, so skip following steps");
-            duplicate = false;
-            continue;
-          }
-          for (auto itr = pre_write_set.begin(); itr != pre_write_set.end(); ++itr){
-            if ((*itr).key == op->key){
-              Debug("write-read dependency in same transaction");
-              if (readwrite == true){
-                Debug("read-write dependency and write-read dependency in same transaction");
-                op_conflict_finish = true;
-              }
-              else {
-                writeread = true;
-              }
-            }
-            break;
-          }
-          pre_read_set.push_back(*op);
-          break;
-        }
-        case PUT: {
-          for (auto itr = pre_write_set.begin(); itr != pre_write_set.end(); ++itr){
-            if ((*itr).key == op->key){
-              duplicate = true;
-              break;
-            }
-          }
-          if (duplicate == true){
-            Debug("write key is duplicated, so skip following steps");
-            duplicate = false;
-            continue;
-          }
-          for (auto itr = pre_read_set.begin(); itr != pre_read_set.end(); ++itr){
-            if ((*itr).key == op->key){
-              Debug("read-write dependency in same transaction");
-              if (writeread == true){
-                Debug("read-write dependency and write-read dependency in same transaction");
-                op_conflict_finish = true;
-              }
-              else {
-                readwrite = true;
-              }
-            }
-            break;
-          }
-          pre_write_set.push_back(*op);
-          break;
-        }
-      }
-    }
+  packer.Reset();
 
-    if (op_conflict_finish == false){
-      Debug("%d : transaction finish\n", tx_num);
-      for(auto itr = pre_read_set.begin(); itr != pre_read_set.end(); ++itr){
-        (*itr).txId = tx_num;
-        read_set.push_back(*itr);
-        readOpNum++;
-      }
-      for(auto itr = pre_write_set.begin(); itr != pre_write_set.end(); ++itr){
-        (*itr).txId = tx_num;
-        write_set.push_back(*itr);
-        writeOpNum++;
-      }
-      pre_write_set.clear();
-      pre_read_set.clear();
+  Debug("ReconstructTransaction: txNum: %lu, txSize: %lu, batchSize: %lu\n", txNum, txSize, batchSize);
+
+  //前回のバッチに入れなかったトランザクションを先に詰める
+  size_t numDeferred = deferredTxs.size();
+  for (size_t i = 0; i < numDeferred; ++i) {
+    BatchPacker::Candidate cand(std::move(deferredTxs.front()));
+    deferredTxs.pop_front();
+    if (tx_num < batchSize && packer.TryAdd(cand, tx_num)) {
       tx_num++;
-      retry_tx.clear();
-      includeRetryTx = true;
-    }
-    else {
-      Panic("This transaction will never commit");
+      retriedTxs++;
+    } else {
+      deferredTxs.push_back(std::move(cand));
     }
   }
 
-
-
-  //トランザクションを再構築する
-  while(tx_num < batchSize){
-    Debug("tx_num: %d\n", tx_num);
-    while (true) {
-      Operation op = currTxn->GetNextOperation_batch(OpCount++, tx_num, readValues);
+  //新しいトランザクションを先読みし、衝突しないものだけをバッチに詰める
+  size_t newDeferred = 0;
+  std::vector<Operation> ops;
+  for (uint64_t genIdx = 0; genIdx < batchSize && tx_num < batchSize &&
+      deferredTxs.size() < PACK_LOOKAHEAD; ++genIdx) {
+    ops.clear();
+    for (size_t opCount = 0; ; ++opCount) {
+      Operation op = currTxn->GetNextOperation_batch(opCount, genIdx, readValues);
       if (op.type == COMMIT) {
-        OpCount = 0;
         break;
       }
-      switch (op.type) {
-        case GET: {
-          retry_tx.push_back(op);
-          for (auto itr = pre_read_set.begin(); itr != pre_read_set.end(); ++itr){
-            if ((*itr).key == op.key){
-              duplicate = true;
-              break;
-            }
-          }
-          if (duplicate == true){
-            Debug("read key is duplicated, so skip following steps");
-            duplicate = false;
-            continue;
-          }
-          for(auto itr = write_set.begin(); itr != write_set.end(); ++itr){
-            if ((*itr).key == op.key){
-              Debug("write-read conflict with other transaction");
-              tx_conflict_finish = true;
-            }
-            break;
-          }
-          for (auto itr = pre_write_set.begin(); itr != pre_write_set.end(); ++itr){
-            if ((*itr).key == op.key){
-              Debug("write-read dependency in same transaction");
-              if (readwrite == true){
-                Debug("read-write dependency and write-read dependency in same transaction");
-                op_conflict_finish = true;
-              }
-              else {
-                writeread = true;
-              }
-            }
-            break;
-          }
-          pre_read_set.push_back(op);
-          break;
-        }
-        case PUT: {
-          retry_tx.push_back(op);
-          for (auto itr = pre_write_set.begin(); itr != pre_write_set.end(); ++itr){
-            if ((*itr).key == op.key){
-              duplicate = true;
-              break;
-            }
-          }
-          if (duplicate == true){
-            Debug("write key is duplicated, so skip following steps");
-            duplicate = false;
-            continue;
-          }
-          for(auto itr = read_set.begin(); itr != read_set.end(); ++itr){
-            if ((*itr).key == op.key){
-              Debug("write-read conflict with other transaction");
-              tx_conflict_finish = true;
-            }
-            break;
-          }
-          for (auto itr = pre_read_set.begin(); itr != pre_read_set.end(); ++itr){
-            if ((*itr).key == op.key){
-               Debug("read-write dependency in same transaction");
-              if (writeread == true){
-                Debug("read-write dependency and write-read dependency in same transaction");
-                op_conflict_finish = true;
-              }
-              else {
-                readwrite = true;
-              }
-            }
-            break;
-          }
-          pre_write_set.push_back(op);
-          break;
-        }
-      }
+      ops.push_back(std::move(op));
     }
-    if (tx_conflict_finish == false && op_conflict_finish == false){
-      Debug("%d : transaction finish\n", tx_num);
-      for(auto itr = pre_read_set.begin(); itr != pre_read_set.end(); ++itr){
-        (*itr).txId = tx_num;
-        read_set.push_back(*itr);
-        readOpNum++;
-      }
-      for(auto itr = pre_write_set.begin(); itr != pre_write_set.end(); ++itr){
-        (*itr).txId = tx_num;
-        write_set.push_back(*itr);
-        writeOpNum++;
-      }
 
-      pre_write_set.clear();
-      pre_read_set.clear();
-      retry_tx.clear();
-      tx_num++;
+    BatchPacker::Candidate cand;
+    if (!BatchPacker::Prepare(ops, cand)) {
+      Panic("This transaction will never commit");
     }
-    else {
-      pre_write_set.clear();
-      pre_read_set.clear();
-      break;
+    if (packer.TryAdd(cand, tx_num)) {
+      Debug("%lu : transaction finish\n", tx_num);
+      tx_num++;
+    } else {
+      Debug("transaction %lu conflicts with the batch, deferring", genIdx);
+      deferredTxs.push_back(std::move(cand));
+      newDeferred++;
     }
   }
 
+  Stats &stats = client->GetStats();
+  stats.Increment("batch_packs", 1);
+  stats.Increment("batch_slots", batchSize);
+  stats.Increment("batch_packed_txs", tx_num);
+  stats.Increment("batch_deferred_txs", newDeferred);
+  stats.Increment("batch_retried_txs", retriedTxs);
+  stats.Record("batch_fill_pct", batchSize == 0 ? 0 : 100UL * tx_num / batchSize);
+  if (batchController) {
+    batchController->Arrival(tx_num);
+    batchController->Flush(tx_num, 0UL);
+  }
+
+  read_set.swap(packer.Reads());
+  write_set.swap(packer.Writes());
+  readOpNum = read_set.size();
+  writeOpNum = write_set.size();
+  readwrite = packer.GetOrder() == BatchPacker::ORDER_READS_FIRST;
+
   //basic
   if (writeOpNum == 0){
     ExecuteReadOperation();
@@ -469,8 +339,12 @@ void AsyncAdapterClient::CommitCallback(transaction_status_t result) {
 
 void AsyncAdapterClient::CommitBigCallback(transaction_status_t result) {
   Debug("Commit Big callback.");
+  if (batchController) {
+    batchController->Complete(result == COMMITTED ? tx_num : 0,
+        BatchController::NowUs() - batchStartUs);
+  }
   RedivisionTransaction();
-  currEcbcb(result, readValues, tx_num, includeRetryTx);
+  currEcbcb(result, readValues, tx_num, retriedTxs);
 }
 
 void AsyncAdapterClient::CommitTimeout() {
@@ -28,11 +28,20 @@
 #define ASYNC_ADAPTER_CLIENT_H
 
 #include "store/common/frontend/async_client.h"
+#include "store/common/frontend/batch_packer.h"
+#include "store/common/batchcontroller.h"
+
+#include <deque>
+#include <memory>
 
 
 class AsyncAdapterClient : public AsyncClient {
  public:
-  AsyncAdapterClient(Client *client, uint32_t timeout);
+  // If adjustBatchSize, the batch size of Execute_batch adapts to the
+  // observed commit latency within the bounds of batchControl.
+  AsyncAdapterClient(Client *client, uint32_t timeout,
+      bool adjustBatchSize = false,
+      const BatchControllerConfig &batchControl = BatchControllerConfig());
   virtual ~AsyncAdapterClient();
 
   // Begin a transaction.
@@ -40,6 +49,12 @@ class AsyncAdapterClient : public AsyncClient {
 
   virtual void Execute_batch(AsyncTransaction *txn, execute_big_callback ecb, bool retry = false);
 
+  // Number of transactions a generator passed to Execute_batch has to
+  // provide: a batch draws at most this many when the client begins its
+  // batches with batchSize.
+  static uint64_t GeneratorBatchSize(uint64_t batchSize, bool adjustBatchSize,
+      const BatchControllerConfig &batchControl);
+
  private:
   void ExecuteNextOperation();
   void GetCallback(int status, const std::string &key, const std::string &val,
@@ -53,6 +68,9 @@ class AsyncAdapterClient : public AsyncClient {
   void AbortCallback();
   void AbortTimeout();
 
+  // Stop drawing new transactions once this many are waiting for a batch.
+  static const size_t PACK_LOOKAHEAD = 4;
+
   //追加
   void ReconstructTransaction(uint64_t txNum, uint64_t txSize, uint64_t batchSize);
   void ExecuteWriteOperation();
@@ -79,13 +97,18 @@ class AsyncAdapterClient : public AsyncClient {
   //追加
   std::vector<Operation> transaction;
   std::vector<Operation> read_set;
-  std::vector<Operation> pre_read_set;
   std::vector<Operation> write_set;
-  std::vector<Operation> pre_write_set;
-  std::vector<Operation> conflict_write_set;
-  std::vector<Operation> retry_tx;
-  int tx_num;
-  int batch_size;
+  // Transactions that conflicted with an earlier batch, packed first next time.
+  std::deque<BatchPacker::Candidate> deferredTxs;
+  BatchPacker packer;
+  uint64_t retriedTxs = 0;
+  // Only set if the batch size adapts; created on the first batch.
+  std::unique_ptr<BatchController> batchController;
+  const bool adjustBatchSize;
+  const BatchControllerConfig batchControl;
+  uint64_t batchStartUs = 0;
+  uint64_t tx_num;
+  uint64_t batch_size;
   int txSize;
   int batchSize;
 
@@ -93,7 +116,6 @@ class AsyncAdapterClient : public AsyncClient {
 
   std::vector<get_callback> gcb_list;
 
-  bool includeRetryTx;
   bool wait_flag;
   bool writeread = false;
   bool readwrite = false;
@@ -0,0 +1,116 @@
+/***********************************************************************
+ * Copyright 2024 AoiKida
+ * Copyright 2021 Florian Suri-Payer <fsp@cs.cornell.edu>
+ *                Matthew Burke <matthelb@cs.cornell.edu>
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ **********************************************************************/
+#include "store/common/frontend/batch_packer.h"
+
+BatchPacker::BatchPacker() : order(ORDER_ANY), numTxs(0UL) {
+}
+
+BatchPacker::~BatchPacker() {
+}
+
+bool BatchPacker::Prepare(const std::vector<Operation> &ops, Candidate &cand) {
+  std::unordered_set<std::string> txReads;
+  std::unordered_set<std::string> txWrites;
+  bool readsFirst = false;
+  bool writesFirst = false;
+
+  cand.reads.clear();
+  cand.writes.clear();
+  for (const auto &op : ops) {
+    switch (op.type) {
+      case GET:
+        if (!txReads.insert(op.key).second) {
+          continue;
+        }
+        if (txWrites.find(op.key) != txWrites.end()) {
+          writesFirst = true;
+        }
+        cand.reads.push_back(op);
+        break;
+      case PUT:
+        if (!txWrites.insert(op.key).second) {
+          continue;
+        }
+        if (txReads.find(op.key) != txReads.end()) {
+          readsFirst = true;
+        }
+        cand.writes.push_back(op);
+        break;
+      default:
+        break;
+    }
+  }
+
+  if (readsFirst && writesFirst) {
+    return false;
+  }
+  cand.order = readsFirst ? ORDER_READS_FIRST :
+      (writesFirst ? ORDER_WRITES_FIRST : ORDER_ANY);
+  return true;
+}
+
+void BatchPacker::Reset() {
+  readKeys.clear();
+  writeKeys.clear();
+  reads.clear();
+  writes.clear();
+  order = ORDER_ANY;
+  numTxs = 0UL;
+}
+
+bool BatchPacker::TryAdd(const Candidate &cand, int txId) {
+  if (cand.order != ORDER_ANY && order != ORDER_ANY && cand.order != order) {
+    return false;
+  }
+  for (const auto &op : cand.reads) {
+    if (writeKeys.find(op.key) != writeKeys.end()) {
+      return false;
+    }
+  }
+  for (const auto &op : cand.writes) {
+    if (readKeys.find(op.key) != readKeys.end() ||
+        writeKeys.find(op.key) != writeKeys.end()) {
+      return false;
+    }
+  }
+
+  for (const auto &op : cand.reads) {
+    readKeys.insert(op.key);
+    reads.push_back(op);
+    reads.back().txId = txId;
+  }
+  for (const auto &op : cand.writes) {
+    writeKeys.insert(op.key);
+    writes.push_back(op);
+    writes.back().txId = txId;
+  }
+  if (cand.order != ORDER_ANY) {
+    order = cand.order;
+  }
+  ++numTxs;
+  return true;
+}
@@ -0,0 +1,83 @@
+/***********************************************************************
+ * Copyright 2024 AoiKida
+ * Copyright 2021 Florian Suri-Payer <fsp@cs.cornell.edu>
+ *                Matthew Burke <matthelb@cs.cornell.edu>
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ **********************************************************************/
+#ifndef BATCH_PACKER_H
+#define BATCH_PACKER_H
+
+#include "store/common/frontend/transaction_utils.h"
+
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+// Packs independent client transactions into one batched transaction. Two
+// transactions conflict if one reads a key the other writes; packed
+// transactions must also agree on whether the batch issues its reads or its
+// writes first. Membership checks use hashed key sets, so adding a
+// transaction costs O(ops) rather than O(ops in batch).
+class BatchPacker {
+ public:
+  enum Order {
+    ORDER_ANY,
+    ORDER_READS_FIRST,  // some transaction writes a key after reading it
+    ORDER_WRITES_FIRST  // some transaction reads a key after writing it
+  };
+
+  // A transaction's deduplicated read and write ops, ready to be packed.
+  struct Candidate {
+    std::vector<Operation> reads;
+    std::vector<Operation> writes;
+    Order order = ORDER_ANY;
+  };
+
+  BatchPacker();
+  ~BatchPacker();
+
+  // Builds a candidate from a transaction's ops in issue order. Returns false
+  // if the transaction needs both orders, in which case no batch can hold it.
+  static bool Prepare(const std::vector<Operation> &ops, Candidate &cand);
+
+  void Reset();
+  // Adds cand to the batch as transaction txId unless it conflicts with a
+  // transaction already packed: it reads a key they write, or writes a key
+  // they read or write.
+  bool TryAdd(const Candidate &cand, int txId);
+
+  inline size_t NumTxs() const { return numTxs; }
+  inline Order GetOrder() const { return order; }
+  inline std::vector<Operation> &Reads() { return reads; }
+  inline std::vector<Operation> &Writes() { return writes; }
+
+ private:
+  std::unordered_set<std::string> readKeys;
+  std::unordered_set<std::string> writeKeys;
+  std::vector<Operation> reads;
+  std::vector<Operation> writes;
+  Order order;
+  size_t numTxs;
+};
+
+#endif /* BATCH_PACKER_H */
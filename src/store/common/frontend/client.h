@@ -83,6 +83,7 @@ class Client {
       uint32_t timeout) = 0;
 
   inline const Stats &GetStats() const { return stats; }
+  inline Stats &GetStats() { return stats; }
 
  protected:
   Stats stats;
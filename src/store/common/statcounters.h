@@ -0,0 +1,74 @@
+/***********************************************************************
+ *
+ * Copyright 2021 Florian Suri-Payer <fsp@cs.cornell.edu>
+ *                Matthew Burke <matthelb@cs.cornell.edu>
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ **********************************************************************/
+#ifndef _STAT_COUNTERS_H_
+#define _STAT_COUNTERS_H_
+
+// Counters bumped on every transaction or CCC check. Each entry is
+// X(id, json key); Stats::Increment(STAT_<id>) updates a per-thread slot and
+// the total is exported under the json key, exactly as if it had been
+// incremented through the string-keyed API. Add new hot counters here.
+#define STAT_COUNTERS(X) \
+  X(CC_ABORTS, "cc_aborts") \
+  X(CC_ABORTS_RW_CONFLICT, "cc_aborts_rw_conflict") \
+  X(CC_ABORTS_WR_CONFLICT, "cc_aborts_wr_conflict") \
+  X(CC_ABORTS_DEP_TS, "cc_aborts_dep_ts") \
+  X(CC_ABORTS_DEP_ABORTED, "cc_aborts_dep_aborted") \
+  X(CC_ABSTAINS, "cc_abstains") \
+  X(CC_ABSTAINS_RW_CONFLICT, "cc_abstains_rw_conflict") \
+  X(CC_ABSTAINS_WR_CONFLICT, "cc_abstains_wr_conflict") \
+  X(CC_ABSTAINS_RTS, "cc_abstains_rts") \
+  X(CC_ABSTAINS_WATERMARK, "cc_abstains_watermark") \
+  X(CC_ABSTAINS_LOW_WATERMARK, "cc_abstains_low_watermark") \
+  X(CC_WAITS, "cc_waits") \
+  X(CC_RETRIES_PREPARED_WRITE, "cc_retries_prepared_write") \
+  X(CC_RETRIES_COMMITTED_WRITE, "cc_retries_committed_write") \
+  X(TOTAL_TRANSACTIONS, "total_transactions") \
+  X(TOTAL_TRANSACTIONS_FAST_COMMIT, "total_transactions_fast_commit") \
+  X(TOTAL_TRANSACTIONS_COMMIT, "total_transactions_commit") \
+  X(TOTAL_TRANSACTIONS_ABORT, "total_transactions_abort") \
+  X(TOTAL_TRANSACTIONS_SLOW, "total_transactions_slow") \
+  X(TOTAL_WRITEBACK_RECEIVED, "total_writeback_received") \
+  X(COMMIT_BATCHES, "commit_batches") \
+  X(COMMIT_BATCH_TXNS, "commit_batch_txns") \
+  X(TOTAL_FRESH_TX_HONEST, "total_fresh_tx_honest") \
+  X(TOTAL_HONEST_P1_STARTED, "total_honest_p1_started") \
+  X(TOTAL_PREPARES, "total_prepares") \
+  X(TOTAL_PREPARES_FAST, "total_prepares_fast") \
+  X(TOTAL_COMMIT_HONEST, "total_commit_honest") \
+  X(TOTAL_ABORT_HONEST, "total_abort_honest") \
+  X(P1_BATCH_CCC, "p1_batch_ccc") \
+  X(P1_BATCH_CCC_TXNS, "p1_batch_ccc_txns") \
+  X(P1_BATCH_CCC_KEYS, "p1_batch_ccc_keys")
+
+enum StatCounter {
+#define STAT_COUNTER_ID(id, key) STAT_##id,
+  STAT_COUNTERS(STAT_COUNTER_ID)
+#undef STAT_COUNTER_ID
+  NUM_STAT_COUNTERS
+};
+
+#endif /* _STAT_COUNTERS_H_ */
@@ -27,12 +27,17 @@
 #include "store/common/stats.h"
 
 #include "lib/assert.h"
+#include "lib/message.h"
 
 #include <algorithm>
+#include <cstdint>
 #include <fstream>
 #include <iostream>
 
-Stats::Stats() {
+std::atomic<uint64_t> Stats::nextId(0);
+thread_local Stats::CounterCache Stats::counterCache = {UINT64_MAX, nullptr};
+
+Stats::Stats() : id(nextId++) {
 }
 
 Stats::~Stats() {
@@ -48,6 +53,40 @@ void Stats::Increment(const std::string &key, int amount) {
   statInts[key] += amount;
 }
 
+const char *Stats::CounterKey(StatCounter counter) {
+  static const char *keys[NUM_STAT_COUNTERS] = {
+#define STAT_COUNTER_KEY(id, key) key,
+    STAT_COUNTERS(STAT_COUNTER_KEY)
+#undef STAT_COUNTER_KEY
+  };
+  return keys[counter];
+}
+
+Stats::CounterShard *Stats::LookupCounterShard() {
+  static thread_local std::unordered_map<uint64_t, CounterShard *> shards;
+  CounterShard *&shard = shards[id];
+  if (shard == nullptr) {
+    std::lock_guard<std::mutex> lock(mtx);
+    counterShards.emplace_back(new CounterShard());
+    shard = counterShards.back().get();
+  }
+  counterCache.id = id;
+  counterCache.shard = shard;
+  return shard;
+}
+
+void Stats::FoldCounters(std::unordered_map<std::string, int64_t> &ints) const {
+  for (int i = 0; i < NUM_STAT_COUNTERS; ++i) {
+    int64_t total = 0;
+    for (const auto &shard : counterShards) {
+      total += shard->counts[i].load(std::memory_order_relaxed);
+    }
+    if (total != 0) {
+      ints[CounterKey(static_cast<StatCounter>(i))] += total;
+    }
+  }
+}
+
 void Stats::IncrementList(const std::string &key, size_t idx, int amount) {
   std::lock_guard<std::mutex> lock(mtx);
   if (statIncLists[key].size() <= idx) {
@@ -69,13 +108,66 @@ void Stats::AddList(const std::string &key, size_t idx, uint64_t value) {
   statLoLs[key][idx].push_back(value);
 }
 
+void Stats::Record(const std::string &key, uint64_t value) {
+  GetShard(key)->Record(value);
+}
+
+Histogram *Stats::GetShard(const std::string &key) {
+  // Keyed by Stats id rather than address so that a destroyed Stats object
+  // can never hand out its shards to a new one.
+  static thread_local std::unordered_map<uint64_t,
+      std::unordered_map<std::string, Histogram *>> shards;
+  auto &local = shards[id];
+  auto itr = local.find(key);
+  if (itr != local.end()) {
+    return itr->second;
+  }
+  std::lock_guard<std::mutex> lock(mtx);
+  statHists[key].emplace_back(new Histogram());
+  Histogram *shard = statHists[key].back().get();
+  local[key] = shard;
+  return shard;
+}
+
+void Stats::MergedHistograms(
+    std::unordered_map<std::string, Histogram> &merged) const {
+  for (const auto &h : statHists) {
+    Histogram &m = merged[h.first];
+    for (const auto &shard : h.second) {
+      m.Merge(*shard);
+    }
+  }
+}
+
+void Stats::DumpHistograms() {
+  std::lock_guard<std::mutex> lock(mtx);
+  std::unordered_map<std::string, Histogram> merged;
+  MergedHistograms(merged);
+  for (auto &h : merged) {
+    Histogram interval(h.second);
+    interval.Subtract(statHistsDumped[h.first]);
+    statHistsDumped[h.first] = h.second;
+    if (interval.Count() == 0) {
+      continue;
+    }
+    Notice("%s: n=%lu mean=%.0f p50=%lu p90=%lu p99=%lu p999=%lu",
+        h.first.c_str(), interval.Count(), interval.Mean(),
+        interval.Percentile(50), interval.Percentile(90),
+        interval.Percentile(99), interval.Percentile(99.9));
+  }
+}
+
 void Stats::ExportJSON(std::ostream &os) {
   std::lock_guard<std::mutex> lock(mtx);
+  std::unordered_map<std::string, Histogram> hists;
+  MergedHistograms(hists);
+  std::unordered_map<std::string, int64_t> statInts(this->statInts);
+  FoldCounters(statInts);
   os << "{" << std::endl;
   for (auto itr = statInts.begin(); itr != statInts.end(); ++itr) {
     os << "    \"" << itr->first << "\": " << itr->second;
     if (std::next(itr) != statInts.end() || statLists.size() > 0 ||
-        statIncLists.size() > 0 || statLoLs.size() > 0) {
+        statIncLists.size() > 0 || statLoLs.size() > 0 || hists.size() > 0) {
       os << ",";
     }
     os << std::endl;
@@ -92,7 +184,7 @@ void Stats::ExportJSON(std::ostream &os) {
     }
     os << "]";
     if (std::next(itr) != statLists.end() || statIncLists.size() > 0 ||
-        statLoLs.size() > 0) {
+        statLoLs.size() > 0 || hists.size() > 0) {
       os << ",";
     }
     os << std::endl;
@@ -108,7 +200,20 @@ void Stats::ExportJSON(std::ostream &os) {
       }
     }
     os << "]";
-    if (std::next(itr) != statIncLists.end() || statLoLs.size() > 0) {
+    if (std::next(itr) != statIncLists.end() || statLoLs.size() > 0 ||
+        hists.size() > 0) {
+      os << ",";
+    }
+    os << std::endl;
+  }
+  for (auto itr = hists.begin(); itr != hists.end(); ++itr) {
+    const Histogram &h = itr->second;
+    os << "    \"" << itr->first << "\": {\"count\": " << h.Count()
+       << ", \"mean\": " << h.Mean() << ", \"min\": " << h.Min()
+       << ", \"p50\": " << h.Percentile(50) << ", \"p90\": " << h.Percentile(90)
+       << ", \"p99\": " << h.Percentile(99) << ", \"p999\": " << h.Percentile(99.9)
+       << ", \"max\": " << h.Max() << "}";
+    if (std::next(itr) != hists.end()) {
       os << ",";
     }
     os << std::endl;
@@ -167,10 +272,25 @@ void Stats::Merge(const Stats &other) {
     statLoLs[lol.first].insert(statLoLs[lol.first].end(), lol.second.begin(),
         lol.second.end());
   }
+  std::lock_guard<std::mutex> otherLock(other.mtx);
+  other.FoldCounters(statInts);
+  for (const auto &h : other.statHists) {
+    Histogram *merged = new Histogram();
+    for (const auto &shard : h.second) {
+      merged->Merge(*shard);
+    }
+    statHists[h.first].emplace_back(merged);
+  }
 }
 
 void Stats::Output(double time){
   double throughput;
+  std::unordered_map<std::string, int64_t> statInts;
+  {
+    std::lock_guard<std::mutex> lock(mtx);
+    statInts = this->statInts;
+    FoldCounters(statInts);
+  }
   std::cout << "{" << std::endl;
   for (auto itr = statInts.begin(); itr != statInts.end(); ++itr) {
     if (itr->first == "total_commit_honest"){
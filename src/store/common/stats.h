@@ -27,6 +27,12 @@
 #ifndef _STATS_H_
 #define _STATS_H_
 
+#include "lib/histogram.h"
+#include "store/common/statcounters.h"
+
+#include <atomic>
+#include <chrono>
+#include <memory>
 #include <mutex>
 #include <ostream>
 #include <string>
@@ -40,9 +46,27 @@ class Stats {
 
   //int64_t Get(const std::string &key);
   void Increment(const std::string &key, int amount = 1);
+  // Lock-free increment of a registered hot counter. Only the calling thread
+  // writes its slot, so a relaxed load/store pair suffices.
+  inline void Increment(StatCounter counter, int amount = 1) {
+    std::atomic<int64_t> &slot = GetCounterShard()->counts[counter];
+    slot.store(slot.load(std::memory_order_relaxed) + amount,
+        std::memory_order_relaxed);
+  }
   void IncrementList(const std::string &key, size_t idx, int amount = 1);
   void Add(const std::string &key, int64_t value);
   void AddList(const std::string &key, size_t idx, uint64_t value);
+  // Records value into the histogram key. Each thread records into its own
+  // shard, so only the first Record of a key on a thread takes the lock.
+  void Record(const std::string &key, uint64_t value);
+  // Logs count/mean/percentiles of every histogram for the samples recorded
+  // since the previous call.
+  void DumpHistograms();
+
+  static inline uint64_t NowNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+  }
 
   void ExportJSON(std::ostream &os);
   void ExportJSON(const std::string &file);
@@ -51,10 +75,60 @@ class Stats {
   void Output(double time);
 
  private:
-  std::mutex mtx;
+  // One thread's registered counters, padded so that threads never share a
+  // cache line.
+  struct alignas(64) CounterShard {
+    std::atomic<int64_t> counts[NUM_STAT_COUNTERS];
+    CounterShard() {
+      for (auto &c : counts) {
+        c.store(0, std::memory_order_relaxed);
+      }
+    }
+  };
+
+  struct CounterCache {
+    uint64_t id;
+    CounterShard *shard;
+  };
+
+  static const char *CounterKey(StatCounter counter);
+  inline CounterShard *GetCounterShard() {
+    if (counterCache.id == id) {
+      return counterCache.shard;
+    }
+    return LookupCounterShard();
+  }
+  CounterShard *LookupCounterShard();
+  // Adds the totals of the registered counters to ints, keyed by their json
+  // keys. Requires mtx.
+  void FoldCounters(std::unordered_map<std::string, int64_t> &ints) const;
+  Histogram *GetShard(const std::string &key);
+  void MergedHistograms(std::unordered_map<std::string, Histogram> &merged) const;
+
+  static std::atomic<uint64_t> nextId;
+  // The shard of the Stats object this thread incremented last.
+  static thread_local CounterCache counterCache;
+  const uint64_t id;
+  mutable std::mutex mtx;
   std::unordered_map<std::string, int64_t> statInts;
+  std::vector<std::unique_ptr<CounterShard>> counterShards;
   std::unordered_map<std::string, std::vector<int64_t>> statLists;
   std::unordered_map<std::string, std::vector<int64_t>> statIncLists;
   std::unordered_map<std::string, std::vector<std::vector<uint64_t>>> statLoLs;
+  std::unordered_map<std::string, std::vector<std::unique_ptr<Histogram>>> statHists;
+  std::unordered_map<std::string, Histogram> statHistsDumped;
+};
+
+// Records the time between construction and destruction into a histogram.
+class StatsTimer {
+ public:
+  StatsTimer(Stats &stats, const char *key) : stats(stats), key(key),
+      start(Stats::NowNs()) { }
+  ~StatsTimer() { stats.Record(key, Stats::NowNs() - start); }
+
+ private:
+  Stats &stats;
+  const char *key;
+  uint64_t start;
 };
 #endif /* _STATS_H_ */
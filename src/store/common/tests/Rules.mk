@@ -0,0 +1,14 @@
+d := $(dir $(lastword $(MAKEFILE_LIST)))
+
+#
+# gtest-based tests
+#
+GTEST_SRCS += $(addprefix $(d), \
+		batchcontroller-test.cc async-adapter-test.cc)
+
+$(d)batchcontroller-test: $(o)batchcontroller-test.o $(LIB-store-common) $(GTEST_MAIN)
+
+$(d)async-adapter-test: $(o)async-adapter-test.o $(LIB-store-frontend) \
+	$(GTEST_MAIN)
+
+TEST_BINS += $(d)batchcontroller-test $(d)async-adapter-test
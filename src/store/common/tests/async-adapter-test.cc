@@ -0,0 +1,130 @@
+/***********************************************************************
+ *
+ * Copyright 2021 Florian Suri-Payer <fsp@cs.cornell.edu>
+ *                Matthew Burke <matthelb@cs.cornell.edu>
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ **********************************************************************/
+#include "store/common/frontend/async_adapter_client.h"
+#include "store/common/frontend/async_transaction.h"
+#include "store/common/transaction.h"
+
+#include <gtest/gtest.h>
+
+#include <string>
+
+// Replies to every request right away.
+class ImmediateClient : public Client {
+ public:
+  explicit ImmediateClient(uint64_t batchSize) : batchSize(batchSize) { }
+
+  void Begin(begin_callback bcb, begin_timeout_callback btcb,
+      uint32_t timeout, bool retry = false) override {
+    bcb(0UL);
+  }
+  void Begin_batch(begin_callback_batch bcb, begin_timeout_callback btcb,
+      uint32_t timeout, bool retry = false) override {
+    bcb(0UL, 0UL, batchSize);
+  }
+  void Get(const std::string &key, get_callback gcb,
+      get_timeout_callback gtcb, uint32_t timeout) override {
+    gcb(REPLY_OK, key, "", Timestamp());
+  }
+  void Put(const std::string &key, const std::string &value,
+      put_callback pcb, put_timeout_callback ptcb, uint32_t timeout) override {
+    pcb(REPLY_OK, key, value);
+  }
+  void Commit(commit_callback cc, commit_timeout_callback ctcb,
+      uint32_t timeout) override {
+    cc(COMMITTED);
+  }
+  void Abort(abort_callback acb, abort_timeout_callback atcb,
+      uint32_t timeout) override {
+    acb();
+  }
+
+ private:
+  const uint64_t batchSize;
+};
+
+// Provides size read-modify-write transactions on distinct keys, like a
+// benchmark generator built for batches of size, and fails the test if the
+// adapter asks for one past them.
+class BoundedTransaction : public AsyncTransaction {
+ public:
+  explicit BoundedTransaction(uint64_t size) : size(size) { }
+
+  Operation GetNextOperation(size_t outstandingOpCount,
+      size_t finishedOpCount,
+      const std::map<std::string, std::string> readValues) override {
+    return Commit();
+  }
+  Operation GetNextOperation_batch(size_t opCount, size_t txCount,
+      const std::map<std::string, std::string> readValues) override {
+    EXPECT_LT(txCount, size);
+    switch (opCount) {
+      case 0:
+        return Get(std::to_string(txCount));
+      case 1:
+        return Put(std::to_string(txCount), "");
+      default:
+        return Commit();
+    }
+  }
+
+ private:
+  const uint64_t size;
+};
+
+// Runs one batch and returns how many transactions it committed.
+static uint64_t RunBatch(AsyncAdapterClient &adapter, AsyncTransaction &txn) {
+  uint64_t packed = 0;
+  adapter.Execute_batch(&txn, [&packed](transaction_status_t result,
+      std::map<std::string, std::string> readValues, uint64_t txNum,
+      uint64_t retriedTxs) {
+    EXPECT_EQ(result, COMMITTED);
+    packed = txNum;
+  });
+  return packed;
+}
+
+TEST(AsyncAdapterClient, FixedBatchSize) {
+  const uint64_t batchSize = 4;
+  ImmediateClient client(batchSize);
+  AsyncAdapterClient adapter(&client, 0);
+  BoundedTransaction txn(AsyncAdapterClient::GeneratorBatchSize(batchSize,
+      false, BatchControllerConfig()));
+  EXPECT_EQ(RunBatch(adapter, txn), batchSize);
+}
+
+TEST(AsyncAdapterClient, AdjustedBatchAtMaxSize) {
+  // The client begins with 2, but the controller starts out at its minimum,
+  // which is already the largest size it allows.
+  const BatchControllerConfig batchControl(32, 32, 0, 0, 1000000);
+  ImmediateClient client(2);
+  AsyncAdapterClient adapter(&client, 0, true, batchControl);
+  uint64_t genBatchSize = AsyncAdapterClient::GeneratorBatchSize(2, true,
+      batchControl);
+  EXPECT_EQ(genBatchSize, batchControl.maxSize);
+  BoundedTransaction txn(genBatchSize);
+  EXPECT_EQ(RunBatch(adapter, txn), batchControl.maxSize);
+}
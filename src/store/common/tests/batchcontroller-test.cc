@@ -0,0 +1,161 @@
+/***********************************************************************
+ *
+ * Copyright 2021 Florian Suri-Payer <fsp@cs.cornell.edu>
+ *                Matthew Burke <matthelb@cs.cornell.edu>
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ **********************************************************************/
+#include "store/common/batchcontroller.h"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <deque>
+
+// Drives a BatchController with a simulated batcher: items arrive every gapUs
+// and a batch leaves when it is full or its oldest item waited the timeout.
+// A single server spends fixedUs + perItemUs * n on a batch of n items.
+class BatcherSim {
+ public:
+  BatcherSim(BatchController &controller, uint64_t gapUs, uint64_t fixedUs,
+      uint64_t perItemUs) : controller(controller), gapUs(gapUs),
+      fixedUs(fixedUs), perItemUs(perItemUs), nowUs(1UL), serverFreeUs(0UL) { }
+
+  // Runs for durationUs and returns the largest server backlog seen.
+  uint64_t Run(uint64_t durationUs) {
+    uint64_t maxBacklogUs = 0;
+    for (uint64_t end = nowUs + durationUs; nowUs < end; ++nowUs) {
+      if (nowUs % gapUs == 0) {
+        pending.push_back(nowUs);
+        controller.Arrival(1, nowUs);
+      }
+      if (pending.empty()) {
+        continue;
+      }
+      uint64_t waitedUs = nowUs - pending.front();
+      if (pending.size() < controller.BatchSize() &&
+          waitedUs < controller.TimeoutMicro()) {
+        continue;
+      }
+      uint64_t n = std::min<uint64_t>(pending.size(), controller.BatchSize());
+      controller.Flush(n, waitedUs, nowUs);
+      serverFreeUs = std::max(nowUs, serverFreeUs) + fixedUs + perItemUs * n;
+      maxBacklogUs = std::max(maxBacklogUs, serverFreeUs - nowUs);
+      uint64_t latencySumUs = 0;
+      for (uint64_t i = 0; i < n; ++i) {
+        latencySumUs += serverFreeUs - pending.front();
+        pending.pop_front();
+      }
+      controller.Complete(n, latencySumUs / n, nowUs);
+    }
+    return maxBacklogUs;
+  }
+
+ private:
+  BatchController &controller;
+  const uint64_t gapUs;
+  const uint64_t fixedUs;
+  const uint64_t perItemUs;
+  uint64_t nowUs;
+  uint64_t serverFreeUs;
+  std::deque<uint64_t> pending;
+};
+
+static const uint64_t INTERVAL_US = 10000;
+
+static BatchControllerConfig TestConfig()
+{
+    return BatchControllerConfig(1, 64, 10, 2000, INTERVAL_US);
+}
+
+TEST(BatchController, ConvergesUnderModerateLoad)
+{
+    Stats stats;
+    BatchController controller("test", stats, TestConfig(), 8, 500);
+    // 0.1 items/us against a server that needs batches of >= 12 to keep up.
+    BatcherSim sim(controller, 10, 100, 1);
+    sim.Run(1000000);
+
+    // The controller probes around its operating point, so compare the
+    // averages of two consecutive windows rather than single values.
+    uint64_t minSize = UINT64_MAX;
+    uint64_t maxSize = 0;
+    uint64_t maxBacklogUs = 0;
+    double sizeSum[2] = {0.0, 0.0};
+    double timeoutSum[2] = {0.0, 0.0};
+    const int window = 150;
+    for (int i = 0; i < 2 * window; ++i) {
+        maxBacklogUs = std::max(maxBacklogUs, sim.Run(INTERVAL_US));
+        minSize = std::min(minSize, controller.BatchSize());
+        maxSize = std::max(maxSize, controller.BatchSize());
+        sizeSum[i / window] += controller.BatchSize();
+        timeoutSum[i / window] += controller.TimeoutMicro();
+        EXPECT_GE(controller.TimeoutMicro(), TestConfig().minTimeoutUs);
+        EXPECT_LT(controller.TimeoutMicro(), TestConfig().maxTimeoutUs);
+    }
+    // The size stays in a band that keeps up with the load without running
+    // to the maximum, the server never falls behind, and the operating point
+    // does not drift.
+    EXPECT_GE(minSize, 12UL);
+    EXPECT_LT(maxSize, TestConfig().maxSize);
+    EXPECT_LT(maxBacklogUs, 2 * TestConfig().maxTimeoutUs);
+    EXPECT_NEAR(sizeSum[1] / sizeSum[0], 1.0, 0.1);
+    EXPECT_NEAR(timeoutSum[1] / timeoutSum[0], 1.0, 0.2);
+}
+
+TEST(BatchController, ShrinksUnderLightLoad)
+{
+    Stats stats;
+    BatchController controller("test", stats, TestConfig(), 32, 1000);
+    // One item per ms: batches leave on the timer almost empty.
+    BatcherSim sim(controller, 1000, 100, 1);
+    sim.Run(1000000);
+
+    for (int i = 0; i < 300; ++i) {
+        sim.Run(INTERVAL_US);
+        EXPECT_LE(controller.BatchSize(), 4UL);
+        EXPECT_LT(controller.TimeoutMicro(), TestConfig().maxTimeoutUs / 2);
+    }
+}
+
+TEST(BatchController, SaturatesUnderOverload)
+{
+    Stats stats;
+    BatchController controller("test", stats, TestConfig(), 8, 500);
+    // 0.5 items/us is more than even full batches can serve.
+    BatcherSim sim(controller, 2, 100, 1);
+    sim.Run(1000000);
+
+    for (int i = 0; i < 100; ++i) {
+        sim.Run(INTERVAL_US);
+        EXPECT_EQ(controller.BatchSize(), TestConfig().maxSize);
+        EXPECT_EQ(controller.TimeoutMicro(), TestConfig().maxTimeoutUs);
+    }
+}
+
+TEST(BatchController, ClampsInitialValues)
+{
+    Stats stats;
+    BatchController controller("test", stats, TestConfig(), 1000, 1);
+    EXPECT_EQ(controller.BatchSize(), TestConfig().maxSize);
+    EXPECT_EQ(controller.TimeoutMicro(), TestConfig().minTimeoutUs);
+}
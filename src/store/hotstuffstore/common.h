@@ -61,6 +61,9 @@ std::string TransactionDigest(const proto::Transaction &txn);
 
 std::string BatchedDigest(proto::BatchedRequest& breq);
 
+// extends the running state digest prev with the next executed digest
+std::string CheckpointDigest(const std::string &prev, const std::string &digest);
+
 std::string string_to_hex(const std::string& input);
 
 void DebugHash(const std::string& hash);
@@ -55,13 +55,16 @@ using namespace std;
 
 Replica::Replica(const transport::Configuration &config, KeyManager *keyManager,
   App *app, int groupIdx, int idx, bool signMessages, uint64_t maxBatchSize,
-  uint64_t batchTimeoutMS, bool primaryCoordinator, bool requestTx, Transport *transport)
+  uint64_t batchTimeoutMS, bool primaryCoordinator, bool requestTx, Transport *transport,
+  uint64_t checkpointInterval, uint64_t checkpointWindow)
     : config(config),
       // HotStuff
       hotstuff_interface(groupIdx, idx),
       keyManager(keyManager), app(app), groupIdx(groupIdx), idx(idx),
     id(groupIdx * config.n + idx), signMessages(signMessages), maxBatchSize(maxBatchSize),
-    batchTimeoutMS(batchTimeoutMS), primaryCoordinator(primaryCoordinator), requestTx(requestTx), transport(transport) {
+    batchTimeoutMS(batchTimeoutMS), primaryCoordinator(primaryCoordinator), requestTx(requestTx), transport(transport),
+    checkpointInterval(checkpointInterval), checkpointWindow(checkpointWindow),
+    lowWatermark(0) {
   transport->Register(this, config, groupIdx, idx);
 
   // intial view
@@ -71,6 +74,11 @@ Replica::Replica(const transport::Configuration &config, KeyManager *keyManager,
   execSeqNum = 0;
   execBatchNum = 0;
 
+  if (this->checkpointWindow == 0) {
+    this->checkpointWindow = 2 * checkpointInterval;
+  }
+  UW_ASSERT(checkpointInterval == 0 || this->checkpointWindow > checkpointInterval);
+
   batchTimerRunning = false;
   nextBatchNum = 0;
 
@@ -163,6 +171,13 @@ void Replica::ReceiveMessage(const TransportAddress &remote, const string &t,
         // Prepare message from shardclient
         recvrequest.ParseFromString(data);
         HandleRequest(remote, recvrequest);
+    } else if (type == recvcheckpoint.GetTypeName()) {
+        recvcheckpoint.ParseFromString(data);
+        if (signMessages && !recvSignedMessage) {
+            stats->Increment("invalid_sig_cp",1);
+            return;
+        }
+        HandleCheckpoint(remote, recvcheckpoint, tmpsignedMessage);
     } else if (true) {
         // Other requests from shardclient (Read)
         Notice("Sending request to app");
@@ -185,17 +200,26 @@ void Replica::HandleRequest(const TransportAddress &remote,
 
   string digest = request.digest();
 
+  std::unique_lock<std::mutex> lock(checkpointMutex);
+  if (retiredDigests.find(digest) != retiredDigests.end()) {
+    Debug("request already executed before the stable checkpoint");
+    stats->Increment("retired_request",1);
+    return;
+  }
+
   if (requests.find(digest) == requests.end()) {
       Notice("new request: %s with digest %d bytes", request.packed_msg().type().c_str(), digest.length());
 
     requests[digest] = request.packed_msg();
     // clone remote mapped to request for reply
     replyAddrs[digest] = remote.clone();
+    lock.unlock();
 
     Notice("before execb");
     // prepare the callback function for HotStuff
     hotstuff_exec_callback execb = [this](const std::string &digest) {
       Notice("execb start");
+        std::unique_lock<std::mutex> lock(checkpointMutex);
         if (requests.find(digest) != requests.end()) {
             proto::PackedMessage packedMsg = requests[digest];
             Notice("Before Execute");
@@ -211,6 +235,15 @@ void Replica::HandleRequest(const TransportAddress &remote,
                     Debug("Invalid execution");
                 }
             }
+
+            uint64_t seqnum = execSeqNum++;
+            if (checkpointInterval > 0) {
+                executedDigests[seqnum] = digest;
+                stateDigest = CheckpointDigest(stateDigest, digest);
+                if (execSeqNum % checkpointInterval == 0) {
+                    takeCheckpoint(seqnum);
+                }
+            }
         } else {
             Panic("unimplemented: try to execute request that has not been received");
         }
@@ -592,6 +625,91 @@ void Replica::executeSlots() {
   }
 }
 
+bool Replica::inWindow(uint64_t seqnum) const {
+  return checkpointInterval == 0 ||
+      (seqnum >= lowWatermark && seqnum < lowWatermark + checkpointWindow);
+}
+
+// called with checkpointMutex held
+void Replica::takeCheckpoint(uint64_t seqnum) {
+  Debug("Sending checkpoint for seq num %lu", seqnum);
+  checkpointDigests[seqnum] = stateDigest;
+
+  proto::Checkpoint checkpoint;
+  checkpoint.set_seqnum(seqnum);
+  checkpoint.set_digest(stateDigest);
+  sendMessageToAll(checkpoint);
+
+  // we may already have the other replicas' checkpoints
+  testCheckpoint(seqnum);
+}
+
+void Replica::HandleCheckpoint(const TransportAddress &remote,
+                              const proto::Checkpoint &checkpoint,
+                            const proto::SignedMessage& signedMsg) {
+  Debug("Handling checkpoint message");
+
+  std::unique_lock<std::mutex> lock(checkpointMutex);
+  uint64_t seqnum = checkpoint.seqnum();
+  if (checkpointInterval == 0 || !inWindow(seqnum)) {
+    stats->Increment("outside_window_cp",1);
+    return;
+  }
+
+  if (signMessages) {
+    // make sure this message is from this shard
+    if (signedMsg.replica_id() / config.n != (uint64_t) groupIdx) {
+      stats->Increment("invalid_cp_group",1);
+      return;
+    }
+    slots.addCheckpoint(checkpoint, signedMsg.replica_id(), signedMsg.signature());
+  } else {
+    slots.addCheckpoint(checkpoint);
+  }
+
+  testCheckpoint(seqnum);
+}
+
+// a checkpoint only becomes stable once we have executed up to it ourselves
+// and 2f+1 replicas (including us) agree on the digest
+void Replica::testCheckpoint(uint64_t seqnum) {
+  auto itr = checkpointDigests.find(seqnum);
+  if (itr == checkpointDigests.end()) {
+    return;
+  }
+
+  if (slots.CheckpointStable(seqnum, itr->second, config.f)) {
+    stabilizeCheckpoint(seqnum);
+  }
+}
+
+void Replica::stabilizeCheckpoint(uint64_t seqnum) {
+  Debug("Checkpoint at seq num %lu is stable", seqnum);
+  stats->Increment("stable_checkpoints",1);
+
+  std::unordered_set<std::string> retired;
+  auto end = executedDigests.upper_bound(seqnum);
+  for (auto itr = executedDigests.begin(); itr != end; ++itr) {
+    requests.erase(itr->second);
+    auto aitr = replyAddrs.find(itr->second);
+    if (aitr != replyAddrs.end()) {
+      delete aitr->second;
+      replyAddrs.erase(aitr);
+    }
+    retired.insert(itr->second);
+  }
+  executedDigests.erase(executedDigests.begin(), end);
+  retiredDigests = std::move(retired);
+
+  slots.GarbageCollect(seqnum);
+  checkpointDigests.erase(checkpointDigests.begin(), checkpointDigests.upper_bound(seqnum));
+  lowWatermark = seqnum + 1;
+
+  stats->Record("live_checkpoints", slots.numCheckpoints());
+  stats->Record("live_requests", requests.size());
+  stats->Record("live_reply_addrs", replyAddrs.size());
+}
+
 void Replica::startActionTimer(uint64_t seq_num, uint64_t viewnum, std::string digest) {
   // actionTimers[seq_num][viewnum][digest] = transport->Timer(10, [seq_num, viewnum, digest, this]() {
   //   Debug("action timer expired, sending");
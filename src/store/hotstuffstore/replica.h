@@ -27,7 +27,10 @@
 #ifndef _HOTSTUFF_REPLICA_H_
 #define _HOTSTUFF_REPLICA_H_
 
+#include <map>
 #include <memory>
+#include <mutex>
+#include <unordered_set>
 
 #include "lib/assert.h"
 #include "lib/configuration.h"
@@ -51,9 +54,13 @@ namespace hotstuffstore {
 
 class Replica : public TransportReceiver {
 public:
+  static const uint64_t DEFAULT_CHECKPOINT_INTERVAL = 128;
+
   Replica(const transport::Configuration &config, KeyManager *keyManager,
     App *app, int groupIdx, int idx, bool signMessages, uint64_t maxBatchSize,
-    uint64_t batchTimeoutMS, bool primaryCoordinator, bool requestTx, Transport *transport);
+    uint64_t batchTimeoutMS, bool primaryCoordinator, bool requestTx, Transport *transport,
+    uint64_t checkpointInterval = DEFAULT_CHECKPOINT_INTERVAL,
+    uint64_t checkpointWindow = 0);
   ~Replica();
 
   // Message handlers.
@@ -76,6 +83,9 @@ public:
                         const proto::SignedMessage& signedMsg);
   void HandleGrouped(const TransportAddress &remote,
                           const proto::GroupedSignedMessage &msg);
+  void HandleCheckpoint(const TransportAddress &remote,
+                          const proto::Checkpoint &msg,
+                        const proto::SignedMessage& signedMsg);
 
  private:
   // HotStuff
@@ -107,6 +117,7 @@ public:
   proto::GroupedSignedMessage recvgrouped;
   proto::RequestRequest recvrr;
   proto::ABRequest recvab;
+  proto::Checkpoint recvcheckpoint;
 
   std::unordered_map<uint64_t, std::string> sessionKeys;
   bool ValidateHMACedMessage(const proto::SignedMessage &signedMessage, std::string &data, std::string &type);
@@ -143,6 +154,33 @@ public:
   // map from tx digest to reply address
   std::unordered_map<std::string, TransportAddress*> replyAddrs;
 
+  // HotStuff orders requests one by one, so here a sequence number counts
+  // executed requests. Every checkpointInterval executions the replica sends
+  // its state digest to the group; once 2f+1 replicas agree on it the
+  // executed requests up to it are dropped. Only checkpoints within
+  // [lowWatermark, lowWatermark + checkpointWindow) are accepted. An
+  // interval of 0 disables checkpointing.
+  uint64_t checkpointInterval;
+  uint64_t checkpointWindow;
+  // the first sequence number above the last stable checkpoint
+  uint64_t lowWatermark;
+  // digest over all requests executed so far
+  std::string stateDigest;
+  // map from seqnum to the request executed at it, until it is checkpointed
+  std::map<uint64_t, std::string> executedDigests;
+  // map from seqnum to our own checkpoint digest, until it becomes stable
+  std::map<uint64_t, std::string> checkpointDigests;
+  // requests discarded by the last stable checkpoint, so that late copies
+  // are not proposed again
+  std::unordered_set<std::string> retiredDigests;
+  // HotStuff executes requests on its own thread; guards requests,
+  // replyAddrs and the checkpoint state above
+  std::mutex checkpointMutex;
+  bool inWindow(uint64_t seqnum) const;
+  void takeCheckpoint(uint64_t seqnum);
+  void testCheckpoint(uint64_t seqnum);
+  void stabilizeCheckpoint(uint64_t seqnum);
+
   // tests to see if we are ready to send commit or executute the slot
   void testSlot(uint64_t seqnum, uint64_t viewnum, std::string digest, bool gotPrepare);
 
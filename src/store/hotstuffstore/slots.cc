@@ -171,4 +171,45 @@ proto::GroupedSignedMessage Slots::getCommitProof(uint64_t seq_num, uint64_t vie
   return proof;
 }
 
+bool Slots::addCheckpoint(const proto::Checkpoint &checkpoint, uint64_t replica_id, const std::string& sig) {
+  checkpoints[checkpoint.seqnum()][checkpoint.digest()][replica_id] = sig;
+  return true;
+}
+
+bool Slots::addCheckpoint(const proto::Checkpoint &checkpoint) {
+  uint64_t seq_num = checkpoint.seqnum();
+  std::string digest = checkpoint.digest();
+
+  // add a checkpoint with a fake id, don't really care because we don't have sigs
+  return addCheckpoint(checkpoint, checkpoints[seq_num][digest].size(), "");
+}
+
+bool Slots::CheckpointStable(uint64_t seq_num, const std::string& digest, uint64_t f) {
+  auto itr = checkpoints.find(seq_num);
+  if (itr == checkpoints.end()) {
+    return false;
+  }
+  auto ditr = itr->second.find(digest);
+  return ditr != itr->second.end() && ditr->second.size() >= 2*f + 1;
+}
+
+void Slots::GarbageCollect(uint64_t seq_num) {
+  for (auto itr = slots.begin(); itr != slots.end(); ) {
+    if (itr->first <= seq_num) {
+      itr = slots.erase(itr);
+    } else {
+      ++itr;
+    }
+  }
+  checkpoints.erase(checkpoints.begin(), checkpoints.upper_bound(seq_num));
+}
+
+size_t Slots::numSlots() const {
+  return slots.size();
+}
+
+size_t Slots::numCheckpoints() const {
+  return checkpoints.size();
+}
+
 }  // namespace hotstuffstore
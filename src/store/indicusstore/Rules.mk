@@ -2,7 +2,8 @@ d := $(dir $(lastword $(MAKEFILE_LIST)))
 
 SRCS += $(addprefix $(d), client.cc shardclient.cc server.cc store.cc common.cc \
 		phase1validator.cc localbatchsigner.cc sharedbatchsigner.cc \
-		basicverifier.cc localbatchverifier.cc sharedbatchverifier.cc proto_bench.cc)
+		basicverifier.cc localbatchverifier.cc sharedbatchverifier.cc proto_bench.cc batchframe_bench.cc \
+		writeback_bench.cc preparedreadindex.cc preparedreads_bench.cc)
 
 PROTOS += $(addprefix $(d), indicus-proto.proto)
 
@@ -10,7 +11,7 @@ LIB-indicus-store := $(o)server.o $(LIB-latency) \
 	$(o)indicus-proto.o  $(o)common.o $(LIB-crypto) $(LIB-batched-sigs) $(LIB-bft-tapir-config) \
 	$(LIB-configuration) $(LIB-store-common) $(LIB-transport) $(o)phase1validator.o \
 	$(o)localbatchsigner.o $(o)sharedbatchsigner.o $(o)basicverifier.o \
-	$(o)localbatchverifier.o $(o)sharedbatchverifier.o
+	$(o)localbatchverifier.o $(o)sharedbatchverifier.o $(o)preparedreadindex.o
 
 LIB-indicus-client := $(LIB-udptransport) \
 	$(LIB-store-frontend) $(LIB-store-common) $(o)indicus-proto.o \
@@ -23,6 +24,12 @@ LIB-proto := $(o)indicus-proto.o
 #-I/home/floriansuri/Indicus/BFT-DB/src/store/common
 $(d)proto_bench: $(LIB-latency) $(LIB-crypto) $(LIB-batched-sigs) $(LIB-store-common) $(LIB-proto) $(o)proto_bench.o
 
-BINS += $(d)proto_bench
+$(d)batchframe_bench: $(LIB-latency) $(LIB-tcptransport) $(LIB-store-common) $(LIB-proto) $(o)batchframe_bench.o
+
+$(d)writeback_bench: $(LIB-latency) $(LIB-store-common) $(LIB-store-backend) $(o)writeback_bench.o
+
+$(d)preparedreads_bench: $(LIB-latency) $(LIB-store-common) $(LIB-proto) $(o)preparedreadindex.o $(o)preparedreads_bench.o
+
+BINS += $(d)proto_bench $(d)batchframe_bench $(d)writeback_bench $(d)preparedreads_bench
 
 include $(d)tests/Rules.mk
@@ -0,0 +1,197 @@
+/***********************************************************************
+ *
+ * Copyright 2021 Florian Suri-Payer <fsp@cs.cornell.edu>
+ *                Matthew Burke <matthelb@cs.cornell.edu>
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ **********************************************************************/
+#include "lib/latency.h"
+#include "lib/frame.h"
+#include "lib/message.h"
+#include "lib/tcptransport.h"
+#include "store/indicusstore/indicus-proto.pb.h"
+#include "store/common/common-proto.pb.h"
+
+#include <event2/buffer.h>
+#include <gflags/gflags.h>
+
+#include <cstring>
+#include <deque>
+#include <random>
+
+DEFINE_uint64(batch_size, 16, "number of messages per batch.");
+DEFINE_uint64(read_set_size, 10, "number of keys in the read/write set of each Phase1.");
+DEFINE_uint64(key_size, 64, "size of each key/value in bytes.");
+DEFINE_uint64(p1_ratio, 2, "one in every p1_ratio messages of a batch is a Phase1, the rest are Reads.");
+DEFINE_uint64(iterations, 1000, "number of iterations to measure.");
+
+const uint32_t MAGIC = 0x06121983;
+
+void GenerateRandomString(uint64_t size, std::random_device &rd, std::string &s) {
+  s.clear();
+  for (uint64_t i = 0; i < size; ++i) {
+    s.push_back(static_cast<char>(rd()));
+  }
+}
+
+// Previous batch format: every message serialized twice and padded to the
+// size of the largest message in the batch.
+size_t EncodePaddedBatch(struct evbuffer *out,
+    const std::vector<::google::protobuf::Message *> &m_list) {
+  size_t maxTotalLen = 0;
+  size_t maxDataLen = 0;
+  for (auto m : m_list) {
+    std::string data;
+    m->SerializeToString(&data);
+    size_t typeLen = m->GetTypeName().length();
+    maxDataLen = std::max(maxDataLen, data.length());
+    maxTotalLen = std::max(maxTotalLen, typeLen + sizeof(typeLen) +
+        data.length() + sizeof(size_t) + sizeof(size_t) + sizeof(uint32_t));
+  }
+  std::vector<char> buf_batch(m_list.size() * maxTotalLen, ' ');
+  for (size_t i = 0; i < m_list.size(); ++i) {
+    std::string data;
+    m_list[i]->SerializeToString(&data);
+    std::string type = m_list[i]->GetTypeName();
+    size_t typeLen = type.length();
+    char *ptr = &buf_batch[i * maxTotalLen];
+    *((uint32_t *) ptr) = MAGIC;
+    ptr += sizeof(uint32_t);
+    *((size_t *) ptr) = maxTotalLen;
+    ptr += sizeof(size_t);
+    *((size_t *) ptr) = typeLen;
+    ptr += sizeof(size_t);
+    memcpy(ptr, type.c_str(), typeLen);
+    ptr += typeLen;
+    *((size_t *) ptr) = maxDataLen;
+    ptr += sizeof(size_t);
+    memcpy(ptr, data.c_str(), data.length());
+  }
+  evbuffer_add(out, buf_batch.data(), buf_batch.size());
+  return buf_batch.size();
+}
+
+// Removes one complete frame from in and copies its messages to
+// types/datas. Returns false, consuming nothing, if no complete and
+// well-formed frame is buffered.
+static bool DecodeFrame(struct evbuffer *in, std::vector<std::string> &types,
+    std::vector<std::string> &datas) {
+  std::vector<std::string_view> typeViews;
+  std::vector<MessageView> dataViews;
+  std::deque<std::string> scratch;
+  size_t frameLen;
+  if (ParseFrame(in, 0, frameLen, typeViews, dataViews, scratch) != FRAME_OK) {
+    return false;
+  }
+  for (size_t i = 0; i < typeViews.size(); ++i) {
+    types.emplace_back(typeViews[i]);
+    datas.emplace_back(dataViews[i].ToString());
+  }
+  evbuffer_drain(in, frameLen);
+  return true;
+}
+
+int main(int argc, char *argv[]) {
+  gflags::SetUsageMessage("benchmark TCPTransport batch framing.");
+	gflags::ParseCommandLineFlags(&argc, &argv, true);
+
+  std::random_device rd;
+
+  struct Latency_t paddedLat;
+  struct Latency_t varLat;
+  _Latency_Init(&paddedLat, "encode_padded");
+  _Latency_Init(&varLat, "encode_varlen");
+
+  std::vector<::google::protobuf::Message *> batch;
+  for (uint64_t i = 0; i < FLAGS_batch_size; ++i) {
+    std::string s;
+    GenerateRandomString(FLAGS_key_size, rd, s);
+    if (FLAGS_p1_ratio > 0 && i % FLAGS_p1_ratio == 0) {
+      indicusstore::proto::Phase1 *p1 = new indicusstore::proto::Phase1();
+      p1->set_req_id(i);
+      indicusstore::proto::Transaction *txn = p1->mutable_txn();
+      txn->set_client_id(0);
+      txn->set_client_seq_num(i);
+      txn->add_involved_groups(0);
+      txn->mutable_timestamp()->set_id(0);
+      txn->mutable_timestamp()->set_timestamp(i);
+      for (uint64_t j = 0; j < FLAGS_read_set_size; ++j) {
+        ReadMessage *read = txn->add_read_set();
+        read->set_key(s);
+        read->mutable_readtime()->set_id(0);
+        read->mutable_readtime()->set_timestamp(j);
+        WriteMessage *write = txn->add_write_set();
+        write->set_key(s);
+        write->set_value(s);
+      }
+      batch.push_back(p1);
+    } else {
+      indicusstore::proto::Read *read = new indicusstore::proto::Read();
+      read->set_req_id(i);
+      read->set_key(s);
+      read->mutable_timestamp()->set_id(0);
+      read->mutable_timestamp()->set_timestamp(i);
+      batch.push_back(read);
+    }
+  }
+
+  Notice("===================================");
+  Notice("Running batch framing bench for %lu iterations with batch size %lu.",
+      FLAGS_iterations, FLAGS_batch_size);
+
+  struct evbuffer *out = evbuffer_new();
+  uint64_t paddedBytes = 0;
+  uint64_t varBytes = 0;
+  uint64_t paddedNs = 0;
+  uint64_t varNs = 0;
+  for (uint64_t i = 0; i < FLAGS_iterations; ++i) {
+    Latency_Start(&paddedLat);
+    paddedBytes += EncodePaddedBatch(out, batch);
+    paddedNs += Latency_End(&paddedLat);
+    evbuffer_drain(out, evbuffer_get_length(out));
+
+    Latency_Start(&varLat);
+    varBytes += TCPTransport::EncodeBatchFrame(out, batch);
+    varNs += Latency_End(&varLat);
+
+    std::vector<std::string> types;
+    std::vector<std::string> datas;
+    UW_ASSERT(DecodeFrame(out, types, datas));
+    UW_ASSERT(types.size() == batch.size());
+  }
+  evbuffer_free(out);
+
+  uint64_t msgs = FLAGS_iterations * FLAGS_batch_size;
+  Notice("padded: %lu bytes/batch, %lu ns/message.",
+      paddedBytes / FLAGS_iterations, paddedNs / msgs);
+  Notice("varlen: %lu bytes/batch, %lu ns/message.",
+      varBytes / FLAGS_iterations, varNs / msgs);
+
+  Latency_Dump(&paddedLat);
+  Latency_Dump(&varLat);
+  Notice("===================================");
+
+  for (auto m : batch) {
+    delete m;
+  }
+  return 0;
+}
@@ -40,18 +40,28 @@
 #include "store/indicusstore/indicus-proto.pb.h"
 #include "store/indicusstore/common.h"
 #include "store/common/stats.h"
+#include "store/common/batchcontroller.h"
 #include "lib/latency.h"
 
+#include <memory>
+
 namespace indicusstore {
 
 class BatchSigner {
  public:
   BatchSigner(Transport *transport, KeyManager *keyManager, Stats &stats,
       uint64_t batchTimeoutMicro, uint64_t batchSize, uint64_t id,
-      bool adjustBatchSize, uint64_t merkleBranchFactor) : transport(transport), keyManager(keyManager),
+      bool adjustBatchSize, uint64_t merkleBranchFactor,
+      const BatchControllerConfig &batchControl = BatchControllerConfig()) :
+      transport(transport), keyManager(keyManager),
       stats(stats), batchTimeoutMicro(batchTimeoutMicro),
       initialBatchSize(batchSize), id(id), adjustBatchSize(adjustBatchSize),
-      merkleBranchFactor(merkleBranchFactor) { }
+      merkleBranchFactor(merkleBranchFactor) {
+    if (adjustBatchSize) {
+      controller.reset(new BatchController("sig_batch", stats, batchControl,
+          batchSize, batchTimeoutMicro));
+    }
+  }
   virtual ~BatchSigner() { }
 
   virtual void MessageToSign(::google::protobuf::Message* msg,
@@ -74,6 +84,15 @@ class BatchSigner {
   const uint64_t id;
   const bool adjustBatchSize;
   const uint64_t merkleBranchFactor;
+  // Only set if adjustBatchSize.
+  std::unique_ptr<BatchController> controller;
+
+  inline uint64_t BatchSize() const {
+    return controller ? controller->BatchSize() : initialBatchSize;
+  }
+  inline uint64_t BatchTimeoutMicro() const {
+    return controller ? controller->TimeoutMicro() : batchTimeoutMicro;
+  }
 
 
 
@@ -127,7 +127,7 @@ void Client::Begin(begin_callback bcb, begin_timeout_callback btcb,
     }
     if(failureActive) stats.Increment("failure_attempts", 1);
     if(failureEnabled) stats.Increment("total_fresh_tx_byz", 1);
-    if(!failureEnabled) stats.Increment("total_fresh_tx_honest", 1);
+    if(!failureEnabled) stats.Increment(STAT_TOTAL_FRESH_TX_HONEST, 1);
 
   }
 
@@ -173,7 +173,7 @@ void Client::Begin_batch(begin_callback_batch bcb, begin_timeout_callback btcb,
     }
     if(failureActive) stats.Increment("failure_attempts", 1);
     if(failureEnabled) stats.Increment("total_fresh_tx_byz", 1);
-    if(!failureEnabled) stats.Increment("total_fresh_tx_honest", 1);
+    if(!failureEnabled) stats.Increment(STAT_TOTAL_FRESH_TX_HONEST, 1);
 
   }
 
@@ -209,6 +209,7 @@ void Client::Get(const std::string &key, get_callback gcb,
   
   transport->Timer(0, [this, key, gcb, gtcb, timeout]() {
     // Latency_Start(&getLatency);
+    uint64_t getStart = Stats::NowNs();
     Debug("GET[%lu:%lu] for key %s", client_id, client_seq_num,
         BytesToHex(key, 16).c_str());
 
@@ -221,13 +222,14 @@ void Client::Get(const std::string &key, get_callback gcb,
       bclient[i]->Begin(client_seq_num);
     }
     //rcb関数を作っている
-    read_callback rcb = [gcb, this](int status, const std::string &key,
+    read_callback rcb = [gcb, getStart, this](int status, const std::string &key,
         const std::string &val, const Timestamp &ts, const proto::Dependency &dep,
         bool hasDep, bool addReadSet) {
       
       Debug("read_callback is called");
 
-      uint64_t ns = 0; //Latency_End(&getLatency);
+      uint64_t ns = Stats::NowNs() - getStart; //Latency_End(&getLatency);
+      stats.Record("lat_get", ns);
       if (Message_DebugEnabled(__FILE__)) {
         Debug("GET[%lu:%lu] Callback for key %s with %lu bytes and ts %lu.%lu after %luus.",
             client_id, client_seq_num, BytesToHex(key, 16).c_str(), val.length(),
@@ -341,7 +343,7 @@ void Client::Phase1(PendingRequest *req) {
   //schedule timeout for when we allow starting FB P1.
   transport->Timer(params.relayP1_timeout, [this, reqId = req->id](){RelayP1TimeoutCallback(reqId);});
 
-  if(!failureEnabled) stats.Increment("total_honest_p1_started", 1);
+  if(!failureEnabled) stats.Increment(STAT_TOTAL_HONEST_P1_STARTED, 1);
 
   //FAIL right after sending P1
 
@@ -454,8 +456,8 @@ void Client::Phase1Callback(uint64_t txnId, int group,
 
   //total_counter++;
   //if(fast) fast_path_counter++;
-  stats.Increment("total_prepares", 1);
-  if(fast) stats.Increment("total_prepares_fast", 1);
+  stats.Increment(STAT_TOTAL_PREPARES, 1);
+  if(fast) stats.Increment(STAT_TOTAL_PREPARES_FAST, 1);
 
   Debug("PHASE1[%lu:%lu] callback decision %d [Fast:%s][Conflict:%s] from group %d", client_id,
       client_seq_num, decision, fast ? "yes" : "no", conflict_flag ? "yes" : "no", group);
@@ -514,6 +516,9 @@ void Client::Phase1TimeoutCallback(int group, uint64_t txnId, int status) {
 
 void Client::HandleAllPhase1Received(PendingRequest *req) {
   Debug("All PHASE1's [%lu] received", client_seq_num);
+  uint64_t now = Stats::NowNs();
+  stats.Record("lat_p1", now - req->phaseStartNs);
+  req->phaseStartNs = now;
 
   //NOTE: Forcefully imulated failures, even if according to protocol logic it is not possible:
   if(failureActive && params.injectFailure.type == InjectFailureType::CLIENT_EQUIVOCATE_SIMULATE
@@ -744,6 +749,11 @@ void Client::Writeback(PendingRequest *req) {
   //total_writebacks++;
   Debug("WRITEBACK[%lu:%lu] result %s", client_id, req->id, req->decision ?  "ABORT" : "COMMIT");
   req->startedWriteback = true;
+  uint64_t now = Stats::NowNs();
+  if (req->startedPhase2) {
+    stats.Record("lat_p2", now - req->phaseStartNs);
+  }
+  stats.Record("lat_commit", now - req->startNs);
 
   if (failureActive && params.injectFailure.type == InjectFailureType::CLIENT_STALL_AFTER_P1) {
     Debug("INJECT CRASH FAILURE[%lu:%lu] with decision %d. txnDigest: %s", client_id, req->id, req->decision,
@@ -795,7 +805,7 @@ void Client::Writeback(PendingRequest *req) {
       result = ABORTED_USER;
     }
     else if(!failureEnabled && result == COMMITTED){
-      stats.Increment("total_commit_honest", 1);
+      stats.Increment(STAT_TOTAL_COMMIT_HONEST, 1);
     }
     if(failureEnabled && result == ABORTED_SYSTEM){ //--> breaks overall tput???
       stats.Increment("total_abort_byz", 1);
@@ -803,7 +813,7 @@ void Client::Writeback(PendingRequest *req) {
       //result = ABORTED_USER;
     }
     else if(!failureEnabled && result == ABORTED_SYSTEM){ //--> breaks overall tput???
-      stats.Increment("total_abort_honest", 1);
+      stats.Increment(STAT_TOTAL_ABORT_HONEST, 1);
       //result = ABORTED_USER;
     }
 
@@ -1197,6 +1207,7 @@ void Client::WritebackFBcallback(uint64_t conflict_id, std::string txnDigest, pr
   if(pendingFB->startedWriteback) return;
   pendingFB->startedWriteback = true;
 
+  stats.Record("lat_fallback", Stats::NowNs() - pendingFB->startNs);
   Debug("Forwarding WritebackFB fast for txn: %s",BytesToHex(txnDigest, 16).c_str());
   //TODO: Need to validate WB message:
   // 1) check that txnDigest matches txn content
@@ -1348,6 +1359,7 @@ void Client::WritebackFB(PendingRequest *req){
   Debug("WRITEBACKFB[%lu:%s] result: %s", client_id, BytesToHex(req->txnDigest, 16).c_str(), req->decision ? "ABORT" : "COMMIT");
 
   req->startedWriteback = true;
+  stats.Record("lat_fallback", Stats::NowNs() - req->startNs);
   WritebackProcessing(req);
 
   for (auto group : req->txn.involved_groups()) {
@@ -113,7 +113,8 @@ class Client : public ::Client {
         decision(proto::COMMIT), fast(true), conflict_flag(false),
         startedPhase2(false), startedWriteback(false),
         callbackInvoked(false), timeout(0UL), slowAbortGroup(-1),
-        decision_view(0UL), startFB(false), eqv_ready(false), client(client) {
+        decision_view(0UL), startFB(false), eqv_ready(false), client(client),
+        startNs(Stats::NowNs()), phaseStartNs(startNs) {
     }
 
     ~PendingRequest() {
@@ -146,6 +147,9 @@ class Client : public ::Client {
     proto::GroupedSignatures p1ReplySigsGrouped;
     proto::GroupedSignatures p2ReplySigsGrouped;
     std::string txnDigest;
+    // for the per-phase latency histograms
+    uint64_t startNs;
+    uint64_t phaseStartNs;
     int slowAbortGroup;
     int fastAbortGroup;
     proto::CommittedProof conflict;
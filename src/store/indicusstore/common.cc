@@ -38,6 +38,7 @@
 
 
 #include "lib/batched_sigs.h"
+#include "lib/objectpool.h"
 
 namespace indicusstore {
 
@@ -50,22 +51,13 @@ void* BoolPointerWrapper(std::function<bool()> func){
     }
   }
 //
+static ObjectPool<std::string> MessageStrings;
+
 std::string* GetUnusedMessageString(){
-    std::unique_lock<std::mutex> lock(msgStr_mutex);
-    std::string* msg;
-    if(MessageStrings.size() > 0){
-      msg = MessageStrings.back();
-      MessageStrings.pop_back();
-    }
-    else{
-      msg = new string();
-    }
-    return msg;
+  return MessageStrings.Get();
 }
 void FreeMessageString(std::string *msg){
-  std::unique_lock<std::mutex> lock(msgStr_mutex);
-  msg->clear();
-  MessageStrings.push_back(msg);
+  MessageStrings.Put(msg);
 }
 
 void SignMessage(::google::protobuf::Message* msg,
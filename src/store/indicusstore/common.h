@@ -45,6 +45,7 @@
 #include <google/protobuf/message.h>
 
 #include "store/common/stats.h"
+#include "store/common/batchcontroller.h"
 
 namespace indicusstore {
 
@@ -74,8 +75,6 @@ struct Triplet {
 //static bool True = true;
 //static bool False = false;
 
-static std::vector<std::string*> MessageStrings;
-static std::mutex msgStr_mutex;
 std::string* GetUnusedMessageString();
 void FreeMessageString(std::string *str);
 
@@ -402,7 +401,12 @@ typedef struct Parameters {
   const uint64_t numKeys;
   const double zipfCoefficient;
   const bool signatureBatch;
-  
+  // Period of the multi-version garbage collector; 0 disables it.
+  const uint64_t gcIntervalMS;
+  // MAC used for all-to-all replica messages.
+  const crypto::HMACType hmacType;
+  // Bounds of the signature batch size and timeout if adjustBatchSize.
+  const BatchControllerConfig sigBatchControl;
 
   Parameters(bool signedMessages, bool validateProofs, bool hashDigest, bool verifyDeps,
     int signatureBatchSize, int64_t maxDepDepth, uint64_t readDepSize,
@@ -419,7 +423,9 @@ typedef struct Parameters {
     bool replicaGossip,
     bool batchOptimization, uint64_t batchSize,
     uint64_t numOps, uint64_t numKeys, double zipfCoefficient,
-    bool signatureBatch) :
+    bool signatureBatch, uint64_t gcIntervalMS = 0,
+    crypto::HMACType hmacType = crypto::HMAC_SHA256,
+    const BatchControllerConfig &sigBatchControl = BatchControllerConfig()) :
     signedMessages(signedMessages), validateProofs(validateProofs),
     hashDigest(hashDigest), verifyDeps(verifyDeps), signatureBatchSize(signatureBatchSize),
     maxDepDepth(maxDepDepth), readDepSize(readDepSize),
@@ -439,7 +445,8 @@ typedef struct Parameters {
     replicaGossip(replicaGossip),
     batchOptimization(batchOptimization), batchSize(batchSize),
     numOps(numOps), numKeys(numKeys), zipfCoefficient(zipfCoefficient),
-    signatureBatch(signatureBatch){ }
+    signatureBatch(signatureBatch), gcIntervalMS(gcIntervalMS),
+    hmacType(hmacType), sigBatchControl(sigBatchControl) { }
 } Parameters;
 
 } // namespace indicusstore
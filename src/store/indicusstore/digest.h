@@ -0,0 +1,123 @@
+/***********************************************************************
+ *
+ * Copyright 2021 Florian Suri-Payer <fsp@cs.cornell.edu>
+ *                Matthew Burke <matthelb@cs.cornell.edu>
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ **********************************************************************/
+#ifndef DIGEST_H
+#define DIGEST_H
+
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <string>
+
+#include "lib/blake3.h"
+
+namespace indicusstore {
+
+// A transaction digest held inline. Digests produced by TransactionDigest
+// are 32 byte BLAKE3 outputs, or 16 bytes (client id, sequence number) without
+// hashDigest; the genesis proof uses the empty digest. Since the bytes are
+// already uniformly distributed (or nearly so), hashing only folds the four
+// 8 byte words instead of running a string hash over the bytes.
+//
+// Digests convert implicitly from std::string, so maps keyed by Digest can be
+// queried with the digests carried in messages. Strings longer than MAX_SIZE
+// (never produced by TransactionDigest, but possible in Byzantine messages)
+// are replaced by their BLAKE3 hash and marked, so they never equal a genuine
+// digest and two of them only collide if their hashes do.
+class Digest {
+ public:
+  static const size_t MAX_SIZE = 32;
+
+  Digest() : len(0) {
+    std::memset(bytes, 0, sizeof(bytes));
+  }
+  Digest(const char *data, size_t size) {
+    std::memset(bytes, 0, sizeof(bytes));
+    if (size > MAX_SIZE) {
+      blake3_hasher hasher;
+      blake3_hasher_init(&hasher);
+      blake3_hasher_update(&hasher, data, size);
+      blake3_hasher_finalize(&hasher, reinterpret_cast<uint8_t *>(bytes),
+          MAX_SIZE);
+      len = OVERLONG;
+    } else {
+      std::memcpy(bytes, data, size);
+      len = size;
+    }
+  }
+  Digest(const std::string &s) : Digest(s.data(), s.size()) { }
+  Digest(const char *s) : Digest(s, std::strlen(s)) { }
+
+  inline const char *data() const { return bytes; }
+  inline size_t size() const { return len == OVERLONG ? MAX_SIZE : len; }
+  inline std::string str() const { return std::string(bytes, size()); }
+  inline operator std::string() const { return str(); }
+
+  inline size_t hash() const {
+    // Without hashDigest the first word is the client id and the second the
+    // sequence number, so both must contribute.
+    uint64_t w[MAX_SIZE / sizeof(uint64_t)];
+    std::memcpy(w, bytes, sizeof(w));
+    uint64_t h = w[0] ^ (w[1] * 0x9e3779b97f4a7c15ULL) ^
+        (w[2] * 0x94d049bb133111ebULL) ^ (w[3] * 0xc2b2ae3d27d4eb4fULL) ^ len;
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    return static_cast<size_t>(h);
+  }
+
+  inline bool operator==(const Digest &other) const {
+    return len == other.len && std::memcmp(bytes, other.bytes, MAX_SIZE) == 0;
+  }
+  inline bool operator!=(const Digest &other) const {
+    return !(*this == other);
+  }
+  inline bool operator<(const Digest &other) const {
+    int c = std::memcmp(bytes, other.bytes, MAX_SIZE);
+    return c < 0 || (c == 0 && len < other.len);
+  }
+
+ private:
+  static const uint8_t OVERLONG = MAX_SIZE + 1;
+
+  char bytes[MAX_SIZE];
+  uint8_t len;
+};
+
+// HashCompare for tbb::concurrent_hash_map.
+struct DigestHashCompare {
+  static size_t hash(const Digest &d) { return d.hash(); }
+  static bool equal(const Digest &a, const Digest &b) { return a == b; }
+};
+
+// Hasher for std:: and tbb::concurrent_unordered containers.
+struct DigestHasher {
+  size_t operator()(const Digest &d) const { return d.hash(); }
+};
+
+} // namespace indicusstore
+
+#endif /* DIGEST_H */
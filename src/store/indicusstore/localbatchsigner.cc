@@ -32,15 +32,12 @@ namespace indicusstore {
 
 LocalBatchSigner::LocalBatchSigner(Transport *transport, KeyManager *keyManager, Stats &stats,
     uint64_t batchTimeoutMicro, uint64_t batchSize, uint64_t id,
-    bool adjustBatchSize, uint64_t merkleBranchFactor) : BatchSigner(transport, keyManager, stats,
-      batchTimeoutMicro, batchSize, id, adjustBatchSize, merkleBranchFactor),
+    bool adjustBatchSize, uint64_t merkleBranchFactor,
+    const BatchControllerConfig &batchControl) : BatchSigner(transport, keyManager, stats,
+      batchTimeoutMicro, batchSize, id, adjustBatchSize, merkleBranchFactor, batchControl),
     batchTimerRunning(false),
-    batchSize(batchSize),
-    messagesBatchedInterval(0UL) {
-  if (adjustBatchSize) {
-    transport->TimerMicro(batchTimeoutMicro, std::bind(
-        &LocalBatchSigner::AdjustBatchSize, this));
-  }
+    batchStartUs(0UL),
+    asyncBatchStartUs(0UL) {
   pendingBatchMessages.reserve(batchSize);
   pendingBatchSignedMessages.reserve(batchSize);
   pendingBatchCallbacks.reserve(batchSize);
@@ -62,12 +59,15 @@ void LocalBatchSigner::MessageToSign(::google::protobuf::Message* msg,
         signedMessage);
     cb();
   } else {
-    messagesBatchedInterval++;
+    if (controller) {
+      controller->Arrival();
+      if (pendingBatchMessages.empty()) batchStartUs = BatchController::NowUs();
+    }
     pendingBatchMessages.push_back(msg);
     pendingBatchSignedMessages.push_back(signedMessage);
     pendingBatchCallbacks.push_back(std::move(cb));
 
-    if (finishBatch || pendingBatchMessages.size() >= batchSize) {
+    if (finishBatch || pendingBatchMessages.size() >= BatchSize()) {
       Debug("Batch is full, sending");
       if (batchTimerRunning) {
         transport->CancelTimer(batchTimerId);
@@ -77,7 +77,7 @@ void LocalBatchSigner::MessageToSign(::google::protobuf::Message* msg,
     } else if (!batchTimerRunning) {
       batchTimerRunning = true;
       Debug("Starting batch timer");
-      batchTimerId = transport->TimerMicro(batchTimeoutMicro, [this]() {
+      batchTimerId = transport->TimerMicro(BatchTimeoutMicro(), [this]() {
         std::unique_lock<std::mutex> lock(this->batchMutex);
         if(this->pendingBatchMessages.size() == 0) return;
         Debug("Batch timer expired with %lu items, sending",
@@ -98,8 +98,14 @@ void LocalBatchSigner::SignBatch() {
   gettimeofday(&curr, NULL);
   uint64_t currMicros = curr.tv_sec * 1000000ULL + curr.tv_usec;
   //stats.Add("sig_batch_sizes_ts",  currMicros);
+  if (controller) {
+    controller->Flush(batchSize, BatchController::NowUs() - batchStartUs);
+  }
   SignMessages(pendingBatchMessages, keyManager->GetPrivateKey(id), id,
     pendingBatchSignedMessages, merkleBranchFactor);
+  if (controller) {
+    controller->Complete(batchSize, BatchController::NowUs() - batchStartUs);
+  }
   pendingBatchMessages.clear();
   pendingBatchSignedMessages.clear();
   for (const auto& cb : pendingBatchCallbacks) {
@@ -108,12 +114,6 @@ void LocalBatchSigner::SignBatch() {
   pendingBatchCallbacks.clear();
 }
 
-void LocalBatchSigner::AdjustBatchSize() {
-  batchSize = (0.75 * batchSize) + (0.25 * messagesBatchedInterval);
-  messagesBatchedInterval = 0;
-  transport->TimerMicro(batchTimeoutMicro, std::bind(&LocalBatchSigner::AdjustBatchSize,
-        this));
-}
 
 
 
@@ -233,14 +233,18 @@ void LocalBatchSigner::asyncMessageToSign(::google::protobuf::Message* msg,
   } else {
     //std::unique_lock<std::mutex> lock(batchMutex);
     Debug("Adding to Sig batch");
-    messagesBatchedInterval++;
+    if (controller) {
+      controller->Arrival();
+      uint64_t noStart = 0UL;
+      asyncBatchStartUs.compare_exchange_strong(noStart, BatchController::NowUs());
+    }
 
     Triplet triplet(msg, signedMessage, std::move(cb));
     //Batch.push_back(std::move(triplet));
     Batch.enqueue(triplet);
 
 
-    if (finishBatch || Batch.size_approx() >= batchSize) {
+    if (finishBatch || Batch.size_approx() >= BatchSize()) {
       Debug("Batch is full, sending");
       if (batchTimerRunning && false) {
         transport->CancelTimer(batchTimerId);
@@ -263,7 +267,7 @@ void LocalBatchSigner::asyncMessageToSign(::google::protobuf::Message* msg,
        Panic("Caught exception");
       }
       std::function<void*()> f(std::bind(&LocalBatchSigner::asyncSignBatch2, this,
-        std::move(results))); //can I move results?
+        std::move(results), asyncBatchStartUs.exchange(0UL))); //can I move results?
 
       //Batch.clear();
 
@@ -278,7 +282,7 @@ void LocalBatchSigner::asyncMessageToSign(::google::protobuf::Message* msg,
           Debug("Starting batch timer");
 
           //batchTimerId = transport->TimerMicro(batchTimeoutMicro, [this]() { //XXX: only need ID if we cancel them.
-          transport->TimerMicro(batchTimeoutMicro, [this]() {
+          transport->TimerMicro(BatchTimeoutMicro(), [this]() {
             //std::unique_lock<std::mutex> lock(this->batchMutex);
 
             this->batchTimerRunning = false;
@@ -295,7 +299,7 @@ void LocalBatchSigner::asyncMessageToSign(::google::protobuf::Message* msg,
             results.resize(count);
             //std::vector<Triplet> _batch(results.begin(), results.end());
             std::function<void*()> f(std::bind(&LocalBatchSigner::asyncSignBatch2, this,
-              std::move(results)));
+              std::move(results), this->asyncBatchStartUs.exchange(0UL)));
 
             Debug("Batch timer expired with %lu items; Dispatching Batch to sign.", count);
             //this->Batch.clear();
@@ -311,7 +315,7 @@ void LocalBatchSigner::asyncMessageToSign(::google::protobuf::Message* msg,
 
 //Change: main thread assembles batches. Then dispatches the batches:
 // managecallback takes as arg the callback list runs those callbacks.
-void* LocalBatchSigner::asyncSignBatch2(std::vector<Triplet> _Batch) {
+void* LocalBatchSigner::asyncSignBatch2(std::vector<Triplet> _Batch, uint64_t batchStartUs) {
 
   uint64_t batchSize = _Batch.size();
   {
@@ -324,7 +328,15 @@ void* LocalBatchSigner::asyncSignBatch2(std::vector<Triplet> _Batch) {
     //stats.Add("sig_batch_sizes_ts",  currMicros);
   }
   Debug("(CPU:%d) Signing batch", sched_getcpu());
+  // batchStartUs is 0 if a concurrent flush already took the batch start.
+  bool report = controller && batchStartUs > 0;
+  if (report) {
+    controller->Flush(batchSize, BatchController::NowUs() - batchStartUs);
+  }
   SignMessages(_Batch, keyManager->GetPrivateKey(id), id, merkleBranchFactor);
+  if (report) {
+    controller->Complete(batchSize, BatchController::NowUs() - batchStartUs);
+  }
 
   Debug("(CPU:%d) Issuing sender callbacks", sched_getcpu());
   for (const auto& triplet : _Batch) {
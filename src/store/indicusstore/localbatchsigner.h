@@ -51,7 +51,8 @@ class LocalBatchSigner : public BatchSigner {
  public:
   LocalBatchSigner(Transport *transport, KeyManager *keyManager, Stats &stats,
       uint64_t batchTimeoutMicro, uint64_t batchSize, uint64_t id,
-      bool adjustBatchSize, uint64_t merkleBranchFactor);
+      bool adjustBatchSize, uint64_t merkleBranchFactor,
+      const BatchControllerConfig &batchControl = BatchControllerConfig());
   virtual ~LocalBatchSigner();
 
   virtual void MessageToSign(::google::protobuf::Message* msg,
@@ -66,18 +67,18 @@ class LocalBatchSigner : public BatchSigner {
 
  private:
   void SignBatch();
-  void AdjustBatchSize();
   void* asyncSignBatch(std::vector<::google::protobuf::Message*> pendingBatchMessages,
           std::vector<proto::SignedMessage*> pendingBatchSignedMessages,
           std::vector<signedCallback> pendingBatchCallbacks);
 
-          void* asyncSignBatch2(std::vector<Triplet> _Batch);
+          void* asyncSignBatch2(std::vector<Triplet> _Batch, uint64_t batchStartUs);
 
   void ManageCallbacks(void* result);
 
   std::atomic_bool batchTimerRunning;
-  uint64_t batchSize;
-  std::atomic_uint64_t messagesBatchedInterval;
+  // Arrival time of the oldest pending message, for the batch controller.
+  uint64_t batchStartUs;
+  std::atomic_uint64_t asyncBatchStartUs;
 
   int batchTimerId;
   std::vector<::google::protobuf::Message*> pendingBatchMessages;
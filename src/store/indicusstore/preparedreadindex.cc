@@ -0,0 +1,88 @@
+/***********************************************************************
+ *
+ * Copyright 2021 Florian Suri-Payer <fsp@cs.cornell.edu>
+ *                Matthew Burke <matthelb@cs.cornell.edu>
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ **********************************************************************/
+#include "store/indicusstore/preparedreadindex.h"
+
+namespace indicusstore {
+
+PreparedReadIndex::PreparedReadIndex() {
+}
+
+PreparedReadIndex::~PreparedReadIndex() {
+}
+
+void PreparedReadIndex::Insert(const Timestamp &txnTs, const Timestamp &readTs,
+    const proto::Transaction *txn) {
+  auto range = readers.equal_range(txnTs);
+  for (auto itr = range.first; itr != range.second; ++itr) {
+    if (itr->second.txn == txn) {
+      return;
+    }
+  }
+
+  Reader reader;
+  reader.readTs = readTs;
+  reader.txn = txn;
+  reader.deps.reserve(txn->deps_size());
+  for (const auto &dep : txn->deps()) {
+    reader.deps.push_back(dep.write().prepared_txn_digest());
+  }
+  readers.emplace_hint(range.second, txnTs, std::move(reader));
+}
+
+void PreparedReadIndex::Erase(const Timestamp &txnTs,
+    const proto::Transaction *txn) {
+  auto range = readers.equal_range(txnTs);
+  for (auto itr = range.first; itr != range.second;) {
+    if (itr->second.txn == txn) {
+      itr = readers.erase(itr);
+    } else {
+      ++itr;
+    }
+  }
+}
+
+PreparedReadIndex::ReaderMap::const_iterator PreparedReadIndex::FindConflict(
+    const Timestamp &ts, const std::string &writerDigest) const {
+  for (auto itr = readers.upper_bound(ts); itr != readers.end(); ++itr) {
+    if (!(itr->second.readTs < ts)) {
+      continue;
+    }
+    bool isDep = false;
+    for (const auto &dep : itr->second.deps) {
+      if (dep == writerDigest) {
+        isDep = true;
+        break;
+      }
+    }
+    if (!isDep) {
+      return itr;
+    }
+  }
+  return readers.end();
+}
+
+} // namespace indicusstore
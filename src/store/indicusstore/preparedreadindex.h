@@ -0,0 +1,77 @@
+/***********************************************************************
+ *
+ * Copyright 2021 Florian Suri-Payer <fsp@cs.cornell.edu>
+ *                Matthew Burke <matthelb@cs.cornell.edu>
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ **********************************************************************/
+#ifndef PREPARED_READ_INDEX_H
+#define PREPARED_READ_INDEX_H
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "store/common/timestamp.h"
+#include "store/indicusstore/indicus-proto.pb.h"
+
+namespace indicusstore {
+
+// Prepared transactions that read a single key, ordered by the reader's
+// transaction timestamp. Each entry caches the version the reader observed
+// and the digests it depends on, so a write check is a range query over the
+// readers with a later timestamp instead of a scan over every reader's deps
+// and read set.
+class PreparedReadIndex {
+ public:
+  struct Reader {
+    Timestamp readTs;
+    const proto::Transaction *txn;
+    std::vector<std::string> deps;
+  };
+  typedef std::multimap<Timestamp, Reader> ReaderMap;
+
+  PreparedReadIndex();
+  ~PreparedReadIndex();
+
+  // Adds txn as a reader of version readTs. A txn is indexed at most once.
+  void Insert(const Timestamp &txnTs, const Timestamp &readTs,
+      const proto::Transaction *txn);
+  void Erase(const Timestamp &txnTs, const proto::Transaction *txn);
+
+  // Returns the first reader that a write at ts would invalidate: one that
+  // read a version older than ts, has a timestamp newer than ts, and does not
+  // depend on writerDigest. Returns end() if there is none.
+  ReaderMap::const_iterator FindConflict(const Timestamp &ts,
+      const std::string &writerDigest) const;
+
+  inline ReaderMap::const_iterator end() const { return readers.end(); }
+  inline bool empty() const { return readers.empty(); }
+  inline size_t size() const { return readers.size(); }
+
+ private:
+  ReaderMap readers;
+};
+
+} // namespace indicusstore
+
+#endif /* PREPARED_READ_INDEX_H */
@@ -0,0 +1,185 @@
+/***********************************************************************
+ *
+ * Copyright 2021 Florian Suri-Payer <fsp@cs.cornell.edu>
+ *                Matthew Burke <matthelb@cs.cornell.edu>
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ **********************************************************************/
+#include "lib/latency.h"
+#include "lib/message.h"
+#include "store/common/timestamp.h"
+#include "store/indicusstore/indicus-proto.pb.h"
+#include "store/indicusstore/preparedreadindex.h"
+
+#include <gflags/gflags.h>
+
+#include <algorithm>
+#include <random>
+#include <set>
+#include <sstream>
+
+DEFINE_string(readers_per_key, "16,64,256", "comma-separated list of prepared readers per hot key.");
+DEFINE_uint64(hot_keys, 8, "number of hot keys written by every Phase1.");
+DEFINE_uint64(read_set_size, 10, "number of reads per prepared reader.");
+DEFINE_uint64(deps_per_txn, 2, "number of dependencies per prepared reader.");
+DEFINE_uint64(write_set_size, 4, "number of hot keys written per Phase1.");
+DEFINE_uint64(num_phase1, 100000, "number of Phase1 write checks per configuration.");
+DEFINE_uint64(ts_range, 1000000, "range of transaction timestamps.");
+DEFINE_uint64(read_gap, 100, "max distance between a reader's read version and its timestamp.");
+
+namespace indicusstore {
+
+// Previous check: scan every prepared reader of the key, its deps and its
+// read set.
+bool ScanConflict(const std::set<const proto::Transaction *> &readers,
+    const std::string &key, const Timestamp &ts, const std::string &txnDigest) {
+  for (const auto preparedReadTxn : readers) {
+    bool isDep = false;
+    for (const auto &dep : preparedReadTxn->deps()) {
+      if (txnDigest == dep.write().prepared_txn_digest()) {
+        isDep = true;
+        break;
+      }
+    }
+
+    bool isReadVersionEarlier = false;
+    for (const auto &read : preparedReadTxn->read_set()) {
+      if (read.key() == key) {
+        isReadVersionEarlier = Timestamp(read.readtime()) < ts;
+        break;
+      }
+    }
+    if (!isDep && isReadVersionEarlier &&
+        ts < Timestamp(preparedReadTxn->timestamp())) {
+      return true;
+    }
+  }
+  return false;
+}
+
+} // namespace indicusstore
+
+int main(int argc, char *argv[]) {
+  gflags::SetUsageMessage("benchmark the Indicus prepared-read write check.");
+	gflags::ParseCommandLineFlags(&argc, &argv, true);
+
+  std::mt19937_64 rng(0);
+  std::vector<std::string> hotKeys;
+  for (uint64_t i = 0; i < FLAGS_hot_keys; ++i) {
+    hotKeys.push_back("hot" + std::to_string(i));
+  }
+  std::uniform_int_distribution<uint64_t> keyDist(0, FLAGS_hot_keys - 1);
+  std::uniform_int_distribution<uint64_t> tsDist(1, FLAGS_ts_range);
+
+  std::vector<uint64_t> readersPerKey;
+  std::stringstream ss(FLAGS_readers_per_key);
+  std::string tok;
+  while (std::getline(ss, tok, ',')) {
+    readersPerKey.push_back(std::stoull(tok));
+  }
+
+  Notice("===================================");
+  Notice("Running prepared-read check bench: %lu hot keys, %lu reads/reader,"
+      " %lu writes/Phase1.", FLAGS_hot_keys, FLAGS_read_set_size,
+      FLAGS_write_set_size);
+
+  for (uint64_t numReaders : readersPerKey) {
+    std::vector<indicusstore::proto::Transaction> txns(numReaders * FLAGS_hot_keys);
+    std::vector<std::set<const indicusstore::proto::Transaction *>> scanReaders(FLAGS_hot_keys);
+    std::vector<indicusstore::PreparedReadIndex> indexReaders(FLAGS_hot_keys);
+    uint64_t coldKey = 0;
+    for (size_t i = 0; i < txns.size(); ++i) {
+      indicusstore::proto::Transaction &txn = txns[i];
+      uint64_t hot = i % FLAGS_hot_keys;
+      Timestamp txnTs(tsDist(rng), i);
+      txnTs.serialize(txn.mutable_timestamp());
+      for (uint64_t d = 0; d < FLAGS_deps_per_txn; ++d) {
+        txn.add_deps()->mutable_write()->set_prepared_txn_digest(
+            "dep" + std::to_string(rng()));
+      }
+      // the hot key is read last so the scan walks the whole read set
+      for (uint64_t r = 0; r + 1 < FLAGS_read_set_size; ++r) {
+        ReadMessage *read = txn.add_read_set();
+        read->set_key("cold" + std::to_string(coldKey++));
+        Timestamp(txnTs.getTimestamp() / 2).serialize(read->mutable_readtime());
+      }
+      ReadMessage *read = txn.add_read_set();
+      read->set_key(hotKeys[hot]);
+      uint64_t gap = std::uniform_int_distribution<uint64_t>(1,
+          FLAGS_read_gap)(rng);
+      Timestamp readTs(txnTs.getTimestamp() - std::min(gap, txnTs.getTimestamp()));
+      readTs.serialize(read->mutable_readtime());
+
+      scanReaders[hot].insert(&txn);
+      indexReaders[hot].Insert(txnTs, readTs, &txn);
+    }
+
+    struct Latency_t scanLat;
+    struct Latency_t indexLat;
+    _Latency_Init(&scanLat, "check_scan");
+    _Latency_Init(&indexLat, "check_index");
+    uint64_t scanNs = 0;
+    uint64_t indexNs = 0;
+    uint64_t scanConflicts = 0;
+    uint64_t indexConflicts = 0;
+
+    std::vector<uint64_t> writeKeys(FLAGS_write_set_size);
+    for (uint64_t p = 0; p < FLAGS_num_phase1; ++p) {
+      Timestamp ts(tsDist(rng), txns.size() + p);
+      std::string txnDigest = "txn" + std::to_string(p);
+      for (auto &k : writeKeys) {
+        k = keyDist(rng);
+      }
+
+      Latency_Start(&scanLat);
+      bool conflict = false;
+      for (uint64_t k : writeKeys) {
+        if (indicusstore::ScanConflict(scanReaders[k], hotKeys[k], ts, txnDigest)) {
+          conflict = true;
+          break;
+        }
+      }
+      scanNs += Latency_End(&scanLat);
+      scanConflicts += conflict;
+
+      Latency_Start(&indexLat);
+      conflict = false;
+      for (uint64_t k : writeKeys) {
+        if (indexReaders[k].FindConflict(ts, txnDigest) != indexReaders[k].end()) {
+          conflict = true;
+          break;
+        }
+      }
+      indexNs += Latency_End(&indexLat);
+      indexConflicts += conflict;
+    }
+    UW_ASSERT(scanConflicts == indexConflicts);
+
+    Notice("%lu readers/key: scan %.0f ns/Phase1, index %.0f ns/Phase1"
+        " (%lu/%lu Phase1s abstain).", numReaders,
+        static_cast<double>(scanNs) / FLAGS_num_phase1,
+        static_cast<double>(indexNs) / FLAGS_num_phase1, indexConflicts,
+        FLAGS_num_phase1);
+  }
+  Notice("===================================");
+  return 0;
+}
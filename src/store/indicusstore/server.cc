@@ -32,8 +32,11 @@
 
 #include "store/indicusstore/server.h"
 
+#include <algorithm>
 #include <bitset>
+#include <memory>
 #include <queue>
+#include <thread>
 #include <ctime>
 #include <chrono>
 #include <sys/time.h>
@@ -48,6 +51,7 @@
 #include "store/indicusstore/localbatchverifier.h"
 #include "store/indicusstore/sharedbatchverifier.h"
 #include "store/common/backend/pingserver.h"
+#include "store/common/backend/snapshot.h"
 #include "store/indicusstore/maxsize.h"
 #include "lib/batched_sigs.h"
 #include <valgrind/memcheck.h>
@@ -70,15 +74,15 @@ Server::Server(const transport::Configuration &config, int groupIdx, int idx,
   p1MetaData = p1MetaDataMap(100000);
   p2MetaDatas = p2MetaDataMap(100000);
   prepared = preparedMap(100000);
-  preparedReads = tbb::concurrent_unordered_map<std::string, std::pair<std::shared_mutex, std::set<const proto::Transaction *>>>(100000);
+  preparedReads = tbb::concurrent_unordered_map<std::string, std::pair<std::shared_mutex, PreparedReadIndex>>(100000);
   preparedWrites = tbb::concurrent_unordered_map<std::string, std::pair<std::shared_mutex,std::map<Timestamp, const proto::Transaction *>>>(100000);
   rts = tbb::concurrent_unordered_map<std::string, std::atomic_int>(100000);
-  committed = tbb::concurrent_unordered_map<std::string, proto::CommittedProof *>(100000);
-  writebackMessages = tbb::concurrent_unordered_map<std::string, proto::Writeback>(100000);
+  committed = committedMap(100000);
+  aborted = abortedMap(100000);
+  writebackMessages = writebackMap(100000);
   dependents = dependentsMap(100000);
   waitingDependencies = std::unordered_map<std::string, WaitingDependency>(100000);
 
-  store.KVStore_Reserve(4200000);
   //Create simulated MACs that are used for Fallback all to all:
   CreateSessionKeys();
   //////
@@ -111,13 +115,13 @@ Server::Server(const transport::Configuration &config, int groupIdx, int idx,
           batchTimeoutMicro, params.signatureBatchSize, id,
           params.validateProofs && params.signedMessages &&
           params.signatureBatchSize > 1 && params.adjustBatchSize,
-          params.merkleBranchFactor);
+          params.merkleBranchFactor, params.sigBatchControl);
     } else {
       batchSigner = new LocalBatchSigner(transport, keyManager, GetStats(),
           batchTimeoutMicro, params.signatureBatchSize, id,
           params.validateProofs && params.signedMessages &&
           params.signatureBatchSize > 1 && params.adjustBatchSize,
-          params.merkleBranchFactor);
+          params.merkleBranchFactor, params.sigBatchControl);
     }
 
     if (params.sharedMemVerify) {
@@ -138,6 +142,13 @@ Server::Server(const transport::Configuration &config, int groupIdx, int idx,
   proof->mutable_txn()->mutable_timestamp()->set_id(0);
 
   committed.insert(std::make_pair("", proof));
+
+  lowWatermark = 0;
+  gcReclaimedWatermark = 0;
+  gcLoopPasses = 0;
+  if (params.gcIntervalMS > 0) {
+    ScheduleGC();
+  }
 }
 
 Server::~Server() {
@@ -157,9 +168,28 @@ Server::~Server() {
   //Latency_Dump(&(store.storeLockLat));
   Notice("Freeing verifier.");
   delete verifier;
+  delete sessionMACs;
    //if(params.mainThreadDispatching) committedMutex.lock();
   for (const auto &c : committed) {   ///XXX technically not threadsafe
     delete c.second;
+  }
+  // proofs already unlinked from committed by the GC
+  for (const auto &p : gcProofRefs) {
+    delete p.first;
+  }
+  for (const auto p : gcRetiredProofs) {
+    delete p;
+  }
+  for (const auto &g : gcGracePeriods) {
+    for (const auto p : g.proofs) {
+      delete p;
+    }
+  }
+  for (const auto p : gcPinnedRetired) {
+    delete p;
+  }
+  for (const auto p : gcUnpinned) {
+    delete p;
   }
    //if(params.mainThreadDispatching) committedMutex.unlock();
    ////if(params.mainThreadDispatching) ongoingMutex.lock();
@@ -167,21 +197,6 @@ Server::~Server() {
     delete o.second;
   }
    ////if(params.mainThreadDispatching) ongoingMutex.unlock();
-   if(params.mainThreadDispatching) readReplyProtoMutex.lock();
-  for (auto r : readReplies) {
-    delete r;
-  }
-   if(params.mainThreadDispatching) readReplyProtoMutex.unlock();
-   if(params.mainThreadDispatching) p1ReplyProtoMutex.lock();
-  for (auto r : p1Replies) {
-    delete r;
-  }
-   if(params.mainThreadDispatching) p1ReplyProtoMutex.unlock();
-   if(params.mainThreadDispatching) p2ReplyProtoMutex.lock();
-  for (auto r : p2Replies) {
-    delete r;
-  }
-   if(params.mainThreadDispatching) p2ReplyProtoMutex.unlock();
   Notice("Freeing signer.");
   if (batchSigner != nullptr) {
     delete batchSigner;
@@ -227,12 +242,12 @@ Server::~Server() {
     //using this path results in an extra copy
     //Can I move the data or release the message to avoid duplicates?
    transport->DispatchTP_main([this, &remote, type, data, meta_data]() {
-     this->ReceiveMessageInternal(remote, type, data, meta_data);
+     this->ReceiveMessageInternal(remote, type, MessageView(data), meta_data);
      return (void*) true;
    });
   }
   else{
-    ReceiveMessageInternal(remote, type, data, meta_data);
+    ReceiveMessageInternal(remote, type, MessageView(data), meta_data);
   }
  }
 
@@ -246,11 +261,37 @@ Server::~Server() {
     //using this path results in an extra copy
     //Can I move the data or release the message to avoid duplicates?
    transport->DispatchTP_main([this, &remote, types, datas, meta_data]() {
-     this->ReceiveMessageInternal_batch(remote, types, datas, meta_data);
+     std::vector<std::string_view> typeViews(types.begin(), types.end());
+     std::vector<MessageView> dataViews(datas.begin(), datas.end());
+     this->ReceiveMessageInternal_batch(remote, typeViews, dataViews, meta_data);
      return (void*) true;
    });
    
   }
+  else{
+    std::vector<std::string_view> typeViews(types.begin(), types.end());
+    std::vector<MessageView> dataViews(datas.begin(), datas.end());
+    ReceiveMessageInternal_batch(remote, typeViews, dataViews, meta_data);
+  }
+ }
+
+ void Server::ReceiveMessageView(const TransportAddress &remote,
+       std::string_view type, const MessageView &data, void *meta_data) {
+  if(params.dispatchMessageReceive){
+    //the frame is drained once we return; take a copy for the other thread.
+    TransportReceiver::ReceiveMessageView(remote, type, data, meta_data);
+  }
+  else{
+    ReceiveMessageInternal(remote, type, data, meta_data);
+  }
+ }
+
+ void Server::ReceiveMessageView_batch(const TransportAddress &remote,
+       const std::vector<std::string_view> &types, const std::vector<MessageView> &datas, void *meta_data) {
+  if(params.dispatchMessageReceive){
+    //the frame is drained once we return; take a copy for the other thread.
+    TransportReceiver::ReceiveMessageView_batch(remote, types, datas, meta_data);
+  }
   else{
     ReceiveMessageInternal_batch(remote, types, datas, meta_data);
   }
@@ -262,7 +303,7 @@ Server::~Server() {
 // 2. dispatchMessageReceive: Dispatch both message deserialization and message handling to main worker thread.
 //TODO: Full CPU utilization parallelism: Assign all handler functions to different threads.
 void Server::ReceiveMessageInternal(const TransportAddress &remote,
-      const std::string &type, const std::string &data, void *meta_data) {
+      std::string_view type, const MessageView &data, void *meta_data) {
 
       //typeがメッセージ
   Debug("Server::ReceiveMessageInternal");
@@ -271,13 +312,13 @@ void Server::ReceiveMessageInternal(const TransportAddress &remote,
 
     //if no dispatching OR if dispatching both deser and Handling to 2nd main thread (no workers)
     if(!params.mainThreadDispatching || (params.dispatchMessageReceive && !params.parallel_reads) ){
-      read.ParseFromString(data);
+      data.ParseInto(&read);
       HandleRead(remote, read);
     }
     //if dispatching to second main or other workers
     else{
       proto::Read* readCopy = GetUnusedReadmessage();
-      readCopy->ParseFromString(data);
+      data.ParseInto(readCopy);
       auto f = [this, &remote, readCopy](){
         this->HandleRead(remote, *readCopy);
         return (void*) true;
@@ -293,12 +334,12 @@ void Server::ReceiveMessageInternal(const TransportAddress &remote,
 
     //Use only with OCC parallel, not full parallel P1. Suffers from non-atomicity in the latter case
     if(!params.mainThreadDispatching || (params.dispatchMessageReceive && !params.parallel_CCC)){
-     phase1.ParseFromString(data);
+     data.ParseInto(&phase1);
      HandlePhase1(remote, phase1);
     }
     else{
       proto::Phase1 *phase1Copy = GetUnusedPhase1message();
-      phase1Copy->ParseFromString(data);
+      data.ParseInto(phase1Copy);
       auto f = [this, &remote, phase1Copy]() {
         this->HandlePhase1(remote, *phase1Copy);
         return (void*) true;
@@ -316,12 +357,12 @@ void Server::ReceiveMessageInternal(const TransportAddress &remote,
   } else if (type == phase2.GetTypeName()) {
 
       if(!params.multiThreading && (!params.mainThreadDispatching || params.dispatchMessageReceive)){
-        phase2.ParseFromString(data);
+        data.ParseInto(&phase2);
         HandlePhase2(remote, phase2);
       }
       else{
         proto::Phase2* p2 = GetUnusedPhase2message();
-        p2->ParseFromString(data);
+        data.ParseInto(p2);
         if(!params.mainThreadDispatching || params.dispatchMessageReceive){
           HandlePhase2(remote, *p2);
         }
@@ -337,12 +378,12 @@ void Server::ReceiveMessageInternal(const TransportAddress &remote,
   } else if (type == writeback.GetTypeName()) {
 
       if(!params.multiThreading && (!params.mainThreadDispatching || params.dispatchMessageReceive)){
-        writeback.ParseFromString(data);
+        data.ParseInto(&writeback);
         HandleWriteback(remote, writeback);
       }
       else{
         proto::Writeback *wb = GetUnusedWBmessage();
-        wb->ParseFromString(data);
+        data.ParseInto(wb);
         if(!params.mainThreadDispatching || params.dispatchMessageReceive){
           HandleWriteback(remote, *wb);
         }
@@ -356,10 +397,10 @@ void Server::ReceiveMessageInternal(const TransportAddress &remote,
       }
 
   } else if (type == abort.GetTypeName()) {
-    abort.ParseFromString(data);
+    data.ParseInto(&abort);
     HandleAbort(remote, abort);
   } else if (type == ping.GetTypeName()) {
-    ping.ParseFromString(data);
+    data.ParseInto(&ping);
     Debug("Ping is called");
     HandlePingMessage(this, remote, ping);
 
@@ -367,12 +408,12 @@ void Server::ReceiveMessageInternal(const TransportAddress &remote,
   } else if (type == phase1FB.GetTypeName()) {
 
     if(!params.mainThreadDispatching || (params.dispatchMessageReceive && !params.parallel_CCC)){
-      phase1FB.ParseFromString(data);
+      data.ParseInto(&phase1FB);
       HandlePhase1FB(remote, phase1FB);
     }
     else{
       proto::Phase1FB *phase1FBCopy = GetUnusedPhase1FBmessage();
-      phase1FBCopy->ParseFromString(data);
+      data.ParseInto(phase1FBCopy);
       auto f = [this, &remote, phase1FBCopy]() {
         this->HandlePhase1FB(remote, *phase1FBCopy);
         return (void*) true;
@@ -390,12 +431,12 @@ void Server::ReceiveMessageInternal(const TransportAddress &remote,
   } else if (type == phase2FB.GetTypeName()) {
 
       if(!params.multiThreading && (!params.mainThreadDispatching || params.dispatchMessageReceive)){
-        phase2FB.ParseFromString(data);
+        data.ParseInto(&phase2FB);
         HandlePhase2FB(remote, phase2FB);
       }
       else{
         proto::Phase2FB* p2FB = GetUnusedPhase2FBmessage();
-        p2FB->ParseFromString(data);
+        data.ParseInto(p2FB);
         if(!params.mainThreadDispatching || params.dispatchMessageReceive){
           HandlePhase2FB(remote, *p2FB);
         }
@@ -411,12 +452,12 @@ void Server::ReceiveMessageInternal(const TransportAddress &remote,
   } else if (type == invokeFB.GetTypeName()) {
 
     if((params.all_to_all_fb || !params.multiThreading) && (!params.mainThreadDispatching || params.dispatchMessageReceive)){
-      invokeFB.ParseFromString(data);
+      data.ParseInto(&invokeFB);
       HandleInvokeFB(remote, invokeFB);
     }
     else{
       proto::InvokeFB* invFB = GetUnusedInvokeFBmessage();
-      invFB->ParseFromString(data);
+      data.ParseInto(invFB);
       if(!params.mainThreadDispatching || params.dispatchMessageReceive){
         HandleInvokeFB(remote, *invFB);
       }
@@ -432,12 +473,12 @@ void Server::ReceiveMessageInternal(const TransportAddress &remote,
   } else if (type == electFB.GetTypeName()) {
 
     if(!params.mainThreadDispatching || params.dispatchMessageReceive){
-      electFB.ParseFromString(data);
+      data.ParseInto(&electFB);
       HandleElectFB(electFB);
     }
     else{
       proto::ElectFB* elFB = GetUnusedElectFBmessage();
-      elFB->ParseFromString(data);
+      data.ParseInto(elFB);
       auto f = [this, elFB](){
           this->HandleElectFB(*elFB);
           return (void*) true;
@@ -448,12 +489,12 @@ void Server::ReceiveMessageInternal(const TransportAddress &remote,
   } else if (type == decisionFB.GetTypeName()) {
 
     if(!params.multiThreading && (!params.mainThreadDispatching || params.dispatchMessageReceive)){
-      decisionFB.ParseFromString(data);
+      data.ParseInto(&decisionFB);
       HandleDecisionFB(decisionFB);
     }
     else{
       proto::DecisionFB* decFB = GetUnusedDecisionFBmessage();
-      decFB->ParseFromString(data);
+      data.ParseInto(decFB);
       if(!params.mainThreadDispatching || params.dispatchMessageReceive){
         HandleDecisionFB(*decFB);
       }
@@ -469,12 +510,12 @@ void Server::ReceiveMessageInternal(const TransportAddress &remote,
   } else if (type == moveView.GetTypeName()) {
 
     if(!params.mainThreadDispatching || params.dispatchMessageReceive){
-      moveView.ParseFromString(data);
+      data.ParseInto(&moveView);
       HandleMoveView(moveView); //Send only to other replicas
     }
     else{
       proto::MoveView* mvView = GetUnusedMoveView();
-      mvView->ParseFromString(data);
+      data.ParseInto(mvView);
       auto f = [this, mvView](){
           this->HandleMoveView( *mvView);
           return (void*) true;
@@ -483,95 +524,75 @@ void Server::ReceiveMessageInternal(const TransportAddress &remote,
     }
 
   } else {
-    Panic("Received unexpected message type: %s", type.c_str());
+    Panic("Received unexpected message type: %.*s", (int) type.size(), type.data());
   }
 }
 
 //Calls function handlers for respective message types.
-// Manages Multithread assignments:
-// 1. mainThreadDispatching: Deserialize messages on thread receiving messages, but dispatch message handling to main worker thread
-// 2. dispatchMessageReceive: Dispatch both message deserialization and message handling to main worker thread.
-//TODO: Full CPU utilization parallelism: Assign all handler functions to different threads.
+// Same threading modes as ReceiveMessageInternal. Consecutive messages of the
+// same type form a run; Read, Phase1 and Writeback runs are parsed into
+// pooled messages (on the worker threads as well, if the run is long enough)
+// and handed to the handlers by pointer. All other runs are handled one
+// message at a time by ReceiveMessageInternal.
 void Server::ReceiveMessageInternal_batch(const TransportAddress &remote,
-      const std::vector<std::string> &types, const std::vector<std::string> &datas, void *meta_data) {
-      
-  Debug("Server::ReceiveMessageInternal_batch");
-
-  int batchSize = datas.size();
-
-  std::vector<int> batchSizeArray;
-  std::vector<std::string> typeArray;
-
-  int type_change_point = 0;
-
-  if (batchSize == 1){
-    batchSizeArray.push_back(batchSize);
-    typeArray.push_back(types[0]);
-  }
-  else {
-    for(int i = 1; i < batchSize; i++){
-      if (types[i] != types[i - 1]){
-        typeArray.push_back(types[i - 1]);
-        batchSizeArray.push_back(i - type_change_point);
-        type_change_point = i;
-      }
-    }
-    typeArray.push_back(types[batchSize - 1]);
-    batchSizeArray.push_back(batchSize - type_change_point);
-    if (batchSizeArray.size() == 0){
-      batchSizeArray.push_back(batchSize);
-      typeArray.push_back(types[0]);
-    }
-  }
-
-  Debug("BatchSize : %d \n", batchSize);
-  Debug("batchSizeArray.size(): %d \n", batchSizeArray.size());
-  Debug("typeArray.size(): %d \n", typeArray.size());
-
-  for(int i = 0; i < batchSizeArray.size(); i++){
-    Debug("type : %s \n", typeArray[i].c_str());
-    if (typeArray[i] == read.GetTypeName()) {
+      const std::vector<std::string_view> &types, const std::vector<MessageView> &datas, void *meta_data) {
+
+  Debug("Server::ReceiveMessageInternal_batch of %lu messages", datas.size());
+
+  size_t runStart = 0;
+  while (runStart < datas.size()) {
+    size_t runEnd = runStart + 1;
+    while (runEnd < datas.size() && types[runEnd] == types[runStart]) {
+      runEnd++;
+    }
+    std::string_view type = types[runStart];
+    Debug("Run of %lu messages of type %.*s", runEnd - runStart,
+        (int) type.size(), type.data());
+
+    if (type == read.GetTypeName()) {
+      std::vector<proto::Read *> readMsgs;
+      ParseRun(datas, runStart, runEnd, readPool, readMsgs);
+      auto f = [this, &remote, readMsgs = std::move(readMsgs)]() {
+        this->HandleRead_batch(remote, readMsgs);
+        for (auto readMsg : readMsgs) {
+          FreeReadmessage(readMsg);
+        }
+        return (void*) true;
+      };
       //if no dispatching OR if dispatching both deser and Handling to 2nd main thread (no workers)
       if(!params.mainThreadDispatching || (params.dispatchMessageReceive && !params.parallel_reads) ){
-        for (int j = 0; j < batchSizeArray[i]; j++){
-          reads[j].ParseFromString(datas[j]);
-          Debug("READ[%lu:%lu] for key %s with ts %lu.%lu.", reads[j].timestamp().id(),
-              reads[j].req_id(), BytesToHex(reads[j].key(), 16).c_str(),
-              reads[j].timestamp().timestamp(), reads[j].timestamp().id());
-        }
-        const_cast<std::vector<std::string> *>(&datas)->erase(std::cbegin(datas), std::cbegin(datas) + batchSizeArray[i]);
-        HandleRead_batch(remote, reads, batchSizeArray[i]);
+        f();
       }
       //if dispatching to second main or other workers
+      else if(params.parallel_reads){
+        transport->DispatchTP_noCB(std::move(f));
+      }
       else{
-        proto::Read readCopies [MAX_MESSAGE_SIZE];
-        for(int j = 0; j < batchSizeArray[i]; j++){
-          readCopies[j].ParseFromString(datas[j]);
-        }
-        const_cast<std::vector<std::string> *>(&datas)->erase(std::cbegin(datas), std::cbegin(datas) + batchSizeArray[i]);
-        auto f = [this, &remote, readCopies, batchSizeArray, i](){
-          this->HandleRead_batch(remote, const_cast<proto::Read *>(readCopies), batchSizeArray[i]);
+        transport->DispatchTP_main(std::move(f));
+      }
+    }
+    else if (type == phase1.GetTypeName() && params.mainThreadDispatching &&
+        !(params.dispatchMessageReceive && !params.parallel_CCC)) {
+      //Use only with OCC parallel, not full parallel P1. Suffers from non-atomicity in the latter case
+      std::vector<proto::Phase1 *> p1s;
+      ParseRun(datas, runStart, runEnd, p1Pool, p1s);
+      if (params.parallel_CCC && p1s.size() > 1) {
+        //check the whole run at once: one lock acquisition for all of its keys.
+        auto f = [this, &remote, p1s = std::move(p1s)]() {
+          this->HandlePhase1_batch(remote, p1s);
           return (void*) true;
         };
-
-        if(params.parallel_reads){
-          transport->DispatchTP_noCB(std::move(f));
+        if(params.dispatchMessageReceive){
+          f();
         }
         else{
-          transport->DispatchTP_main(std::move(f));
+          Debug("Dispatching HandlePhase1_batch");
+          transport->DispatchTP_noCB(std::move(f));
         }
+        runStart = runEnd;
+        continue;
       }
-    }
-    else if (typeArray[i] == phase1.GetTypeName()) {
-      //Use only with OCC parallel, not full parallel P1. Suffers from non-atomicity in the latter case
-      //Use only with OCC parallel, not full parallel P1. Suffers from non-atomicity in the latter case
-      if(!params.mainThreadDispatching || (params.dispatchMessageReceive && !params.parallel_CCC)){
-        phase1.ParseFromString(datas[0]);
-        HandlePhase1(remote, phase1);
-      }
-      else{
-        proto::Phase1 *phase1Copy = GetUnusedPhase1message();
-        phase1Copy->ParseFromString(datas[0]);
+      for (auto phase1Copy : p1s) {
         auto f = [this, &remote, phase1Copy]() {
           this->HandlePhase1(remote, *phase1Copy);
           return (void*) true;
@@ -581,225 +602,93 @@ void Server::ReceiveMessageInternal_batch(const TransportAddress &remote,
         }
         else{
           Debug("Dispatching HandlePhase1");
-          //transport->DispatchTP_main(f);
-          transport->DispatchTP_noCB(f); //use if want to dispatch to all workers
+          transport->DispatchTP_noCB(std::move(f));
         }
       }
     }
-    else if (typeArray[i] == phase2.GetTypeName()) {
-
-        if(!params.multiThreading && (!params.mainThreadDispatching || params.dispatchMessageReceive)){
-          phase2.ParseFromString(datas[0]);
-          HandlePhase2(remote, phase2);
-        }
-        else{
-          proto::Phase2* p2 = GetUnusedPhase2message();
-          p2->ParseFromString(datas[0]);
-          if(!params.mainThreadDispatching || params.dispatchMessageReceive){
-            HandlePhase2(remote, *p2);
-          }
-          else{
-            auto f = [this, &remote, p2](){
-              this->HandlePhase2(remote, *p2);
-              return (void*) true;
-            };
-            transport->DispatchTP_main(std::move(f));
-          }
-        }
-    }
-    else if (typeArray[i] == writeback.GetTypeName()) {
-      
-
+    else if (type == writeback.GetTypeName()) {
       if(!params.multiThreading && (!params.mainThreadDispatching || params.dispatchMessageReceive)){
-        for(int j = 0; j < batchSizeArray[i]; j++){
-          writeback.ParseFromString(datas[j]);
-          HandleWriteback(remote, writeback);
-        }
-        const_cast<std::vector<std::string> *>(&datas)->erase(std::cbegin(datas), std::cbegin(datas) + batchSizeArray[i]);
-      }
-      else{
-        
-        for (int j = 0; j < batchSizeArray[i]; j++){
-          proto::Writeback *wb = GetUnusedWBmessage();
-          wb->ParseFromString(datas[j]);
-          if(!params.mainThreadDispatching || params.dispatchMessageReceive){
-            HandleWriteback(remote, *wb);
-          }
-          else{
-            auto f = [this, &remote, wb](){
-              this->HandleWriteback(remote, *wb);
-              return (void*) true;
-            };
-            transport->DispatchTP_main(std::move(f));
+        std::vector<proto::Writeback *> wbs;
+        for (size_t j = runStart; j < runEnd; j++){
+          datas[j].ParseInto(&writebacks[wbs.size()]);
+          wbs.push_back(&writebacks[wbs.size()]);
+          if(wbs.size() == MAX_TRANSACTION_SIZE || j == runEnd - 1){
+            HandleWriteback_batch(remote, wbs);
+            wbs.clear();
           }
         }
-        const_cast<std::vector<std::string> *>(&datas)->erase(std::cbegin(datas), std::cbegin(datas) + batchSizeArray[i]);
-      }
-      
-      /*
-      if(!params.multiThreading && (!params.mainThreadDispatching || params.dispatchMessageReceive)){
-        for (int j = 0; j < batchSizeArray[i]; j++){
-          writebacks[j].ParseFromString(datas[j]);
-        }
-        const_cast<std::vector<std::string> *>(&datas)->erase(std::cbegin(datas), std::cbegin(datas) + batchSizeArray[i]);
-        HandleWriteback_batch(remote, writebacks, batchSizeArray[i]);
       }
       else{
-        proto::Writeback writebackCopies [MAX_TRANSACTION_SIZE];
-
-        for(int j = 0; j < batchSizeArray[i]; j++){
-        writebackCopies[j].ParseFromString(datas[j]);
-        }
-        const_cast<std::vector<std::string> *>(&datas)->erase(std::cbegin(datas), std::cbegin(datas) + batchSizeArray[i]);
-        
+        std::vector<proto::Writeback *> wbs;
+        ParseRun(datas, runStart, runEnd, WBPool, wbs);
         if(!params.mainThreadDispatching || params.dispatchMessageReceive){
-          HandleWriteback_batch(remote, const_cast<proto::Writeback *>(writebackCopies), batchSizeArray[i]);
+          HandleWriteback_batch(remote, wbs);
         }
         else{
-          auto f = [this, &remote, writebackCopies, batchSizeArray, i](){
-            this->HandleWriteback_batch(remote, const_cast<proto::Writeback *>(writebackCopies), batchSizeArray[i]);
+          auto f = [this, &remote, wbs = std::move(wbs)](){
+            this->HandleWriteback_batch(remote, wbs);
             return (void*) true;
           };
           transport->DispatchTP_main(std::move(f));
         }
       }
-      */
-    }
-    else if (typeArray[i] == abort.GetTypeName()) {
-      abort.ParseFromString(datas[0]);
-      HandleAbort(remote, abort);
-    } 
-    else if (typeArray[i] == ping.GetTypeName()) {
-      ping.ParseFromString(datas[0]);
-      Debug("Ping is called");
-      HandlePingMessage(this, remote, ping);
-    // Add all Fallback signedMessages
     }
-    else if (typeArray[i] == phase1FB.GetTypeName()) {
-      if(!params.mainThreadDispatching || (params.dispatchMessageReceive && !params.parallel_CCC)){
-        phase1FB.ParseFromString(datas[0]);
-        const_cast<std::vector<std::string> *>(&datas)->erase(std::cbegin(datas), std::cbegin(datas) + batchSizeArray[i]);
-        HandlePhase1FB(remote, phase1FB);
-      }
-      else{
-        proto::Phase1FB *phase1FBCopy = GetUnusedPhase1FBmessage();
-        phase1FBCopy->ParseFromString(datas[0]);
-        const_cast<std::vector<std::string> *>(&datas)->erase(std::cbegin(datas), std::cbegin(datas) + batchSizeArray[i]);
-        auto f = [this, &remote, phase1FBCopy]() {
-          this->HandlePhase1FB(remote, *phase1FBCopy);
-          return (void*) true;
-        };
-        if(params.dispatchMessageReceive){
-          f();
-        }
-        else{
-          Debug("Dispatching HandlePhase1");
-          transport->DispatchTP_main(std::move(f));
-          //transport->DispatchTP_noCB(f); //use if want to dispatch to all workers
-        }
-      }
-    } 
-    else if (typeArray[i] == phase2FB.GetTypeName()) {
-
-      if(!params.multiThreading && (!params.mainThreadDispatching || params.dispatchMessageReceive)){
-        phase2FB.ParseFromString(datas[0]);
-        HandlePhase2FB(remote, phase2FB);
-      }
-      else{
-        proto::Phase2FB* p2FB = GetUnusedPhase2FBmessage();
-        p2FB->ParseFromString(datas[0]);
-        if(!params.mainThreadDispatching || params.dispatchMessageReceive){
-          HandlePhase2FB(remote, *p2FB);
-        }
-        else{
-          auto f = [this, &remote, p2FB](){
-            this->HandlePhase2FB(remote, *p2FB);
-            return (void*) true;
-          };
-          transport->DispatchTP_main(std::move(f));
-        }
-      }
-
-    } 
-    else if (typeArray[i] == invokeFB.GetTypeName()) {
-
-      if((params.all_to_all_fb || !params.multiThreading) && (!params.mainThreadDispatching || params.dispatchMessageReceive)){
-        invokeFB.ParseFromString(datas[0]);
-        HandleInvokeFB(remote, invokeFB);
-      }
-      else{
-        proto::InvokeFB* invFB = GetUnusedInvokeFBmessage();
-        invFB->ParseFromString(datas[0]);
-        if(!params.mainThreadDispatching || params.dispatchMessageReceive){
-          HandleInvokeFB(remote, *invFB);
-        }
-        else{
-          auto f = [this, &remote, invFB](){
-            this->HandleInvokeFB(remote, *invFB);
-            return (void*) true;
-          };
-          transport->DispatchTP_main(std::move(f));
-        }
+    else {
+      for (size_t j = runStart; j < runEnd; j++) {
+        ReceiveMessageInternal(remote, types[j], datas[j], meta_data);
       }
+    }
+    runStart = runEnd;
+  }
+}
 
-    } 
-    else if (typeArray[i] == electFB.GetTypeName()) {
-
-      if(!params.mainThreadDispatching || params.dispatchMessageReceive){
-        electFB.ParseFromString(datas[0]);
-        HandleElectFB(electFB);
-      }
-      else{
-        proto::ElectFB* elFB = GetUnusedElectFBmessage();
-        elFB->ParseFromString(datas[0]);
-        auto f = [this, elFB](){
-          this->HandleElectFB(*elFB);
-          return (void*) true;
-        };
-        transport->DispatchTP_main(std::move(f));
-      }
-    } 
-    else if (typeArray[i] == decisionFB.GetTypeName()) {
+//Parses datas[start, end) into messages taken from pool. Long runs are split
+//into PARSE_CHUNK_SIZE chunks that the worker threads help parse; returns
+//only once every chunk is parsed, since the views are not valid afterwards.
+template<class M>
+void Server::ParseRun(const std::vector<MessageView> &datas, size_t start,
+    size_t end, ObjectPool<M> &pool, std::vector<M *> &msgs) {
+  size_t n = end - start;
+  msgs.resize(n);
+  for (size_t j = 0; j < n; j++) {
+    msgs[j] = pool.Get();
+  }
 
-      if(!params.multiThreading && (!params.mainThreadDispatching || params.dispatchMessageReceive)){
-        decisionFB.ParseFromString(datas[0]);
-        HandleDecisionFB(decisionFB);
-      }
-      else{
-        proto::DecisionFB* decFB = GetUnusedDecisionFBmessage();
-        decFB->ParseFromString(datas[0]);
-        if(!params.mainThreadDispatching || params.dispatchMessageReceive){
-          HandleDecisionFB(*decFB);
-        }
-        else{
-          auto f = [this, decFB](){
-            this->HandleDecisionFB( *decFB);
-            return (void*) true;
-          };
-          transport->DispatchTP_main(std::move(f));
-        }
-      }
-    } 
-    else if (typeArray[i] == moveView.GetTypeName()) {
+  size_t chunks = (n + PARSE_CHUNK_SIZE - 1) / PARSE_CHUNK_SIZE;
+  if (!params.multiThreading || chunks <= 1) {
+    for (size_t j = 0; j < n; j++) {
+      datas[start + j].ParseInto(msgs[j]);
+    }
+    return;
+  }
 
-      if(!params.mainThreadDispatching || params.dispatchMessageReceive){
-        moveView.ParseFromString(datas[0]);
-        HandleMoveView(moveView); //Send only to other replicas
-      }
-      else{
-        proto::MoveView* mvView = GetUnusedMoveView();
-        mvView->ParseFromString(datas[0]);
-        auto f = [this, mvView](){
-          this->HandleMoveView( *mvView);
-          return (void*) true;
-        };
-        transport->DispatchTP_main(std::move(f));
-      }
-    } 
-    else {
-      Panic("Received unexpected message type: %s", typeArray[i].c_str());
+  struct ParseState {
+    std::atomic<size_t> next{0};
+    std::atomic<size_t> done{0};
+  };
+  auto state = std::make_shared<ParseState>();
+  const MessageView *views = &datas[start];
+  M **out = msgs.data();
+  auto parse = [state, views, out, n, chunks]() {
+    size_t c;
+    while ((c = state->next.fetch_add(1)) < chunks) {
+      size_t chunkEnd = std::min(n, (c + 1) * PARSE_CHUNK_SIZE);
+      for (size_t j = c * PARSE_CHUNK_SIZE; j < chunkEnd; j++) {
+        views[j].ParseInto(out[j]);
+      }
+      state->done.fetch_add(1, std::memory_order_release);
     }
-  }   
+    return (void*) true;
+  };
+  //Helpers that start after all chunks were claimed return without touching
+  //views or out.
+  for (size_t c = 1; c < chunks; c++) {
+    transport->DispatchTP_noCB(parse);
+  }
+  parse();
+  while (state->done.load(std::memory_order_acquire) < chunks) {
+    std::this_thread::yield();
+  }
 }
 
 //Adds new key-value store entry
@@ -809,9 +698,11 @@ void Server::Load(const std::string &key, const std::string &value,
     const Timestamp timestamp) {
   Value val;
   val.val = value;
-  auto committedItr = committed.find("");
-  UW_ASSERT(committedItr != committed.end());
-  val.proof = committedItr->second;
+  committedMap::const_accessor c;
+  bool found = committed.find(c, "");
+  UW_ASSERT(found);
+  val.proof = c->second;
+  c.release();
   store.put(key, val, timestamp);
   if (key.length() == 5 && key[0] == 0) {
     std::cerr << std::bitset<8>(key[0]) << ' '
@@ -823,11 +714,254 @@ void Server::Load(const std::string &key, const std::string &value,
   }
 }
 
+void Server::ReserveLoad(size_t numKeys) {
+  store.KVStore_Reserve(numKeys);
+}
+
+void Server::LoadBatch(std::vector<std::pair<std::string, std::string>> &kvs,
+    const Timestamp timestamp) {
+  committedMap::const_accessor c;
+  bool found = committed.find(c, "");
+  UW_ASSERT(found);
+  proto::CommittedProof *proof = c->second;
+  c.release();
+
+  std::vector<std::pair<std::string, Value>> vals(kvs.size());
+  for (size_t i = 0; i < kvs.size(); ++i) {
+    vals[i].first = std::move(kvs[i].first);
+    vals[i].second.val = std::move(kvs[i].second);
+    vals[i].second.proof = proof;
+  }
+  store.loadBatch(vals, timestamp);
+}
+
+// "INDICUS1": bump whenever a section's record encoding changes.
+static const uint64_t SNAPSHOT_FORMAT = 0x3153554349444e49ULL;
+
+enum SnapshotSection : uint32_t {
+  SNAPSHOT_PROOFS = 1,          // txn digest, serialized CommittedProof
+  SNAPSHOT_VERSIONS = 2,        // key, ts, value, proof index
+  SNAPSHOT_COMMITTED_READS = 3, // key, commit ts, read ts, proof index
+  SNAPSHOT_RTS = 4              // key, rts
+};
+
+static inline void PutTimestamp(SnapshotWriter &writer, const Timestamp &ts) {
+  writer.PutU64(ts.getTimestamp());
+  writer.PutU64(ts.getID());
+}
+
+static inline bool GetTimestamp(SnapshotReader::Cursor &cursor, Timestamp &ts) {
+  uint64_t t;
+  uint64_t id;
+  if (!cursor.GetU64(t) || !cursor.GetU64(id)) {
+    return false;
+  }
+  ts = Timestamp(t, id);
+  return true;
+}
+
+bool Server::WriteSnapshot(const std::string &path) {
+  uint64_t start = Stats::NowNs();
+  committedMap::const_accessor c;
+  bool found = committed.find(c, "");
+  UW_ASSERT(found);
+  const proto::CommittedProof *genesis = c->second;
+  c.release();
+
+  // A proof is shared by every version and read its txn committed, so it is
+  // written once and referenced by index. Index 0 is the genesis proof each
+  // replica creates for itself.
+  std::unordered_map<const proto::CommittedProof *, uint64_t> proofIdxs;
+  std::vector<const proto::CommittedProof *> proofs;
+  auto proofIdx = [&](const proto::CommittedProof *proof) -> uint64_t {
+    if (proof == nullptr || proof == genesis) {
+      return 0;
+    }
+    auto p = proofIdxs.emplace(proof, proofs.size() + 1);
+    if (p.second) {
+      proofs.push_back(proof);
+    }
+    return p.first->second;
+  };
+
+  SnapshotWriter writer(path, SNAPSHOT_FORMAT);
+  uint64_t numVersions = 0;
+  writer.BeginSection(SNAPSHOT_VERSIONS);
+  store.forEachVersion([&](const std::string &key, const Timestamp &ts,
+        const Value &val) {
+    writer.PutBytes(key);
+    PutTimestamp(writer, ts);
+    writer.PutBytes(val.val);
+    writer.PutU64(proofIdx(val.proof));
+    writer.EndRecord();
+    ++numVersions;
+  });
+
+  writer.BeginSection(SNAPSHOT_COMMITTED_READS);
+  for (const auto &reads : committedReads) {
+    for (const auto &read : reads.second.second) {
+      writer.PutBytes(reads.first);
+      PutTimestamp(writer, std::get<0>(read));
+      PutTimestamp(writer, std::get<1>(read));
+      writer.PutU64(proofIdx(std::get<2>(read)));
+      writer.EndRecord();
+    }
+  }
+
+  writer.BeginSection(SNAPSHOT_RTS);
+  for (const auto &r : rts) {
+    writer.PutBytes(r.first);
+    writer.PutU64(static_cast<uint64_t>(static_cast<int64_t>(r.second.load())));
+    writer.EndRecord();
+  }
+
+  // Proofs the GC already unlinked from committed have their digest recomputed.
+  std::unordered_map<const proto::CommittedProof *, const Digest *> digests;
+  for (const auto &c : committed) {
+    digests.emplace(c.second, &c.first);
+  }
+  writer.BeginSection(SNAPSHOT_PROOFS);
+  std::string proofBytes;
+  for (const auto proof : proofs) {
+    auto itr = digests.find(proof);
+    if (itr != digests.end()) {
+      writer.PutBytes(itr->second->data(), itr->second->size());
+    } else {
+      writer.PutBytes(TransactionDigest(proof->txn(), params.hashDigest));
+    }
+    proof->SerializeToString(&proofBytes);
+    writer.PutBytes(proofBytes);
+    writer.EndRecord();
+  }
+
+  if (!writer.Finish()) {
+    return false;
+  }
+  uint64_t ms = (Stats::NowNs() - start) / 1000000UL;
+  stats.Increment("snapshot_write_ms", ms);
+  Notice("Wrote snapshot %s with %lu versions and %lu proofs in %lu ms.",
+      path.c_str(), numVersions, proofs.size(), ms);
+  return true;
+}
+
+bool Server::LoadSnapshot(const std::string &path, size_t numThreads) {
+  uint64_t start = Stats::NowNs();
+  SnapshotReader reader;
+  if (!reader.Open(path, SNAPSHOT_FORMAT, numThreads)) {
+    return false;
+  }
+
+  committedMap::const_accessor c;
+  bool found = committed.find(c, "");
+  UW_ASSERT(found);
+  const proto::CommittedProof *genesis = c->second;
+  c.release();
+
+  // Checksums passed, so from here on a malformed record is a format bug and
+  // the partially loaded state cannot be used.
+  std::vector<const proto::CommittedProof *> proofs(
+      reader.NumRecords(SNAPSHOT_PROOFS) + 1, genesis);
+  bool ok = reader.ForEachChunk(SNAPSHOT_PROOFS, numThreads,
+      [&](const SnapshotReader::Chunk &chunk) {
+    SnapshotReader::Cursor cursor(chunk);
+    std::string digest;
+    const char *data;
+    uint32_t len;
+    for (uint64_t i = 0; i < chunk.numRecords; ++i) {
+      if (!cursor.GetBytes(digest) || !cursor.GetBytes(data, len)) {
+        return false;
+      }
+      proto::CommittedProof *proof = new proto::CommittedProof();
+      if (!proof->ParseFromArray(data, len)) {
+        delete proof;
+        return false;
+      }
+      committedMap::accessor a;
+      if (committed.insert(a, digest)) {
+        a->second = proof;
+      } else {
+        delete proof;
+      }
+      proofs[chunk.firstRecord + i + 1] = a->second;
+    }
+    return cursor.Done();
+  });
+
+  auto getProof = [&](SnapshotReader::Cursor &cursor,
+      const proto::CommittedProof *&proof) {
+    uint64_t idx;
+    if (!cursor.GetU64(idx) || idx >= proofs.size()) {
+      return false;
+    }
+    proof = proofs[idx];
+    return true;
+  };
+
+  ok = ok && reader.ForEachChunk(SNAPSHOT_VERSIONS, numThreads,
+      [&](const SnapshotReader::Chunk &chunk) {
+    SnapshotReader::Cursor cursor(chunk);
+    std::string key;
+    Timestamp ts;
+    Value val;
+    for (uint64_t i = 0; i < chunk.numRecords; ++i) {
+      if (!cursor.GetBytes(key) || !GetTimestamp(cursor, ts) ||
+          !cursor.GetBytes(val.val) || !getProof(cursor, val.proof)) {
+        return false;
+      }
+      store.put(key, val, ts);
+    }
+    return cursor.Done();
+  });
+
+  ok = ok && reader.ForEachChunk(SNAPSHOT_COMMITTED_READS, numThreads,
+      [&](const SnapshotReader::Chunk &chunk) {
+    SnapshotReader::Cursor cursor(chunk);
+    std::string key;
+    Timestamp ts;
+    Timestamp readTs;
+    const proto::CommittedProof *proof;
+    for (uint64_t i = 0; i < chunk.numRecords; ++i) {
+      if (!cursor.GetBytes(key) || !GetTimestamp(cursor, ts) ||
+          !GetTimestamp(cursor, readTs) || !getProof(cursor, proof)) {
+        return false;
+      }
+      std::pair<std::shared_mutex, std::set<committedRead>> &y = committedReads[key];
+      std::unique_lock lock(y.first);
+      y.second.emplace(ts, readTs, proof);
+    }
+    return cursor.Done();
+  });
+
+  ok = ok && reader.ForEachChunk(SNAPSHOT_RTS, numThreads,
+      [&](const SnapshotReader::Chunk &chunk) {
+    SnapshotReader::Cursor cursor(chunk);
+    std::string key;
+    uint64_t r;
+    for (uint64_t i = 0; i < chunk.numRecords; ++i) {
+      if (!cursor.GetBytes(key) || !cursor.GetU64(r)) {
+        return false;
+      }
+      rts[key] = static_cast<int>(static_cast<int64_t>(r));
+    }
+    return cursor.Done();
+  });
+
+  if (!ok) {
+    Panic("Snapshot %s is malformed.", path.c_str());
+  }
+  uint64_t ms = (Stats::NowNs() - start) / 1000000UL;
+  stats.Increment("snapshot_load_ms", ms);
+  Notice("Loaded snapshot %s with %lu versions in %lu ms.", path.c_str(),
+      reader.NumRecords(SNAPSHOT_VERSIONS), ms);
+  return true;
+}
+
 //Handle Read Message
 //Dispatches to reader thread if params.parallel_reads = true, and multithreading enabled
 //Returns a signed message including i) the latest committed write (+ cert), and ii) the latest prepared write (both w.r.t to Timestamp of reader)
 void Server::HandleRead(const TransportAddress &remote,
      proto::Read &msg) {
+  StatsTimer readTimer(stats, "lat_read");
 
   Debug("READ[%lu:%lu] for key %s with ts %lu.%lu.", msg.timestamp().id(),
       msg.req_id(), BytesToHex(msg.key(), 16).c_str(),
@@ -1006,7 +1140,8 @@ void Server::HandleRead(const TransportAddress &remote,
 }
 
 void Server::HandleRead_batch(const TransportAddress &remote,
-     proto::Read *read_msgs, int batch_size) {
+     const std::vector<proto::Read *> &read_msgs) {
+  int batch_size = read_msgs.size();
   
   Debug("Server::HandleRead_batch : batch_size: %d", batch_size);
 
@@ -1019,10 +1154,10 @@ void Server::HandleRead_batch(const TransportAddress &remote,
   std::vector<proto::SignedMessage *> smsgs;
 
   for (int i = 0; i < batch_size; i++){
-    Debug("READ[%lu:%lu] for key %s with ts %lu.%lu.", read_msgs[i].timestamp().id(),
-      read_msgs[i].req_id(), BytesToHex(read_msgs[i].key(), 16).c_str(),
-      read_msgs[i].timestamp().timestamp(), read_msgs[i].timestamp().id());
-    Timestamp ts(read_msgs[i].timestamp());
+    Debug("READ[%lu:%lu] for key %s with ts %lu.%lu.", read_msgs[i]->timestamp().id(),
+      read_msgs[i]->req_id(), BytesToHex(read_msgs[i]->key(), 16).c_str(),
+      read_msgs[i]->timestamp().timestamp(), read_msgs[i]->timestamp().id());
+    Timestamp ts(read_msgs[i]->timestamp());
 
     if (CheckHighWatermark(ts)) {
       // ignore request if beyond high watermark
@@ -1032,15 +1167,15 @@ void Server::HandleRead_batch(const TransportAddress &remote,
 
     std::pair<Timestamp, Server::Value> tsVal;
     //find committed write value to read from
-    bool exists = store.get(read_msgs[i].key(), ts, tsVal);
+    bool exists = store.get(read_msgs[i]->key(), ts, tsVal);
 
     proto::ReadReply* readReply = GetUnusedReadReply();
-    readReply->set_req_id(read_msgs[i].req_id());
-    readReply->set_key(read_msgs[i].key());
+    readReply->set_req_id(read_msgs[i]->req_id());
+    readReply->set_key(read_msgs[i]->key());
 
     if (exists) {
       Debug("READ[%lu:%lu] Committed value of length %lu bytes with ts %lu.%lu.",
-        read_msgs[i].timestamp().id(), read_msgs[i].req_id(), tsVal.second.val.length(), tsVal.first.getTimestamp(),
+        read_msgs[i]->timestamp().id(), read_msgs[i]->req_id(), tsVal.second.val.length(), tsVal.first.getTimestamp(),
         tsVal.first.getID());
       readReply->mutable_write()->set_committed_value(tsVal.second.val);
       tsVal.first.serialize(readReply->mutable_write()->mutable_committed_timestamp());
@@ -1054,15 +1189,15 @@ void Server::HandleRead_batch(const TransportAddress &remote,
   
       //Sets RTS timestamp. Favors readers commit chances.
       //Disable if worried about Byzantine Readers DDos, or if one wants to favor writers.
-      Debug("Set up RTS for READ[%lu:%lu]", read_msgs[i].timestamp().id(), read_msgs[i].req_id());
-      auto itr = rts.find(read_msgs[i].key());
+      Debug("Set up RTS for READ[%lu:%lu]", read_msgs[i]->timestamp().id(), read_msgs[i]->req_id());
+      auto itr = rts.find(read_msgs[i]->key());
       if(itr != rts.end()){
         if(ts.getTimestamp() > itr->second ) {
-          rts[read_msgs[i].key()] = ts.getTimestamp();
+          rts[read_msgs[i]->key()] = ts.getTimestamp();
         }
       }
       else{
-        rts[read_msgs[i].key()] = ts.getTimestamp();
+        rts[read_msgs[i]->key()] = ts.getTimestamp();
       }
       /* update rts */
       // TODO: For "proper Aborts": how to track RTS by transaction without knowing transaction digest?
@@ -1078,11 +1213,11 @@ void Server::HandleRead_batch(const TransportAddress &remote,
       /* add prepared deps */
       
       if (params.maxDepDepth > -2) {
-        Debug("Look for prepared value to READ[%lu:%lu]", read_msgs[i].timestamp().id(), read_msgs[i].req_id());
+        Debug("Look for prepared value to READ[%lu:%lu]", read_msgs[i]->timestamp().id(), read_msgs[i]->req_id());
         const proto::Transaction *mostRecent = nullptr;
 
         //std::pair<std::shared_mutex,std::map<Timestamp, const proto::Transaction *>> &x = preparedWrites[write.key()];
-        auto itr = preparedWrites.find(read_msgs[i].key());
+        auto itr = preparedWrites.find(read_msgs[i]->key());
         if (itr != preparedWrites.end()){
 
           //std::pair &x = preparedWrites[write.key()];
@@ -1099,7 +1234,7 @@ void Server::HandleRead_batch(const TransportAddress &remote,
             if (mostRecent != nullptr) {
               std::string preparedValue;
               for (const auto &w : mostRecent->write_set()) {
-                if (w.key() == read_msgs[i].key()) {
+                if (w.key() == read_msgs[i]->key()) {
                   preparedValue = w.value();
                   break;
                 }
@@ -1122,7 +1257,7 @@ void Server::HandleRead_batch(const TransportAddress &remote,
   }
 
   if (params.validateProofs && params.signedMessages){
-    //Debug("Sign Read Reply for READ[%lu:%lu]", read_msgs[i].timestamp().id(), read_msgs[i].req_id());
+    //Debug("Sign Read Reply for READ[%lu:%lu]", read_msgs[i]->timestamp().id(), read_msgs[i]->req_id());
     //If readReplyBatch is false then respond immediately, otherwise respect batching policy
     if (params.readReplyBatch) {
       for (int i = 0; i < batch_size; i++){
@@ -1207,7 +1342,9 @@ void Server::HandlePhase1_atomic(const TransportAddress &remote,
   //NOTE: Ongoing *must* be added before p2/wb since the latter dont include it themselves as an optimization
   //TCP guarantees that this happens, but I cannot dispatch parallel P1 before logging ongoing or else it could be ordered after p2/wb.
   ongoingMap::accessor b;
-  ongoing.insert(b, std::make_pair(txnDigest, txn));
+  if (ongoing.insert(b, std::make_pair(txnDigest, txn))) {
+    TrackOngoing(txn);
+  }
   b.release();
 
   //NOTE: "Problem": If client comes after writeback, it will try to do a p2/wb itself but fail
@@ -1444,7 +1581,9 @@ void Server::HandlePhase1(const TransportAddress &remote,
 
      // //if(params.mainThreadDispatching) ongoingMutex.lock();
      ongoingMap::accessor b;
-     ongoing.insert(b, std::make_pair(txnDigest, txn));
+     if (ongoing.insert(b, std::make_pair(txnDigest, txn))) {
+       TrackOngoing(txn);
+     }
      b.release();
      //normal.insert(txnDigest);
      //std::cerr << "[N] Added tx to ongoing: " << BytesToHex(txnDigest, 16) << std::endl;
@@ -1487,161 +1626,107 @@ void Server::HandlePhase1(const TransportAddress &remote,
   HandlePhase1CB(&msg, result, committedProof, txnDigest, remote, abstain_conflict, replicaGossip);
 }
 
+//Batched variant of HandlePhase1 for a run of P1 messages from the same remote.
+//Does the per message bookkeeping of HandlePhase1, then checks all fresh transactions
+//of the run together (DoOCCCheck_batch) and answers them with a single reply batch.
 void Server::HandlePhase1_batch(const TransportAddress &remote,
-    proto::Phase1 *msgs, int batch_size) {
-  //dummyTx = msg.txn(); //PURELY TESTING PURPOSES!!: NOTE WARNING
-  std::vector<std::string> txnDigests;
-  std::vector<proto::ConcurrencyControl::Result> results;
-  std::vector<const proto::CommittedProof *> committedProofs;
-  const proto::Transaction *abstain_conflict = nullptr;
-  std::vector<proto::Transaction *> txnBatch;
-  std::vector<proto::Phase1> msgs_copy;
-
-  bool replicaGossip = false;
-  if (params.replicaGossip){
-    replicaGossip = true;
-  }
-
-  Debug("HandlePhase1_batch : req_id():%d", msgs[0].req_id());
-
-  for(int i = 0; i < batch_size; i++){
-    std::string txnDigest = TransactionDigest(msgs[i].txn(), params.hashDigest); //could parallelize it too hypothetically
-    txnDigests.push_back(txnDigest);
-    //if(waiting.count(txnDigest) > 0){ Panic("P1 did eventually arrive");}
-    Debug("HandlePhase1_batch : req_id():%d", msgs[0].req_id());
-    Debug("PHASE1[%lu:%lu][%s] with ts %lu.", msgs[i].txn().client_id(),
-        msgs[i].txn().client_seq_num(), BytesToHex(txnDigest, 16).c_str(),
-        msgs[i].txn().timestamp().timestamp());
-    proto::ConcurrencyControl::Result result;
-    const proto::CommittedProof *committedProof;
-    if(msgs[i].has_crash_failure() && msgs[i].crash_failure()){
+    const std::vector<proto::Phase1 *> &msgs) {
+  size_t batch_size = msgs.size();
+  std::vector<std::string> txnDigests(batch_size);
+  std::vector<proto::Transaction *> txns(batch_size, nullptr); //only set for txns that still need a check
+  //WAIT doubles as "no reply": gossiped duplicates and invalid messages keep it.
+  std::vector<proto::ConcurrencyControl::Result> results(batch_size, proto::ConcurrencyControl::WAIT);
+  std::vector<const proto::CommittedProof *> committedProofs(batch_size, nullptr);
+  std::vector<const proto::Transaction *> abstainConflicts(batch_size, nullptr);
+  bool anyFresh = false;
+
+  for(size_t i = 0; i < batch_size; i++){
+    proto::Phase1 &msg = *msgs[i];
+    txnDigests[i] = TransactionDigest(msg.txn(), params.hashDigest);
+    const std::string &txnDigest = txnDigests[i];
+    Debug("PHASE1[%lu:%lu][%s] with ts %lu.", msg.txn().client_id(),
+        msg.txn().client_seq_num(), BytesToHex(txnDigest, 16).c_str(),
+        msg.txn().timestamp().timestamp());
+
+    if(msg.has_crash_failure() && msg.crash_failure()){
       stats.Increment("total_crash_received", 1);
     }
-    //add to ongoing, lock ongoing and send to all when done.
+    bool replicaGossip = msg.replica_gossip();
+
     p1MetaDataMap::const_accessor c;
-    //std::cerr << "[Normal] acquire lock for txn: " << BytesToHex(txnDigest, 64) << std::endl;
-    //p1MetaDataMap::const_accessor c;
-    p1MetaData.insert(c, txnDigest);  //TODO: next: make P1 part of ongoing? same for P2?
-    //c->second.P1meta_mutex.lock();
+    p1MetaData.insert(c, txnDigest);
     bool hasP1 = c->second.hasP1;
-
-    if(hasP1 && replicaGossip){  // If P1 has already been received and current message is a gossip one, do nothing.
-    //Do not need to reply to forwarded P1. If adding replica GC -> want to forward it to leader.
-    //Inform_P1_GC_Leader(proto::Phase1Reply &reply, proto::Transaction &txn, std::string &txnDigest, int64_t grpLeader);
+    if(hasP1 && replicaGossip){ // Already received, and a forwarded P1 needs no reply.
+      c.release();
     }
-    else if(hasP1){ // If P1 has already been received (sent by a fallback) and current message is from original client, then only inform client of blocked dependencies so it can issue fallbacks of its own
-      result = c->second.result;
-      // need to check if result is WAIT: if so, need to add to waitingDeps original client..
-        //(TODO) Instead: use original client list and store pairs <txnDigest, <reqID, remote>>
-      if(result == proto::ConcurrencyControl::WAIT){
-        ManageDependencies(txnDigest, msgs[i].txn(), remote, msgs[i].req_id());
+    else if(hasP1){ // Already received (e.g. from a fallback): only reply with the buffered result.
+      results[i] = c->second.result;
+      if(results[i] == proto::ConcurrencyControl::WAIT){
+        ManageDependencies(txnDigest, msg.txn(), remote, msg.req_id());
       }
-
-      if (result == proto::ConcurrencyControl::ABORT) {
-        committedProof = c->second.conflict;
-        UW_ASSERT(committedProof != nullptr);
+      if (results[i] == proto::ConcurrencyControl::ABORT) {
+        committedProofs[i] = c->second.conflict;
+        UW_ASSERT(committedProofs[i] != nullptr);
       }
       c.release();
-      results.push_back(result);
-      committedProofs.push_back(committedProof);
     }
-    else{ // FIRST P1 request received (i.e. from original client). Gossip if desired and check whether dependencies are valid
-    Debug("HandlePhase1_batch : req_id():%d", msgs[0].req_id());
+    else{ // FIRST P1 request received. Gossip if desired and check whether dependencies are valid
       c.release();
-      if(params.replicaGossip) ForwardPhase1(msgs[i]); //If params.replicaGossip is enabled then set msg.replica_gossip to true and forward.
-      if(!replicaGossip) msgs[i].set_replica_gossip(false); //unset msg.replica_gossip (which we possibly just set to foward) if the message was received by the client
+      if(params.replicaGossip) ForwardPhase1(msg);
+      if(!replicaGossip) msg.set_replica_gossip(false);
 
+      bool validDeps = true;
       if (params.validateProofs && params.signedMessages && params.verifyDeps) {
-        for (const auto &dep : msgs[i].txn().deps()) {
-      //  for (const auto &dep : txn->deps()) {
+        for (const auto &dep : msg.txn().deps()) {
           if (!dep.has_write_sigs()) {
             Debug("Dep for txn %s missing signatures.", BytesToHex(txnDigest, 16).c_str());
-            if(params.mainThreadDispatching && (!params.dispatchMessageReceive || params.parallel_CCC)) FreePhase1message(&(msgs[i]));
-            return;
+            validDeps = false;
+            break;
           }
           if (!ValidateDependency(dep, &config, params.readDepSize, keyManager, verifier)) {
             Debug("VALIDATE Dependency failed for txn %s.", BytesToHex(txnDigest, 16).c_str());
             // safe to ignore Byzantine client
-            if(params.mainThreadDispatching && (!params.dispatchMessageReceive || params.parallel_CCC)) FreePhase1message(&(msgs[i]));
-            return;
+            validDeps = false;
+            break;
           }
         }
       }
-      //current_views[txnDigest] = 0;
+      if(!validDeps) continue;
+
       p2MetaDataMap::accessor p;
       p2MetaDatas.insert(p, txnDigest);
       p.release();
 
-      proto::Transaction *txn = msgs[i].release_txn();
-
-      txnBatch.push_back(txn);
-
-      // if(params.mainThreadDispatching) ongoingMutex.lock();
+      proto::Transaction *txn = msg.release_txn();
       ongoingMap::accessor b;
-      ongoing.insert(b, std::make_pair(txnDigest, txn));
-      b.release();
-      //normal.insert(txnDigest);
-      //std::cerr << "[N] Added tx to ongoing: " << BytesToHex(txnDigest, 16) << std::endl;
-      // //ongoing[txnDigest] = txn;
-      // if(params.mainThreadDispatching) ongoingMutex.unlock();
-      Timestamp retryTs;
-      Debug("HandlePhase1_batch : req_id():%d", msgs[0].req_id());
-      //この条件に合致するのは、parallel_CCCがtrueかつ、mainthreadDispathching がtrue
-      if(!params.parallel_CCC || !params.mainThreadDispatching){
-        //ここを通るはず
-        result = DoOCCCheck(msgs[i].req_id(), remote, txnDigest, *txn, retryTs,
-          committedProof, abstain_conflict, false, replicaGossip); //forwarded messages dont need to be treated as original client.
-        BufferP1Result(result, committedProof, txnDigest);
-        results.push_back(result);
-        committedProofs.push_back(committedProof);
+      if (ongoing.insert(b, std::make_pair(txnDigest, txn))) {
+        TrackOngoing(txn);
       }
+      b.release();
+      txns[i] = txn;
+      anyFresh = true;
     }
-    msgs_copy.push_back(msgs[i]);
   }
-  Debug("HandlePhase1_batch : req_id():%d", msgs[0].req_id());
-  if (params.no_fallback || !replicaGossip){
-    if (params.parallel_CCC && params.mainThreadDispatching){
-      
-        auto f = [this, msgs_copy, remote_ptr = &remote, txnDigests, txnBatch, committedProofs, abstain_conflict, replicaGossip, batch_size]() mutable {
-          std::vector<proto::ConcurrencyControl::Result> results;
-          for(int i = 0; i < batch_size; i++){
-            Timestamp retryTs;
-            //check if concurrently committed/aborted already, and if so return
-            ongoingMap::const_accessor b;
-            if(!ongoing.find(b, txnDigests[i])){
-              Debug("Already concurrently Committed/Aborted txn[%s]", BytesToHex(txnDigests[i], 16).c_str());
-              return (void*) false;
-            }
-            b.release();
-            Debug("starting occ check for txn: %s", BytesToHex(txnDigests[i], 16).c_str());
-            Debug("HandlePhase1_batch : req_id():%d", msgs_copy[i].req_id());
-            const indicusstore::proto::CommittedProof * committedProof;
-            proto::ConcurrencyControl::Result *result = new proto::ConcurrencyControl::Result(this->DoOCCCheck(msgs_copy[i].req_id(),
-                *remote_ptr, txnDigests[i], *(txnBatch[i]), retryTs, committedProof, abstain_conflict, false, replicaGossip));
-            Debug("end occ check");
-            Debug("HandlePhase1_batch : req_id():%d", msgs_copy[i].req_id());
-            results.push_back(*result);
-            BufferP1Result(*result, committedProof, txnDigests[i]);
-            committedProofs.push_back(committedProof);
-            //c->second.P1meta_mutex.unlock();
-            //std::cerr << "[Normal] release lock for txn: " << BytesToHex(txnDigest, 64) << std::endl;
-          }
-          /*
-          for (int i = 0; i < batch_size; i++){
-            Debug("HandlePhase1_batch : req_id():%d",msgs_copy[i].req_id());
-          }
-          */
-          HandlePhase1CB_batch_multi(msgs_copy, results, committedProofs, txnDigests, *remote_ptr, abstain_conflict, replicaGossip);
 
-          return (void*) true;
-          
-        };
-        transport->DispatchTP_noCB(std::move(f));
-        return;
-    }
-    else {
-      HandlePhase1CB_batch(msgs, results, committedProofs, txnDigests, remote, abstain_conflict, replicaGossip);
-    }
+  if(!anyFresh){
+    HandlePhase1CB_batch(msgs, results, committedProofs, abstainConflicts, txnDigests, remote);
+    return;
+  }
+
+  if(!params.parallel_CCC || !params.mainThreadDispatching){
+    DoOCCCheck_batch(msgs, remote, txnDigests, txns, results, committedProofs, abstainConflicts);
+    HandlePhase1CB_batch(msgs, results, committedProofs, abstainConflicts, txnDigests, remote);
+  }
+  else{
+    auto f = [this, msgs, remote_ptr = &remote,
+        txnDigests = std::move(txnDigests), txns = std::move(txns),
+        results = std::move(results), committedProofs = std::move(committedProofs),
+        abstainConflicts = std::move(abstainConflicts)]() mutable {
+      DoOCCCheck_batch(msgs, *remote_ptr, txnDigests, txns, results, committedProofs, abstainConflicts);
+      HandlePhase1CB_batch(msgs, results, committedProofs, abstainConflicts, txnDigests, *remote_ptr);
+      return (void*) true;
+    };
+    transport->DispatchTP_noCB(std::move(f));
   }
 }
 
@@ -1665,75 +1750,41 @@ void Server::HandlePhase1CB(proto::Phase1 *msg, proto::ConcurrencyControl::Resul
   if(params.mainThreadDispatching && (!params.dispatchMessageReceive || params.parallel_CCC)) FreePhase1message(msg);
 }
 
-//Called after Concurrency Control Check completes
-//Sends P1Reply to client. Sends no reply if P1 receives was simply forwarded by another replica.
-//TODO: move p1Decision into this function (not sendp1: Then, can unlock here.)
-void Server::HandlePhase1CB_batch(proto::Phase1 *msgs, std::vector<proto::ConcurrencyControl::Result> &results,
-  std::vector<const proto::CommittedProof*> &committedProofs, std::vector<std::string> &txnDigests, const TransportAddress &remote, const proto::Transaction *abstain_conflict, bool replicaGossip){
-  
-  Debug("HandlePhase1CB_batch start");
-  std::vector<uint64_t> reqIds;
+//Batched variant of HandlePhase1CB: replies to all messages of the run that have a
+//final result and were not merely forwarded by another replica, then frees the run.
+void Server::HandlePhase1CB_batch(const std::vector<proto::Phase1 *> &msgs,
+  std::vector<proto::ConcurrencyControl::Result> &results,
+  std::vector<const proto::CommittedProof*> &committedProofs,
+  std::vector<const proto::Transaction*> &abstainConflicts,
+  std::vector<std::string> &txnDigests, const TransportAddress &remote){
 
-  int batchSize = results.size();
-
-  for(int i = 0; i < batchSize; i++){
-    reqIds.push_back(msgs[i].req_id());
-    Debug("HandlePhase1CB_batch : req_id : %d\n", reqIds[i]);
-    if (results[i] == proto::ConcurrencyControl::WAIT || replicaGossip){
-      results.erase(results.begin()+i);
-      committedProofs.erase(committedProofs.begin()+i);
-      txnDigests.erase(txnDigests.begin()+i);
-      reqIds.erase(reqIds.begin()+i);
-      batchSize--;
-    }
-  }
-
-  if (batchSize == 0){
-    return;
-  }
-  else {
-    SendPhase1Reply_batch(reqIds, results, committedProofs, txnDigests, &remote, abstain_conflict);
-  }
-
-}
-
-void Server::HandlePhase1CB_batch_multi(std::vector<proto::Phase1> &msgs, std::vector<proto::ConcurrencyControl::Result> &results,
-  std::vector<const proto::CommittedProof*> &committedProofs, std::vector<std::string> &txnDigests, const TransportAddress &remote, const proto::Transaction *abstain_conflict, bool replicaGossip){
-
- //replicagossipがtrueになっている。
-  
-  Debug("HandlePhase1CB_batch start");
+  Debug("HandlePhase1CB_batch of %lu messages", msgs.size());
   std::vector<uint64_t> reqIds;
-
-  int batchSize = results.size();
-
-  int wait_tx = 0;
-
-  for (int i = 0; i < batchSize; i++){
-    reqIds.push_back(msgs[i].req_id());
-    Debug("HandlePhase1CB_batch : req_id : %d\n", reqIds[i]);
-  }
-
-
-  for(int i = 0; i < batchSize; i++){
-    if (results[i - wait_tx] == proto::ConcurrencyControl::WAIT || replicaGossip){
-      Debug("results[i] == proto::ConcurrencyControl::WAIT || replicaGossip");
-      results.erase(results.begin() + i - wait_tx);
-      committedProofs.erase(committedProofs.begin() + i - wait_tx);
-      txnDigests.erase(txnDigests.begin() + i - wait_tx);
-      reqIds.erase(reqIds.begin() + i - wait_tx);
-      wait_tx++;
+  size_t numReplies = 0;
+  for(size_t i = 0; i < msgs.size(); i++){
+    if (results[i] == proto::ConcurrencyControl::WAIT || msgs[i]->replica_gossip()){
+      continue;
     }
+    reqIds.push_back(msgs[i]->req_id());
+    results[numReplies] = results[i];
+    committedProofs[numReplies] = committedProofs[i];
+    abstainConflicts[numReplies] = abstainConflicts[i];
+    if (numReplies != i) txnDigests[numReplies] = std::move(txnDigests[i]);
+    numReplies++;
   }
+  results.resize(numReplies);
+  committedProofs.resize(numReplies);
+  abstainConflicts.resize(numReplies);
+  txnDigests.resize(numReplies);
 
-  if (results.size() == 0){
-    Debug("if");
+  if (numReplies > 0){
+    SendPhase1Reply_batch(reqIds, results, committedProofs, txnDigests, &remote, abstainConflicts);
   }
-  else {
-    Debug("else");
-    SendPhase1Reply_batch(reqIds, results, committedProofs, txnDigests, &remote, abstain_conflict);
+  if(params.mainThreadDispatching && (!params.dispatchMessageReceive || params.parallel_CCC)){
+    for (auto msg : msgs) {
+      FreePhase1message(msg);
+    }
   }
-
 }
 
 //Sends a signed P2 reply to the client, containing Commit/Abort respectively. 
@@ -1866,6 +1917,7 @@ void Server::SendPhase2Reply(proto::Phase2 *msg, proto::Phase2Reply *phase2Reply
 //Dispatches verification to worker threads if multiThreading enabled.
 void Server::HandlePhase2(const TransportAddress &remote,
        proto::Phase2 &msg) {
+  StatsTimer p2Timer(stats, "lat_p2");
 
 //  std::cerr << "Received Phase2 msg with special id: " << msg.req_id() << std::endl;
 
@@ -1947,13 +1999,13 @@ void Server::HandlePhase2(const TransportAddress &remote,
   //TODO: Replace both Commit/Abort check with ForwardWriteback at some point. (this should happen before the hasP2 case then.)
   //NOTE: Either approach only works if atomicity of adding to committed/aborted and removing from ongoing is given.
           //Currently, this is that case as HandlePhase2 and WritebackCB are always on the same thread.
-  else if(committed.find(*txnDigest) != committed.end()){
+  else if(committed.count(*txnDigest) > 0){
       p.release();
       phase2Reply->mutable_p2_decision()->set_decision(proto::COMMIT);
       phase2Reply->mutable_p2_decision()->set_view(0);
       SendPhase2Reply(&msg, phase2Reply, std::move(sendCB));
   }
-  else if(aborted.find(*txnDigest) != aborted.end()){
+  else if(aborted.count(*txnDigest) > 0){
       p.release();
       phase2Reply->mutable_p2_decision()->set_decision(proto::ABORT);
       phase2Reply->mutable_p2_decision()->set_view(0);
@@ -2087,7 +2139,7 @@ void Server::HandlePhase2(const TransportAddress &remote,
 //Updates committed/aborted datastructures and key-value store accordingly
 //Garbage collects ongoing meta-data
 void Server::WritebackCallback(proto::Writeback *msg, const std::string* txnDigest,
-  proto::Transaction* txn, void* valid){
+  proto::Transaction* txn, void* valid, bool grouped){
 
   if(!valid){
     Debug("VALIDATE Writeback for TX %s failed.", BytesToHex(*txnDigest, 16).c_str());
@@ -2097,7 +2149,7 @@ void Server::WritebackCallback(proto::Writeback *msg, const std::string* txnDige
     return;
   }
 
-  auto f = [this, msg, txnDigest, txn, valid]() mutable {
+  auto f = [this, msg, txnDigest, txn, valid, grouped]() mutable {
       Debug("WRITEBACK Callback[%s] being called", BytesToHex(*txnDigest, 16).c_str());
 
       ///////////////////////////// Below: Only executed by MainThread
@@ -2106,13 +2158,19 @@ void Server::WritebackCallback(proto::Writeback *msg, const std::string* txnDige
       // //z->second.lock();
       // z.release();
 
-      if(committed.find(*txnDigest) != committed.end() || aborted.find(*txnDigest) != aborted.end()){
+      if(committed.count(*txnDigest) > 0 || aborted.count(*txnDigest) > 0){
         //duplicate, do nothing. TODO: Forward to all interested clients and empty it?
         Debug("duplicate transaction");
       }
+      else if (msg->decision() == proto::COMMIT && txn != nullptr && GCReclaimed(*txn)) {
+        //decided long ago and already reclaimed; committing again would
+        //bring back pruned versions.
+        Debug("WRITEBACK[%s] below the GC watermark.", BytesToHex(*txnDigest, 16).c_str());
+        stats.Increment("gc_late_writebacks", 1);
+      }
       else if (msg->decision() == proto::COMMIT) {
-        stats.Increment("total_transactions", 1);
-        stats.Increment("total_transactions_commit", 1);
+        stats.Increment(STAT_TOTAL_TRANSACTIONS, 1);
+        stats.Increment(STAT_TOTAL_TRANSACTIONS_COMMIT, 1);
         Debug("WRITEBACK[%s] successfully committing.", BytesToHex(*txnDigest, 16).c_str());
         bool p1Sigs = msg->has_p1_sigs();
         uint64_t view = -1;
@@ -2128,10 +2186,16 @@ void Server::WritebackCallback(proto::Writeback *msg, const std::string* txnDige
           }
         }
         Debug("COMMIT ONLY RUN BY MAINTHREAD: %d", sched_getcpu());
-        Commit(*txnDigest, txn, p1Sigs ? msg->release_p1_sigs() : msg->release_p2_sigs(), p1Sigs, view);
+        proto::GroupedSignatures *groupedSigs = p1Sigs ? msg->release_p1_sigs() : msg->release_p2_sigs();
+        if(grouped){
+          StageCommit({*txnDigest, txn, groupedSigs, p1Sigs, view});
+        }
+        else{
+          Commit(*txnDigest, txn, groupedSigs, p1Sigs, view);
+        }
       } else {
-        stats.Increment("total_transactions", 1);
-        stats.Increment("total_transactions_abort", 1);
+        stats.Increment(STAT_TOTAL_TRANSACTIONS, 1);
+        stats.Increment(STAT_TOTAL_TRANSACTIONS_ABORT, 1);
         Debug("WRITEBACK[%s] successfully aborting.", BytesToHex(*txnDigest, 16).c_str());
         //msg->set_allocated_txn(txn); //dont need to set since client will?
         //writebackMessages[*txnDigest] = *msg;  //Only necessary for fallback... (could avoid storing these, if one just replied with a p2 vote instea - but that is not as responsive)
@@ -2159,9 +2223,9 @@ void Server::WritebackCallback(proto::Writeback *msg, const std::string* txnDige
 //Verifies correctness of request (quorum of P1replies or P2 replies depending on Fast/Slow Path)
 //Dispatches verification to worker threads if multiThreading enabled
 void Server::HandleWriteback(const TransportAddress &remote,
-    proto::Writeback &msg) {
+    proto::Writeback &msg, bool grouped) {
   Debug("handlewriteback start");
-  stats.Increment("total_writeback_received", 1);
+  stats.Increment(STAT_TOTAL_WRITEBACK_RECEIVED, 1);
   //simulating failures in local experiment
   // fail_writeback++;
   // if(fail_writeback %2 == 1){
@@ -2180,7 +2244,7 @@ void Server::HandleWriteback(const TransportAddress &remote,
   if (msg.has_txn_digest() ) {
     txnDigest = &msg.txn_digest();
 
-    if(committed.find(*txnDigest) != committed.end() || aborted.find(*txnDigest) != aborted.end()){
+    if(committed.count(*txnDigest) > 0 || aborted.count(*txnDigest) > 0){
       if(params.multiThreading || (params.mainThreadDispatching && !params.dispatchMessageReceive)){
         Clean(*txnDigest); //XXX Clean again since client could have added it back to ongoing...
         FreeWBmessage(&msg);
@@ -2220,7 +2284,7 @@ void Server::HandleWriteback(const TransportAddress &remote,
     computedTxnDigest = TransactionDigest(msg.txn(), params.hashDigest);
     txnDigest = &computedTxnDigest;
 
-    if(committed.find(*txnDigest) != committed.end() || aborted.find(*txnDigest) != aborted.end()){
+    if(committed.count(*txnDigest) > 0 || aborted.count(*txnDigest) > 0){
       if(params.multiThreading || (params.mainThreadDispatching && !params.dispatchMessageReceive)){
         Clean(*txnDigest); //XXX Clean again since client could have added it back to ongoing...
         FreeWBmessage(&msg);
@@ -2240,10 +2304,10 @@ void Server::HandleWriteback(const TransportAddress &remote,
 
           Debug("1: TAKING MULTITHREADING BRANCH, generating MCB");
           mainThreadCallback mcb(std::bind(&Server::WritebackCallback, this, &msg,
-            txnDigest, txn, std::placeholders::_1));
+            txnDigest, txn, std::placeholders::_1, grouped));
 
           if(params.signedMessages && msg.decision() == proto::COMMIT && msg.has_p1_sigs()){
-            stats.Increment("total_transactions_fast_commit", 1);
+            stats.Increment(STAT_TOTAL_TRANSACTIONS_FAST_COMMIT, 1);
             int64_t myProcessId;
             proto::ConcurrencyControl::Result myResult;
             LookupP1Decision(*txnDigest, myProcessId, myResult);
@@ -2284,7 +2348,7 @@ void Server::HandleWriteback(const TransportAddress &remote,
           }
 
           else if (params.signedMessages && msg.has_p2_sigs()) {
-             stats.Increment("total_transactions_slow", 1);
+             stats.Increment(STAT_TOTAL_TRANSACTIONS_SLOW, 1);
               // require clients to include view for easier matching
               if(!msg.has_p2_view()) return;
               int64_t myProcessId;
@@ -2335,7 +2399,7 @@ void Server::HandleWriteback(const TransportAddress &remote,
             LookupP1Decision(*txnDigest, myProcessId, myResult);
 
             if(params.batchVerification){
-              mainThreadCallback mcb(std::bind(&Server::WritebackCallback, this, &msg, txnDigest, txn, std::placeholders::_1));
+              mainThreadCallback mcb(std::bind(&Server::WritebackCallback, this, &msg, txnDigest, txn, std::placeholders::_1, grouped));
               asyncBatchValidateP1Replies(proto::COMMIT,
                     true, txn, txnDigest,msg.p1_sigs(), keyManager, &config, myProcessId,
                     myResult, verifier, std::move(mcb), transport, false);
@@ -2356,7 +2420,7 @@ void Server::HandleWriteback(const TransportAddress &remote,
             LookupP1Decision(*txnDigest, myProcessId, myResult);
 
             if(params.batchVerification){
-              mainThreadCallback mcb(std::bind(&Server::WritebackCallback, this, &msg, txnDigest, txn, std::placeholders::_1));
+              mainThreadCallback mcb(std::bind(&Server::WritebackCallback, this, &msg, txnDigest, txn, std::placeholders::_1, grouped));
               asyncBatchValidateP1Replies(proto::ABORT,
                     true, txn, txnDigest,msg.p1_sigs(), keyManager, &config, myProcessId,
                     myResult, verifier, std::move(mcb), transport, false);
@@ -2380,7 +2444,7 @@ void Server::HandleWriteback(const TransportAddress &remote,
 
 
             if(params.batchVerification){
-              mainThreadCallback mcb(std::bind(&Server::WritebackCallback, this, &msg, txnDigest, txn, std::placeholders::_1));
+              mainThreadCallback mcb(std::bind(&Server::WritebackCallback, this, &msg, txnDigest, txn, std::placeholders::_1, grouped));
               asyncBatchValidateP2Replies(msg.decision(), msg.p2_view(),
                     txn, txnDigest, msg.p2_sigs(), keyManager, &config, myProcessId,
                     myDecision, verifier, std::move(mcb), transport, false);
@@ -2400,7 +2464,7 @@ void Server::HandleWriteback(const TransportAddress &remote,
                 params.hashDigest);
 
                 if(params.batchVerification){
-                  mainThreadCallback mcb(std::bind(&Server::WritebackCallback, this, &msg, txnDigest, txn, std::placeholders::_1));
+                  mainThreadCallback mcb(std::bind(&Server::WritebackCallback, this, &msg, txnDigest, txn, std::placeholders::_1, grouped));
                   asyncValidateCommittedConflict(msg.conflict(), &committedTxnDigest, txn,
                         txnDigest, params.signedMessages, keyManager, &config, verifier,
                         std::move(mcb), transport, false, params.batchVerification);
@@ -2411,286 +2475,32 @@ void Server::HandleWriteback(const TransportAddress &remote,
                         txnDigest, params.signedMessages, keyManager, &config, verifier)) {
                     Debug("WRITEBACK[%s] Failed to validate committed conflict for fast abort.",
                         BytesToHex(*txnDigest, 16).c_str());
-                    return WritebackCallback(&msg, txnDigest, txn, (void*) false);
-                }
-
-            }
-          } else if (params.signedMessages) {
-            Debug("WRITEBACK[%s] decision %d, has_p1_sigs %d, has_p2_sigs %d, and"
-                " has_conflict %d.", BytesToHex(*txnDigest, 16).c_str(),
-                msg.decision(), msg.has_p1_sigs(), msg.has_p2_sigs(), msg.has_conflict());
-            return WritebackCallback(&msg, txnDigest, txn, (void*) false);
-          }
-       }
-
-  }
-  WritebackCallback(&msg, txnDigest, txn, (void*) true);
-}
-
-void Server::HandleWriteback_batch(const TransportAddress &remote,
-     proto::Writeback *msgs, int batch_size) {
-  stats.Increment("total_writeback_received", 1);
-  //simulating failures in local experiment
-  // fail_writeback++;
-  // if(fail_writeback %2 == 1){
-  //   return;
-  // }
-
-  for(int i = 0; i < batch_size; i++){
-    proto::Transaction *txn;
-    const std::string *txnDigest;
-    std::string computedTxnDigest;
-    if (!msgs[i].has_txn() && !msgs[i].has_txn_digest()) {
-      Debug("WRITEBACK message contains neither txn nor txn_digest.");
-      return WritebackCallback(&msgs[i], txnDigest, txn, (void*) false);
-    }
-
-    if (msgs[i].has_txn_digest() ) {
-      txnDigest = &msgs[i].txn_digest();
-
-      if(committed.find(*txnDigest) != committed.end() || aborted.find(*txnDigest) != aborted.end()){
-        Debug("This transaction is already committted or aborted");
-        if(params.multiThreading || (params.mainThreadDispatching && !params.dispatchMessageReceive)){
-          Clean(*txnDigest); //XXX Clean again since client could have added it back to ongoing...
-        }
-        return;  //TODO: Forward to all interested clients and empty it?
-      }
-
-      ongoingMap::const_accessor b;
-      auto txnItr = ongoing.find(b, msgs[i].txn_digest());
-      if(txnItr){
-        txn = b->second;
-        b.release();
-      }
-      else{
-        b.release();
-        if(msgs[i].has_txn()){
-          txn = msgs[i].release_txn();
-          // check that digest and txn match..
-          if(*txnDigest !=TransactionDigest(*txn, params.hashDigest)) return;
-        }
-        else{
-          Debug("Writeback[%s] message does not contain txn, but have not seen"
-              " txn_digest previously.", BytesToHex(msgs[i].txn_digest(), 16).c_str());
-          // std::cerr << "Aborting for txn: " << BytesToHex(msg.txn_digest(), 16) << std::endl;
-          // if(normal.count(*txnDigest) > 0){ std::cerr << "was added on normal P1" << std::endl;}
-          // else if(fallback.count(*txnDigest) > 0){ std::cerr << "was added on ExecP1 FB" << std::endl;}
-          // else{ std::cerr << "have not seen p1" << std::endl;}
-          // waiting.insert(msg.txn_digest());
-          //transport->Timer(10000, [this](){Panic("Fail in WB");});
-          Warning("Cannot process Writeback because ongoing does not contain tx for this request. Should not happen with TCP...");
-          //Panic("When using TCP the tx should always be ongoing before doing WB");
-          return WritebackCallback(&msgs[i], txnDigest, txn, (void*) false);
-        }
-      }
-    } else {
-      txn = msgs[i].release_txn();
-      computedTxnDigest = TransactionDigest(msgs[i].txn(), params.hashDigest);
-      txnDigest = &computedTxnDigest;
-
-      if(committed.find(*txnDigest) != committed.end() || aborted.find(*txnDigest) != aborted.end()){
-        Debug("This transaction is already committted or aborted");
-        if(params.multiThreading || (params.mainThreadDispatching && !params.dispatchMessageReceive)){
-          Clean(*txnDigest); //XXX Clean again since client could have added it back to ongoing...
-        }
-        return;  //TODO: Forward to all interested clients and empty it?
-      }
-    }
-
-     Debug("WRITEBACK[%s] with decision %d.", BytesToHex(*txnDigest, 16).c_str(), msgs[i].decision());
-
-     //Verifying signatures
-    //XXX batchVerification branches are currently deprecated
-    if (params.validateProofs) {
-      if(params.multiThreading){
-
-          Debug("1: TAKING MULTITHREADING BRANCH, generating MCB");
-          mainThreadCallback mcb(std::bind(&Server::WritebackCallback, this, &msgs[i],
-            txnDigest, txn, std::placeholders::_1));
-
-          if(params.signedMessages && msgs[i].decision() == proto::COMMIT && msgs[i].has_p1_sigs()){
-            stats.Increment("total_transactions_fast_commit", 1);
-            int64_t myProcessId;
-            proto::ConcurrencyControl::Result myResult;
-            LookupP1Decision(*txnDigest, myProcessId, myResult);
-
-            if(params.batchVerification){
-              Debug("2: Taking batch branch p1 commit");
-              asyncBatchValidateP1Replies(msgs[i].decision(),
-                    true, txn, txnDigest, msgs[i].p1_sigs(), keyManager, &config, myProcessId,
-                    myResult, verifier, std::move(mcb), transport, true);
-            }
-            else{
-              Debug("2: Taking non-batch branch p1 commit");
-              asyncValidateP1Replies(msgs[i].decision(),
-                  true, txn, txnDigest, msgs[i].p1_sigs(), keyManager, &config, myProcessId,
-                  myResult, verifier, std::move(mcb), transport, true);
-            }
-            return;
-          }
-          else if(params.signedMessages && msgs[i].decision() == proto::ABORT && msgs[i].has_p1_sigs()){
-            stats.Increment("total_transactions_fast_Abort_sigs", 1);
-            int64_t myProcessId;
-            proto::ConcurrencyControl::Result myResult;
-            LookupP1Decision(*txnDigest, myProcessId, myResult);
-
-            if(params.batchVerification){
-              Debug("2: Taking batch branch p1 abort");
-              asyncBatchValidateP1Replies(msgs[i].decision(),
-                    true, txn, txnDigest, msgs[i].p1_sigs(), keyManager, &config, myProcessId,
-                    myResult, verifier, std::move(mcb), transport, true);
-            }
-            else{
-              Debug("2: Taking non-batch branch p1 abort");
-            asyncValidateP1Replies(msgs[i].decision(),
-                  true, txn, txnDigest, msgs[i].p1_sigs(), keyManager, &config, myProcessId,
-                  myResult, verifier, std::move(mcb), transport, true);
-            }
-            return;
-          }
-
-          else if (params.signedMessages && msgs[i].has_p2_sigs()) {
-             stats.Increment("total_transactions_slow", 1);
-              // require clients to include view for easier matching
-              if(!msgs[i].has_p2_view()) return;
-              int64_t myProcessId;
-              proto::CommitDecision myDecision;
-              LookupP2Decision(*txnDigest, myProcessId, myDecision);
-
-              if(params.batchVerification){
-                Debug("2: Taking batch branch p2");
-                asyncBatchValidateP2Replies(msgs[i].decision(), msgs[i].p2_view(),
-                      txn, txnDigest, msgs[i].p2_sigs(), keyManager, &config, myProcessId,
-                      myDecision, verifier, std::move(mcb), transport, true);
-              }
-              else{
-                Debug("2: Taking non-batch branch p2");
-                asyncValidateP2Replies(msgs[i].decision(), msgs[i].p2_view(),
-                      txn, txnDigest, msgs[i].p2_sigs(), keyManager, &config, myProcessId,
-                      myDecision, verifier, std::move(mcb), transport, true);
-              }
-              return;
-          }
-
-          else if (msgs[i].decision() == proto::ABORT && msgs[i].has_conflict()) {
-             stats.Increment("total_transactions_fast_Abort_conflict", 1);
-
-              std::string committedTxnDigest = TransactionDigest(msgs[i].conflict().txn(),
-                  params.hashDigest);
-              asyncValidateCommittedConflict(msgs[i].conflict(), &committedTxnDigest, txn,
-                    txnDigest, params.signedMessages, keyManager, &config, verifier,
-                    std::move(mcb), transport, true, params.batchVerification);
-              return;
-          }
-          else if (params.signedMessages) {
-
-             Debug("WRITEBACK[%s] decision %d, has_p1_sigs %d, has_p2_sigs %d, and"
-                 " has_conflict %d.", BytesToHex(*txnDigest, 16).c_str(),
-                 msgs[i].decision(), msgs[i].has_p1_sigs(), msgs[i].has_p2_sigs(), msgs[i].has_conflict());
-             return WritebackCallback(&msgs[i], txnDigest, txn, (void*) false);;
-          }
-
-      }
-      //If I make the else case use the async function too, then I can collapse the duplicate code here
-      //and just pass params.multiThreading as argument...
-      //Currently NOT doing that because the async version does additional copies (binds) that are avoided in the single threaded code.
-      else{
-
-          if (params.signedMessages && msgs[i].decision() == proto::COMMIT && msgs[i].has_p1_sigs()) {
-            int64_t myProcessId;
-            proto::ConcurrencyControl::Result myResult;
-            LookupP1Decision(*txnDigest, myProcessId, myResult);
-
-            if(params.batchVerification){
-              mainThreadCallback mcb(std::bind(&Server::WritebackCallback, this, &msgs[i], txnDigest, txn, std::placeholders::_1));
-              asyncBatchValidateP1Replies(proto::COMMIT,
-                    true, txn, txnDigest,msgs[i].p1_sigs(), keyManager, &config, myProcessId,
-                    myResult, verifier, std::move(mcb), transport, false);
-              return;
-            }
-            else{
-              if (!ValidateP1Replies(proto::COMMIT, true, txn, txnDigest, msgs[i].p1_sigs(),
-                    keyManager, &config, myProcessId, myResult, verifyLat, verifier)) {
-                Debug("WRITEBACK[%s] Failed to validate P1 replies for fast commit.",
-                    BytesToHex(*txnDigest, 16).c_str());
-                return WritebackCallback(&msgs[i], txnDigest, txn, (void*) false);
-              }
-            }
-          }
-          else if (params.signedMessages && msgs[i].decision() == proto::ABORT && msgs[i].has_p1_sigs()) {
-            int64_t myProcessId;
-            proto::ConcurrencyControl::Result myResult;
-            LookupP1Decision(*txnDigest, myProcessId, myResult);
-
-            if(params.batchVerification){
-              mainThreadCallback mcb(std::bind(&Server::WritebackCallback, this, &msgs[i], txnDigest, txn, std::placeholders::_1));
-              asyncBatchValidateP1Replies(proto::ABORT,
-                    true, txn, txnDigest,msgs[i].p1_sigs(), keyManager, &config, myProcessId,
-                    myResult, verifier, std::move(mcb), transport, false);
-              return;
-            }
-            else{
-              if (!ValidateP1Replies(proto::ABORT, true, txn, txnDigest, msgs[i].p1_sigs(),
-                    keyManager, &config, myProcessId, myResult, verifyLat, verifier)) {
-                Debug("WRITEBACK[%s] Failed to validate P1 replies for fast abort.",
-                    BytesToHex(*txnDigest, 16).c_str());
-                return WritebackCallback(&msgs[i], txnDigest, txn, (void*) false);
-              }
-            }
-          }
-
-          else if (params.signedMessages && msgs[i].has_p2_sigs()) {
-            if(!msgs[i].has_p2_view()) return;
-            int64_t myProcessId;
-            proto::CommitDecision myDecision;
-            LookupP2Decision(*txnDigest, myProcessId, myDecision);
-
-
-            if(params.batchVerification){
-              mainThreadCallback mcb(std::bind(&Server::WritebackCallback, this, &msgs[i], txnDigest, txn, std::placeholders::_1));
-              asyncBatchValidateP2Replies(msgs[i].decision(), msgs[i].p2_view(),
-                    txn, txnDigest, msgs[i].p2_sigs(), keyManager, &config, myProcessId,
-                    myDecision, verifier, std::move(mcb), transport, false);
-              return;
-            }
-            else{
-              if (!ValidateP2Replies(msgs[i].decision(), msgs[i].p2_view(), txn, txnDigest, msgs[i].p2_sigs(),
-                    keyManager, &config, myProcessId, myDecision, verifyLat, verifier)) {
-                Debug("WRITEBACK[%s] Failed to validate P2 replies for decision %d.",
-                    BytesToHex(*txnDigest, 16).c_str(), msgs[i].decision());
-                return WritebackCallback(&msgs[i], txnDigest, txn, (void*) false);
-              }
-            }
-
-          } else if (msgs[i].decision() == proto::ABORT && msgs[i].has_conflict()) {
-            std::string committedTxnDigest = TransactionDigest(msgs[i].conflict().txn(),
-                params.hashDigest);
-
-                if(params.batchVerification){
-                  mainThreadCallback mcb(std::bind(&Server::WritebackCallback, this, &msgs[i], txnDigest, txn, std::placeholders::_1));
-                  asyncValidateCommittedConflict(msgs[i].conflict(), &committedTxnDigest, txn,
-                        txnDigest, params.signedMessages, keyManager, &config, verifier,
-                        std::move(mcb), transport, false, params.batchVerification);
-                  return;
-                }
-                else{
-                  if (!ValidateCommittedConflict(msgs[i].conflict(), &committedTxnDigest, txn,
-                        txnDigest, params.signedMessages, keyManager, &config, verifier)) {
-                    Debug("WRITEBACK[%s] Failed to validate committed conflict for fast abort.",
-                        BytesToHex(*txnDigest, 16).c_str());
-                    return WritebackCallback(&msgs[i], txnDigest, txn, (void*) false);
+                    return WritebackCallback(&msg, txnDigest, txn, (void*) false);
                 }
 
             }
           } else if (params.signedMessages) {
             Debug("WRITEBACK[%s] decision %d, has_p1_sigs %d, has_p2_sigs %d, and"
                 " has_conflict %d.", BytesToHex(*txnDigest, 16).c_str(),
-                msgs[i].decision(), msgs[i].has_p1_sigs(), msgs[i].has_p2_sigs(), msgs[i].has_conflict());
-            return WritebackCallback(&msgs[i], txnDigest, txn, (void*) false);
+                msg.decision(), msg.has_p1_sigs(), msg.has_p2_sigs(), msg.has_conflict());
+            return WritebackCallback(&msg, txnDigest, txn, (void*) false);
           }
-      }
-    }
-    WritebackCallback(&msgs[i], txnDigest, txn, (void*) true);
+       }
+
+  }
+  WritebackCallback(&msg, txnDigest, txn, (void*) true, grouped);
+}
+
+//Handles writebacks that arrived together. Validation is unchanged, but
+//commits are staged and applied together by FlushCommits. Grouping needs
+//the commit callbacks to run on a single thread (the main thread, or the
+//network thread when nothing is dispatched).
+void Server::HandleWriteback_batch(const TransportAddress &remote,
+     const std::vector<proto::Writeback *> &msgs) {
+  bool grouped = msgs.size() > 1 && (!params.multiThreading ||
+      (params.mainThreadDispatching && params.dispatchCallbacks));
+  for (auto msg : msgs) {
+    HandleWriteback(remote, *msg, grouped);
   }
 }
 
@@ -2800,6 +2610,7 @@ proto::ConcurrencyControl::Result Server::DoOCCCheck(
     Timestamp &retryTs, const proto::CommittedProof* &conflict,
     const proto::Transaction* &abstain_conflict,
     bool fallback_flow, bool replicaGossip) {
+  StatsTimer occTimer(stats, "lat_p1_ccc");
 
   Debug("DoOCCCheck start");
 
@@ -2809,6 +2620,17 @@ proto::ConcurrencyControl::Result Server::DoOCCCheck(
     locks = LockTxnKeys_scoped(txn);
   }
 
+  return DoOCCCheckLocked(reqId, remote, txnDigest, txn, retryTs, conflict,
+      abstain_conflict, fallback_flow, replicaGossip);
+}
+
+//Concurrency control check proper. Caller must hold the key locks if parallel_CCC is set.
+proto::ConcurrencyControl::Result Server::DoOCCCheckLocked(
+    uint64_t reqId, const TransportAddress &remote,
+    const std::string &txnDigest, const proto::Transaction &txn,
+    Timestamp &retryTs, const proto::CommittedProof* &conflict,
+    const proto::Transaction* &abstain_conflict,
+    bool fallback_flow, bool replicaGossip) {
   switch (occType) {
     case TAPIR:
       return DoTAPIROCCCheck(txnDigest, txn, retryTs);
@@ -2882,6 +2704,79 @@ locks_t Server::LockTxnKeys_scoped(const proto::Transaction &txn) {
     return locks;
 }
 
+//Checks a batch of transactions under a single acquisition of the locks for the
+//union of their keys. Within the batch, transactions are checked in (timestamp, digest)
+//order, so that conflicts among them resolve deterministically: a later transaction
+//simply observes the preparation of an earlier one instead of contending for its locks.
+void Server::DoOCCCheck_batch(const std::vector<proto::Phase1 *> &msgs,
+    const TransportAddress &remote, const std::vector<std::string> &txnDigests,
+    const std::vector<proto::Transaction *> &txns,
+    std::vector<proto::ConcurrencyControl::Result> &results,
+    std::vector<const proto::CommittedProof*> &conflicts,
+    std::vector<const proto::Transaction*> &abstainConflicts) {
+  StatsTimer occTimer(stats, "lat_p1_ccc_batch");
+
+  std::vector<size_t> order;
+  order.reserve(txns.size());
+  for (size_t i = 0; i < txns.size(); ++i) {
+    if (txns[i] != nullptr) order.push_back(i);
+  }
+  std::sort(order.begin(), order.end(), [&txns, &txnDigests](size_t a, size_t b) {
+    Timestamp tsA(txns[a]->timestamp());
+    Timestamp tsB(txns[b]->timestamp());
+    if (tsA != tsB) return tsA < tsB;
+    return txnDigests[a] < txnDigests[b];
+  });
+  stats.Increment(STAT_P1_BATCH_CCC);
+  stats.Increment(STAT_P1_BATCH_CCC_TXNS, order.size());
+
+  locks_t locks;
+  if(params.parallel_CCC){
+    locks = LockBatchKeys_scoped(txns);
+    stats.Increment(STAT_P1_BATCH_CCC_KEYS, locks.size());
+  }
+
+  for (size_t i : order) {
+    //check if concurrently committed/aborted already, and if so skip
+    ongoingMap::const_accessor b;
+    if(!ongoing.find(b, txnDigests[i])){
+      Debug("Already concurrently Committed/Aborted txn[%s]", BytesToHex(txnDigests[i], 16).c_str());
+      continue;
+    }
+    b.release();
+
+    Timestamp retryTs;
+    //forwarded messages dont need to be treated as original client.
+    results[i] = DoOCCCheckLocked(msgs[i]->req_id(), remote, txnDigests[i], *txns[i],
+        retryTs, conflicts[i], abstainConflicts[i], false, msgs[i]->replica_gossip());
+    BufferP1Result(results[i], conflicts[i], txnDigests[i]);
+  }
+}
+
+//Like LockTxnKeys_scoped, but for the union of the keys of all (non-null) txns.
+//Locks are taken in global key order, so this composes with per transaction locking.
+locks_t Server::LockBatchKeys_scoped(const std::vector<proto::Transaction *> &txns) {
+  std::vector<const std::string *> keys;
+  for (const proto::Transaction *txn : txns) {
+    if (txn == nullptr) continue;
+    for (const auto &read : txn->read_set()) keys.push_back(&read.key());
+    for (const auto &write : txn->write_set()) keys.push_back(&write.key());
+  }
+  std::sort(keys.begin(), keys.end(), [](const std::string *a, const std::string *b) {
+    return *a < *b;
+  });
+  keys.erase(std::unique(keys.begin(), keys.end(), [](const std::string *a, const std::string *b) {
+    return *a == *b;
+  }), keys.end());
+
+  locks_t locks;
+  locks.reserve(keys.size());
+  for (const std::string *key : keys) {
+    locks.emplace_back(mutex_map[*key]);
+  }
+  return locks;
+}
+
 //XXX DEPRECATED
 void Server::LockTxnKeys(proto::Transaction &txn){
   // Lock all (read/write) keys in order for atomicity if using parallel OCC
@@ -2998,8 +2893,8 @@ proto::ConcurrencyControl::Result Server::DoTAPIROCCCheck(
             txn.client_id(),
             txn.client_seq_num(),
             BytesToHex(read.key(), 16).c_str());
-        stats.Increment("cc_abstains", 1);
-        stats.Increment("cc_abstains_rw_conflict", 1);
+        stats.Increment(STAT_CC_ABSTAINS, 1);
+        stats.Increment(STAT_CC_ABSTAINS_RW_CONFLICT, 1);
         return proto::ConcurrencyControl::ABSTAIN;
       }
     } else {
@@ -3012,8 +2907,8 @@ proto::ConcurrencyControl::Result Server::DoTAPIROCCCheck(
       //UW_ASSERT(timestamp > range.first);
       Debug("[%s] ABORT rw conflict: %lu > %lu", txnDigest.c_str(),
           txn.timestamp().timestamp(), range.second.getTimestamp());
-      stats.Increment("cc_aborts", 1);
-      stats.Increment("cc_aborts_rw_conflict", 1);
+      stats.Increment(STAT_CC_ABORTS, 1);
+      stats.Increment(STAT_CC_ABORTS_RW_CONFLICT, 1);
       return proto::ConcurrencyControl::ABORT;
     }
   }
@@ -3033,7 +2928,7 @@ proto::ConcurrencyControl::Result Server::DoTAPIROCCCheck(
         Debug("[%s] RETRY ww conflict w/ prepared key:%s", txnDigest.c_str(),
             write.key().c_str());
         retryTs = val.first;
-        stats.Increment("cc_retries_committed_write", 1);
+        stats.Increment(STAT_CC_RETRIES_COMMITTED_WRITE, 1);
          //if(params.mainThreadDispatching) storeMutex.unlock();
         return proto::ConcurrencyControl::ABSTAIN;
       }
@@ -3070,7 +2965,7 @@ proto::ConcurrencyControl::Result Server::DoTAPIROCCCheck(
         Debug("[%s] RETRY ww conflict w/ prepared key:%s", txnDigest.c_str(),
             write.key().c_str());
         retryTs = it->first;
-        stats.Increment("cc_retries_prepared_write", 1);
+        stats.Increment(STAT_CC_RETRIES_PREPARED_WRITE, 1);
          //if(params.mainThreadDispatching) preparedWritesMutex.unlock_shared();
          itr->second.first.unlock_shared();
         return proto::ConcurrencyControl::ABSTAIN;
@@ -3087,7 +2982,7 @@ proto::ConcurrencyControl::Result Server::DoTAPIROCCCheck(
         pReads[write.key()].end()) {
       Debug("[%s] ABSTAIN wr conflict w/ prepared key: %s",
             txnDigest.c_str(), write.key().c_str());
-      stats.Increment("cc_abstains", 1);
+      stats.Increment(STAT_CC_ABSTAINS, 1);
       return proto::ConcurrencyControl::ABSTAIN;
     }
   }
@@ -3123,8 +3018,17 @@ proto::ConcurrencyControl::Result Server::DoMVTSOOCCCheck(
           txn.client_id(), txn.client_seq_num(),
           BytesToHex(txnDigest, 16).c_str(),
           ts.getTimestamp());
-      stats.Increment("cc_abstains", 1);
-      stats.Increment("cc_abstains_watermark", 1);
+      stats.Increment(STAT_CC_ABSTAINS, 1);
+      stats.Increment(STAT_CC_ABSTAINS_WATERMARK, 1);
+      return proto::ConcurrencyControl::ABSTAIN;
+    }
+    if (CheckLowWatermark(txn)) {
+      Debug("[%lu:%lu][%s] ABSTAIN ts %lu (or a dependency) below low watermark.",
+          txn.client_id(), txn.client_seq_num(),
+          BytesToHex(txnDigest, 16).c_str(),
+          ts.getTimestamp());
+      stats.Increment(STAT_CC_ABSTAINS, 1);
+      stats.Increment(STAT_CC_ABSTAINS_LOW_WATERMARK, 1);
       return proto::ConcurrencyControl::ABSTAIN;
     }
     for (const auto &read : txn.read_set()) {
@@ -3152,8 +3056,8 @@ proto::ConcurrencyControl::Result Server::DoMVTSOOCCCheck(
               read.readtime().timestamp(),
               read.readtime().id(), committedWrite.first.getTimestamp(),
               committedWrite.first.getID(), ts.getTimestamp(), ts.getID());
-          stats.Increment("cc_aborts", 1);
-          stats.Increment("cc_aborts_wr_conflict", 1);
+          stats.Increment(STAT_CC_ABORTS, 1);
+          stats.Increment(STAT_CC_ABORTS_WR_CONFLICT, 1);
           return proto::ConcurrencyControl::ABORT;
         }
       }
@@ -3174,8 +3078,8 @@ proto::ConcurrencyControl::Result Server::DoMVTSOOCCCheck(
                 read.readtime().timestamp(),
                 read.readtime().id(), preparedTs.first.getTimestamp(),
                 preparedTs.first.getID(), ts.getTimestamp(), ts.getID());
-            stats.Increment("cc_abstains", 1);
-            stats.Increment("cc_abstains_wr_conflict", 1);
+            stats.Increment(STAT_CC_ABSTAINS, 1);
+            stats.Increment(STAT_CC_ABSTAINS_WR_CONFLICT, 1);
 
             // if(fallback_flow){
             //   std::cerr<< "Abstain ["<<BytesToHex(txnDigest, 16)<<"] against prepared write from tx[" << BytesToHex(TransactionDigest(*preparedTs.second, params.hashDigest), 16) << "]" << std::endl;
@@ -3218,8 +3122,8 @@ proto::ConcurrencyControl::Result Server::DoMVTSOOCCCheck(
                   std::get<1>(*ritr).getID(), ts.getTimestamp(),
                   ts.getID(), std::get<0>(*ritr).getTimestamp(),
                   std::get<0>(*ritr).getID());
-              stats.Increment("cc_aborts", 1);
-              stats.Increment("cc_aborts_rw_conflict", 1);
+              stats.Increment(STAT_CC_ABORTS, 1);
+              stats.Increment(STAT_CC_ABORTS_RW_CONFLICT, 1);
               return proto::ConcurrencyControl::ABORT;
             }
           }
@@ -3231,44 +3135,28 @@ proto::ConcurrencyControl::Result Server::DoMVTSOOCCCheck(
 
         std::shared_lock lock(preparedReadsItr->second.first);
 
-        for (const auto preparedReadTxn : preparedReadsItr->second.second) {
-          bool isDep = false;
-          for (const auto &dep : preparedReadTxn->deps()) {
-            if (txnDigest == dep.write().prepared_txn_digest()) {
-              isDep = true;
-              break;
-            }
-          }
-
-          bool isReadVersionEarlier = false;
-          Timestamp readTs;
-          for (const auto &read : preparedReadTxn->read_set()) {
-            if (read.key() == write.key()) {
-              readTs = Timestamp(read.readtime());
-              isReadVersionEarlier = readTs < ts;
-              break;
-            }
-          }
-          if (!isDep && isReadVersionEarlier &&
-              ts < Timestamp(preparedReadTxn->timestamp())) {
-            Debug("[%lu:%lu][%s] ABSTAIN rw conflict prepared read for key %s: prepared"
-                " read ts %lu.%lu < this txn's ts %lu.%lu < committed ts %lu.%lu.",
-                txn.client_id(),
-                txn.client_seq_num(),
-                BytesToHex(txnDigest, 16).c_str(),
-                BytesToHex(write.key(), 16).c_str(),
-                readTs.getTimestamp(),
-                readTs.getID(), ts.getTimestamp(),
-                ts.getID(), preparedReadTxn->timestamp().timestamp(),
-                preparedReadTxn->timestamp().id());
-            stats.Increment("cc_abstains", 1);
-            stats.Increment("cc_abstains_rw_conflict", 1);
-
-            // if(fallback_flow){
-            //   std::cerr<< "Abstain ["<<BytesToHex(txnDigest, 16)<<"] against prepared read from tx[" << BytesToHex(TransactionDigest(*preparedReadTxn, params.hashDigest), 16) << "]" << std::endl;
-            // }
-            return proto::ConcurrencyControl::ABSTAIN;
-          }
+        const PreparedReadIndex &readers = preparedReadsItr->second.second;
+        auto conflictItr = readers.FindConflict(ts, txnDigest);
+        if (conflictItr != readers.end()) {
+          const Timestamp &readTs = conflictItr->second.readTs;
+          const proto::Transaction *preparedReadTxn = conflictItr->second.txn;
+          Debug("[%lu:%lu][%s] ABSTAIN rw conflict prepared read for key %s: prepared"
+              " read ts %lu.%lu < this txn's ts %lu.%lu < committed ts %lu.%lu.",
+              txn.client_id(),
+              txn.client_seq_num(),
+              BytesToHex(txnDigest, 16).c_str(),
+              BytesToHex(write.key(), 16).c_str(),
+              readTs.getTimestamp(),
+              readTs.getID(), ts.getTimestamp(),
+              ts.getID(), preparedReadTxn->timestamp().timestamp(),
+              preparedReadTxn->timestamp().id());
+          stats.Increment(STAT_CC_ABSTAINS, 1);
+          stats.Increment(STAT_CC_ABSTAINS_RW_CONFLICT, 1);
+
+          // if(fallback_flow){
+          //   std::cerr<< "Abstain ["<<BytesToHex(txnDigest, 16)<<"] against prepared read from tx[" << BytesToHex(TransactionDigest(*preparedReadTxn, params.hashDigest), 16) << "]" << std::endl;
+          // }
+          return proto::ConcurrencyControl::ABSTAIN;
         }
       }
 
@@ -3302,8 +3190,8 @@ proto::ConcurrencyControl::Result Server::DoMVTSOOCCCheck(
       //             BytesToHex(write.key(), 16).c_str(),
       //             rtsLB->getTimestamp(),
       //             rtsLB->getID(), ts.getTimestamp(), ts.getID());
-      //         stats.Increment("cc_abstains", 1);
-      //         stats.Increment("cc_abstains_rts", 1);
+      //         stats.Increment(STAT_CC_ABSTAINS, 1);
+      //         stats.Increment(STAT_CC_ABSTAINS_RTS, 1);
       //          if(params.mainThreadDispatching) rtsMutex.unlock_shared();
       //         return proto::ConcurrencyControl::ABSTAIN;
       //       }
@@ -3316,8 +3204,8 @@ proto::ConcurrencyControl::Result Server::DoMVTSOOCCCheck(
         if(rtsItr->second > ts.getTimestamp()){
           ///TODO XXX Re-introduce ID also, for finer ordering. This is safe, since the
           //RTS check is just an additional heuristic; The prepare/commit checks guarantee serializability on their own
-          stats.Increment("cc_abstains", 1);
-          stats.Increment("cc_abstains_rts", 1);
+          stats.Increment(STAT_CC_ABSTAINS, 1);
+          stats.Increment(STAT_CC_ABSTAINS_RTS, 1);
           return proto::ConcurrencyControl::ABSTAIN;
         }
       }
@@ -3333,8 +3221,8 @@ proto::ConcurrencyControl::Result Server::DoMVTSOOCCCheck(
         if (dep.involved_group() != groupIdx) {
           continue;
         }
-        if (committed.find(dep.write().prepared_txn_digest()) == committed.end() &&
-            aborted.find(dep.write().prepared_txn_digest()) == aborted.end()) {
+        if (committed.count(dep.write().prepared_txn_digest()) == 0 &&
+            aborted.count(dep.write().prepared_txn_digest()) == 0) {
           //check whether we (i.e. the server) have prepared it ourselves: This alleviates having to verify dep proofs
 
           preparedMap::const_accessor a2;
@@ -3361,7 +3249,7 @@ proto::ConcurrencyControl::Result Server::DoMVTSOOCCCheck(
    Debug("reqId:%d", reqId);
 
   if (!allFinished) {
-    stats.Increment("cc_waits", 1);
+    stats.Increment(STAT_CC_WAITS, 1);
     return proto::ConcurrencyControl::WAIT;
   } else {
     return CheckDependencies(txn);
@@ -3408,8 +3296,8 @@ bool Server::ManageDependencies(const std::string &txnDigest, const proto::Trans
        // bool currently_completing = completing.find(z, dep.write().prepared_txn_digest());
        // if(currently_completing) //z->second.lock();
 
-       if (committed.find(dep.write().prepared_txn_digest()) == committed.end() &&
-           aborted.find(dep.write().prepared_txn_digest()) == aborted.end()) {
+       if (committed.count(dep.write().prepared_txn_digest()) == 0 &&
+           aborted.count(dep.write().prepared_txn_digest()) == 0) {
          Debug("[%lu:%lu][%s] WAIT for dependency %s to finish.",
              txn.client_id(), txn.client_seq_num(),
              BytesToHex(txnDigest, 16).c_str(),
@@ -3526,9 +3414,9 @@ void Server::Prepare(const std::string &txnDigest,
       //preparedReads[read.key()].insert(p.first->second.second);
       //preparedReads[read.key()].insert(a->second.second);
 
-      std::pair<std::shared_mutex, std::set<const proto::Transaction *>> &y = preparedReads[read.key()];
+      std::pair<std::shared_mutex, PreparedReadIndex> &y = preparedReads[read.key()];
       std::unique_lock lock(y.first);
-      y.second.insert(a->second.second);
+      y.second.Insert(a->second.first, Timestamp(read.readtime()), a->second.second);
     }
   }
 
@@ -3562,6 +3450,7 @@ void Server::GetCommittedWrites(const std::string &key, const Timestamp &ts,
 
 void Server::Commit(const std::string &txnDigest, proto::Transaction *txn,
       proto::GroupedSignatures *groupedSigs, bool p1Sigs, uint64_t view) {
+  StatsTimer commitTimer(stats, "lat_writeback");
 
   Debug("Commit");
 
@@ -3577,7 +3466,10 @@ void Server::Commit(const std::string &txnDigest, proto::Transaction *txn,
   }
   val.proof = proof;
 
-  auto committedItr = committed.insert(std::make_pair(txnDigest, proof));
+  committedMap::const_accessor c;
+  bool newCommit = committed.insert(c, std::make_pair(txnDigest, proof));
+  const proto::CommittedProof *committedProof = c->second;
+  c.release();
   //auto committedItr =committed.emplace(txnDigest, proof);
 
   if (params.validateProofs) {
@@ -3608,8 +3500,7 @@ void Server::Commit(const std::string &txnDigest, proto::Transaction *txn,
 
      std::pair<std::shared_mutex, std::set<committedRead>> &z = committedReads[read.key()];
      std::unique_lock lock(z.first);
-     z.second.insert(std::make_tuple(ts, read.readtime(),
-           committedItr.first->second));
+     z.second.insert(std::make_tuple(ts, read.readtime(), committedProof));
     // committedReads[read.key()].insert(std::make_tuple(ts, read.readtime(),
     //       committedItr.first->second));
 
@@ -3647,17 +3538,172 @@ void Server::Commit(const std::string &txnDigest, proto::Transaction *txn,
     //  if(params.mainThreadDispatching) rtsMutex.unlock();
   }
 
+  if (params.gcIntervalMS > 0 && newCommit) {
+    EnqueueGC(txnDigest, ts, txn);
+  }
+
   Clean(txnDigest);
   CheckDependents(txnDigest);
   CleanDependencies(txnDigest);
 
 }
 
+void Server::StageCommit(PendingCommit &&commit) {
+  //Mark the txn committed right away so that duplicate writebacks,
+  //CheckDependencies and Phase2 see the decision before the flush. Its
+  //prepared reads/writes stay in place until CommitBatch applies it.
+  proto::CommittedProof *proof = nullptr;
+  if (params.validateProofs) {
+    proof = new proto::CommittedProof();
+  }
+  committedMap::const_accessor c;
+  bool newCommit = committed.insert(c, std::make_pair(commit.txnDigest, proof));
+  c.release();
+  if (!newCommit) {
+    //duplicate writeback, already committed or staged
+    delete proof;
+    delete commit.groupedSigs;
+    return;
+  }
+  if (params.validateProofs) {
+    proof->set_allocated_txn(commit.txn);
+    if (params.signedMessages) {
+      if (commit.p1Sigs) {
+        proof->set_allocated_p1_sigs(commit.groupedSigs);
+      } else {
+        proof->set_allocated_p2_sigs(commit.groupedSigs);
+        proof->set_p2_view(commit.view);
+      }
+    }
+  }
+  commit.proof = proof;
+
+  std::unique_lock<std::mutex> lock(pendingCommitsMutex);
+  pendingCommits.push_back(std::move(commit));
+  if (pendingCommits.size() > 1) return;
+  //First staged commit: flush once the callbacks queued behind it have run.
+  if (params.mainThreadDispatching) {
+    transport->DispatchTP_main([this]() {
+      FlushCommits();
+      return (void*) true;
+    });
+  }
+  else {
+    transport->Timer(0, [this]() { FlushCommits(); });
+  }
+}
+
+void Server::FlushCommits() {
+  std::vector<PendingCommit> commits;
+  {
+    std::unique_lock<std::mutex> lock(pendingCommitsMutex);
+    commits.swap(pendingCommits);
+  }
+  if (!commits.empty()) {
+    CommitBatch(commits);
+  }
+}
+
+//Same as Commit, but for many txns at once: reads and writes are sorted by
+//key so that each committedReads lock and store entry is taken once.
+void Server::CommitBatch(std::vector<PendingCommit> &commits) {
+  StatsTimer commitTimer(stats, "lat_writeback_batch");
+  Debug("CommitBatch of %lu txns", commits.size());
+  stats.Increment(STAT_COMMIT_BATCHES, 1);
+  stats.Increment(STAT_COMMIT_BATCH_TXNS, commits.size());
+
+  struct ReadOp {
+    const std::string *key;
+    committedRead read;
+  };
+  struct WriteOp {
+    const std::string *key;
+    Timestamp ts;
+    const std::string *value;
+    const proto::CommittedProof *proof;
+  };
+  std::vector<ReadOp> reads;
+  std::vector<WriteOp> writes;
+  std::vector<std::string> txnDigests;
+  txnDigests.reserve(commits.size());
+
+  for (auto &commit : commits) {
+    proto::Transaction *txn = commit.txn;
+    Timestamp ts(txn->timestamp());
+
+    //inserted into committed by StageCommit
+    const proto::CommittedProof *proof = commit.proof;
+
+    for (const auto &read : txn->read_set()) {
+      if (IsKeyOwned(read.key())) {
+        reads.push_back({&read.key(), std::make_tuple(ts, Timestamp(read.readtime()), proof)});
+      }
+    }
+    for (const auto &write : txn->write_set()) {
+      if (IsKeyOwned(write.key())) {
+        Debug("COMMIT[%lu,%lu] Committing write for key %s.",
+            txn->client_id(), txn->client_seq_num(),
+            BytesToHex(write.key(), 16).c_str());
+        writes.push_back({&write.key(), ts, &write.value(), proof});
+      }
+    }
+
+    if (params.gcIntervalMS > 0) {
+      EnqueueGC(commit.txnDigest, ts, txn);
+    }
+    txnDigests.push_back(commit.txnDigest);
+  }
+
+  std::sort(reads.begin(), reads.end(), [](const ReadOp &a, const ReadOp &b) {
+    return *a.key < *b.key;
+  });
+  for (size_t i = 0; i < reads.size();) {
+    std::pair<std::shared_mutex, std::set<committedRead>> &z = committedReads[*reads[i].key];
+    std::unique_lock lock(z.first);
+    size_t j = i;
+    for (; j < reads.size() && *reads[j].key == *reads[i].key; ++j) {
+      z.second.insert(reads[j].read);
+    }
+    i = j;
+  }
+
+  std::sort(writes.begin(), writes.end(), [](const WriteOp &a, const WriteOp &b) {
+    int cmp = a.key->compare(*b.key);
+    return cmp < 0 || (cmp == 0 && a.ts < b.ts);
+  });
+  std::vector<std::pair<Timestamp, Value>> versions;
+  for (size_t i = 0; i < writes.size();) {
+    versions.clear();
+    size_t j = i;
+    for (; j < writes.size() && *writes[j].key == *writes[i].key; ++j) {
+      versions.emplace_back(writes[j].ts, Value{*writes[j].value, writes[j].proof});
+    }
+    store.putBatch(*writes[i].key, versions);
+    i = j;
+  }
+
+  for (const auto &txnDigest : txnDigests) {
+    Clean(txnDigest);
+    CheckDependents(txnDigest);
+    CleanDependencies(txnDigest);
+  }
+}
+
 void Server::Abort(const std::string &txnDigest) {
   //if(params.mainThreadDispatching) abortedMutex.lock();
   Debug("abort");
-  aborted.insert(txnDigest);
+  bool newAbort = aborted.insert(std::make_pair(txnDigest, true));
   //if(params.mainThreadDispatching) abortedMutex.unlock();
+  if (params.gcIntervalMS > 0 && newAbort) {
+    // txns this replica never received are reclaimed relative to local time
+    Timestamp ts(timeServer.GetTime());
+    ongoingMap::const_accessor b;
+    if (ongoing.find(b, txnDigest)) {
+      ts = Timestamp(b->second->timestamp());
+    }
+    b.release();
+    EnqueueGC(txnDigest, ts, nullptr);
+  }
   Clean(txnDigest);
   CheckDependents(txnDigest);
   CleanDependencies(txnDigest);
@@ -3682,6 +3728,7 @@ void Server::Clean(const std::string &txnDigest) {
 
   ongoingMap::accessor b;
   if(ongoing.find(b, txnDigest)){
+      UntrackOngoing(b->second);
       ongoing.erase(b);
   }
   //ongoing.erase(txnDigest);
@@ -3695,9 +3742,9 @@ void Server::Clean(const std::string &txnDigest) {
       if (IsKeyOwned(read.key())) {
         //preparedReads[read.key()].erase(a->second.second);
         //preparedReads[read.key()].erase(itr->second.second);
-        std::pair<std::shared_mutex, std::set<const proto::Transaction *>> &y = preparedReads[read.key()];
+        std::pair<std::shared_mutex, PreparedReadIndex> &y = preparedReads[read.key()];
         std::unique_lock lock(y.first);
-        y.second.erase(a->second.second);
+        y.second.Erase(a->second.first, a->second.second);
       }
     }
     for (const auto &write : a->second.second->write_set()) {
@@ -3716,6 +3763,10 @@ void Server::Clean(const std::string &txnDigest) {
   b.release(); //Release only at the end, so that Prepare and Clean in parallel for the same TX are atomic.
   //TODO: might want to move release all the way to the end.
 
+  CleanFallback(txnDigest);
+}
+
+void Server::CleanFallback(const std::string &txnDigest) {
   //XXX: Fallback related cleans
 
   //interestedClients[txnDigest].insert(remote.clone());
@@ -3872,11 +3923,11 @@ proto::ConcurrencyControl::Result Server::CheckDependencies(
     {
       //std::shared_lock lock(committedMutex);
       //std::shared_lock lock2(abortedMutex);
-      if(committed.find(txnDigest) != committed.end()){
+      if(committed.count(txnDigest) > 0){
         //if(params.mainThreadDispatching) ongoingMutex.unlock_shared();
         return proto::ConcurrencyControl::COMMIT;
       }
-      else if(aborted.find(txnDigest) != aborted.end()){
+      else if(aborted.count(txnDigest) > 0){
         //if(params.mainThreadDispatching) ongoingMutex.unlock_shared();
         return proto::ConcurrencyControl::ABSTAIN;
       }
@@ -3900,16 +3951,16 @@ proto::ConcurrencyControl::Result Server::CheckDependencies(
     if (dep.involved_group() != groupIdx) {
       continue;
     }
-    if (committed.find(dep.write().prepared_txn_digest()) != committed.end()) {
+    if (committed.count(dep.write().prepared_txn_digest()) > 0) {
       if (Timestamp(dep.write().prepared_timestamp()) > Timestamp(txn.timestamp())) {
-        stats.Increment("cc_aborts", 1);
-        stats.Increment("cc_aborts_dep_ts", 1);
+        stats.Increment(STAT_CC_ABORTS, 1);
+        stats.Increment(STAT_CC_ABORTS_DEP_TS, 1);
          //if(params.mainThreadDispatching) committedMutex.unlock_shared();
         return proto::ConcurrencyControl::ABSTAIN;
       }
     } else {
-      stats.Increment("cc_aborts", 1);
-      stats.Increment("cc_aborts_dep_aborted", 1);
+      stats.Increment(STAT_CC_ABORTS, 1);
+      stats.Increment(STAT_CC_ABORTS_DEP_ABORTED, 1);
        //if(params.mainThreadDispatching) committedMutex.unlock_shared();
       return proto::ConcurrencyControl::ABSTAIN;
     }
@@ -3926,6 +3977,303 @@ bool Server::CheckHighWatermark(const Timestamp &ts) {
   return ts > highWatermark;
 }
 
+// MULTI-VERSION GARBAGE COLLECTION
+//
+// Every gcIntervalMS the GC advances the low watermark to local time minus
+// timeDelta (the mirror image of CheckHighWatermark), but never past the
+// oldest timestamp an ongoing txn depends on. Below that watermark it
+// reclaims (1) store versions shadowed by a newer version below the
+// watermark, (2) committedReads entries, (3) the committed/aborted records of
+// txns and (4) the CommittedProofs no longer referenced by any version.
+// CCC abstains from txns (or txns with dependencies) below the watermark,
+// since the state needed to validate them may already be gone, and late
+// writebacks below it are dropped. Proofs are freed only after a grace
+// period (Transport::GraceToken), and never while a p1MetaData entry still
+// holds them as a conflict.
+
+bool Server::CheckLowWatermark(const proto::Transaction &txn) {
+  if (params.gcIntervalMS == 0) {
+    return false;
+  }
+  return OldestTimestamp(txn) < Timestamp(lowWatermark);
+}
+
+Timestamp Server::OldestTimestamp(const proto::Transaction &txn) {
+  Timestamp oldest(txn.timestamp());
+  for (const auto &dep : txn.deps()) {
+    if (dep.write().has_prepared_timestamp()) {
+      Timestamp depTs(dep.write().prepared_timestamp());
+      if (depTs < oldest) {
+        oldest = depTs;
+      }
+    }
+  }
+  return oldest;
+}
+
+void Server::TrackOngoing(const proto::Transaction *txn) {
+  if (params.gcIntervalMS == 0) {
+    return;
+  }
+  Timestamp oldest = OldestTimestamp(*txn);
+  // CCC abstains from these anyways; they must not hold back the watermark.
+  if (oldest < Timestamp(lowWatermark)) {
+    return;
+  }
+  OngoingShard &shard = ongoingTracker[(reinterpret_cast<uintptr_t>(txn) >> 6) %
+      GC_TRACKER_SHARDS];
+  std::unique_lock<std::mutex> lock(shard.mtx);
+  shard.txns.insert(std::make_pair(oldest, txn));
+}
+
+void Server::UntrackOngoing(const proto::Transaction *txn) {
+  if (params.gcIntervalMS == 0) {
+    return;
+  }
+  Timestamp oldest = OldestTimestamp(*txn);
+  OngoingShard &shard = ongoingTracker[(reinterpret_cast<uintptr_t>(txn) >> 6) %
+      GC_TRACKER_SHARDS];
+  std::unique_lock<std::mutex> lock(shard.mtx);
+  shard.txns.erase(std::make_pair(oldest, txn));
+}
+
+// txn is nullptr for aborted txns.
+void Server::EnqueueGC(const std::string &txnDigest, const Timestamp &ts,
+    const proto::Transaction *txn) {
+  GCEntry entry;
+  entry.txnDigest = txnDigest;
+  entry.committed = txn != nullptr;
+  if (txn != nullptr) {
+    for (const auto &read : txn->read_set()) {
+      if (IsKeyOwned(read.key())) {
+        entry.readKeys.push_back(read.key());
+      }
+    }
+    for (const auto &write : txn->write_set()) {
+      if (IsKeyOwned(write.key())) {
+        entry.writeKeys.push_back(write.key());
+      }
+    }
+  }
+  std::unique_lock<std::mutex> lock(gcMutex);
+  gcQueue.insert(std::make_pair(ts, std::move(entry)));
+}
+
+void Server::ScheduleGC() {
+  transport->Timer(params.gcIntervalMS, [this]() {
+    // Running here means the event loop is between callbacks.
+    gcLoopPasses++;
+    if (params.multiThreading) {
+      transport->DispatchTP_noCB([this]() {
+        RunGC();
+        ScheduleGC();
+        return (void *) true;
+      });
+    } else {
+      RunGC();
+      ScheduleGC();
+    }
+  });
+}
+
+void Server::ReleaseProofRef(const proto::CommittedProof *proof) {
+  auto itr = gcProofRefs.find(proof);
+  // proofs still in committed are accounted for when they are unlinked
+  if (itr == gcProofRefs.end() || itr->second == 0) {
+    return;
+  }
+  if (--itr->second == 0) {
+    gcRetiredProofs.push_back(proof);
+    gcProofRefs.erase(itr);
+  }
+}
+
+bool Server::GCReclaimed(const proto::Transaction &txn) {
+  return params.gcIntervalMS > 0 &&
+      txn.timestamp().timestamp() < gcReclaimedWatermark;
+}
+
+void Server::PinProof(const proto::CommittedProof *proof) {
+  std::unique_lock<std::mutex> lock(gcPinMutex);
+  gcPinnedProofs[proof]++;
+}
+
+void Server::UnpinProof(const proto::CommittedProof *proof) {
+  std::unique_lock<std::mutex> lock(gcPinMutex);
+  auto itr = gcPinnedProofs.find(proof);
+  UW_ASSERT(itr != gcPinnedProofs.end());
+  if (--itr->second > 0) {
+    return;
+  }
+  gcPinnedProofs.erase(itr);
+  // A thread may still hold it from p1MetaData: retire it anew.
+  if (gcPinnedRetired.erase(proof) > 0) {
+    gcUnpinned.push_back(proof);
+  }
+}
+
+// Frees the retired proofs whose grace period is over, unless they have
+// been pinned in the meantime.
+void Server::FreeRetiredProofs(uint64_t &proofs, uint64_t &bytes) {
+  while (!gcGracePeriods.empty() &&
+      gcLoopPasses > gcGracePeriods.front().loopPass &&
+      transport->GraceExpired(gcGracePeriods.front().graceToken)) {
+    std::unique_lock<std::mutex> lock(gcPinMutex);
+    for (const auto proof : gcGracePeriods.front().proofs) {
+      if (gcPinnedProofs.find(proof) != gcPinnedProofs.end()) {
+        gcPinnedRetired.insert(proof);
+        continue;
+      }
+      bytes += proof->SpaceUsedLong();
+      delete proof;
+      proofs++;
+    }
+    lock.unlock();
+    gcGracePeriods.pop_front();
+  }
+}
+
+void Server::RunGC() {
+  // Publish the new watermark before reading the tracker: a txn that is
+  // tracked after the reads below is checked against the new watermark.
+  uint64_t now = timeServer.GetTime();
+  if (now > timeDelta && now - timeDelta > lowWatermark) {
+    lowWatermark = now - timeDelta;
+  }
+  Timestamp watermark(lowWatermark);
+  for (size_t i = 0; i < GC_TRACKER_SHARDS; ++i) {
+    std::unique_lock<std::mutex> lock(ongoingTracker[i].mtx);
+    if (!ongoingTracker[i].txns.empty() &&
+        ongoingTracker[i].txns.begin()->first < watermark) {
+      watermark = ongoingTracker[i].txns.begin()->first;
+    }
+  }
+  Debug("GC low watermark: %lu.", watermark.getTimestamp());
+
+  uint64_t bytes = 0;
+  uint64_t proofs = 0;
+  FreeRetiredProofs(proofs, bytes);
+  {
+    std::unique_lock<std::mutex> lock(gcPinMutex);
+    gcRetiredProofs.swap(gcUnpinned);
+  }
+
+  std::vector<std::pair<Timestamp, GCEntry>> batch;
+  {
+    std::unique_lock<std::mutex> lock(gcMutex);
+    auto end = gcQueue.lower_bound(watermark);
+    for (auto itr = gcQueue.begin(); itr != end; ++itr) {
+      batch.emplace_back(itr->first, std::move(itr->second));
+    }
+    gcQueue.erase(gcQueue.begin(), end);
+  }
+  // Published before anything is unlinked, so that a writeback that no
+  // longer finds its txn in committed is sure to see it.
+  if (watermark.getTimestamp() > gcReclaimedWatermark) {
+    gcReclaimedWatermark = watermark.getTimestamp();
+  }
+
+  std::unordered_set<std::string> readKeys;
+  std::unordered_set<std::string> writeKeys;
+  for (const auto &e : batch) {
+    readKeys.insert(e.second.readKeys.begin(), e.second.readKeys.end());
+    writeKeys.insert(e.second.writeKeys.begin(), e.second.writeKeys.end());
+  }
+
+  uint64_t reads = 0;
+  committedRead bound = std::make_tuple(watermark, Timestamp(),
+      (const proto::CommittedProof *) nullptr);
+  for (const auto &key : readKeys) {
+    auto committedReadsItr = committedReads.find(key);
+    if (committedReadsItr == committedReads.end()) {
+      continue;
+    }
+    std::unique_lock lock(committedReadsItr->second.first);
+    std::set<committedRead> &keyReads = committedReadsItr->second.second;
+    auto end = keyReads.lower_bound(bound);
+    for (auto itr = keyReads.begin(); itr != end; ++itr) {
+      reads++;
+    }
+    keyReads.erase(keyReads.begin(), end);
+  }
+  bytes += reads * sizeof(committedRead);
+
+  uint64_t versions = 0;
+  std::vector<std::pair<Timestamp, Value>> pruned;
+  for (const auto &key : writeKeys) {
+    pruned.clear();
+    store.prune(key, watermark, pruned);
+    for (const auto &p : pruned) {
+      bytes += sizeof(p) + p.second.val.size();
+      if (p.second.proof != nullptr) {
+        ReleaseProofRef(p.second.proof);
+      }
+    }
+    versions += pruned.size();
+  }
+
+  uint64_t txns = 0;
+  for (const auto &e : batch) {
+    {
+      p1MetaDataMap::accessor p;
+      if (p1MetaData.find(p, e.second.txnDigest)) {
+        const proto::CommittedProof *conflict = p->second.conflict;
+        p1MetaData.erase(p);
+        if (conflict != nullptr) {
+          UnpinProof(conflict);
+        }
+      }
+    }
+    if (!e.second.committed) {
+      if (aborted.erase(e.second.txnDigest)) {
+        bytes += e.second.txnDigest.size();
+        txns++;
+      }
+      continue;
+    }
+
+    committedMap::accessor c;
+    if (!committed.find(c, e.second.txnDigest)) {
+      continue;
+    }
+    const proto::CommittedProof *proof = c->second;
+    committed.erase(c);
+    bytes += e.second.txnDigest.size();
+    txns++;
+    if (proof == nullptr) {
+      continue;
+    }
+
+    // versions written by this txn that survived pruning keep the proof alive
+    size_t refs = 0;
+    std::pair<Timestamp, Value> val;
+    for (const auto &key : e.second.writeKeys) {
+      if (store.get(key, e.first, val) && val.first == e.first) {
+        refs++;
+      }
+    }
+    if (refs == 0) {
+      gcRetiredProofs.push_back(proof);
+    } else {
+      gcProofRefs[proof] = refs;
+    }
+  }
+
+  if (!gcRetiredProofs.empty()) {
+    gcGracePeriods.push_back({transport->GraceToken(), gcLoopPasses, {}});
+    gcGracePeriods.back().proofs.swap(gcRetiredProofs);
+  }
+
+  stats.Increment("gc_passes", 1);
+  stats.Increment("gc_versions_reclaimed", versions);
+  stats.Increment("gc_committed_reads_reclaimed", reads);
+  stats.Increment("gc_txns_reclaimed", txns);
+  stats.Increment("gc_proofs_reclaimed", proofs);
+  stats.Increment("gc_bytes_reclaimed", bytes);
+  Debug("GC reclaimed %lu versions, %lu committed reads, %lu txns, %lu proofs"
+      " (%lu bytes).", versions, reads, txns, proofs, bytes);
+}
+
 //XXX if you *DONT* want to buffer Wait results then call BufferP1Result only inside SendPhase1Reply
 void Server::BufferP1Result(proto::ConcurrencyControl::Result &result,
   const proto::CommittedProof *conflict, const std::string &txnDigest, int fb){
@@ -3940,6 +4288,9 @@ void Server::BufferP1Result(proto::ConcurrencyControl::Result &result,
       //if(result == proto::ConcurrencyControl::ABORT) XXX //by default nullptr if passed
       c->second.conflict = conflict;
       c->second.hasP1 = true;
+      if (params.gcIntervalMS > 0 && conflict != nullptr) {
+        PinProof(conflict);
+      }
     }
     else{
       if(result != proto::ConcurrencyControl::WAIT){
@@ -3952,6 +4303,12 @@ void Server::BufferP1Result(proto::ConcurrencyControl::Result &result,
         }
         else{
           c->second.result = result;
+          if (params.gcIntervalMS > 0 && conflict != nullptr) {
+            PinProof(conflict);
+          }
+          if (params.gcIntervalMS > 0 && c->second.conflict != nullptr) {
+            UnpinProof(c->second.conflict);
+          }
           c->second.conflict = conflict; //by default nullptr if passed; should never be called here since WAIT can only change to COMMIT/ABSTAIN
           //std::cerr << "Path[" << fb << "] Replacing result: " << c->second.result << " with result:" << result << " for txn: " << BytesToHex(txnDigest, 64) << std::endl;
         }
@@ -3975,6 +4332,9 @@ void Server::BufferP1Result(p1MetaDataMap::accessor &c, proto::ConcurrencyContro
       //if(result == proto::ConcurrencyControl::ABORT) XXX //by default nullptr if passed
       c->second.conflict = conflict;
       c->second.hasP1 = true;
+      if (params.gcIntervalMS > 0 && conflict != nullptr) {
+        PinProof(conflict);
+      }
     }
     else{
       if(result != proto::ConcurrencyControl::WAIT){
@@ -3986,6 +4346,12 @@ void Server::BufferP1Result(p1MetaDataMap::accessor &c, proto::ConcurrencyContro
         }
         else{
           c->second.result = result;
+          if (params.gcIntervalMS > 0 && conflict != nullptr) {
+            PinProof(conflict);
+          }
+          if (params.gcIntervalMS > 0 && c->second.conflict != nullptr) {
+            UnpinProof(c->second.conflict);
+          }
           c->second.conflict = conflict; //by default nullptr if passed; should never be called here since WAIT can only change to COMMIT/ABSTAIN
           //std::cerr << "Path[" << fb << "] Replacing result: " << c->second.result << " with result:" << result << " for txn: " << BytesToHex(txnDigest, 64) << std::endl;
         }
@@ -4034,8 +4400,10 @@ void Server::SendPhase1Reply(uint64_t reqId,
       Debug("PHASE1[%s] Batching Phase1Reply.",
             BytesToHex(txnDigest, 16).c_str());
 
+      uint64_t signStart = Stats::NowNs();
       MessageToSign(cc, phase1Reply->mutable_signed_cc(),
-        [sendCB, cc, txnDigest, this, phase1Reply]() {
+        [sendCB, cc, txnDigest, this, phase1Reply, signStart]() {
+          stats.Record("lat_p1_sign", Stats::NowNs() - signStart);
           Debug("PHASE1[%s] Sending Phase1Reply with signature %s from priv key %lu.",
             BytesToHex(txnDigest, 16).c_str(),
             BytesToHex(phase1Reply->signed_cc().signature(), 100).c_str(),
@@ -4054,8 +4422,9 @@ void Server::SendPhase1Reply(uint64_t reqId,
 void Server::SendPhase1Reply_batch(std::vector<uint64_t> &reqIds,
     std::vector<proto::ConcurrencyControl::Result> &results,
     std::vector<const proto::CommittedProof *> &conflicts, const std::vector<std::string> &txnDigests,
-    const TransportAddress *remote, const proto::Transaction * abstain_conflict) {
-  
+    const TransportAddress *remote,
+    const std::vector<const proto::Transaction *> &abstainConflicts) {
+
   std::vector<Message *> phase1Replies;
   TransportAddress *remoteCopy = remote->clone();
 
@@ -4071,9 +4440,8 @@ void Server::SendPhase1Reply_batch(std::vector<uint64_t> &reqIds,
     Debug("phase1Reply->req_id : %d\n", phase1Reply->req_id());
     //NOTE WARNING PURELY testing
     //if(result == proto::ConcurrencyControl::ABSTAIN) *phase1Reply->mutable_abstain_conflict() = dummyTx;
-    if(abstain_conflict != nullptr){
-      //Panic("setting abstain_conflict");
-      *phase1Reply->mutable_abstain_conflict() = *abstain_conflict;
+    if(abstainConflicts[i] != nullptr){
+      *phase1Reply->mutable_abstain_conflict() = *abstainConflicts[i];
     }
     phase1Reply->mutable_cc()->set_ccr(results[i]);
 
@@ -4130,6 +4498,8 @@ void Server::SendPhase1Reply_batch(std::vector<uint64_t> &reqIds,
   */
 
   this->transport->SendMessage_batch(this, *remoteCopy, phase1Replies);
+  FreePhase1Reply_batch(phase1Replies);
+  delete remoteCopy;
 }
 
 void Server::CleanDependencies(const std::string &txnDigest) {
@@ -4288,345 +4658,158 @@ void Server::MessageToSign(::google::protobuf::Message* msg,
   }
 }
 
-//TODO: replace all of these with moodycamel queue (just check that try_dequeue is successful)
+//Message re-use allocators. Objects are Clear()ed when they are returned to
+//their pool, so callers always receive an empty message.
 proto::ReadReply *Server::GetUnusedReadReply() {
-  return new proto::ReadReply();
-
-  // std::unique_lock<std::mutex> lock(readReplyProtoMutex);
-  // proto::ReadReply *reply;
-  // if (readReplies.size() > 0) {
-  //   reply = readReplies.back();
-  //   reply->Clear();
-  //   readReplies.pop_back();
-  // } else {
-  //   reply = new proto::ReadReply();
-  // }
-  // return reply;
+  return readReplyPool.Get();
 }
 
 proto::Phase1Reply *Server::GetUnusedPhase1Reply() {
-  return new proto::Phase1Reply();
-
-  // //Latency_Start(&waitOnProtoLock);
-  // std::unique_lock<std::mutex> lock(p1ReplyProtoMutex);
-  // //Latency_End(&waitOnProtoLock);
-  // proto::Phase1Reply *reply;
-  // if (p1Replies.size() > 0) {
-  //   reply = p1Replies.back();
-  //   //reply->Clear(); //can move this to Free if want more work at threads
-  //   p1Replies.pop_back();
-  // } else {
-  //   reply = new proto::Phase1Reply();
-  // }
-  // return reply;
+  return p1ReplyPool.Get();
 }
 
 proto::Phase2Reply *Server::GetUnusedPhase2Reply() {
-  return new proto::Phase2Reply();
-
-  // //Latency_Start(&waitOnProtoLock);
-  // std::unique_lock<std::mutex> lock(p2ReplyProtoMutex);
-  // //Latency_End(&waitOnProtoLock);
-  // proto::Phase2Reply *reply;
-  // if (p2Replies.size() > 0) {
-  //   reply = p2Replies.back();
-  //   //reply->Clear();
-  //   p2Replies.pop_back();
-  // } else {
-  //   reply = new proto::Phase2Reply();
-  // }
-  // return reply;
+  return p2ReplyPool.Get();
 }
 
 proto::Read *Server::GetUnusedReadmessage() {
-  return new proto::Read();
-
-  // std::unique_lock<std::mutex> lock(readProtoMutex);
-  // proto::Read *msg;
-  // if (readMessages.size() > 0) {
-  //   msg = readMessages.back();
-  //   msg->Clear();
-  //   readMessages.pop_back();
-  // } else {
-  //   msg = new proto::Read();
-  // }
-  // return msg;
+  return readPool.Get();
 }
 
 proto::Phase1 *Server::GetUnusedPhase1message() {
-  return new proto::Phase1();
-
-  // //Latency_Start(&waitOnProtoLock);
-  // std::unique_lock<std::mutex> lock(p1ProtoMutex);
-  // //Latency_End(&waitOnProtoLock);
-  // proto::Phase1 *msg;
-  // if (p1messages.size() > 0) {
-  //   msg = p1messages.back();
-  //   msg->Clear();
-  //   p1messages.pop_back();
-  // } else {
-  //   msg = new proto::Phase1();
-  // }
-  // return msg;
+  return p1Pool.Get();
 }
 
 proto::Phase2 *Server::GetUnusedPhase2message() {
-  return new proto::Phase2();
-
-  // //Latency_Start(&waitOnProtoLock);
-  // std::unique_lock<std::mutex> lock(p2ProtoMutex);
-  // //Latency_End(&waitOnProtoLock);
-  // proto::Phase2 *msg;
-  // if (p2messages.size() > 0) {
-  //   msg = p2messages.back();
-  //   msg->Clear();
-  //   p2messages.pop_back();
-  // } else {
-  //   msg = new proto::Phase2();
-  // }
-  // return msg;
+  return p2Pool.Get();
 }
 
 proto::Writeback *Server::GetUnusedWBmessage() {
-  return new proto::Writeback();
-
-  // //Latency_Start(&waitOnProtoLock);
-  // std::unique_lock<std::mutex> lock(WBProtoMutex);
-  // //Latency_End(&waitOnProtoLock);
-  // proto::Writeback *msg;
-  // if (WBmessages.size() > 0) {
-  //   msg = WBmessages.back();
-  //   msg->Clear();
-  //   WBmessages.pop_back();
-  // } else {
-  //   msg = new proto::Writeback();
-  // }
-  // return msg;
+  return WBPool.Get();
 }
 
 void Server::FreeReadReply(proto::ReadReply *reply) {
-  delete reply;
-  // std::unique_lock<std::mutex> lock(readReplyProtoMutex);
-  // //reply->Clear();
-  // readReplies.push_back(reply);
+  readReplyPool.Put(reply);
 }
 
 void Server::FreeReadReply_batch(std::vector<Message *> &replies) {
-  for (auto itr = replies.begin(); itr != replies.end(); itr++){
-    delete *itr;
+  for (auto reply : replies) {
+    readReplyPool.Put(static_cast<proto::ReadReply *>(reply));
   }
-  
-  // std::unique_lock<std::mutex> lock(readReplyProtoMutex);
-  // //reply->Clear();
-  // readReplies.push_back(reply);
 }
 
 void Server::FreePhase1Reply(proto::Phase1Reply *reply) {
-  delete reply;
-  // std::unique_lock<std::mutex> lock(p1ReplyProtoMutex);
-  //
-  // reply->Clear();
-  // p1Replies.push_back(reply);
+  p1ReplyPool.Put(reply);
 }
 
 void Server::FreePhase1Reply_batch(std::vector<Message *> &replies) {
-  for (auto itr = replies.begin(); itr != replies.end(); itr++){
-    delete *itr;
+  for (auto reply : replies) {
+    p1ReplyPool.Put(static_cast<proto::Phase1Reply *>(reply));
   }
-  // std::unique_lock<std::mutex> lock(p1ReplyProtoMutex);
-  //
-  // reply->Clear();
-  // p1Replies.push_back(reply);
 }
 
 void Server::FreePhase2Reply(proto::Phase2Reply *reply) {
-  delete reply;
-  // std::unique_lock<std::mutex> lock(p2ReplyProtoMutex);
-  // reply->Clear();
-  // p2Replies.push_back(reply);
+  p2ReplyPool.Put(reply);
 }
 
 void Server::FreeReadmessage(proto::Read *msg) {
-  delete msg;
-  // std::unique_lock<std::mutex> lock(readProtoMutex);
-  // readMessages.push_back(msg);
+  readPool.Put(msg);
 }
 
 void Server::FreePhase1message(proto::Phase1 *msg) {
-  delete msg;
-  // //Latency_Start(&waitOnProtoLock);
-  // std::unique_lock<std::mutex> lock(p1ProtoMutex);
-  // //Latency_End(&waitOnProtoLock);
-  // p1messages.push_back(msg);
+  p1Pool.Put(msg);
 }
 
 void Server::FreePhase2message(proto::Phase2 *msg) {
-  delete msg;
-  // //Latency_Start(&waitOnProtoLock);
-  // std::unique_lock<std::mutex> lock(p2ProtoMutex);
-  // //Latency_End(&waitOnProtoLock);
-  // p2messages.push_back(msg);
+  p2Pool.Put(msg);
 }
 
 void Server::FreeWBmessage(proto::Writeback *msg) {
-  delete msg;
-  // //Latency_Start(&waitOnProtoLock);
-  // std::unique_lock<std::mutex> lock(WBProtoMutex);
-  // //Latency_End(&waitOnProtoLock);
-  // WBmessages.push_back(msg);
+  WBPool.Put(msg);
 }
 
 
 //Fallback message re-use allocators
 
 proto::Phase1FB *Server::GetUnusedPhase1FBmessage() {
-  return new proto::Phase1FB();
-
-  // //Latency_Start(&waitOnProtoLock);
-  // std::unique_lock<std::mutex> lock(p1ProtoMutex);
-  // //Latency_End(&waitOnProtoLock);
-  // proto::Phase1FB *msg;
-  // if (p1FBmessages.size() > 0) {
-  //   msg = p1FBmessages.back();
-  //   msg->Clear();
-  //   p1FBmessages.pop_back();
-  // } else {
-  //   msg = new proto::Phase1FB();
-  // }
-  // return msg;
+  return p1FBPool.Get();
 }
 
 void Server::FreePhase1FBmessage(proto::Phase1FB *msg) {
-  delete msg;
-  // //Latency_Start(&waitOnProtoLock);
-  // std::unique_lock<std::mutex> lock(p1FBProtoMutex);
-  // //Latency_End(&waitOnProtoLock);
-  // p1FBmessages.push_back(msg);
-}
-
-proto::Phase1FBReply *Server::GetUnusedPhase1FBReply(){
-  return new proto::Phase1FBReply();
-  // //Latency_Start(&waitOnProtoLock);
-  // std::unique_lock<std::mutex> lock(P1FBRProtoMutex);
-  // //Latency_End(&waitOnProtoLock);
-  // proto::Phase1FBReply *msg;
-  // if (P1FBReplies.size() > 0) {
-  //   msg = P1FBReplies.back();
-  //   msg->Clear();
-  //   P1FBReplies.pop_back();
-  // } else {
-  //   msg = new proto::proto::Phase1FBReply();
-  // }
-  // return msg;
+  p1FBPool.Put(msg);
+}
+
+proto::Phase1FBReply *Server::GetUnusedPhase1FBReply() {
+  return p1FBReplyPool.Get();
 }
 
-void Server::FreePhase1FBReply(proto::Phase1FBReply *msg){
-  delete msg;
-  // //Latency_Start(&waitOnProtoLock);
-  // std::unique_lock<std::mutex> lock(P1FBRProtoMutex);
-  // //Latency_End(&waitOnProtoLock);
-  // P1FBReplies.push_back(msg);
+void Server::FreePhase1FBReply(proto::Phase1FBReply *msg) {
+  p1FBReplyPool.Put(msg);
 }
 
 proto::Phase2FB *Server::GetUnusedPhase2FBmessage() {
-  return new proto::Phase2FB();
-
-  // //Latency_Start(&waitOnProtoLock);
-  // std::unique_lock<std::mutex> lock(p2FBProtoMutex);
-  // //Latency_End(&waitOnProtoLock);
-  // proto::Phase2FB *msg;
-  // if (p2FBmessages.size() > 0) {
-  //   msg = p2FBmessages.back();
-  //   msg->Clear();
-  //   p2FBmessages.pop_back();
-  // } else {
-  //   msg = new proto::Phase2FB();
-  // }
-  // return msg;
+  return p2FBPool.Get();
 }
 
 void Server::FreePhase2FBmessage(const proto::Phase2FB *msg) {
-  delete msg;
-  // //Latency_Start(&waitOnProtoLock);
-  // std::unique_lock<std::mutex> lock(p2FBProtoMutex);
-  // //Latency_End(&waitOnProtoLock);
-  // p2FBmessages.push_back(msg);
-}
-
-proto::Phase2FBReply *Server::GetUnusedPhase2FBReply(){
-  return new proto::Phase2FBReply();
-  // //Latency_Start(&waitOnProtoLock);
-  // std::unique_lock<std::mutex> lock(P2FBRProtoMutex);
-  // //Latency_End(&waitOnProtoLock);
-  // proto::Phase2FBReply *msg;
-  // if (P2FBReplies.size() > 0) {
-  //   msg = P2FBReplies.back();
-  //   msg->Clear();
-  //   P2FBReplies.pop_back();
-  // } else {
-  //   msg = new proto::proto::Phase2FBReply();
-  // }
-  // return msg;
+  p2FBPool.Put(const_cast<proto::Phase2FB *>(msg));
 }
 
-void Server::FreePhase2FBReply(proto::Phase2FBReply *msg){
-  delete msg;
-  // //Latency_Start(&waitOnProtoLock);
-  // std::unique_lock<std::mutex> lock(P2FBRProtoMutex);
-  // //Latency_End(&waitOnProtoLock);
-  // P2FBReplies.push_back(msg);
+proto::Phase2FBReply *Server::GetUnusedPhase2FBReply() {
+  return p2FBReplyPool.Get();
 }
 
-
-proto::InvokeFB *Server::GetUnusedInvokeFBmessage(){
-  return new proto::InvokeFB();
+void Server::FreePhase2FBReply(proto::Phase2FBReply *msg) {
+  p2FBReplyPool.Put(msg);
 }
 
-void Server::FreeInvokeFBmessage(proto::InvokeFB *msg){
-  delete msg;
+proto::InvokeFB *Server::GetUnusedInvokeFBmessage() {
+  return invokeFBPool.Get();
 }
 
-proto::SendView *Server::GetUnusedSendViewMessage(){
-  return new proto::SendView();
+void Server::FreeInvokeFBmessage(proto::InvokeFB *msg) {
+  invokeFBPool.Put(msg);
 }
 
-void Server::FreeSendViewMessage(proto::SendView *msg){
-  delete msg;
+proto::SendView *Server::GetUnusedSendViewMessage() {
+  return sendViewPool.Get();
 }
 
-proto::ElectMessage *Server::GetUnusedElectMessage(){
-  return new proto::ElectMessage();
+void Server::FreeSendViewMessage(proto::SendView *msg) {
+  sendViewPool.Put(msg);
 }
 
-void Server::FreeElectMessage(proto::ElectMessage *msg){
-  delete msg;
+proto::ElectMessage *Server::GetUnusedElectMessage() {
+  return electMessagePool.Get();
 }
 
-proto::ElectFB *Server::GetUnusedElectFBmessage(){
-  return new proto::ElectFB();
+void Server::FreeElectMessage(proto::ElectMessage *msg) {
+  electMessagePool.Put(msg);
 }
 
-void Server::FreeElectFBmessage(proto::ElectFB *msg){
-  delete msg;
+proto::ElectFB *Server::GetUnusedElectFBmessage() {
+  return electFBPool.Get();
 }
 
-proto::DecisionFB *Server::GetUnusedDecisionFBmessage(){
-  return new proto::DecisionFB();
+void Server::FreeElectFBmessage(proto::ElectFB *msg) {
+  electFBPool.Put(msg);
 }
 
-void Server::FreeDecisionFBmessage(proto::DecisionFB *msg){
-  delete msg;
+proto::DecisionFB *Server::GetUnusedDecisionFBmessage() {
+  return decisionFBPool.Get();
 }
 
-proto::MoveView *Server::GetUnusedMoveView(){
-  return new proto::MoveView();
+void Server::FreeDecisionFBmessage(proto::DecisionFB *msg) {
+  decisionFBPool.Put(msg);
 }
 
-void Server::FreeMoveView(proto::MoveView *msg){
-  delete msg;
+proto::MoveView *Server::GetUnusedMoveView() {
+  return moveViewPool.Get();
 }
 
-
+void Server::FreeMoveView(proto::MoveView *msg) {
+  moveViewPool.Put(msg);
+}
 
 
 //XXX Simulated HMAC code
@@ -4639,13 +4822,16 @@ void CreateHMACedMessage(const ::google::protobuf::Message &msg, proto::SignedMe
 //TODO: If one wants to use Macs for Clients, need to add it to keymanager (in advance or dynamically based off id)
 //can use client id to replica id (group * n + idx)
 void Server::CreateSessionKeys(){
+  std::vector<std::string> keys;
   for (uint64_t i = 0; i < config.n; i++) {
     if (i > idx) {
       sessionKeys[i] = std::string(8, (char) idx + 0x30) + std::string(8, (char) i + 0x30);
     } else {
       sessionKeys[i] = std::string(8, (char) i + 0x30) + std::string(8, (char) idx + 0x30);
     }
+    keys.push_back(sessionKeys[i]);
   }
+  sessionMACs = new crypto::SessionMACs(params.hmacType, keys);
 }
 
 // create MAC messages and verify them: Used for all to all leader election.
@@ -4653,7 +4839,9 @@ bool Server::ValidateHMACedMessage(const proto::SignedMessage &signedMessage) {
 
 proto::HMACs hmacs;
 hmacs.ParseFromString(signedMessage.signature());
-return crypto::verifyHMAC(signedMessage.data(), (*hmacs.mutable_hmacs())[idx], sessionKeys[signedMessage.process_id() % config.n]);
+auto itr = hmacs.hmacs().find(idx);
+if (itr == hmacs.hmacs().end()) return false;
+return sessionMACs->Verify(signedMessage.data(), itr->second, signedMessage.process_id() % config.n);
 }
 
 void Server::CreateHMACedMessage(const ::google::protobuf::Message &msg, proto::SignedMessage& signedMessage) {
@@ -4662,9 +4850,11 @@ const std::string &msgData = msg.SerializeAsString();
 signedMessage.set_data(msgData);
 signedMessage.set_process_id(id);
 
+std::vector<std::string> macs;
+sessionMACs->MacAll(msgData, macs);
 proto::HMACs hmacs;
 for (uint64_t i = 0; i < config.n; i++) {
-  (*hmacs.mutable_hmacs())[i] = crypto::HMAC(msgData, sessionKeys[i]);
+  (*hmacs.mutable_hmacs())[i] = std::move(macs[i]);
 }
 signedMessage.set_signature(hmacs.SerializeAsString());
 }
@@ -4728,7 +4918,8 @@ bool Server::ForwardWriteback(const TransportAddress &remote, uint64_t ReqId, co
   
   Debug("Checking for existing WB message for txn %s", BytesToHex(txnDigest, 16).c_str());
   //1) COMMIT CASE
-  if(committed.find(txnDigest) != committed.end()){
+  committedMap::const_accessor c;
+  if(committed.find(c, txnDigest)){
       Debug("ForwardingWriteback Commit for txn: %s", BytesToHex(txnDigest, 64).c_str());
       proto::Phase1FBReply phase1FBReply;
       phase1FBReply.Clear();
@@ -4739,7 +4930,7 @@ bool Server::ForwardWriteback(const TransportAddress &remote, uint64_t ReqId, co
       wb->Clear();
       wb->set_decision(proto::COMMIT);
       wb->set_txn_digest(txnDigest);
-      proto::CommittedProof* proof = committed[txnDigest];
+      proto::CommittedProof* proof = c->second;
 
       //*wb->mutable_txn() = proof->txn();
 
@@ -4755,6 +4946,7 @@ bool Server::ForwardWriteback(const TransportAddress &remote, uint64_t ReqId, co
         // A Commit proof
         return false;
       }
+      c.release();
 
       transport->SendMessage(this, remote, phase1FBReply);
 
@@ -4796,7 +4988,8 @@ bool Server::ForwardWritebackMulti(const std::string &txnDigest, interestedClien
   //if(!jtr) return true; //no interested clients, return
   proto::Phase1FBReply phase1FBReply;
 
-  if(committed.find(txnDigest) != committed.end()){
+  committedMap::const_accessor c;
+  if(committed.find(c, txnDigest)){
       Debug("ForwardingWritebackMulti Commit for txn: %s", BytesToHex(txnDigest, 64).c_str());
       phase1FBReply.Clear();
       phase1FBReply.set_req_id(0);
@@ -4806,7 +4999,7 @@ bool Server::ForwardWritebackMulti(const std::string &txnDigest, interestedClien
       wb->Clear();
       wb->set_decision(proto::COMMIT);
       wb->set_txn_digest(txnDigest);
-      proto::CommittedProof* proof = committed[txnDigest];
+      proto::CommittedProof* proof = c->second;
 
       //*wb->mutable_txn() = proof->txn();
 
@@ -4834,6 +5027,7 @@ bool Server::ForwardWritebackMulti(const std::string &txnDigest, interestedClien
   else{
     return false;
   }
+  c.release();
 
   for (const auto addr : i->second) {
     Debug("ForwardingWritebackMulti for txn: %s to +1 clients", BytesToHex(txnDigest, 64).c_str()); //would need to store client ID with it to print.
@@ -4851,6 +5045,7 @@ bool Server::ForwardWritebackMulti(const std::string &txnDigest, interestedClien
 //For example, 1) case for committed could fail, but all consecutive fail too because it was committed inbetween.
 //Could just put abort cases last; but makes for redundant work if it should occur inbetween.
 void Server::HandlePhase1FB(const TransportAddress &remote, proto::Phase1FB &msg) {
+  StatsTimer fbTimer(stats, "lat_fallback");
 
   stats.Increment("total_p1FB_received", 1);
   std::string txnDigest = TransactionDigest(msg.txn(), params.hashDigest);
@@ -5039,7 +5234,9 @@ bool Server::ExecP1(p1MetaDataMap::accessor &c, proto::Phase1FB &msg, const Tran
 
   proto::Transaction *txn = msg.release_txn();
   ongoingMap::accessor b;
-  ongoing.insert(b, std::make_pair(txnDigest, txn));
+  if (ongoing.insert(b, std::make_pair(txnDigest, txn))) {
+    TrackOngoing(txn);
+  }
   b.release();
   //fallback.insert(txnDigest);
   //std::cerr << "[FB] Added tx to ongoing: " << BytesToHex(txnDigest, 16) << std::endl;
@@ -5212,6 +5409,7 @@ void Server::SendPhase1FBReply(P1FBorganizer *p1fb_organizer, const std::string
 
 void Server::HandlePhase2FB(const TransportAddress &remote,
     const proto::Phase2FB &msg) {
+  StatsTimer fbTimer(stats, "lat_fallback");
 
   //std::string txnDigest = TransactionDigest(msg.txn(), params.hashDigest);
   const std::string &txnDigest = msg.txn_digest();
@@ -5603,6 +5801,7 @@ void Server::SendView(const TransportAddress &remote, const std::string &txnDige
 //   }
 //otherwise pass and invoke for the first time!
 void Server::HandleInvokeFB(const TransportAddress &remote, proto::InvokeFB &msg) {
+  StatsTimer fbTimer(stats, "lat_fallback");
 
 
     // CHECK if part of logging shard. (this needs to be done at all p2s, reject if its not ourselves)
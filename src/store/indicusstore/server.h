@@ -33,6 +33,7 @@
 #define _INDICUS_SERVER_H_
 
 #include "lib/latency.h"
+#include "lib/objectpool.h"
 #include "lib/transport.h"
 #include "store/common/backend/pingserver.h"
 #include "store/server.h"
@@ -45,8 +46,11 @@
 #include "store/indicusstore/batchsigner.h"
 #include "store/indicusstore/verifier.h"
 #include "store/indicusstore/maxsize.h"
+#include "store/indicusstore/preparedreadindex.h"
+#include "store/indicusstore/digest.h"
 #include <sys/time.h>
 
+#include <deque>
 #include <set>
 #include <unordered_map>
 #include <unordered_set>
@@ -101,8 +105,23 @@ class Server : public TransportReceiver, public ::Server, public PingServer {
       const std::vector<std::string> &types, const std::vector<std::string> &datas,
       void *meta_data);
 
+  // Parses straight out of the transport's receive buffer unless handling is
+  // dispatched to another thread, in which case the frame must be copied.
+  virtual void ReceiveMessageView(const TransportAddress &remote,
+      std::string_view type, const MessageView &data,
+      void *meta_data) override;
+
+  virtual void ReceiveMessageView_batch(const TransportAddress &remote,
+      const std::vector<std::string_view> &types, const std::vector<MessageView> &datas,
+      void *meta_data) override;
+
   virtual void Load(const std::string &key, const std::string &value,
       const Timestamp timestamp) override;
+  virtual void ReserveLoad(size_t numKeys) override;
+  virtual bool WriteSnapshot(const std::string &path) override;
+  virtual bool LoadSnapshot(const std::string &path, size_t numThreads) override;
+  virtual void LoadBatch(std::vector<std::pair<std::string, std::string>> &kvs,
+      const Timestamp timestamp) override;
 
   virtual inline Stats &GetStats() override { return stats; }
 
@@ -113,7 +132,13 @@ class Server : public TransportReceiver, public ::Server, public PingServer {
    std::string dummyString;
    proto::Transaction dummyTx;
 
+  // Per-transaction state is keyed by the inline Digest rather than a heap
+  // allocated std::string, so lookups neither allocate nor rehash the bytes.
+  template<typename V>
+  using DigestMap = tbb::concurrent_hash_map<Digest, V, DigestHashCompare>;
+
   friend class ServerTest;
+  friend class SnapshotTest;
   struct Value {
     std::string val;
     const proto::CommittedProof *proof;
@@ -121,16 +146,23 @@ class Server : public TransportReceiver, public ::Server, public PingServer {
   
 
   void ReceiveMessageInternal(const TransportAddress &remote,
-      const std::string &type, const std::string &data,
+      std::string_view type, const MessageView &data,
       void *meta_data);
 
   void ReceiveMessageInternal_batch(const TransportAddress &remote,
-      const std::vector<std::string> &types, const std::vector<std::string> &datas,
+      const std::vector<std::string_view> &types, const std::vector<MessageView> &datas,
       void *meta_data);
 
+  // With multiThreading, runs longer than PARSE_CHUNK_SIZE messages are
+  // parsed by the worker threads as well.
+  static constexpr size_t PARSE_CHUNK_SIZE = 16;
+  template<class M>
+  void ParseRun(const std::vector<MessageView> &datas, size_t start,
+      size_t end, ObjectPool<M> &pool, std::vector<M *> &msgs);
+
   void HandleRead(const TransportAddress &remote, proto::Read &msg);
 
-  void HandleRead_batch(const TransportAddress &remote, proto::Read *read_msgs, int batch_size);
+  void HandleRead_batch(const TransportAddress &remote, const std::vector<proto::Read *> &read_msgs);
 
   void HandlePhase1_atomic(const TransportAddress &remote,
       proto::Phase1 &msg);
@@ -144,19 +176,17 @@ class Server : public TransportReceiver, public ::Server, public PingServer {
       proto::Phase1 &msg);
 
   void HandlePhase1_batch(const TransportAddress &remote,
-      proto::Phase1 *msg, int batch_size);
+      const std::vector<proto::Phase1 *> &msgs);
 
   void HandlePhase1CB(proto::Phase1 *msg, proto::ConcurrencyControl::Result result,
         const proto::CommittedProof* &committedProof, std::string &txnDigest, const TransportAddress &remote,
         const proto::Transaction *abstain_conflict, bool replicaGossip = false);
 
-  void HandlePhase1CB_batch(proto::Phase1 *msgs, std::vector<proto::ConcurrencyControl::Result> &results,
-        std::vector<const proto::CommittedProof*> &committedProofs, std::vector<std::string> &txnDigests, 
-        const TransportAddress &remote, const proto::Transaction *abstain_conflict, bool replicaGossip = false);
-
-  void HandlePhase1CB_batch_multi(std::vector<proto::Phase1> &msgs, std::vector<proto::ConcurrencyControl::Result> &results,
-        std::vector<const proto::CommittedProof*> &committedProofs, std::vector<std::string> &txnDigests, 
-        const TransportAddress &remote, const proto::Transaction *abstain_conflict, bool replicaGossip = false);
+  void HandlePhase1CB_batch(const std::vector<proto::Phase1 *> &msgs,
+        std::vector<proto::ConcurrencyControl::Result> &results,
+        std::vector<const proto::CommittedProof*> &committedProofs,
+        std::vector<const proto::Transaction*> &abstainConflicts,
+        std::vector<std::string> &txnDigests, const TransportAddress &remote);
 
   void HandlePhase2CB(TransportAddress *remote, proto::Phase2 *msg, const std::string* txnDigest,
         signedCallback sendCB, proto::Phase2Reply* phase2Reply, cleanCallback cleanCB, void* valid); //bool valid);
@@ -166,11 +196,11 @@ class Server : public TransportReceiver, public ::Server, public PingServer {
 
 
   void WritebackCallback(proto::Writeback *msg, const std::string* txnDigest,
-    proto::Transaction* txn, void* valid); //bool valid);
+    proto::Transaction* txn, void* valid, bool grouped = false); //bool valid);
   void HandleWriteback(const TransportAddress &remote,
-      proto::Writeback &msg);
+      proto::Writeback &msg, bool grouped = false);
   void HandleWriteback_batch(const TransportAddress &remote,
-     proto::Writeback *msgs, int batch_size);
+     const std::vector<proto::Writeback *> &msgs);
   void HandleAbort(const TransportAddress &remote, const proto::Abort &msg);
 
   //Fallback handler functions
@@ -267,7 +297,7 @@ class Server : public TransportReceiver, public ::Server, public PingServer {
       bool hasP1;
       std::mutex P1meta_mutex;
     };
-    typedef tbb::concurrent_hash_map<std::string, P1MetaData> p1MetaDataMap;
+    typedef DigestMap<P1MetaData> p1MetaDataMap;
 
     void RelayP1(const std::string &dependency_txnDig, bool fallback_flow, uint64_t reqId, const TransportAddress &remote, const std::string &txnDigest);
     void SendRelayP1(const TransportAddress &remote, const std::string &dependency_txnDig, uint64_t dependent_id, const std::string &dependent_txnDig);
@@ -310,9 +340,9 @@ class Server : public TransportReceiver, public ::Server, public PingServer {
 
     //keep list of all remote addresses == interested client_seq_num
     //TODO: store original client separately..
-    typedef tbb::concurrent_hash_map<std::string, tbb::concurrent_unordered_set<const TransportAddress*>> interestedClientsMap;
+    typedef DigestMap<tbb::concurrent_unordered_set<const TransportAddress*>> interestedClientsMap;
     interestedClientsMap interestedClients;
-    tbb::concurrent_hash_map<std::string, std::pair<uint64_t, const TransportAddress*>> originalClient;
+    DigestMap<std::pair<uint64_t, const TransportAddress*>> originalClient;
 
     bool ForwardWriteback(const TransportAddress &remote, uint64_t ReqId, const std::string &txnDigest);
     bool ForwardWritebackMulti(const std::string &txnDigest, interestedClientsMap::accessor &i);
@@ -324,6 +354,21 @@ class Server : public TransportReceiver, public ::Server, public PingServer {
       Timestamp &retryTs, const proto::CommittedProof* &conflict,
       const proto::Transaction* &abstain_conflict,
       bool fallback_flow = false, bool replicaGossip = false);
+  // Runs the check for every non-null entry of txns while holding the locks
+  // for the union of their keys, in (timestamp, digest) order, and buffers
+  // the results. Entries that were concurrently finalized are left as WAIT.
+  void DoOCCCheck_batch(const std::vector<proto::Phase1 *> &msgs,
+      const TransportAddress &remote, const std::vector<std::string> &txnDigests,
+      const std::vector<proto::Transaction *> &txns,
+      std::vector<proto::ConcurrencyControl::Result> &results,
+      std::vector<const proto::CommittedProof*> &conflicts,
+      std::vector<const proto::Transaction*> &abstainConflicts);
+  proto::ConcurrencyControl::Result DoOCCCheckLocked(
+      uint64_t reqId, const TransportAddress &remote,
+      const std::string &txnDigest, const proto::Transaction &txn,
+      Timestamp &retryTs, const proto::CommittedProof* &conflict,
+      const proto::Transaction* &abstain_conflict,
+      bool fallback_flow, bool replicaGossip);
   proto::ConcurrencyControl::Result DoTAPIROCCCheck(
       const std::string &txnDigest, const proto::Transaction &txn,
       Timestamp &retryTs);
@@ -348,6 +393,20 @@ class Server : public TransportReceiver, public ::Server, public PingServer {
       std::vector<std::pair<Timestamp, Value>> &writes);
   void Commit(const std::string &txnDigest, proto::Transaction *txn,
       proto::GroupedSignatures *groupedSigs, bool p1Sigs, uint64_t view);
+  // Grouped apply for writebacks that arrive together: commits are staged
+  // and applied by CommitBatch, which takes each key's lock once.
+  struct PendingCommit {
+    std::string txnDigest;
+    proto::Transaction *txn;
+    proto::GroupedSignatures *groupedSigs;
+    bool p1Sigs;
+    uint64_t view;
+    // set by StageCommit, which already inserted it into committed
+    proto::CommittedProof *proof = nullptr;
+  };
+  void StageCommit(PendingCommit &&commit);
+  void FlushCommits();
+  void CommitBatch(std::vector<PendingCommit> &commits);
   void Abort(const std::string &txnDigest);
   void CheckDependents(const std::string &txnDigest);
   proto::ConcurrencyControl::Result CheckDependencies(
@@ -355,6 +414,20 @@ class Server : public TransportReceiver, public ::Server, public PingServer {
   proto::ConcurrencyControl::Result CheckDependencies(
       const proto::Transaction &txn);
   bool CheckHighWatermark(const Timestamp &ts);
+  // Multi-version garbage collection (params.gcIntervalMS > 0).
+  bool CheckLowWatermark(const proto::Transaction &txn);
+  Timestamp OldestTimestamp(const proto::Transaction &txn);
+  void TrackOngoing(const proto::Transaction *txn);
+  void UntrackOngoing(const proto::Transaction *txn);
+  void EnqueueGC(const std::string &txnDigest, const Timestamp &ts,
+      const proto::Transaction *txn);
+  bool GCReclaimed(const proto::Transaction &txn);
+  void PinProof(const proto::CommittedProof *proof);
+  void UnpinProof(const proto::CommittedProof *proof);
+  void FreeRetiredProofs(uint64_t &proofs, uint64_t &bytes);
+  void ScheduleGC();
+  void RunGC();
+  void ReleaseProofRef(const proto::CommittedProof *proof);
   void BufferP1Result(proto::ConcurrencyControl::Result &result,
     const proto::CommittedProof *conflict, const std::string &txnDigest, int fb = 0);
   void BufferP1Result(p1MetaDataMap::accessor &c, proto::ConcurrencyControl::Result &result,
@@ -368,9 +441,11 @@ class Server : public TransportReceiver, public ::Server, public PingServer {
   void SendPhase1Reply_batch(std::vector<uint64_t> &reqIds,
     std::vector<proto::ConcurrencyControl::Result> &results,
     std::vector<const proto::CommittedProof *> &conflicts, const std::vector<std::string> &txnDigests,
-    const TransportAddress *remote, const proto::Transaction *abstain_conflict);
+    const TransportAddress *remote,
+    const std::vector<const proto::Transaction *> &abstainConflicts);
 
   void Clean(const std::string &txnDigest);
+  void CleanFallback(const std::string &txnDigest);
   void CleanDependencies(const std::string &txnDigest);
   void LookupP1Decision(const std::string &txnDigest, int64_t &myProcessId,
       proto::ConcurrencyControl::Result &myResult) const;
@@ -475,15 +550,24 @@ class Server : public TransportReceiver, public ::Server, public PingServer {
 
   std::mutex signMutex;
 
-  //proto mutexes
-  std::mutex protoMutex;
-  std::mutex readReplyProtoMutex;
-  std::mutex p1ReplyProtoMutex;
-  std::mutex p2ReplyProtoMutex;
-  std::mutex readProtoMutex;
-  std::mutex p1ProtoMutex;
-  std::mutex p2ProtoMutex;
-  std::mutex WBProtoMutex;
+  //proto pools (lock-free, per-thread cached; see lib/objectpool.h)
+  ObjectPool<proto::ReadReply> readReplyPool;
+  ObjectPool<proto::Phase1Reply> p1ReplyPool;
+  ObjectPool<proto::Phase2Reply> p2ReplyPool;
+  ObjectPool<proto::Read> readPool;
+  ObjectPool<proto::Phase1> p1Pool;
+  ObjectPool<proto::Phase2> p2Pool;
+  ObjectPool<proto::Writeback> WBPool;
+  ObjectPool<proto::Phase1FB> p1FBPool;
+  ObjectPool<proto::Phase1FBReply> p1FBReplyPool;
+  ObjectPool<proto::Phase2FB> p2FBPool;
+  ObjectPool<proto::Phase2FBReply> p2FBReplyPool;
+  ObjectPool<proto::InvokeFB> invokeFBPool;
+  ObjectPool<proto::SendView> sendViewPool;
+  ObjectPool<proto::ElectMessage> electMessagePool;
+  ObjectPool<proto::ElectFB> electFBPool;
+  ObjectPool<proto::DecisionFB> decisionFBPool;
+  ObjectPool<proto::MoveView> moveViewPool;
 
 
   //std::vector<proto::CommittedProof*> testing_committed_proof;
@@ -491,10 +575,7 @@ class Server : public TransportReceiver, public ::Server, public PingServer {
   /* Declare protobuf objects as members to avoid stack alloc/dealloc costs */
   proto::SignedMessage signedMessage;
   proto::Read read;
-  //追加
-  proto::Read reads [MAX_MESSAGE_SIZE];
   proto::Phase1 phase1;
-  proto::Phase1 phase1s [MAX_TRANSACTION_SIZE];
   proto::Phase2 phase2;
   proto::Writeback writeback;
   proto::Writeback writebacks [MAX_TRANSACTION_SIZE];
@@ -505,13 +586,6 @@ class Server : public TransportReceiver, public ::Server, public PingServer {
   proto::AbortInternal abortInternal;
   std::vector<int> dummyTxnGroups;
 
-  std::vector<proto::ReadReply *> readReplies;
-  std::vector<proto::Phase1Reply *> p1Replies;
-  std::vector<proto::Phase2Reply *> p2Replies;
-  std::vector<proto::Read *> readMessages;
-  std::vector<proto::Phase1 *> p1messages;
-  std::vector<proto::Phase2 *> p2messages; //
-  std::vector<proto::Writeback *> WBmessages; //
   proto::Phase1Reply phase1Reply;
   proto::Phase2Reply phase2Reply;
   proto::RelayP1 relayP1;
@@ -529,6 +603,8 @@ class Server : public TransportReceiver, public ::Server, public PingServer {
 
 //Simulated HMAC code
   std::unordered_map<uint64_t, std::string> sessionKeys;
+  // MACs all-to-all messages under every session key in one call.
+  crypto::SessionMACs *sessionMACs;
   void CreateSessionKeys();
   bool ValidateHMACedMessage(const proto::SignedMessage &signedMessage);
   void CreateHMACedMessage(const ::google::protobuf::Message &msg, proto::SignedMessage& signedMessage);
@@ -546,19 +622,19 @@ class Server : public TransportReceiver, public ::Server, public PingServer {
 
   // Digest -> V
   //std::unordered_map<std::string, proto::Transaction *> ongoing;
-  typedef tbb::concurrent_hash_map<std::string, proto::Transaction *> ongoingMap;
+  typedef DigestMap<proto::Transaction *> ongoingMap;
   ongoingMap ongoing;
   // std::unordered_set<std::string> normal;
   // std::unordered_set<std::string> fallback;
   // std::unordered_set<std::string> waiting;
   // Digest -> V
   //std::unordered_map<std::string, std::pair<Timestamp, const proto::Transaction *>> prepared;
-  typedef tbb::concurrent_hash_map<std::string, std::pair<Timestamp, const proto::Transaction *>> preparedMap;
+  typedef DigestMap<std::pair<Timestamp, const proto::Transaction *>> preparedMap;
   preparedMap prepared;
 
-  // Key -> Tx
+  // Key -> prepared readers
   //std::unordered_map<std::string, std::set<const proto::Transaction *>> preparedReads;
-  tbb::concurrent_unordered_map<std::string, std::pair<std::shared_mutex, std::set<const proto::Transaction *>>> preparedReads;
+  tbb::concurrent_unordered_map<std::string, std::pair<std::shared_mutex, PreparedReadIndex>> preparedReads;
   //std::unordered_map<std::string, std::map<Timestamp, const proto::Transaction *>> preparedWrites;
   tbb::concurrent_unordered_map<std::string, std::pair<std::shared_mutex,std::map<Timestamp, const proto::Transaction *>>> preparedWrites;
 
@@ -571,28 +647,79 @@ class Server : public TransportReceiver, public ::Server, public PingServer {
   tbb::concurrent_unordered_map<std::string, std::mutex> mutex_map;
   //typedef std::vector<std::unique_lock<std::mutex>> locks_t;
   locks_t LockTxnKeys_scoped(const proto::Transaction &txn);
+  locks_t LockBatchKeys_scoped(const std::vector<proto::Transaction *> &txns);
   inline static bool sortReadByKey(const ReadMessage &lhs, const ReadMessage &rhs) { return lhs.key() < rhs.key(); }
   inline static bool sortWriteByKey(const WriteMessage &lhs, const WriteMessage &rhs) { return lhs.key() < rhs.key(); }
 
   //lock to make dependency handling atomic (per tx)  //TODO: Use this instead of waitingdep global mutex.
-  tbb::concurrent_hash_map<std::string, std::mutex> completing;
+  DigestMap<std::mutex> completing;
 
   //std::unordered_map<std::string, proto::ConcurrencyControl::Result> p1Decisions;
   //std::unordered_map<std::string, const proto::CommittedProof *> p1Conflicts;
   //std::unordered_map<std::string, proto::CommitDecision> p2Decisions;
   //std::unordered_map<std::string, proto::CommittedProof *> committed;
   //std::unordered_set<std::string> aborted;
-  //XXX TODO: p1Decisions and p1Conflicts erase only threadsafe if Clean called by a single thread.
-  typedef tbb::concurrent_hash_map<std::string, proto::ConcurrencyControl::Result> p1DecisionsMap;
-  p1DecisionsMap p1Decisions;
-  typedef tbb::concurrent_hash_map<std::string, const proto::CommittedProof *> p1ConflictsMap;
-  p1ConflictsMap p1Conflicts;
-  tbb::concurrent_unordered_map<std::string, proto::CommittedProof *> committed;
-  tbb::concurrent_unordered_set<std::string> aborted;
-  tbb::concurrent_unordered_map<std::string, proto::Writeback> writebackMessages;
+  // hash maps (rather than unordered maps) so that the GC can erase entries
+  typedef DigestMap<proto::CommittedProof *> committedMap;
+  committedMap committed;
+  typedef DigestMap<bool> abortedMap;
+  abortedMap aborted;
+  typedef tbb::concurrent_unordered_map<Digest, proto::Writeback, DigestHasher> writebackMap;
+  writebackMap writebackMessages;
   //ADD Aborted proof to it.(in order to reply to Fallback)
   //creating new map to store writeback messages..  Need to find a better way, but suffices as placeholder
 
+  // Commits staged by grouped writebacks, waiting for FlushCommits.
+  std::mutex pendingCommitsMutex;
+  std::vector<PendingCommit> pendingCommits;
+
+  // GC STATE
+  // Every txn in ongoing is tracked by the oldest timestamp it depends on (its
+  // own or one of its dependencies'). The GC never reclaims state at or above
+  // the oldest tracked timestamp; CCC abstains from txns below lowWatermark.
+  static const size_t GC_TRACKER_SHARDS = 32;
+  struct OngoingShard {
+    std::mutex mtx;
+    std::set<std::pair<Timestamp, const proto::Transaction *>> txns;
+  };
+  OngoingShard ongoingTracker[GC_TRACKER_SHARDS];
+  std::atomic<uint64_t> lowWatermark;
+  struct GCEntry {
+    std::string txnDigest;
+    bool committed;
+    std::vector<std::string> readKeys;
+    std::vector<std::string> writeKeys;
+  };
+  // Committed/aborted txns by timestamp, reclaimed once below the watermark.
+  std::mutex gcMutex;
+  std::multimap<Timestamp, GCEntry> gcQueue;
+  // Proofs removed from committed but still referenced by store versions, with
+  // their remaining reference count. Only accessed by the GC pass.
+  std::unordered_map<const proto::CommittedProof *, size_t> gcProofRefs;
+  // Proofs that became unreferenced during the current GC pass.
+  std::vector<const proto::CommittedProof *> gcRetiredProofs;
+  // Retired proofs are freed after a grace period: the event loop has run
+  // the GC timer again (loopPass) and every pool thread has left the job it
+  // was in when they were retired (graceToken).
+  struct RetiredProofs {
+    uint64_t graceToken;
+    uint64_t loopPass;
+    std::vector<const proto::CommittedProof *> proofs;
+  };
+  std::deque<RetiredProofs> gcGracePeriods;
+  // Bumped on the event loop, read by RunGC on a pool thread.
+  std::atomic<uint64_t> gcLoopPasses;
+  // Proofs held as P1 conflicts in p1MetaData, with the number of holders.
+  // A pin is released when the GC drops the holder's p1MetaData entry; a
+  // proof retired while pinned waits in gcPinnedRetired until then.
+  std::mutex gcPinMutex;
+  std::unordered_map<const proto::CommittedProof *, size_t> gcPinnedProofs;
+  std::unordered_set<const proto::CommittedProof *> gcPinnedRetired;
+  std::vector<const proto::CommittedProof *> gcUnpinned;
+  // Decided txns below this timestamp have been reclaimed; their late
+  // writebacks are dropped instead of committing them a second time.
+  std::atomic<uint64_t> gcReclaimedWatermark;
+
 
   //FB HELPER DATA STRUCTURES
   //keep list of timeouts
@@ -630,7 +757,7 @@ class Server : public TransportReceiver, public ::Server, public PingServer {
     TransportAddress *original_address;
   };
   //tbb::concurrent_hash_map<std::string, uint64_t> current_views;
-  typedef tbb::concurrent_hash_map<std::string, P2MetaData> p2MetaDataMap;
+  typedef DigestMap<P2MetaData> p2MetaDataMap;
   p2MetaDataMap p2MetaDatas;
 
   //typedef std::pair< std::unordered_set<uint64_t>, std::unordered_set<proto::Signature*>>replica_sig_sets_pair;
@@ -640,10 +767,10 @@ class Server : public TransportReceiver, public ::Server, public PingServer {
     std::map<uint64_t, std::unordered_map<proto::CommitDecision, replica_sig_sets_pair>> view_quorums;
     std::map<uint64_t, std::pair<uint64_t, bool >> move_view_counts;
   };
-  typedef tbb::concurrent_hash_map<std::string, ElectFBorganizer> ElectQuorumMap;
+  typedef DigestMap<ElectFBorganizer> ElectQuorumMap;
   ElectQuorumMap ElectQuorums;
 
-  tbb::concurrent_hash_map<std::string, P1FBorganizer*> fallbackStates;
+  DigestMap<P1FBorganizer*> fallbackStates;
   //TODO: put all other info such as current views, Quorums etc in this?
 
   //std::unordered_map<std::string, std::unordered_set<std::string>> dependents; // Each V depends on K
@@ -656,7 +783,7 @@ class Server : public TransportReceiver, public ::Server, public PingServer {
   std::unordered_map<std::string, WaitingDependency> waitingDependencies; // K depends on each V
 
   //XXX re-writing concurrent:
-  typedef tbb::concurrent_hash_map<std::string, std::unordered_set<std::string> > dependentsMap; //can be unordered set, as long as i keep lock access long enough
+  typedef DigestMap<std::unordered_set<std::string>> dependentsMap; //can be unordered set, as long as i keep lock access long enough
   dependentsMap dependents;
 
   struct WaitingDependency_new {
@@ -667,7 +794,7 @@ class Server : public TransportReceiver, public ::Server, public PingServer {
     std::mutex deps_mutex;
     std::unordered_set<std::string> deps; //acquire mutex before erasing (or use hashmap)
   };
-  typedef tbb::concurrent_hash_map<std::string, WaitingDependency_new> waitingDependenciesMap;
+  typedef DigestMap<WaitingDependency_new> waitingDependenciesMap;
   waitingDependenciesMap waitingDependencies_new;
 
 
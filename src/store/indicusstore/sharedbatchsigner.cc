@@ -35,9 +35,10 @@ namespace indicusstore {
 
 SharedBatchSigner::SharedBatchSigner(Transport *transport,
     KeyManager *keyManager, Stats &stats, uint64_t batchTimeoutMicro,
-    uint64_t batchSize, uint64_t id, bool adjustBatchSize, uint64_t merkleBranchFactor) : BatchSigner(
+    uint64_t batchSize, uint64_t id, bool adjustBatchSize, uint64_t merkleBranchFactor,
+    const BatchControllerConfig &batchControl) : BatchSigner(
       transport, keyManager, stats, batchTimeoutMicro, batchSize, id,
-      adjustBatchSize, merkleBranchFactor), batchSize(batchSize), batchTimerId(0), nextPendingBatchId(0UL),
+      adjustBatchSize, merkleBranchFactor, batchControl), batchStartUs(0UL), batchTimerId(0), nextPendingBatchId(0UL),
       alive(false), currentBatchId(0) {
   segment = new managed_shared_memory(open_or_create, "MySharedMemory", 33554432);//67108864); // 64 MB
   alloc_inst = new void_allocator(segment->get_segment_manager());
@@ -113,12 +114,14 @@ void SharedBatchSigner::MessageToSign(::google::protobuf::Message* msg,
 
     if (*sharedBatchId != currentBatchId) {
       currentBatchId = *sharedBatchId;
+      batchStartUs = BatchController::NowUs();
       StopTimeout();
     }
+    if (controller) controller->Arrival();
 
     Debug("Current batch id is %d.", currentBatchId);
 
-    if (sharedWorkQueue->size() >= batchSize) {
+    if (sharedWorkQueue->size() >= BatchSize()) {
       Debug("Batch is full, sending");
       StopTimeout();
 
@@ -182,8 +185,14 @@ void SharedBatchSigner::SignBatch() {
   uint64_t currMicros = curr.tv_sec * 1000000ULL + curr.tv_usec;
   stats.Add("sig_batch_sizes_ts",  currMicros);
 
+  if (controller) {
+    controller->Flush(batchSize, BatchController::NowUs() - batchStartUs);
+  }
   BatchedSigs::generateBatchedSignatures(batchMessages, privKey, batchSignatures,
       merkleBranchFactor);
+  if (controller) {
+    controller->Complete(batchSize, BatchController::NowUs() - batchStartUs);
+  }
 
   for (size_t i = 0; i < batchSignatures.size(); ++i) {
     scoped_lock<named_mutex> lock(*GetCompletionQueueMutex(pids[i]));
@@ -212,7 +221,7 @@ void SharedBatchSigner::StopTimeout() {
 void SharedBatchSigner::StartTimeout() {
   if (batchTimerId == 0) {
     Debug("Starting batch timeout.");
-    batchTimerId = transport->TimerMicro(batchTimeoutMicro,
+    batchTimerId = transport->TimerMicro(BatchTimeoutMicro(),
         std::bind(&SharedBatchSigner::BatchTimeout, this));
   }
 }
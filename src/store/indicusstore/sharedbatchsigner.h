@@ -57,7 +57,8 @@ class SharedBatchSigner : public BatchSigner {
  public:
   SharedBatchSigner(Transport *transport, KeyManager *keyManager, Stats &stats,
       uint64_t batchTimeoutMicro, uint64_t batchSize, uint64_t id,
-      bool adjustBatchSize, uint64_t merkleBranchFactor);
+      bool adjustBatchSize, uint64_t merkleBranchFactor,
+      const BatchControllerConfig &batchControl = BatchControllerConfig());
   virtual ~SharedBatchSigner();
 
   virtual void MessageToSign(::google::protobuf::Message* msg,
@@ -80,7 +81,8 @@ class SharedBatchSigner : public BatchSigner {
   void RunSignedCallbackConsumer();
   void RunSignTimeoutChecker();
 
-  uint64_t batchSize;
+  // Time the current shared batch got its first message, for the controller.
+  uint64_t batchStartUs;
   std::mutex batchTimerMtx;
   int batchTimerId;
 
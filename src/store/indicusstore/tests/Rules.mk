@@ -1,6 +1,7 @@
 d := $(dir $(lastword $(MAKEFILE_LIST)))
 
-GTEST_SRCS += $(addprefix $(d), common-test.cc server-test.cc common.cc)
+GTEST_SRCS += $(addprefix $(d), common-test.cc server-test.cc snapshot-test.cc \
+	common.cc)
 
 $(d)common-test: $(o)common-test.o $(LIB-indicus-store) \
 		$(GTEST_MAIN) $(o)common.o $(GMOCK)
@@ -8,4 +9,7 @@ $(d)common-test: $(o)common-test.o $(LIB-indicus-store) \
 $(d)server-test: $(o)server-test.o $(LIB-indicus-store) \
 		$(GTEST_MAIN) $(o)common.o $(GMOCK)
 
-TEST_BINS += $(d)common-test $(d)server-test 
+$(d)snapshot-test: $(o)snapshot-test.o $(LIB-indicus-store) \
+		$(LIB-repltransport) $(GTEST_MAIN) $(o)common.o
+
+TEST_BINS += $(d)common-test $(d)server-test $(d)snapshot-test
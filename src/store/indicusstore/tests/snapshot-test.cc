@@ -0,0 +1,186 @@
+/***********************************************************************
+ *
+ * Copyright 2021 Florian Suri-Payer <fsp@cs.cornell.edu>
+ *                Matthew Burke <matthelb@cs.cornell.edu>
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ **********************************************************************/
+#include <gtest/gtest.h>
+
+#include <map>
+#include <sstream>
+#include <string>
+#include <unistd.h>
+
+#include "lib/keymanager.h"
+#include "lib/repltransport.h"
+#include "store/common/partitioner.h"
+#include "store/indicusstore/server.h"
+#include "store/indicusstore/tests/common.h"
+
+#define F 1
+
+namespace indicusstore {
+
+class SnapshotTest : public ::testing::Test {
+ public:
+  SnapshotTest() : keyManager("./", crypto::ED25, false),
+      params(false, false, false, false, 1, -1, 0, false, false, false, false,
+          2, InjectFailure(), false, false, 1, false, false, false, false,
+          false, false, false, 100, false, false, 1, 1, 0, 0.0, false) { }
+  virtual ~SnapshotTest() { }
+
+  virtual void SetUp() {
+    std::stringstream configSS;
+    GenerateTestConfig(1, F, configSS);
+    config = new transport::Configuration(configSS);
+    path = "/tmp/indicus-snapshot-test-" + std::to_string(getpid());
+  }
+
+  virtual void TearDown() {
+    unlink(path.c_str());
+    delete config;
+  }
+
+ protected:
+  typedef std::map<std::pair<std::string, Timestamp>,
+      std::pair<std::string, std::string>> VersionMap;
+  typedef std::map<std::string, std::set<std::tuple<Timestamp, Timestamp,
+      std::string>>> ReadMap;
+
+  Server *NewServer() {
+    return new Server(*config, 0, 0, 1, 1, &transport, &keyManager, params,
+        100UL, MVTSO, &part, 0);
+  }
+
+  // Commits txn's writes and reads at ts without running the protocol.
+  void Apply(Server *server, const proto::Transaction &txn) {
+    Timestamp ts(txn.timestamp());
+    proto::CommittedProof *proof = new proto::CommittedProof();
+    *proof->mutable_txn() = txn;
+    server->committed.insert(std::make_pair(
+          TransactionDigest(txn, params.hashDigest), proof));
+    for (const auto &write : txn.write_set()) {
+      server->store.put(write.key(), {write.value(), proof}, ts);
+    }
+    for (const auto &read : txn.read_set()) {
+      server->committedReads[read.key()].second.emplace(ts,
+          Timestamp(read.readtime()), proof);
+    }
+  }
+
+  // The digest of the txn a proof commits, empty for the genesis proof.
+  std::string ProofDigest(Server *server, const proto::CommittedProof *proof) {
+    if (proof == nullptr || proof->txn().client_id() == 0) {
+      return "";
+    }
+    return TransactionDigest(proof->txn(), params.hashDigest);
+  }
+
+  VersionMap Versions(Server *server) {
+    VersionMap versions;
+    server->store.forEachVersion([&](const std::string &key,
+          const Timestamp &ts, const Server::Value &val) {
+      versions[std::make_pair(key, ts)] = std::make_pair(val.val,
+          ProofDigest(server, val.proof));
+    });
+    return versions;
+  }
+
+  ReadMap CommittedReads(Server *server) {
+    ReadMap reads;
+    for (const auto &r : server->committedReads) {
+      for (const auto &read : r.second.second) {
+        reads[r.first].emplace(std::get<0>(read), std::get<1>(read),
+            ProofDigest(server, std::get<2>(read)));
+      }
+    }
+    return reads;
+  }
+
+  std::map<std::string, int> Rts(Server *server) {
+    std::map<std::string, int> rts;
+    for (const auto &r : server->rts) {
+      rts[r.first] = r.second.load();
+    }
+    return rts;
+  }
+
+  void SetRts(Server *server, const std::string &key, int ts) {
+    server->rts[key] = ts;
+  }
+
+  bool Committed(Server *server, const proto::Transaction &txn) {
+    Server::committedMap::const_accessor c;
+    return server->committed.find(c,
+        TransactionDigest(txn, params.hashDigest));
+  }
+
+  ReplTransport transport;
+  KeyManager keyManager;
+  Parameters params;
+  DefaultPartitioner part;
+  transport::Configuration *config;
+  std::string path;
+};
+
+TEST_F(SnapshotTest, RoundTrip) {
+  Server *server = NewServer();
+  server->Load("key0", "init0", Timestamp());
+  server->Load("key1", "init1", Timestamp());
+
+  proto::Transaction txn1;
+  PopulateTransaction({{"key0", Timestamp()}}, {{"key1", "val1"}},
+      Timestamp(50, 1), {0}, txn1);
+  Apply(server, txn1);
+  proto::Transaction txn2;
+  PopulateTransaction({{"key1", Timestamp(50, 1)}},
+      {{"key0", "val0"}, {"key2", "val2"}}, Timestamp(60, 2), {0}, txn2);
+  txn2.set_client_seq_num(2);
+  Apply(server, txn2);
+  SetRts(server, "key0", 70);
+  SetRts(server, "key3", 80);
+
+  ASSERT_TRUE(server->WriteSnapshot(path));
+  VersionMap versions = Versions(server);
+  ReadMap reads = CommittedReads(server);
+  std::map<std::string, int> rts = Rts(server);
+  delete server;
+
+  Server *restored = NewServer();
+  ASSERT_TRUE(restored->LoadSnapshot(path, 2));
+  EXPECT_EQ(versions, Versions(restored));
+  EXPECT_EQ(reads, CommittedReads(restored));
+  EXPECT_EQ(rts, Rts(restored));
+  EXPECT_TRUE(Committed(restored, txn1));
+  EXPECT_TRUE(Committed(restored, txn2));
+  EXPECT_EQ(5UL, versions.size());
+  delete restored;
+}
+
+TEST_F(SnapshotTest, MissingFile) {
+  Server *server = NewServer();
+  EXPECT_FALSE(server->LoadSnapshot(path, 1));
+  delete server;
+}
+
+} // namespace indicusstore
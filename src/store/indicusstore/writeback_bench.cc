@@ -0,0 +1,139 @@
+/***********************************************************************
+ *
+ * Copyright 2021 Florian Suri-Payer <fsp@cs.cornell.edu>
+ *                Matthew Burke <matthelb@cs.cornell.edu>
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ **********************************************************************/
+#include "lib/latency.h"
+#include "lib/message.h"
+#include "store/common/timestamp.h"
+#include "store/common/backend/versionstore_safe.h"
+
+#include <gflags/gflags.h>
+
+#include <algorithm>
+#include <random>
+#include <sstream>
+
+DEFINE_string(batch_sizes, "1,4,16,64,256", "comma-separated list of writeback batch sizes.");
+DEFINE_uint64(write_set_size, 10, "number of writes per transaction.");
+DEFINE_uint64(num_keys, 10000, "number of distinct keys written.");
+DEFINE_uint64(value_size, 64, "size of each value in bytes.");
+DEFINE_uint64(num_txns, 100000, "number of transactions applied per batch size.");
+
+struct Write {
+  const std::string *key;
+  Timestamp ts;
+  const std::string *value;
+};
+
+// Previous apply path: every write of every txn takes its key's lock.
+void ApplyPerWrite(VersionedKVStore<Timestamp, std::string> &store,
+    const std::vector<Write> &writes) {
+  for (const auto &write : writes) {
+    store.put(*write.key, *write.value, write.ts);
+  }
+}
+
+// Grouped apply path: writes of the whole batch are sorted by key and each
+// key's versions are inserted under a single lock.
+void ApplyGrouped(VersionedKVStore<Timestamp, std::string> &store,
+    std::vector<Write> &writes) {
+  std::sort(writes.begin(), writes.end(), [](const Write &a, const Write &b) {
+    int cmp = a.key->compare(*b.key);
+    return cmp < 0 || (cmp == 0 && a.ts < b.ts);
+  });
+  std::vector<std::pair<Timestamp, std::string>> versions;
+  for (size_t i = 0; i < writes.size();) {
+    versions.clear();
+    size_t j = i;
+    for (; j < writes.size() && *writes[j].key == *writes[i].key; ++j) {
+      versions.emplace_back(writes[j].ts, *writes[j].value);
+    }
+    store.putBatch(*writes[i].key, versions);
+    i = j;
+  }
+}
+
+int main(int argc, char *argv[]) {
+  gflags::SetUsageMessage("benchmark Indicus writeback apply throughput.");
+	gflags::ParseCommandLineFlags(&argc, &argv, true);
+
+  std::mt19937_64 rng(0);
+  std::vector<std::string> keys;
+  for (uint64_t i = 0; i < FLAGS_num_keys; ++i) {
+    keys.push_back("key" + std::to_string(i));
+  }
+  std::string value(FLAGS_value_size, 'v');
+  std::uniform_int_distribution<uint64_t> keyDist(0, FLAGS_num_keys - 1);
+
+  std::vector<uint64_t> batchSizes;
+  std::stringstream ss(FLAGS_batch_sizes);
+  std::string tok;
+  while (std::getline(ss, tok, ',')) {
+    batchSizes.push_back(std::stoull(tok));
+  }
+
+  Notice("===================================");
+  Notice("Running writeback apply bench: %lu txns, %lu writes/txn, %lu keys.",
+      FLAGS_num_txns, FLAGS_write_set_size, FLAGS_num_keys);
+
+  for (uint64_t batchSize : batchSizes) {
+    struct Latency_t perWriteLat;
+    struct Latency_t groupedLat;
+    _Latency_Init(&perWriteLat, "apply_per_write");
+    _Latency_Init(&groupedLat, "apply_grouped");
+
+    VersionedKVStore<Timestamp, std::string> perWriteStore;
+    VersionedKVStore<Timestamp, std::string> groupedStore;
+    uint64_t perWriteNs = 0;
+    uint64_t groupedNs = 0;
+    uint64_t batches = (FLAGS_num_txns + batchSize - 1) / batchSize;
+    uint64_t txnId = 0;
+
+    std::vector<Write> writes;
+    for (uint64_t b = 0; b < batches; ++b) {
+      writes.clear();
+      for (uint64_t t = 0; t < batchSize; ++t, ++txnId) {
+        Timestamp ts(txnId, 0);
+        for (uint64_t w = 0; w < FLAGS_write_set_size; ++w) {
+          writes.push_back({&keys[keyDist(rng)], ts, &value});
+        }
+      }
+
+      Latency_Start(&perWriteLat);
+      ApplyPerWrite(perWriteStore, writes);
+      perWriteNs += Latency_End(&perWriteLat);
+
+      Latency_Start(&groupedLat);
+      ApplyGrouped(groupedStore, writes);
+      groupedNs += Latency_End(&groupedLat);
+    }
+
+    Notice("batch %lu: per-write %.0f txn/s, grouped %.0f txn/s.", batchSize,
+        txnId * 1e9 / std::max<uint64_t>(perWriteNs, 1),
+        txnId * 1e9 / std::max<uint64_t>(groupedNs, 1));
+  }
+  Notice("===================================");
+  return 0;
+}
@@ -41,8 +41,26 @@ std::vector<::google::protobuf::Message*> App::Execute(const std::string &msg, c
   Panic("Unimplemented");
 }
 
+std::vector<std::vector<::google::protobuf::Message*>> App::Execute_batch(
+    const std::vector<std::string>& types, const std::vector<std::string>& msgs) {
+  std::vector<std::vector<::google::protobuf::Message*>> replies;
+  for (size_t i = 0; i < types.size(); i++) {
+    replies.push_back(Execute(types[i], msgs[i]));
+  }
+  return replies;
+}
+
 ::google::protobuf::Message* App::HandleMessage(const std::string& type, const std::string& msg) {
   Panic("Unimplemented");
 }
 
+std::vector<::google::protobuf::Message*> App::HandleMessage_batch(
+    const std::vector<std::string>& types, const std::vector<std::string>& msgs) {
+  std::vector<::google::protobuf::Message*> replies;
+  for (size_t i = 0; i < types.size(); i++) {
+    replies.push_back(HandleMessage(types[i], msgs[i]));
+  }
+  return replies;
+}
+
 }
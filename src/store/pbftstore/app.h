@@ -42,8 +42,16 @@ public:
     virtual ~App();
 
     virtual ::google::protobuf::Message* HandleMessage(const std::string& type, const std::string& msg);
+    // handle a batch of unordered messages; returns one reply (or nullptr)
+    // per message, in order
+    virtual std::vector<::google::protobuf::Message*> HandleMessage_batch(
+        const std::vector<std::string>& types, const std::vector<std::string>& msgs);
     // upcall to execute the message
     virtual std::vector<::google::protobuf::Message*> Execute(const std::string& type, const std::string& msg);
+    // upcall to execute the messages of one ordered batch; returns the
+    // replies of each message, in order
+    virtual std::vector<std::vector<::google::protobuf::Message*>> Execute_batch(
+        const std::vector<std::string>& types, const std::vector<std::string>& msgs);
 
     virtual Stats* mutableStats() = 0;
 };
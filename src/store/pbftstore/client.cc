@@ -37,7 +37,7 @@ Client::Client(const transport::Configuration& config, int nGroups, int nShards,
       uint64_t readQuorumSize, bool signMessages,
       bool validateProofs, KeyManager *keyManager,
       bool order_commit, bool validate_abort,
-      TrueTime timeserver) : config(config), nshards(nShards),
+      TrueTime timeserver, uint64_t batchSize, uint64_t batchTimeoutMS) : config(config), nshards(nShards),
     ngroups(nGroups), transport(transport), part(part), readQuorumSize(readQuorumSize),
     signMessages(signMessages),
     validateProofs(validateProofs), keyManager(keyManager),
@@ -63,7 +63,8 @@ Client::Client(const transport::Configuration& config, int nGroups, int nShards,
   /* Start a client for each shard. */
   for (uint64_t i = 0; i < ngroups; i++) {
     bclient[i] = new ShardClient(config, transport, i,
-        signMessages, validateProofs, keyManager, &stats, order_commit, validate_abort);
+        signMessages, validateProofs, keyManager, &stats, order_commit, validate_abort,
+        batchSize, batchTimeoutMS);
   }
 
   Debug("PBFT client [%lu] created! %lu %lu", client_id, ngroups,
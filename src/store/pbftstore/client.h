@@ -50,7 +50,8 @@ class Client : public ::Client {
       uint64_t readQuorumSize, bool signMessages,
       bool validateProofs, KeyManager *keyManager,
       bool order_commit = false, bool validate_abort = false,
-      TrueTime timeserver = TrueTime(0,0));
+      TrueTime timeserver = TrueTime(0,0),
+      uint64_t batchSize = 1, uint64_t batchTimeoutMS = 1);
   ~Client();
 
   // Begin a transaction.
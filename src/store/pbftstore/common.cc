@@ -154,6 +154,20 @@ std::string BatchedDigest(proto::BatchedRequest& breq) {
   return digest;
 }
 
+std::string CheckpointDigest(const std::string &prev, const std::string &digest) {
+
+  CryptoPP::SHA256 hash;
+  std::string next;
+
+  hash.Update((const CryptoPP::byte*) prev.data(), prev.length());
+  hash.Update((const CryptoPP::byte*) digest.data(), digest.length());
+
+  next.resize(hash.DigestSize());
+  hash.Final((CryptoPP::byte*) &next[0]);
+
+  return next;
+}
+
 std::string string_to_hex(const std::string& input)
 {
     static const char hex_digits[] = "0123456789ABCDEF";
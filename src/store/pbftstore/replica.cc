@@ -28,6 +28,8 @@
 #include "store/pbftstore/pbft_batched_sigs.h"
 #include "store/pbftstore/common.h"
 
+#include <algorithm>
+
 namespace pbftstore {
 
 using namespace std;
@@ -56,11 +58,20 @@ using namespace std;
 
 Replica::Replica(const transport::Configuration &config, KeyManager *keyManager,
   App *app, int groupIdx, int idx, bool signMessages, uint64_t maxBatchSize,
-  uint64_t batchTimeoutMS, uint64_t EbatchSize, uint64_t EbatchTimeoutMS, bool primaryCoordinator, bool requestTx, Transport *transport)
+  uint64_t batchTimeoutMS, uint64_t EbatchSize, uint64_t EbatchTimeoutMS, bool primaryCoordinator, bool requestTx, Transport *transport,
+  crypto::HMACType hmacType, bool batchMessages, uint64_t checkpointInterval,
+  uint64_t checkpointWindow)
     : config(config), keyManager(keyManager), app(app), groupIdx(groupIdx), idx(idx),
     id(groupIdx * config.n + idx), signMessages(signMessages), maxBatchSize(maxBatchSize),
-    batchTimeoutMS(batchTimeoutMS), EbatchSize(EbatchSize), EbatchTimeoutMS(EbatchTimeoutMS), primaryCoordinator(primaryCoordinator), requestTx(requestTx), transport(transport) {
-  transport->Register(this, config, groupIdx, idx);
+    batchTimeoutMS(batchTimeoutMS), EbatchSize(EbatchSize), EbatchTimeoutMS(EbatchTimeoutMS), primaryCoordinator(primaryCoordinator), requestTx(requestTx), transport(transport),
+    batchMessages(batchMessages), sendBatchDepth(0), receivingBatch(false), batchRemote(nullptr),
+    checkpointInterval(checkpointInterval), checkpointWindow(checkpointWindow),
+    lowWatermark(0) {
+  if (batchMessages) {
+    transport->Register_batch(this, config, groupIdx, idx);
+  } else {
+    transport->Register(this, config, groupIdx, idx);
+  }
 
   // intial view
   currentView = 0;
@@ -69,6 +80,13 @@ Replica::Replica(const transport::Configuration &config, KeyManager *keyManager,
   execSeqNum = 0;
   execBatchNum = 0;
 
+  // the primary must be able to run ahead of the stable checkpoint by at
+  // least one interval, otherwise it waits for every checkpoint
+  if (this->checkpointWindow == 0) {
+    this->checkpointWindow = 2 * checkpointInterval;
+  }
+  UW_ASSERT(checkpointInterval == 0 || this->checkpointWindow > checkpointInterval);
+
   batchTimerRunning = false;
   nextBatchNum = 0;
 
@@ -89,16 +107,21 @@ Replica::Replica(const transport::Configuration &config, KeyManager *keyManager,
 
 
   // assume these are somehow secretly shared before hand
+  std::vector<std::string> keys;
   for (uint64_t i = 0; i < config.n; i++) {
     if (i > idx) {
       sessionKeys[i] = std::string(8, (char) idx + 0x30) + std::string(8, (char) i + 0x30);
     } else {
       sessionKeys[i] = std::string(8, (char) i + 0x30) + std::string(8, (char) idx + 0x30);
     }
+    keys.push_back(sessionKeys[i]);
   }
+  sessionMACs = new crypto::SessionMACs(hmacType, keys);
 }
 
-Replica::~Replica() {}
+Replica::~Replica() {
+  delete sessionMACs;
+}
 
 bool Replica::ValidateHMACedMessage(const proto::SignedMessage &signedMessage, std::string &data, std::string &type) {
   proto::PackedMessage packedMessage;
@@ -108,7 +131,11 @@ bool Replica::ValidateHMACedMessage(const proto::SignedMessage &signedMessage, s
 
   proto::HMACs hmacs;
   hmacs.ParseFromString(signedMessage.signature());
-  return crypto::verifyHMAC(signedMessage.packed_msg(), (*hmacs.mutable_hmacs())[idx], sessionKeys[signedMessage.replica_id() % config.n]);
+  auto itr = hmacs.hmacs().find(idx);
+  if (itr == hmacs.hmacs().end()) {
+    return false;
+  }
+  return sessionMACs->Verify(signedMessage.packed_msg(), itr->second, signedMessage.replica_id() % config.n);
 }
 
 void Replica::CreateHMACedMessage(const ::google::protobuf::Message &msg, proto::SignedMessage& signedMessage) {
@@ -121,15 +148,39 @@ void Replica::CreateHMACedMessage(const ::google::protobuf::Message &msg, proto:
   signedMessage.set_packed_msg(msgData);
   signedMessage.set_replica_id(id);
 
+  std::vector<std::string> macs;
+  sessionMACs->MacAll(msgData, macs);
   proto::HMACs hmacs;
   for (uint64_t i = 0; i < config.n; i++) {
-    (*hmacs.mutable_hmacs())[i] = crypto::HMAC(msgData, sessionKeys[i]);
+    (*hmacs.mutable_hmacs())[i] = std::move(macs[i]);
   }
   signedMessage.set_signature(hmacs.SerializeAsString());
 }
 
 void Replica::ReceiveMessage(const TransportAddress &remote, const string &t,
                           const string &d, void *meta_data) {
+  ReceiveMessageInternal(remote, t, d);
+}
+
+void Replica::ReceiveMessage_batch(const TransportAddress &remote, const std::vector<std::string> &types,
+                          const std::vector<std::string> &datas, void *meta_data) {
+  Debug("Received batch of %lu messages", types.size());
+  stats->Record("pbft_recv_batch", types.size());
+
+  receivingBatch = true;
+  batchRemote = nullptr;
+  startSendBatch();
+  for (size_t i = 0; i < types.size(); i++) {
+    ReceiveMessageInternal(remote, types[i], datas[i]);
+  }
+  handleAppMessages(remote);
+  flushSendBatch();
+  receivingBatch = false;
+  batchRemote = nullptr;
+}
+
+void Replica::ReceiveMessageInternal(const TransportAddress &remote, const string &t,
+                          const string &d) {
   string type;
   string data;
   bool recvSignedMessage = false;
@@ -162,7 +213,8 @@ void Replica::ReceiveMessage(const TransportAddress &remote, const string &t,
     HandleBatchedRequest(remote, recvbatchedRequest);
   } else if (type == recvab.GetTypeName()) {
     recvab.ParseFromString(data);
-    if (slots.getSlotDigest(recvab.seqnum(), recvab.viewnum()) == recvab.digest()) {
+    if (inWindow(recvab.seqnum()) &&
+        slots.getSlotDigest(recvab.seqnum(), recvab.viewnum()) == recvab.digest()) {
       stats->Increment("valid_ab", 1);
 
       proto::Preprepare preprepare;
@@ -219,6 +271,18 @@ void Replica::ReceiveMessage(const TransportAddress &remote, const string &t,
     recvgrouped.ParseFromString(data);
 
     HandleGrouped(remote, recvgrouped);
+  } else if (type == recvcheckpoint.GetTypeName()) {
+    recvcheckpoint.ParseFromString(data);
+    if (signMessages && !recvSignedMessage) {
+      stats->Increment("invalid_sig_cp",1);
+      return;
+    }
+
+    HandleCheckpoint(remote, recvcheckpoint, tmpsignedMessage);
+  } else if (batchMessages && receivingBatch) {
+    Debug("Queueing request for app");
+    pendingAppTypes.push_back(std::move(type));
+    pendingAppDatas.push_back(std::move(data));
   } else {
     Debug("Sending request to app");
     handleMessage(remote, type, data);
@@ -226,8 +290,31 @@ void Replica::ReceiveMessage(const TransportAddress &remote, const string &t,
   }
 }
 
-void Replica::ReceiveMessage_batch(const TransportAddress &remote, const std::vector<std::string> &types,
-                          const std::vector<std::string> &datas, void *meta_data) {}
+void Replica::handleAppMessages(const TransportAddress &remote) {
+  if (pendingAppTypes.empty()) {
+    return;
+  }
+
+  std::vector<::google::protobuf::Message*> replies = app->HandleMessage_batch(pendingAppTypes, pendingAppDatas);
+  pendingAppTypes.clear();
+  pendingAppDatas.clear();
+
+  std::vector<::google::protobuf::Message*> valid;
+  for (auto reply : replies) {
+    if (reply != nullptr) {
+      valid.push_back(reply);
+    } else {
+      Debug("Invalid app request in batch");
+    }
+  }
+  if (!valid.empty()) {
+    stats->Record("pbft_reply_batch", valid.size());
+    transport->SendMessage_batch(this, remote, valid);
+  }
+  for (auto reply : valid) {
+    delete reply;
+  }
+}
 
 void Replica::handleMessage(const TransportAddress &remote, const string &type, const string &data){
   if(false){
@@ -258,8 +345,56 @@ void Replica::handleMessage(const TransportAddress &remote, const string &type,
 
 }
 
+void Replica::startSendBatch() {
+  sendBatchDepth++;
+}
+
+void Replica::flushSendBatch() {
+  UW_ASSERT(sendBatchDepth > 0);
+  if (--sendBatchDepth > 0) {
+    return;
+  }
+
+  if (!pendingToAll.empty()) {
+    Debug("Sending batch of %lu messages to all", pendingToAll.size());
+    stats->Record("pbft_send_batch", pendingToAll.size());
+    transport->SendMessageToGroup_batch(this, groupIdx, pendingToAll);
+    transport->SendMessageToReplica_batch(this, groupIdx, idx, pendingToAll);
+    for (auto msg : pendingToAll) {
+      delete msg;
+    }
+    pendingToAll.clear();
+  }
+  if (!pendingToPrimary.empty()) {
+    Debug("Sending batch of %lu messages to primary", pendingToPrimary.size());
+    stats->Record("pbft_send_batch", pendingToPrimary.size());
+    int primaryIdx = config.GetLeaderIndex(currentView);
+    transport->SendMessageToReplica_batch(this, groupIdx, primaryIdx, pendingToPrimary);
+    for (auto msg : pendingToPrimary) {
+      delete msg;
+    }
+    pendingToPrimary.clear();
+  }
+}
+
+std::shared_ptr<TransportAddress> Replica::replyAddress(const TransportAddress &remote) {
+  if (batchMessages && receivingBatch) {
+    if (batchRemote == nullptr) {
+      batchRemote.reset(remote.clone());
+    }
+    return batchRemote;
+  }
+  return std::shared_ptr<TransportAddress>(remote.clone());
+}
+
 bool Replica::sendMessageToPrimary(const ::google::protobuf::Message& msg) {
   int primaryIdx = config.GetLeaderIndex(currentView);
+  if (batchMessages && sendBatchDepth > 0 && !signMessages) {
+    ::google::protobuf::Message *copy = msg.New();
+    copy->CopyFrom(msg);
+    pendingToPrimary.push_back(copy);
+    return true;
+  }
   if (signMessages) {
     proto::SignedMessage signedMsg;
     // SignMessage(msg, keyManager->GetPrivateKey(id), id, signedMsg);
@@ -272,6 +407,19 @@ bool Replica::sendMessageToPrimary(const ::google::protobuf::Message& msg) {
 
 bool Replica::sendMessageToAll(const ::google::protobuf::Message& msg) {
 
+  if (batchMessages && sendBatchDepth > 0) {
+    if (signMessages) {
+      proto::SignedMessage *signedMsg = new proto::SignedMessage();
+      CreateHMACedMessage(msg, *signedMsg);
+      pendingToAll.push_back(signedMsg);
+    } else {
+      ::google::protobuf::Message *copy = msg.New();
+      copy->CopyFrom(msg);
+      pendingToAll.push_back(copy);
+    }
+    return true;
+  }
+
   if (signMessages) {
     // ::google::protobuf::Message* copy = msg.New();
     // copy->CopyFrom(msg);
@@ -307,6 +455,12 @@ void Replica::HandleRequest(const TransportAddress &remote,
   string digest = request.digest();
   DebugHash(digest);
 
+  if (retiredDigests.find(digest) != retiredDigests.end()) {
+    Debug("request already executed before the stable checkpoint");
+    stats->Increment("retired_request",1);
+    return;
+  }
+
   if (requests.find(digest) == requests.end()) {
     Debug("new request: %s", request.packed_msg().type().c_str());
 
@@ -314,7 +468,7 @@ void Replica::HandleRequest(const TransportAddress &remote,
 
     // clone remote mapped to request for reply
     //replyAddrsMutex.lock();
-    replyAddrs[digest] = remote.clone();
+    replyAddrs[digest] = replyAddress(remote);
     //replyAddrsMutex.unlock();
 
     int currentPrimaryIdx = config.GetLeaderIndex(currentView);
@@ -333,6 +487,7 @@ void Replica::HandleRequest(const TransportAddress &remote,
         Debug("Starting batch timer");
         batchTimerId = transport->Timer(batchTimeoutMS, [this]() {
           Debug("Batch timer expired, sending");
+          this->stats->Increment("batch_timeouts", 1);
           this->batchTimerRunning = false;
           this->sendBatchedPreprepare();
         });
@@ -345,8 +500,18 @@ void Replica::HandleRequest(const TransportAddress &remote,
 }
 
 void Replica::sendBatchedPreprepare() {
+  if (!inWindow(nextSeqNum)) {
+    // keep the digests pending until the next stable checkpoint moves the
+    // window forward
+    Debug("seq num %d is above the high watermark, holding batch", nextSeqNum);
+    stats->Increment("window_full",1);
+    return;
+  }
+
+  // the batched request and its preprepare go out together
+  startSendBatch();
   proto::BatchedRequest batchedRequest;
-  stats->Increment(bStatNames[pendingBatchedDigests.size()], 1);
+  stats->Increment(bStatNames[std::min<uint64_t>(pendingBatchedDigests.size(), maxBatchSize)], 1);
   for (const auto& pair : pendingBatchedDigests) {
     (*batchedRequest.mutable_digests())[pair.first] = pair.second;
   }
@@ -364,6 +529,7 @@ void Replica::sendBatchedPreprepare() {
   preprepare.set_digest(digest);
 
   SendPreprepare(seqnum, preprepare);
+  flushSendBatch();
 }
 
 void Replica::SendPreprepare(uint64_t seqnum, const proto::Preprepare& preprepare) {
@@ -394,6 +560,12 @@ void Replica::HandlePreprepare(const TransportAddress &remote,
                                 const proto::SignedMessage& signedMsg) {
   Debug("Handling preprepare message");
 
+  if (!inWindow(preprepare.seqnum())) {
+    if (!holdAboveWindow(preprepare.seqnum(), remote, preprepare, signedMsg)) {
+      stats->Increment("outside_window_pp",1);
+    }
+    return;
+  }
 
   int primaryIdx = config.GetLeaderIndex(currentView);
   int primaryId = groupIdx * config.n + primaryIdx;
@@ -447,6 +619,13 @@ void Replica::HandlePrepare(const TransportAddress &remote,
                                const proto::Prepare &prepare,
                              const proto::SignedMessage& signedMsg) {
   Debug("Handling prepare message");
+  if (!inWindow(prepare.seqnum())) {
+    if (!holdAboveWindow(prepare.seqnum(), remote, prepare, signedMsg)) {
+      stats->Increment("outside_window_p",1);
+    }
+    return;
+  }
+
   if (signMessages) {
     // make sure this message is from this shard
     if (signedMsg.replica_id() / config.n != (uint64_t) groupIdx) {
@@ -476,6 +655,13 @@ void Replica::HandleCommit(const TransportAddress &remote,
                             const proto::SignedMessage& signedMsg) {
   Debug("Handling commit message");
 
+  if (!inWindow(commit.seqnum())) {
+    if (!holdAboveWindow(commit.seqnum(), remote, commit, signedMsg)) {
+      stats->Increment("outside_window_c",1);
+    }
+    return;
+  }
+
   if (signMessages) {
     // make sure this message is from this shard
     if (signedMsg.replica_id() / config.n != (uint64_t) groupIdx) {
@@ -702,6 +888,12 @@ void Replica::executeSlots_internal_multi() {
           Debug("Done executing batch");
           execBatchNum = 0;
           execSeqNum++;
+          if (checkpointInterval > 0) {
+            stateDigest = CheckpointDigest(stateDigest, batchDigest);
+            if (execSeqNum % checkpointInterval == 0) {
+              takeCheckpoint(execSeqNum - 1);
+            }
+          }
         }
 
       } else {
@@ -794,48 +986,47 @@ void Replica::executeSlots_internal() {
     string batchDigest = pendingExecutions[execSeqNum];
     // only execute when we have the batched request
     if (batchedRequests.find(batchDigest) != batchedRequests.end()) {
-      string digest = (*batchedRequests[batchDigest].mutable_digests())[execBatchNum];
-      DebugHash(digest);
-      // only execute if we have the full request
-      if (requests.find(digest) != requests.end()) {
-        stats->Increment("exec_request",1);
-        Debug("executing seq num: %lu %lu", execSeqNum, execBatchNum);
-        proto::PackedMessage packedMsg = requests[digest];
-        std::vector<::google::protobuf::Message*> replies = app->Execute(packedMsg.type(), packedMsg.msg());
-        for (const auto& reply : replies) {
-          if (reply != nullptr) {
-            Debug("Sending reply");
-            stats->Increment("execs_sent",1);
-            EpendingBatchedMessages.push_back(reply);
-            EpendingBatchedDigs.push_back(digest);
-            if (EpendingBatchedMessages.size() >= EbatchSize) {
-              Debug("EBatch is full, sending");
-              if (EbatchTimerRunning) {
-                transport->CancelTimer(EbatchTimerId);
-                EbatchTimerRunning = false;
-              }
-              sendEbatch();
-            } else if (!EbatchTimerRunning) {
-              EbatchTimerRunning = true;
-              Debug("Starting ebatch timer");
-              EbatchTimerId = transport->Timer(EbatchTimeoutMS, [this]() {
-                Debug("EBatch timer expired, sending");
-                this->EbatchTimerRunning = false;
-                this->sendEbatch();
-              });
-            }
-          } else {
-            Debug("Invalid execution");
-          }
+      proto::BatchedRequest &batch = batchedRequests[batchDigest];
+      // hand the app every request of the batch we already have, up to the
+      // first missing one, as one ordered batch
+      std::vector<std::string> types;
+      std::vector<std::string> datas;
+      std::vector<std::string> digests;
+      for (int i = execBatchNum; i < batch.digests_size(); i++) {
+        string digest = (*batch.mutable_digests())[i];
+        auto itr = requests.find(digest);
+        if (itr == requests.end()) {
+          break;
         }
+        types.push_back(itr->second.type());
+        datas.push_back(itr->second.msg());
+        digests.push_back(std::move(digest));
+      }
 
-        execBatchNum++;
-        if ((int) execBatchNum >= batchedRequests[batchDigest].digests_size()) {
-          Debug("Done executing batch");
-          execBatchNum = 0;
-          execSeqNum++;
+      if (!digests.empty()) {
+        stats->Increment("exec_request", digests.size());
+        Debug("executing seq num: %lu %lu-%lu", execSeqNum, execBatchNum,
+            execBatchNum + digests.size() - 1);
+        std::vector<std::vector<::google::protobuf::Message*>> replies = app->Execute_batch(types, datas);
+        for (size_t i = 0; i < digests.size(); i++) {
+          queueReplies(replies[i], digests[i]);
+        }
+        execBatchNum += digests.size();
+      }
+
+      if ((int) execBatchNum >= batch.digests_size()) {
+        Debug("Done executing batch");
+        execBatchNum = 0;
+        execSeqNum++;
+        if (checkpointInterval > 0) {
+          stateDigest = CheckpointDigest(stateDigest, batchDigest);
+          if (execSeqNum % checkpointInterval == 0) {
+            takeCheckpoint(execSeqNum - 1);
+          }
         }
       } else {
+        string digest = (*batch.mutable_digests())[execBatchNum];
+        DebugHash(digest);
         Debug("request from batch %lu not yet received", execSeqNum);
         if (requestTx) {
           stats->Increment("req_txn",1);
@@ -863,6 +1054,37 @@ void Replica::executeSlots_internal() {
   }
 }
 
+void Replica::queueReplies(std::vector<::google::protobuf::Message*> &replies,
+    const string &digest) {
+  for (const auto& reply : replies) {
+    if (reply != nullptr) {
+      Debug("Sending reply");
+      stats->Increment("execs_sent",1);
+      EpendingBatchedMessages.push_back(reply);
+      EpendingBatchedDigs.push_back(digest);
+      if (EpendingBatchedMessages.size() >= EbatchSize) {
+        Debug("EBatch is full, sending");
+        if (EbatchTimerRunning) {
+          transport->CancelTimer(EbatchTimerId);
+          EbatchTimerRunning = false;
+        }
+        sendEbatch();
+      } else if (!EbatchTimerRunning) {
+        EbatchTimerRunning = true;
+        Debug("Starting ebatch timer");
+        EbatchTimerId = transport->Timer(EbatchTimeoutMS, [this]() {
+          Debug("EBatch timer expired, sending");
+          this->stats->Increment("ebatch_timeouts", 1);
+          this->EbatchTimerRunning = false;
+          this->sendEbatch();
+        });
+      }
+    } else {
+      Debug("Invalid execution");
+    }
+  }
+}
+
 void Replica::sendEbatch() {
   //std::cerr << "executing sendEbatch" << std::endl;
   stats->Increment(EbStatNames[EpendingBatchedMessages.size()], 1);
@@ -886,16 +1108,187 @@ void Replica::sendEbatch() {
   pbftBatchedSigs::generateBatchedSignatures(messageStrs, keyManager->GetPrivateKey(id), sigs);
 
   //replyAddrsMutex.lock();
-  for (unsigned int i = 0; i < EpendingBatchedMessages.size(); i++) {
-    transport->SendMessage(this, *replyAddrs[EpendingBatchedDigs[i]], *EsignedMessages[i]);
-    //std::cerr << "deleting reply" << std::endl;
-    delete EpendingBatchedMessages[i];
+  if (batchMessages) {
+    // coalesce the replies per reply address; requests received in one batch
+    // share their address (see replyAddress)
+    std::vector<std::pair<TransportAddress*, std::vector<::google::protobuf::Message*>>> dsts;
+    for (unsigned int i = 0; i < EpendingBatchedMessages.size(); i++) {
+      TransportAddress *addr = replyAddrs[EpendingBatchedDigs[i]].get();
+      auto itr = std::find_if(dsts.begin(), dsts.end(),
+          [addr](const auto &dst) { return dst.first == addr; });
+      if (itr == dsts.end()) {
+        dsts.emplace_back(addr, std::vector<::google::protobuf::Message*>());
+        itr = dsts.end() - 1;
+      }
+      itr->second.push_back(EsignedMessages[i]);
+    }
+    for (const auto &dst : dsts) {
+      stats->Record("pbft_reply_batch", dst.second.size());
+      transport->SendMessage_batch(this, *dst.first, dst.second);
+    }
+    for (unsigned int i = 0; i < EpendingBatchedMessages.size(); i++) {
+      delete EpendingBatchedMessages[i];
+    }
+  } else {
+    for (unsigned int i = 0; i < EpendingBatchedMessages.size(); i++) {
+      transport->SendMessage(this, *replyAddrs[EpendingBatchedDigs[i]], *EsignedMessages[i]);
+      //std::cerr << "deleting reply" << std::endl;
+      delete EpendingBatchedMessages[i];
+    }
   }
   //replyAddrsMutex.unlock();
   EpendingBatchedDigs.clear();
   EpendingBatchedMessages.clear();
 }
 
+bool Replica::inWindow(uint64_t seqnum) const {
+  return checkpointInterval == 0 ||
+      (seqnum >= lowWatermark && seqnum < lowWatermark + checkpointWindow);
+}
+
+bool Replica::holdAboveWindow(uint64_t seqnum, const TransportAddress &remote,
+    const ::google::protobuf::Message &msg, const proto::SignedMessage& signedMsg) {
+  // stale messages, and anything beyond the next window, are dropped
+  if (seqnum < lowWatermark + checkpointWindow ||
+      seqnum >= lowWatermark + 2 * checkpointWindow) {
+    return false;
+  }
+  stats->Increment("held_above_window",1);
+  HeldMessage held;
+  held.remote.reset(remote.clone());
+  held.msg.reset(msg.New());
+  held.msg->CopyFrom(msg);
+  held.signedMsg = signedMsg;
+  heldMessages.emplace(seqnum, std::move(held));
+  return true;
+}
+
+void Replica::releaseHeldMessages() {
+  // take the newly admitted messages out first: handling them may execute
+  // slots and move the window again
+  auto end = heldMessages.lower_bound(lowWatermark + checkpointWindow);
+  std::vector<HeldMessage> ready;
+  for (auto itr = heldMessages.begin(); itr != end; ++itr) {
+    ready.push_back(std::move(itr->second));
+  }
+  heldMessages.erase(heldMessages.begin(), end);
+
+  for (const HeldMessage& held : ready) {
+    if (auto *preprepare = dynamic_cast<proto::Preprepare*>(held.msg.get())) {
+      HandlePreprepare(*held.remote, *preprepare, held.signedMsg);
+    } else if (auto *prepare = dynamic_cast<proto::Prepare*>(held.msg.get())) {
+      HandlePrepare(*held.remote, *prepare, held.signedMsg);
+    } else if (auto *commit = dynamic_cast<proto::Commit*>(held.msg.get())) {
+      HandleCommit(*held.remote, *commit, held.signedMsg);
+    }
+  }
+}
+
+void Replica::takeCheckpoint(uint64_t seqnum) {
+  Debug("Sending checkpoint for seq num %lu", seqnum);
+  checkpointDigests[seqnum] = stateDigest;
+
+  proto::Checkpoint checkpoint;
+  checkpoint.set_seqnum(seqnum);
+  checkpoint.set_digest(stateDigest);
+  sendMessageToAll(checkpoint);
+
+  // we may already have the other replicas' checkpoints
+  testCheckpoint(seqnum);
+}
+
+void Replica::HandleCheckpoint(const TransportAddress &remote,
+                              const proto::Checkpoint &checkpoint,
+                            const proto::SignedMessage& signedMsg) {
+  Debug("Handling checkpoint message");
+
+  uint64_t seqnum = checkpoint.seqnum();
+  if (checkpointInterval == 0 || !inWindow(seqnum)) {
+    stats->Increment("outside_window_cp",1);
+    return;
+  }
+
+  if (signMessages) {
+    // make sure this message is from this shard
+    if (signedMsg.replica_id() / config.n != (uint64_t) groupIdx) {
+      stats->Increment("invalid_cp_group",1);
+      return;
+    }
+    slots.addCheckpoint(checkpoint, signedMsg.replica_id(), signedMsg.signature());
+  } else {
+    slots.addCheckpoint(checkpoint);
+  }
+
+  testCheckpoint(seqnum);
+}
+
+// a checkpoint only becomes stable once we have executed up to it ourselves
+// and 2f+1 replicas (including us) agree on the digest
+void Replica::testCheckpoint(uint64_t seqnum) {
+  auto itr = checkpointDigests.find(seqnum);
+  if (itr == checkpointDigests.end()) {
+    return;
+  }
+
+  if (slots.CheckpointStable(seqnum, itr->second, config.f)) {
+    stabilizeCheckpoint(seqnum);
+  }
+}
+
+void Replica::stabilizeCheckpoint(uint64_t seqnum) {
+  Debug("Checkpoint at seq num %lu is stable", seqnum);
+  stats->Increment("stable_checkpoints",1);
+
+  // replies still waiting for their signature batch need the reply
+  // addresses we are about to drop
+  if (!EpendingBatchedMessages.empty()) {
+    if (EbatchTimerRunning) {
+      transport->CancelTimer(EbatchTimerId);
+      EbatchTimerRunning = false;
+    }
+    sendEbatch();
+  }
+
+  std::unordered_set<std::string> retired;
+  for (uint64_t seq = lowWatermark; seq <= seqnum; seq++) {
+    auto itr = pendingExecutions.find(seq);
+    if (itr == pendingExecutions.end()) {
+      continue;
+    }
+    auto bitr = batchedRequests.find(itr->second);
+    if (bitr != batchedRequests.end()) {
+      for (const auto& pair : bitr->second.digests()) {
+        requests.erase(pair.second);
+        // execution does not run concurrently with us (see executeSlots)
+        replyAddrs.unsafe_erase(pair.second);
+        retired.insert(pair.second);
+      }
+      batchedRequests.erase(bitr);
+    }
+    pendingExecutions.erase(itr);
+  }
+  retiredDigests = std::move(retired);
+
+  slots.GarbageCollect(seqnum);
+  checkpointDigests.erase(checkpointDigests.begin(), checkpointDigests.upper_bound(seqnum));
+  lowWatermark = seqnum + 1;
+
+  stats->Record("live_slots", slots.numSlots());
+  stats->Record("live_checkpoints", slots.numCheckpoints());
+  stats->Record("live_requests", requests.size());
+  stats->Record("live_batched_requests", batchedRequests.size());
+  stats->Record("live_reply_addrs", replyAddrs.size());
+  stats->Record("live_held_messages", heldMessages.size());
+
+  // the primary may have been holding a batch at the old high watermark
+  int primaryIdx = config.GetLeaderIndex(currentView);
+  if (idx == primaryIdx && !pendingBatchedDigests.empty() && !batchTimerRunning) {
+    sendBatchedPreprepare();
+  }
+
+  releaseHeldMessages();
+}
+
 void Replica::startActionTimer(uint64_t seq_num, uint64_t viewnum, std::string digest) {
   // actionTimers[seq_num][viewnum][digest] = transport->Timer(10, [seq_num, viewnum, digest, this]() {
   //   Debug("action timer expired, sending");
@@ -42,16 +42,23 @@
 #include "store/pbftstore/slots.h"
 #include "store/pbftstore/app.h"
 #include "store/pbftstore/common.h"
+#include <map>
 #include <mutex>
+#include <unordered_set>
 #include "tbb/concurrent_unordered_map.h"
 
 namespace pbftstore {
 
 class Replica : public TransportReceiver {
 public:
+  static const uint64_t DEFAULT_CHECKPOINT_INTERVAL = 128;
+
   Replica(const transport::Configuration &config, KeyManager *keyManager,
     App *app, int groupIdx, int idx, bool signMessages, uint64_t maxBatchSize,
-    uint64_t batchTimeoutMS, uint64_t EbatchSize, uint64_t EbatchTimeoutMS, bool primaryCoordinator, bool requestTx, Transport *transport);
+    uint64_t batchTimeoutMS, uint64_t EbatchSize, uint64_t EbatchTimeoutMS, bool primaryCoordinator, bool requestTx, Transport *transport,
+    crypto::HMACType hmacType = crypto::HMAC_SHA256, bool batchMessages = false,
+    uint64_t checkpointInterval = DEFAULT_CHECKPOINT_INTERVAL,
+    uint64_t checkpointWindow = 0);
   ~Replica();
 
   // Message handlers.
@@ -74,6 +81,9 @@ public:
                         const proto::SignedMessage& signedMsg);
   void HandleGrouped(const TransportAddress &remote,
                           const proto::GroupedSignedMessage &msg);
+  void HandleCheckpoint(const TransportAddress &remote,
+                          const proto::Checkpoint &msg,
+                        const proto::SignedMessage& signedMsg);
 
  private:
   const transport::Configuration &config;
@@ -90,6 +100,10 @@ public:
   bool primaryCoordinator;
   bool requestTx;
   Transport *transport;
+  // Use the transport's batched path: register with Register_batch and
+  // coalesce the messages produced while handling a received batch (or a
+  // timer) into one send per destination.
+  bool batchMessages;
   int currentView;
   int nextSeqNum;
 
@@ -103,8 +117,10 @@ public:
   proto::GroupedSignedMessage recvgrouped;
   proto::RequestRequest recvrr;
   proto::ABRequest recvab;
+  proto::Checkpoint recvcheckpoint;
 
   std::unordered_map<uint64_t, std::string> sessionKeys;
+  crypto::SessionMACs *sessionMACs;
   bool ValidateHMACedMessage(const proto::SignedMessage &signedMessage, std::string &data, std::string &type);
   void CreateHMACedMessage(const ::google::protobuf::Message &msg, proto::SignedMessage& signedMessage);
 
@@ -130,6 +146,24 @@ public:
   bool sendMessageToAll(const ::google::protobuf::Message& msg);
   bool sendMessageToPrimary(const ::google::protobuf::Message& msg);
 
+  // While sendBatchDepth > 0 (and batchMessages is set), messages to all and
+  // to the primary are queued and only sent by the outermost flushSendBatch.
+  int sendBatchDepth;
+  std::vector<::google::protobuf::Message*> pendingToAll;
+  std::vector<::google::protobuf::Message*> pendingToPrimary;
+  void startSendBatch();
+  void flushSendBatch();
+  // Unordered app requests (reads, writebacks) of the batch being received,
+  // handed to the app together once the batch is done.
+  std::vector<std::string> pendingAppTypes;
+  std::vector<std::string> pendingAppDatas;
+  void handleAppMessages(const TransportAddress &remote);
+  // Requests of one received batch share a single reply address so that
+  // sendEbatch can coalesce their replies.
+  bool receivingBatch;
+  std::shared_ptr<TransportAddress> batchRemote;
+  std::shared_ptr<TransportAddress> replyAddress(const TransportAddress &remote);
+
   // map from batched digest to received batched requests
   std::unordered_map<std::string, proto::BatchedRequest> batchedRequests;
   // map from digest to received requests
@@ -148,7 +182,8 @@ public:
 
   // map from tx digest to reply address
   //std::unordered_map<std::string, TransportAddress*> replyAddrs;
-  tbb::concurrent_unordered_map<std::string, TransportAddress*> replyAddrs;
+  // addresses are shared by the requests of one received batch
+  tbb::concurrent_unordered_map<std::string, std::shared_ptr<TransportAddress>> replyAddrs;
   //std::mutex replyAddrsMutex;
 
   // tests to see if we are ready to send commit or executute the slot
@@ -160,10 +195,48 @@ public:
   void executeSlots_internal_multi();
 
   void executeSlots_callback(std::vector<::google::protobuf::Message*> &replies, string batchDigest, string digest);
+  // adds the replies to a request to the signature batch
+  void queueReplies(std::vector<::google::protobuf::Message*> &replies, const std::string &digest);
 
   std::mutex batchMutex;
 
+  // Every checkpointInterval sequence numbers the replica sends its state
+  // digest to the group. Once 2f+1 replicas agree on it the checkpoint is
+  // stable: everything up to it is dropped from the slots and the maps
+  // above, and the window of accepted sequence numbers moves to
+  // [lowWatermark, lowWatermark + checkpointWindow). An interval of 0
+  // disables checkpointing.
+  uint64_t checkpointInterval;
+  uint64_t checkpointWindow;
+  // the first sequence number above the last stable checkpoint
+  uint64_t lowWatermark;
+  // digest over all batches executed so far
+  std::string stateDigest;
+  // map from seqnum to our own checkpoint digest, until it becomes stable
+  std::map<uint64_t, std::string> checkpointDigests;
+  // requests discarded by the last stable checkpoint, so that late copies
+  // are not ordered again
+  std::unordered_set<std::string> retiredDigests;
+  // preprepares, prepares and commits that arrived ahead of the window, up
+  // to one more window past it. They are handled once a stable checkpoint
+  // moves the window over them.
+  struct HeldMessage {
+    std::unique_ptr<TransportAddress> remote;
+    std::unique_ptr<::google::protobuf::Message> msg;
+    proto::SignedMessage signedMsg;
+  };
+  std::multimap<uint64_t, HeldMessage> heldMessages;
+  bool inWindow(uint64_t seqnum) const;
+  bool holdAboveWindow(uint64_t seqnum, const TransportAddress &remote,
+      const ::google::protobuf::Message &msg, const proto::SignedMessage& signedMsg);
+  void releaseHeldMessages();
+  void takeCheckpoint(uint64_t seqnum);
+  void testCheckpoint(uint64_t seqnum);
+  void stabilizeCheckpoint(uint64_t seqnum);
+
   void handleMessage(const TransportAddress &remote, const string &type, const string &data);
+  void ReceiveMessageInternal(const TransportAddress &remote,
+                              const std::string &type, const std::string &data);
 
   // map from seqnum to view num to
   std::unordered_map<uint64_t, std::unordered_map<uint64_t, std::unordered_map<std::string, int>>> actionTimers;
@@ -38,12 +38,12 @@ Server::Server(const transport::Configuration& config, KeyManager *keyManager,
   int groupIdx, int idx, int numShards, int numGroups, bool signMessages,
   bool validateProofs, uint64_t timeDelta, Partitioner *part,
   bool order_commit, bool validate_abort,
-  TrueTime timeServer) : config(config), keyManager(keyManager),
+  TrueTime timeServer, uint64_t execThreads) : config(config), keyManager(keyManager),
   groupIdx(groupIdx), idx(idx), id(groupIdx * config.n + idx),
   numShards(numShards), numGroups(numGroups), signMessages(signMessages),
   validateProofs(validateProofs),  timeDelta(timeDelta), part(part),
   order_commit(order_commit), validate_abort(validate_abort),
-  timeServer(timeServer) {
+  timeServer(timeServer), executor(execThreads) {
   dummyProof = std::make_shared<proto::CommitProof>();
 
   dummyProof->mutable_writeback_message()->set_status(REPLY_OK);
@@ -133,11 +133,14 @@ bool Server::CCC2(const proto::Transaction& txn) {
     }
 
     // check prepared reads
-    for (const auto& read : preparedReads[write.key()]) {
-      // second is the read ts, first is the txTs that did the read
-      if (read.second < txTs && txTs < read.first) {
-          Debug("found prepared conflict with write for key: %s", write.key().c_str());
-          return false;
+    auto preparedReadsItr = preparedReads.find(write.key());
+    if (preparedReadsItr != preparedReads.end()) {
+      for (const auto& read : preparedReadsItr->second) {
+        // second is the read ts, first is the txTs that did the read
+        if (read.second < txTs && txTs < read.first) {
+            Debug("found prepared conflict with write for key: %s", write.key().c_str());
+            return false;
+        }
       }
     }
   }
@@ -240,9 +243,64 @@ bool Server::CCC(const proto::Transaction& txn) {
 }
 
 std::vector<::google::protobuf::Message*> Server::Execute(const string& type, const string& msg) {
-  Debug("Execute: %s", type.c_str());
+  std::unique_lock lock(atomicMutex);
+  return ExecuteInternal(type, msg);
+}
+
+// Transactions of the batch are scheduled by their owned keys: the OCC
+// checks of transactions that share no key run in parallel against the
+// state left by the transactions before them, and their results are then
+// applied in batch order. Transactions only read (in CCC2) and write (when
+// applied) the per-key state of their own keys, so the outcome is that of
+// executing the batch serially. Anything else, i.e. ordered decisions,
+// runs on its own.
+std::vector<std::vector<::google::protobuf::Message*>> Server::Execute_batch(
+    const std::vector<std::string>& types, const std::vector<std::string>& msgs) {
+  Debug("Execute batch of %lu", types.size());
+  stats.Record("pbft_exec_batch", types.size());
   std::unique_lock lock(atomicMutex);
 
+  std::vector<std::vector<::google::protobuf::Message*>> results(types.size());
+  std::vector<proto::Transaction> txns(types.size());
+  std::vector<BatchOp> ops(types.size());
+  // not a vector<bool>: written concurrently
+  std::vector<char> ccc(types.size(), false);
+  proto::Transaction transaction;
+  for (size_t i = 0; i < types.size(); i++) {
+    if (types[i] != transaction.GetTypeName() || !txns[i].ParseFromString(msgs[i])) {
+      ops[i].barrier = true;
+      continue;
+    }
+    for (const auto& read : txns[i].readset()) {
+      if (IsKeyOwned(read.key())) {
+        ops[i].keys.push_back(read.key());
+      }
+    }
+    for (const auto& write : txns[i].writeset()) {
+      if (IsKeyOwned(write.key())) {
+        ops[i].keys.push_back(write.key());
+      }
+    }
+  }
+
+  executor.Execute(ops, [&](size_t i) {
+    if (!ops[i].barrier) {
+      ccc[i] = CCC2(txns[i]);
+    }
+  }, [&](size_t i) {
+    if (ops[i].barrier) {
+      results[i] = ExecuteInternal(types[i], msgs[i]);
+    } else {
+      bool result = ccc[i];
+      results[i] = HandleTransaction(txns[i], &result);
+    }
+  });
+  return results;
+}
+
+std::vector<::google::protobuf::Message*> Server::ExecuteInternal(const string& type, const string& msg) {
+  Debug("Execute: %s", type.c_str());
+
   proto::Transaction transaction;
   proto::GroupedDecision gdecision;
   if (type == transaction.GetTypeName()) {
@@ -270,7 +328,8 @@ std::vector<::google::protobuf::Message*> Server::Execute(const string& type, co
   return results;
 }
 
-std::vector<::google::protobuf::Message*> Server::HandleTransaction(const proto::Transaction& transaction) {
+std::vector<::google::protobuf::Message*> Server::HandleTransaction(const proto::Transaction& transaction,
+    const bool *ccc) {
   std::vector<::google::protobuf::Message*> results;
   proto::TransactionDecision* decision = new proto::TransactionDecision();
   //std::cerr << "allocating reply" << std::endl;
@@ -297,7 +356,7 @@ std::vector<::google::protobuf::Message*> Server::HandleTransaction(const proto:
   }
 
   // OCC check
-  if (CCC2(transaction)) {
+  if (ccc != nullptr ? *ccc : CCC2(transaction)) {
     stats.Increment("ccc_succeed",1);
     Debug("ccc succeeded");
     decision->set_status(REPLY_OK);
@@ -358,8 +417,27 @@ std::vector<::google::protobuf::Message*> Server::HandleTransaction(const proto:
 }
 
 ::google::protobuf::Message* Server::HandleMessage(const string& type, const string& msg) {
-  Debug("Handle %s", type.c_str());
   std::shared_lock lock(atomicMutex);
+  return HandleMessageInternal(type, msg);
+}
+
+std::vector<::google::protobuf::Message*> Server::HandleMessage_batch(
+    const std::vector<std::string>& types, const std::vector<std::string>& msgs) {
+  Debug("Handle batch of %lu", types.size());
+  stats.Record("pbft_app_batch", types.size());
+  // one lock acquisition for the whole batch
+  std::shared_lock lock(atomicMutex);
+
+  std::vector<::google::protobuf::Message*> replies;
+  replies.reserve(types.size());
+  for (size_t i = 0; i < types.size(); i++) {
+    replies.push_back(HandleMessageInternal(types[i], msgs[i]));
+  }
+  return replies;
+}
+
+::google::protobuf::Message* Server::HandleMessageInternal(const string& type, const string& msg) {
+  Debug("Handle %s", type.c_str());
 
   proto::Read read;
   proto::GroupedDecision gdecision;
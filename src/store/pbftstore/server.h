@@ -39,6 +39,7 @@
 #include "lib/keymanager.h"
 #include "lib/configuration.h"
 #include "store/common/backend/versionstore.h"
+#include "store/common/backend/batchexecutor.h"
 #include "store/common/partitioner.h"
 #include "store/common/truetime.h"
 
@@ -49,11 +50,15 @@ public:
   Server(const transport::Configuration& config, KeyManager *keyManager, int groupIdx, int idx, int numShards,
     int numGroups, bool signMessages, bool validateProofs, uint64_t timeDelta, Partitioner *part,
     bool order_commit = false, bool validate_abort = false,
-    TrueTime timeServer = TrueTime(0, 0));
+    TrueTime timeServer = TrueTime(0, 0), uint64_t execThreads = 1);
   ~Server();
 
   std::vector<::google::protobuf::Message*> Execute(const std::string& type, const std::string& msg);
+  std::vector<std::vector<::google::protobuf::Message*>> Execute_batch(
+      const std::vector<std::string>& types, const std::vector<std::string>& msgs);
   ::google::protobuf::Message* HandleMessage(const std::string& type, const std::string& msg);
+  std::vector<::google::protobuf::Message*> HandleMessage_batch(
+      const std::vector<std::string>& types, const std::vector<std::string>& msgs);
 
   void Load(const std::string &key, const std::string &value,
       const Timestamp timestamp);
@@ -93,7 +98,17 @@ private:
   VersionedKVStore<Timestamp, ValueAndProof> commitStore;
 
 
-  std::vector<::google::protobuf::Message*> HandleTransaction(const proto::Transaction& transaction);
+  // runs the OCC checks of an ordered batch in parallel (see Execute_batch)
+  BatchExecutor executor;
+
+  // Execute without taking atomicMutex
+  std::vector<::google::protobuf::Message*> ExecuteInternal(const std::string& type, const std::string& msg);
+  // ccc is the result of CCC2 if it was already computed
+  std::vector<::google::protobuf::Message*> HandleTransaction(const proto::Transaction& transaction,
+      const bool *ccc = nullptr);
+
+  // HandleMessage without taking atomicMutex
+  ::google::protobuf::Message* HandleMessageInternal(const std::string& type, const std::string& msg);
 
   ::google::protobuf::Message* HandleRead(const proto::Read& read);
 
@@ -33,16 +33,70 @@ namespace pbftstore {
 ShardClient::ShardClient(const transport::Configuration& config, Transport *transport,
     uint64_t group_idx,
     bool signMessages, bool validateProofs,
-    KeyManager *keyManager, Stats* stats, bool order_commit, bool validate_abort) :
+    KeyManager *keyManager, Stats* stats, bool order_commit, bool validate_abort,
+    uint64_t batchSize, uint64_t batchTimeoutMS) :
     config(config), transport(transport),
     group_idx(group_idx),
     signMessages(signMessages), validateProofs(validateProofs),
-    keyManager(keyManager), stats(stats), order_commit(order_commit), validate_abort(validate_abort) {
-  transport->Register(this, config, -1, -1);
+    keyManager(keyManager), stats(stats), order_commit(order_commit), validate_abort(validate_abort),
+    batchSize(batchSize), batchTimeoutMS(batchTimeoutMS), batchTimerRunning(false) {
+  if (batchSize > 1) {
+    transport->Register_batch(this, config, -1, -1);
+  } else {
+    transport->Register(this, config, -1, -1);
+  }
   readReq = 0;
 }
 
-ShardClient::~ShardClient() {}
+ShardClient::~ShardClient() {
+  // The timer callback captures this.
+  if (batchTimerRunning) {
+    transport->CancelTimer(batchTimerId);
+    batchTimerRunning = false;
+  }
+  for (auto msg : pendingGroupMsgs) {
+    delete msg;
+  }
+}
+
+void ShardClient::sendMessageToGroup(const ::google::protobuf::Message &msg) {
+  if (batchSize <= 1) {
+    transport->SendMessageToGroup(this, group_idx, msg);
+    return;
+  }
+
+  ::google::protobuf::Message *copy = msg.New();
+  copy->CopyFrom(msg);
+  pendingGroupMsgs.push_back(copy);
+  if (pendingGroupMsgs.size() >= batchSize) {
+    Debug("Client batch is full, sending");
+    if (batchTimerRunning) {
+      transport->CancelTimer(batchTimerId);
+      batchTimerRunning = false;
+    }
+    flushGroupBatch();
+  } else if (!batchTimerRunning) {
+    batchTimerRunning = true;
+    batchTimerId = transport->Timer(batchTimeoutMS, [this]() {
+      Debug("Client batch timer expired, sending");
+      this->stats->Increment("client_batch_timeouts", 1);
+      this->batchTimerRunning = false;
+      this->flushGroupBatch();
+    });
+  }
+}
+
+void ShardClient::flushGroupBatch() {
+  if (pendingGroupMsgs.empty()) {
+    return;
+  }
+  stats->Record("pbft_client_batch", pendingGroupMsgs.size());
+  transport->SendMessageToGroup_batch(this, group_idx, pendingGroupMsgs);
+  for (auto msg : pendingGroupMsgs) {
+    delete msg;
+  }
+  pendingGroupMsgs.clear();
+}
 
 bool ShardClient::validateReadProof(const proto::CommitProof& commitProof, const std::string& key,
   const std::string& value, const Timestamp& timestamp) {
@@ -173,7 +227,13 @@ void ShardClient::ReceiveMessage(const TransportAddress &remote,
 
 void ShardClient::ReceiveMessage_batch(const TransportAddress &remote,
     const std::vector<std::string> &types, const std::vector<std::string> &datas,
-    void *meta_data) {}
+    void *meta_data) {
+  Debug("handling batch of %lu messages", types.size());
+  stats->Record("pbft_client_recv_batch", types.size());
+  for (size_t i = 0; i < types.size(); i++) {
+    ReceiveMessage(remote, types[i], datas[i], meta_data);
+  }
+}
 
 // ================================
 // ======= MESSAGE HANDLERS =======
@@ -445,7 +505,7 @@ void ShardClient::Get(const std::string &key, const Timestamp &ts,
   read.set_key(key);
   ts.serialize(read.mutable_timestamp());
 
-  transport->SendMessageToGroup(this, group_idx, read);
+  sendMessageToGroup(read);
   PendingRead pr;
   pr.rcb = gcb;
   pr.numResultsRequired = numResults;
@@ -510,7 +570,7 @@ void ShardClient::Prepare(const proto::Transaction& txn, prepare_callback pcb,
     request.mutable_packed_msg()->set_type(txn.GetTypeName());
 
     Debug("Sending txn to all replicas in shard");
-    transport->SendMessageToGroup(this, group_idx, request);
+    sendMessageToGroup(request);
 
     PendingPrepare pp;
     pp.pcb = pcb;
@@ -557,7 +617,7 @@ void ShardClient::SignedPrepare(const proto::Transaction& txn, signed_prepare_ca
     stats->Increment("shard_prepare_s",1);
 
     Debug("Sending txn to all replicas in shard");
-    transport->SendMessageToGroup(this, group_idx, request);
+    sendMessageToGroup(request);
 
     PendingSignedPrepare psp;
     psp.pcb = pcb;
@@ -600,7 +660,7 @@ void ShardClient::Commit(const std::string& txn_digest, const proto::ShardDecisi
     stats->Increment("shard_commit", 1);
 
     Debug("Sending commit to all replicas in shard");
-    transport->SendMessageToGroup(this, group_idx, groupedDecision);
+    sendMessageToGroup(groupedDecision);
 
     PendingWritebackReply pwr;
     pwr.wcb = wcb;
@@ -651,10 +711,10 @@ void ShardClient::CommitSigned(const std::string& txn_digest, const proto::Shard
       request.mutable_packed_msg()->set_msg(groupedDecision.SerializeAsString());
       request.mutable_packed_msg()->set_type(groupedDecision.GetTypeName());
 
-      transport->SendMessageToGroup(this, group_idx, request);
+      sendMessageToGroup(request);
     }
     else{
-      transport->SendMessageToGroup(this, group_idx, groupedDecision);
+      sendMessageToGroup(groupedDecision);
     }
 
     PendingWritebackReply pwr;
@@ -702,10 +762,10 @@ void ShardClient::CommitSigned(const std::string& txn_digest, const proto::Shard
       request.mutable_packed_msg()->set_msg(groupedDecision.SerializeAsString());
       request.mutable_packed_msg()->set_type(groupedDecision.GetTypeName());
 
-      transport->SendMessageToGroup(this, group_idx, request);
+      sendMessageToGroup(request);
     }
     else{
-      transport->SendMessageToGroup(this, group_idx, groupedDecision);
+      sendMessageToGroup(groupedDecision);
     }
 
     // TODO timeout
@@ -738,7 +798,7 @@ void ShardClient::Abort(std::string& txn_digest, const proto::ShardSignedDecisio
 
     stats->Increment("shard_abort", 1);
     Debug("AB abort to all replicas in shard");
-    transport->SendMessageToGroup(this, group_idx, request);
+    sendMessageToGroup(request);
 
     PendingWritebackReply pwr;
     pendingWritebacks[txn_digest] = pwr;  //not sure what use this has
@@ -62,7 +62,8 @@ class ShardClient : public TransportReceiver {
   ShardClient(const transport::Configuration& config, Transport *transport,
       uint64_t group_idx,
       bool signMessages, bool validateProofs,
-      KeyManager *keyManager, Stats* stats, bool order_commit = false, bool validate_abort = false);
+      KeyManager *keyManager, Stats* stats, bool order_commit = false, bool validate_abort = false,
+      uint64_t batchSize = 1, uint64_t batchTimeoutMS = 1);
   ~ShardClient();
 
   void ReceiveMessage(const TransportAddress &remote,
@@ -108,6 +109,17 @@ class ShardClient : public TransportReceiver {
 
   uint64_t readReq;
 
+  // Messages to the group are coalesced into batches of up to batchSize,
+  // sent at the latest batchTimeoutMS after the first one was queued.
+  // batchSize <= 1 sends every message on its own.
+  uint64_t batchSize;
+  uint64_t batchTimeoutMS;
+  std::vector<::google::protobuf::Message*> pendingGroupMsgs;
+  bool batchTimerRunning;
+  int batchTimerId;
+  void sendMessageToGroup(const ::google::protobuf::Message &msg);
+  void flushGroupBatch();
+
   struct PendingRead {
     // the set of ids that we have received a read reply for
     std::unordered_set<uint64_t> receivedReplies;
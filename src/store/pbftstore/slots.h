@@ -28,6 +28,7 @@
 #define _PBFT_SLOTS_H_
 
 #include <cstdint>
+#include <map>
 #include <unordered_map>
 #include <unordered_set>
 
@@ -66,6 +67,20 @@ class Slots {
 
   proto::GroupedSignedMessage getCommitProof(uint64_t seq_num, uint64_t view, const std::string& digest);
 
+  // add replica_id to the set of replicas attesting to the checkpoint digest
+  bool addCheckpoint(const proto::Checkpoint &checkpoint, uint64_t replica_id, const std::string& sig);
+  bool addCheckpoint(const proto::Checkpoint &checkpoint);
+
+  // returns true if 2f+1 replicas attest to digest at seq_num
+  bool CheckpointStable(uint64_t seq_num, const std::string& digest, uint64_t f);
+
+  // drops all slots and checkpoints up to and including seq_num
+  void GarbageCollect(uint64_t seq_num);
+
+  // number of slots and checkpoints currently held
+  size_t numSlots() const;
+  size_t numCheckpoints() const;
+
  private:
 
     struct digest_and_sig {
@@ -87,6 +102,9 @@ class Slots {
     };
 
     std::unordered_map<uint64_t, std::unordered_map<uint64_t, Slot>> slots;
+
+    // map from seqnum to state digest to replica id to signature (may be empty)
+    std::map<uint64_t, std::unordered_map<std::string, std::unordered_map<uint64_t, std::string>>> checkpoints;
 };
 
 }  // namespace pbftstore
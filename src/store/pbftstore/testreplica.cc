@@ -27,16 +27,20 @@
 #include "store/pbftstore/replica.h"
 #include "store/pbftstore/server.h"
 
+#include <cstring>
+
 int main(int argc, char **argv) {
   const char *configPath = NULL;
   const char *keyPath = NULL;
   int groupIdx = -1;
   int myId = -1;
+  crypto::HMACType hmacType = crypto::HMAC_SHA256;
+  uint64_t execThreads = 1;
 
   // Parse arguments
   int opt;
   char *strtolPtr;
-  while ((opt = getopt(argc, argv, "c:k:g:i:")) != -1) {
+  while ((opt = getopt(argc, argv, "c:k:g:i:m:t:")) != -1) {
     switch (opt) {
       case 'c':
         configPath = optarg;
@@ -58,6 +62,26 @@ int main(int argc, char **argv) {
         }
         break;
       }
+      case 'm':
+        // MAC for all-to-all replica messages
+        if (strcmp(optarg, "sha256") == 0) {
+          hmacType = crypto::HMAC_SHA256;
+        } else if (strcmp(optarg, "blake3") == 0) {
+          hmacType = crypto::HMAC_BLAKE3;
+        } else {
+          fprintf(stderr, "option -m must be sha256 or blake3\n");
+          exit(-1);
+        }
+        break;
+      case 't': {
+        // Threads that execute the transactions of a committed batch
+        execThreads = strtoul(optarg, &strtolPtr, 10);
+        if ((*optarg == '\0') || (*strtolPtr != '\0') || (execThreads < 1)) {
+          fprintf(stderr, "option -t requires a positive numeric arg\n");
+          exit(-1);
+        }
+        break;
+      }
       default:
         fprintf(stderr, "Unknown argument %s\n", argv[optind]);
     }
@@ -101,8 +125,9 @@ int main(int argc, char **argv) {
   uint64_t EbatchTimeoutMS = 10;
   uint64_t timeoutms = 10;
   DefaultPartitioner dp;
-  pbftstore::Server* server = new pbftstore::Server(config, &keyManager, groupIdx, myId, numShards, numGroups, signMessages, validateProofs, 10, &dp);
-  pbftstore::Replica replica(config, &keyManager, dynamic_cast<pbftstore::App *>(server), groupIdx, myId, signMessages, maxBatchSize, timeoutms, EbatchSize, EbatchTimeoutMS, primaryCoordinator, false, &transport);
+  pbftstore::Server* server = new pbftstore::Server(config, &keyManager, groupIdx, myId, numShards, numGroups, signMessages, validateProofs, 10, &dp,
+      false, false, TrueTime(0, 0), execThreads);
+  pbftstore::Replica replica(config, &keyManager, dynamic_cast<pbftstore::App *>(server), groupIdx, myId, signMessages, maxBatchSize, timeoutms, EbatchSize, EbatchTimeoutMS, primaryCoordinator, false, &transport, hmacType);
 
   printf("Running transport\n");
   transport.Run();
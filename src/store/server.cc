@@ -34,11 +34,14 @@
 #include "lib/keymanager.h"
 #include "lib/transport.h"
 #include "lib/tcptransport.h"
+#include "lib/iouringtransport.h"
+#include "lib/shmtransport.h"
 #include "lib/udptransport.h"
 #include "lib/io_utils.h"
 
 #include "store/common/partitioner.h"
 #include "store/server.h"
+#include "store/bulkloader.h"
 
 #include "store/benchmark/async/tpcc/tpcc-proto.pb.h"
 #include "store/indicusstore/common.h"
@@ -56,6 +59,8 @@ enum transmode_t {
 	TRANS_UNKNOWN,
   TRANS_UDP,
   TRANS_TCP,
+  TRANS_IOURING,
+  TRANS_SHM,
 };
 
 enum occ_type_t {
@@ -112,12 +117,16 @@ DEFINE_validator(protocol, &ValidateProtocol);
 
 const std::string trans_args[] = {
   "udp",
-	"tcp"
+	"tcp",
+	"iouring",
+	"shm"
 };
 
 const transmode_t transmodes[] {
   TRANS_UDP,
-	TRANS_TCP
+	TRANS_TCP,
+	TRANS_IOURING,
+	TRANS_SHM
 };
 static bool ValidateTransMode(const char* flagname,
     const std::string &value) {
@@ -190,14 +199,25 @@ DEFINE_bool(indicus_verify_deps, true, "check signatures of transaction"
     " depdendencies (for Indicus)");
 DEFINE_bool(indicus_read_reply_batch, false, "wait to reply to reads until batch"
     " is ready (for Indicus)");
-DEFINE_bool(indicus_adjust_batch_size, false, "dynamically adjust batch size"
-    " every sig_batch_timeout (for Indicus)");
+DEFINE_bool(indicus_adjust_batch_size, false, "adapt signature batch size and"
+    " timeout to the load, within the indicus_sig_batch_{min,max} and"
+    " indicus_sig_batch_timeout_{min,max} bounds (for Indicus)");
 DEFINE_uint64(indicus_merkle_branch_factor, 2, "branch factor of merkle tree"
     " of batch (for Indicus)");
 DEFINE_uint64(indicus_sig_batch, 1, "signature batch size"
     " sig batch size (for Indicus)");
 DEFINE_uint64(indicus_sig_batch_timeout, 10, "signature batch timeout ms"
     " sig batch timeout (for Indicus)");
+DEFINE_uint64(indicus_sig_batch_min, 1, "smallest signature batch size with"
+    " indicus_adjust_batch_size (for Indicus)");
+DEFINE_uint64(indicus_sig_batch_max, 64, "largest signature batch size with"
+    " indicus_adjust_batch_size (for Indicus)");
+DEFINE_uint64(indicus_sig_batch_timeout_min, 1, "shortest signature batch"
+    " timeout in us with indicus_adjust_batch_size (for Indicus)");
+DEFINE_uint64(indicus_sig_batch_timeout_max, 1000, "longest signature batch"
+    " timeout in us with indicus_adjust_batch_size (for Indicus)");
+DEFINE_uint64(indicus_batch_adjust_interval_ms, 100, "interval between two"
+    " batch size adjustments with indicus_adjust_batch_size (for Indicus)");
 DEFINE_string(indicus_key_path, "", "path to directory containing public and"
     " private keys (for Indicus)");
 DEFINE_int64(indicus_max_dep_depth, -1, "maximum length of dependency chain"
@@ -231,6 +251,11 @@ DEFINE_uint64(indicus_relayP1_timeout, 100, "time (ms) after which to send Relay
 DEFINE_bool(indicus_replica_gossip, false, "use gossip between replicas to exchange p1");
 DEFINE_uint64(indicus_batch_size, 2, "number of transaction in batch");
 DEFINE_uint64(indicus_num_ops, 10, "number of operations in transaction");
+DEFINE_string(indicus_hmac_type, "sha256", "MAC for all-to-all replica messages"
+    " (options: sha256, blake3) (for Indicus)");
+DEFINE_uint64(indicus_gc_interval_ms, 0, "interval (ms) of the multi-version"
+    " garbage collector; versions older than time_delta are reclaimed (0 to"
+    " disable)");
 
 DEFINE_double(zipf_coefficient, 0.5, "the coefficient of the zipf distribution "
     "for key selection.");
@@ -295,6 +320,8 @@ DEFINE_validator(indicus_read_dep, &ValidateReadDep);
 DEFINE_int32(clock_skew, 0, "difference between real clock and TrueTime");
 DEFINE_int32(clock_error, 0, "maximum error for clock");
 DEFINE_string(stats_file, "", "path to file for server stats");
+DEFINE_uint64(stats_dump_interval_ms, 0, "log latency histogram percentiles"
+    " for each interval of this length (0 disables)");
 
 /**
  * Benchmark settings.
@@ -304,13 +331,26 @@ DEFINE_string(stats_file, "", "path to file for server stats");
 DEFINE_string(keys_path, "", "path to file containing keys in the system");
 DEFINE_uint64(num_keys, 0, "number of keys to generate");
 DEFINE_string(data_file_path, "", "path to file containing key-value pairs to be loaded");
+DEFINE_uint64(load_threads, 0, "number of threads loading the data file or"
+    " snapshot (0 = one per hardware thread)");
+DEFINE_string(snapshot_path, "", "path of the store snapshot restored at startup"
+    " instead of loading keys, if it exists");
+DEFINE_bool(snapshot_on_shutdown, false, "write a snapshot to snapshot_path"
+    " on shutdown");
 
 Server *server = nullptr;
 TransportReceiver *replica = nullptr;
 ::Transport *tport = nullptr;
 Partitioner *part = nullptr;
 
+// Set by the signal handler; the event loop polls it and stops itself.
+volatile std::sig_atomic_t shutdownSignal = 0;
+const uint64_t SHUTDOWN_POLL_MS = 100;
+
 void Cleanup(int signal);
+void PollShutdown();
+void Shutdown();
+void DumpStats();
 
 int main(int argc, char **argv) {
 
@@ -376,6 +416,12 @@ int main(int argc, char **argv) {
       tport = new TCPTransport(0.0, 0.0, 0, false, FLAGS_indicus_process_id, FLAGS_indicus_total_processes, FLAGS_indicus_hyper_threading, true);
 			 //TODO: add: process_id + total processes (max_grpid/ machines (= servers/n))
       break;
+    case TRANS_IOURING:
+      tport = new IOUringTransport(0.0, 0.0, 0, false, FLAGS_indicus_process_id, FLAGS_indicus_total_processes, FLAGS_indicus_hyper_threading, true);
+      break;
+    case TRANS_SHM:
+      tport = new ShmTransport(false, FLAGS_indicus_process_id, FLAGS_indicus_total_processes, FLAGS_indicus_hyper_threading, true);
+      break;
     case TRANS_UDP:
       tport = new UDPTransport(0.0, 0.0, 0, nullptr);
       break;
@@ -459,6 +505,16 @@ int main(int argc, char **argv) {
   }
   KeyManager keyManager(FLAGS_indicus_key_path, keyType, true);
 
+  crypto::HMACType hmacType;
+  if (FLAGS_indicus_hmac_type == "sha256") {
+    hmacType = crypto::HMAC_SHA256;
+  } else if (FLAGS_indicus_hmac_type == "blake3") {
+    hmacType = crypto::HMAC_BLAKE3;
+  } else {
+    std::cerr << "Unknown hmac type " << FLAGS_indicus_hmac_type << std::endl;
+    return 1;
+  }
+
   switch (proto) {
   case PROTO_INDICUS: {
       uint64_t readDepSize = 0;
@@ -504,7 +560,13 @@ int main(int argc, char **argv) {
 																			FLAGS_indicus_all_to_all_fb,
 																		  FLAGS_indicus_no_fallback, FLAGS_indicus_relayP1_timeout,
 																		  FLAGS_indicus_replica_gossip, 
-                                      FLAGS_batch_optimization, FLAGS_indicus_batch_size, FLAGS_indicus_num_ops, FLAGS_num_keys, FLAGS_zipf_coefficient, FLAGS_signature_batch);
+                                      FLAGS_batch_optimization, FLAGS_indicus_batch_size, FLAGS_indicus_num_ops, FLAGS_num_keys, FLAGS_zipf_coefficient, FLAGS_signature_batch,
+                                      FLAGS_indicus_gc_interval_ms, hmacType,
+                                      BatchControllerConfig(FLAGS_indicus_sig_batch_min,
+                                        FLAGS_indicus_sig_batch_max,
+                                        FLAGS_indicus_sig_batch_timeout_min,
+                                        FLAGS_indicus_sig_batch_timeout_max,
+                                        FLAGS_indicus_batch_adjust_interval_ms * 1000));
       Debug("Starting new server object");
       server = new indicusstore::Server(config, FLAGS_group_idx,
                                         FLAGS_replica_idx, FLAGS_num_shards, FLAGS_num_groups, tport,
@@ -518,9 +580,17 @@ int main(int argc, char **argv) {
   }
 
   // parse keys
+  uint64_t loadStart = Stats::NowNs();
+  size_t loadThreads = FLAGS_load_threads;
+  if (loadThreads == 0) {
+    loadThreads = std::max(1U, std::thread::hardware_concurrency());
+  }
   std::vector<std::string> keys;
+  if (FLAGS_snapshot_path.length() > 0 &&
+      server->LoadSnapshot(FLAGS_snapshot_path, loadThreads)) {
+    Notice("Restored store from snapshot %s.", FLAGS_snapshot_path.c_str());
   // data_fileとkeys_fileがない場合 → rwか、retwisのどちらか
-  if (FLAGS_data_file_path.empty() && FLAGS_keys_path.empty()) {
+  } else if (FLAGS_data_file_path.empty() && FLAGS_keys_path.empty()) {
     /*if (FLAGS_num_keys > 0) {
       for (size_t i = 0; i < FLAGS_num_keys; ++i) {
         keys.push_back(std::to_string(i));
@@ -557,32 +627,18 @@ int main(int argc, char **argv) {
 		}
   // tpcc or smallbankの場合はこっちを通っているはず。
   } else if (FLAGS_data_file_path.length() > 0 && FLAGS_keys_path.empty()) {
-    std::ifstream in;
-    in.open(FLAGS_data_file_path);
-    if (!in) {
+    Debug("Populating with data from %s.", FLAGS_data_file_path.c_str());
+    BulkLoadResult result;
+    if (!BulkLoadDataFile(FLAGS_data_file_path, server, part, FLAGS_num_shards,
+          FLAGS_group_idx, FLAGS_num_groups, loadThreads, result)) {
       std::cerr << "Could not read data from: " << FLAGS_data_file_path
                 << std::endl;
       return 1;
     }
-    size_t loaded = 0;
-    size_t stored = 0;
-    Debug("Populating with data from %s.", FLAGS_data_file_path.c_str());
-    std::vector<int> txnGroups;
-    while (!in.eof()) {
-      std::string key;
-      std::string value;
-      int i = ReadBytesFromStream(&in, key);
-      if (i == 0) {
-        ReadBytesFromStream(&in, value);
-        if ((*part)(key, FLAGS_num_shards, FLAGS_group_idx, txnGroups) % FLAGS_num_groups == FLAGS_group_idx) {
-          server->Load(key, value, Timestamp());
-          ++stored;
-        }
-        ++loaded;
-      }
-    }
-		Notice("Stored %lu out of %lu key-value pairs from file %s.", stored,
-        loaded, FLAGS_data_file_path.c_str());
+    server->GetStats().Increment("load_keys_total", result.loaded);
+    server->GetStats().Increment("load_keys_stored", result.stored);
+		Notice("Stored %lu out of %lu key-value pairs from file %s with %lu threads.",
+        result.stored, result.loaded, FLAGS_data_file_path.c_str(), loadThreads);
     // Debug("Stored %lu out of %lu key-value pairs from file %s.", stored,
     //     loaded, FLAGS_data_file_path.c_str());
   } else {
@@ -602,8 +658,10 @@ int main(int argc, char **argv) {
     }
     in.close();
   }
+  uint64_t loadMs = (Stats::NowNs() - loadStart) / 1000000UL;
+  server->GetStats().Increment("load_time_ms", loadMs);
+  Notice("Loaded initial data in %lu ms.", loadMs);
 
-  std::signal(SIGKILL, Cleanup);
   std::signal(SIGTERM, Cleanup);
   std::signal(SIGINT, Cleanup);
 
@@ -614,7 +672,8 @@ int main(int argc, char **argv) {
 		cpu_set_t cpuset;
 		CPU_ZERO(&cpuset);
 		//bool hyperthreading = true;
-	  int num_cpus = std::thread::hardware_concurrency();///(2-FLAGS_indicus_hyper_threading);
+	  // same layout as the transport's ThreadPool
+	  int num_cpus = std::thread::hardware_concurrency()/(2-FLAGS_indicus_hyper_threading);
 		//CPU_SET(num_cpus-1, &cpuset); //last core is for main
 		num_cpus /= FLAGS_indicus_total_processes;
 	  int offset = FLAGS_indicus_process_id * num_cpus;
@@ -626,14 +685,52 @@ int main(int argc, char **argv) {
 
 	//event_enable_debug_logging(EVENT_DBG_ALL);
 
+  if (FLAGS_stats_dump_interval_ms > 0) {
+    tport->Timer(FLAGS_stats_dump_interval_ms, DumpStats);
+  }
+
+  tport->Timer(SHUTDOWN_POLL_MS, PollShutdown);
+
   tport->Run();
   CALLGRIND_STOP_INSTRUMENTATION;
   CALLGRIND_DUMP_STATS;
 
+  Shutdown();
   return 0;
 }
 
+void DumpStats() {
+  if (server == nullptr) {
+    return;
+  }
+  server->GetStats().DumpHistograms();
+  tport->Timer(FLAGS_stats_dump_interval_ms, DumpStats);
+}
+
+// Only async-signal-safe work here: the loop notices the flag in PollShutdown.
 void Cleanup(int signal) {
+  shutdownSignal = signal;
+}
+
+void PollShutdown() {
+  if (shutdownSignal != 0) {
+    // breaks the event loop and joins the thread pool, so main can finish
+    tport->Stop();
+    return;
+  }
+  tport->Timer(SHUTDOWN_POLL_MS, PollShutdown);
+}
+
+// Runs on the main thread after the event loop returned.
+void Shutdown() {
+  // No pool thread is left to mutate the store mid-snapshot.
+  tport->Stop();
+  if (FLAGS_snapshot_on_shutdown && FLAGS_snapshot_path.size() > 0 &&
+      server != nullptr) {
+    if (!server->WriteSnapshot(FLAGS_snapshot_path)) {
+      Warning("Could not write snapshot %s.", FLAGS_snapshot_path.c_str());
+    }
+  }
   if (FLAGS_stats_file.size() > 0) {
     server->GetStats().ExportJSON(FLAGS_stats_file);
   }
@@ -650,10 +747,8 @@ void Cleanup(int signal) {
   }
   Notice("Freeing transport.");
   if (tport != nullptr) {
-    tport->Stop();
     delete tport;
     tport = nullptr;
   }
   Notice("Exiting.");
-  exit(0);
 }
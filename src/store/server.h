@@ -30,7 +30,10 @@
 #include "store/common/timestamp.h"
 #include "store/common/stats.h"
 
+#include <mutex>
 #include <string>
+#include <utility>
+#include <vector>
 
 class Server {
  public:
@@ -39,7 +42,32 @@ class Server {
   virtual void Load(const std::string &key, const std::string &value,
       const Timestamp timestamp) = 0;
 
+  // Bulk-load path. ReserveLoad is called once before loading with the number
+  // of keys this server will store. LoadBatch may be called concurrently from
+  // several loader threads and may move out of kvs; the default serializes
+  // onto Load.
+  virtual void ReserveLoad(size_t numKeys) { }
+  virtual void LoadBatch(std::vector<std::pair<std::string, std::string>> &kvs,
+      const Timestamp timestamp) {
+    std::lock_guard<std::mutex> lock(loadMtx);
+    for (const auto &kv : kvs) {
+      Load(kv.first, kv.second, timestamp);
+    }
+  }
+
+  // Writes the store's committed state to a snapshot at path, or restores it
+  // from one using numThreads threads. Both return false if the protocol has
+  // no snapshot support or the file is unusable, and neither may run
+  // concurrently with request processing.
+  virtual bool WriteSnapshot(const std::string &path) { return false; }
+  virtual bool LoadSnapshot(const std::string &path, size_t numThreads) {
+    return false;
+  }
+
   virtual Stats &GetStats() = 0;
+
+ private:
+  std::mutex loadMtx;
 };
 
 #endif /* STORE_SERVER_H */
@@ -7,7 +7,8 @@ PROTOS += $(addprefix $(d), strong-proto.proto)
 
 OBJS-strong-client := $(OBJS-vr-client) $(LIB-udptransport) $(LIB-store-frontend) $(LIB-store-common) $(o)strong-proto.o $(o)shardclient.o $(o)client.o
 
+LIB-strong-backend := $(o)occstore.o $(o)lockstore.o
+
 LIB-strong-store := $(LIB-message) $(LIB-store-common) $(OBJS-vr-replica) \
-	$(LIB-store-backend) $(o)strong-proto.o $(o)server.o $(o)occstore.o \
-	$(o)lockstore.o
+	$(LIB-store-backend) $(o)strong-proto.o $(o)server.o $(LIB-strong-backend)
 
@@ -76,10 +76,6 @@ OCCStore::Prepare(uint64_t id, const Transaction &txn)
         return REPLY_OK;
     }
 
-    // Do OCC checks.
-    set<string> pWrites = getPreparedWrites();
-    set<string> pRW = getPreparedReadWrites();
-
     // Check for conflicts with the read set.
     for (auto &read : txn.getReadSet()) {
         pair<Timestamp, string> cur;
@@ -100,7 +96,7 @@ OCCStore::Prepare(uint64_t id, const Transaction &txn)
         }
 
         // If there is a pending write for this key, abort.
-        if (pWrites.find(read.first) != pWrites.end()) {
+        if (isPreparedWrite(read.first)) {
             Debug("[%lu] ABORT rw conflict w/ prepared key:%s",
                   id, read.first.c_str());
             Abort(id);
@@ -111,7 +107,7 @@ OCCStore::Prepare(uint64_t id, const Transaction &txn)
     // Check for conflicts with the write set.
     for (auto &write : txn.getWriteSet()) {
         // If there is a pending read or write for this key, abort.
-        if (pRW.find(write.first) != pRW.end()) {
+        if (isPreparedRead(write.first) || isPreparedWrite(write.first)) {
             Debug("[%lu] ABORT ww conflict w/ prepared key:%s", id,
                     write.first.c_str());
             Abort(id);
@@ -121,6 +117,7 @@ OCCStore::Prepare(uint64_t id, const Transaction &txn)
 
     // Otherwise, prepare this transaction for commit
     prepared[id] = txn;
+    indexPrepared(txn);
     Debug("[%lu] PREPARED TO COMMIT", id);
     return REPLY_OK;
 }
@@ -129,9 +126,10 @@ void
 OCCStore::Commit(uint64_t id, uint64_t timestamp)
 {
     Debug("[%lu] COMMIT", id);
-    UW_ASSERT(prepared.find(id) != prepared.end());
+    auto itr = prepared.find(id);
+    UW_ASSERT(itr != prepared.end());
 
-    Transaction txn = prepared[id];
+    const Transaction &txn = itr->second;
 
     for (auto &write : txn.getWriteSet()) {
         store.put(write.first, // key
@@ -139,14 +137,19 @@ OCCStore::Commit(uint64_t id, uint64_t timestamp)
                     Timestamp(timestamp)); // timestamp
     }
 
-    prepared.erase(id);
+    unindexPrepared(txn);
+    prepared.erase(itr);
 }
 
 void
 OCCStore::Abort(uint64_t id, const Transaction &txn)
 {
     Debug("[%lu] ABORT", id);
-    prepared.erase(id);
+    auto itr = prepared.find(id);
+    if (itr != prepared.end()) {
+        unindexPrepared(itr->second);
+        prepared.erase(itr);
+    }
 }
 
 void
@@ -155,33 +158,46 @@ OCCStore::Load(const string &key, const string &value, const Timestamp &timestam
     store.put(key, value, timestamp);
 }
 
-set<string>
-OCCStore::getPreparedWrites()
+bool
+OCCStore::isPreparedWrite(const string &key) const
 {
-    // gather up the set of all writes that we are currently prepared for
-    set<string> writes;
-    for (auto &t : prepared) {
-        for (auto &write : t.second.getWriteSet()) {
-            writes.insert(write.first);
-        }
+    return preparedWrites.find(key) != preparedWrites.end();
+}
+
+bool
+OCCStore::isPreparedRead(const string &key) const
+{
+    return preparedReads.find(key) != preparedReads.end();
+}
+
+void
+OCCStore::indexPrepared(const Transaction &txn)
+{
+    for (auto &read : txn.getReadSet()) {
+        preparedReads[read.first]++;
+    }
+    for (auto &write : txn.getWriteSet()) {
+        preparedWrites[write.first]++;
     }
-    return writes;
 }
 
-set<string>
-OCCStore::getPreparedReadWrites()
+void
+OCCStore::unindexPrepared(const Transaction &txn)
 {
-    // gather up the set of all writes that we are currently prepared for
-    set<string> readwrites;
-    for (auto &t : prepared) {
-        for (auto &write : t.second.getWriteSet()) {
-            readwrites.insert(write.first);
+    for (auto &read : txn.getReadSet()) {
+        auto itr = preparedReads.find(read.first);
+        UW_ASSERT(itr != preparedReads.end());
+        if (--itr->second == 0) {
+            preparedReads.erase(itr);
         }
-        for (auto &read : t.second.getReadSet()) {
-            readwrites.insert(read.first);
+    }
+    for (auto &write : txn.getWriteSet()) {
+        auto itr = preparedWrites.find(write.first);
+        UW_ASSERT(itr != preparedWrites.end());
+        if (--itr->second == 0) {
+            preparedWrites.erase(itr);
         }
     }
-    return readwrites;
 }
 
 } // namespace strongstore
@@ -40,6 +40,7 @@
 #include "store/common/transaction.h"
 
 #include <map>
+#include <unordered_map>
 
 namespace strongstore {
 
@@ -63,8 +64,15 @@ private:
 
     std::map<uint64_t, Transaction> prepared;
 
-    std::set<std::string> getPreparedWrites();
-    std::set<std::string> getPreparedReadWrites();
+    // Number of prepared transactions reading/writing each key, updated on
+    // Prepare, Commit and Abort.
+    std::unordered_map<std::string, uint64_t> preparedReads;
+    std::unordered_map<std::string, uint64_t> preparedWrites;
+
+    bool isPreparedWrite(const std::string &key) const;
+    bool isPreparedRead(const std::string &key) const;
+    void indexPrepared(const Transaction &txn);
+    void unindexPrepared(const Transaction &txn);
 };
 
 } // namespace strongstore
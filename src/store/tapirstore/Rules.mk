@@ -5,7 +5,9 @@ SRCS += $(addprefix $(d), client.cc shardclient.cc server.cc store.cc \
 
 PROTOS += $(addprefix $(d), tapir-proto.proto)
 
-LIB-tapir-store := $(OBJS-ir-replica) $(o)server.o $(o)store.o \
+LIB-tapir-backend := $(o)store.o
+
+LIB-tapir-store := $(OBJS-ir-replica) $(o)server.o $(LIB-tapir-backend) \
 	$(o)tapir-proto.o 
 
 LIB-tapir-client := $(OBJS-ir-client)  $(LIB-udptransport) \
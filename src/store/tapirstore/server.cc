@@ -156,6 +156,23 @@ Server::Merge(const std::map<opid_t, std::vector<RecordEntry>> &d,
     Panic("Unimplemented!");
 }
 
+bool
+Server::Compactable(const RecordEntry &entry)
+{
+    Request request;
+    request.ParseFromString(entry.request.op());
+
+    switch (request.op()) {
+    case tapirstore::proto::Request::COMMIT:
+    case tapirstore::proto::Request::ABORT:
+        return true;
+    case tapirstore::proto::Request::PREPARE:
+        return store->Finished(request.txnid());
+    default:
+        return false;
+    }
+}
+
 void
 Server::Load(const string &key, const string &value, const Timestamp timestamp)
 {
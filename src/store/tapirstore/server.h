@@ -67,12 +67,16 @@ public:
         const std::map<opid_t, std::vector<RecordEntry>> &u,
         const std::map<opid_t, std::string> &majority_results_in_d) override;
 
+    // Commits and aborts are applied once finalized; a prepare can go
+    // once its transaction is decided.
+    bool Compactable(const RecordEntry &entry) override;
+
     virtual void Load(const string &key, const string &value, const Timestamp timestamp) override;
 
     virtual inline Stats &GetStats() override { return store->GetStats(); }
 
 private:
-    TxnStore *store;
+    Store *store;
 };
 
 } // namespace tapirstore
@@ -87,12 +87,6 @@ Store::Prepare(uint64_t id, const Transaction &txn, const Timestamp &timestamp,
       ongoing[id] = txn;
     }
 
-    // do OCC checks
-    unordered_map<string, set<Timestamp>> pReads;
-    GetPreparedReads(pReads);
-    unordered_map<string, set<Timestamp>> preparedWrites;
-    GetPreparedWrites(preparedWrites);
-
     // check for conflicts with the read set
     for (auto &read : txn.getReadSet()) {
         pair<Timestamp, Timestamp> range;
@@ -110,12 +104,13 @@ Store::Prepare(uint64_t id, const Transaction &txn, const Timestamp &timestamp,
         if (range.first != read.second) continue;
 
         // if the value is still valid
+        auto pWrites = preparedWrites.find(read.first);
         if (!range.second.isValid()) {
             // check pending writes.
-            if (preparedWrites.find(read.first) != preparedWrites.end() && 
-                (linearizable || 
-                 preparedWrites[read.first].upper_bound(timestamp) !=
-                  preparedWrites[read.first].begin()) ) {
+            if (pWrites != preparedWrites.end() &&
+                (linearizable ||
+                 pWrites->second.upper_bound(timestamp) !=
+                  pWrites->second.begin()) ) {
                 Debug("[%lu] ABSTAIN wr conflict w/ prepared key:%s",
                       id, read.first.c_str());
                 stats.Increment("cc_abstains", 1);
@@ -165,16 +160,16 @@ Store::Prepare(uint64_t id, const Transaction &txn, const Timestamp &timestamp,
              * pending writes again.  If proposed transaction is
              * earlier, abstain
              */
-            if (preparedWrites.find(read.first) != preparedWrites.end()) {
-                for (auto &writeTime : preparedWrites[read.first]) {
-                    if (writeTime > range.first && 
-                        writeTime < timestamp) {
-                        Debug("[%lu] ABSTAIN wr conflict w/ prepared key:%s",
-                              id, read.first.c_str());
-                        stats.Increment("cc_abstains", 1);
-                        stats.Increment("cc_abstains_wr_conflict", 1);
-                        return REPLY_ABSTAIN;
-                    }
+            if (pWrites != preparedWrites.end()) {
+                // only writes strictly between the read version and our
+                // timestamp conflict
+                auto it = pWrites->second.upper_bound(range.first);
+                if (it != pWrites->second.end() && *it < timestamp) {
+                    Debug("[%lu] ABSTAIN wr conflict w/ prepared key:%s",
+                          id, read.first.c_str());
+                    stats.Increment("cc_abstains", 1);
+                    stats.Increment("cc_abstains_wr_conflict", 1);
+                    return REPLY_ABSTAIN;
                 }
             }
         }
@@ -225,10 +220,10 @@ Store::Prepare(uint64_t id, const Transaction &txn, const Timestamp &timestamp,
 
         // if there is a pending write for this key, greater than the
         // proposed timestamp, retry
-        if ( linearizable &&
-             preparedWrites.find(write.first) != preparedWrites.end()) {
-            set<Timestamp>::iterator it = preparedWrites[write.first].upper_bound(timestamp);
-            if ( it != preparedWrites[write.first].end() ) {
+        auto pWrites = preparedWrites.find(write.first);
+        if ( linearizable && pWrites != preparedWrites.end()) {
+            auto it = pWrites->second.upper_bound(timestamp);
+            if ( it != pWrites->second.end() ) {
                 Debug("[%lu] RETRY ww conflict w/ prepared key:%s",
                       id, write.first.c_str());
                 proposedTimestamp = *it;
@@ -241,8 +236,9 @@ Store::Prepare(uint64_t id, const Transaction &txn, const Timestamp &timestamp,
 
         //if there is a pending read for this key, greater than the
         //propsed timestamp, abstain
-        if ( pReads.find(write.first) != pReads.end() &&
-             pReads[write.first].upper_bound(timestamp) != pReads[write.first].end() ) {
+        auto pReads = preparedReads.find(write.first);
+        if ( pReads != preparedReads.end() &&
+             pReads->second.upper_bound(timestamp) != pReads->second.end() ) {
             Debug("[%lu] ABSTAIN rw conflict w/ prepared key:%s", 
                   id, write.first.c_str());
             stats.Increment("cc_abstains", 1);
@@ -253,9 +249,7 @@ Store::Prepare(uint64_t id, const Transaction &txn, const Timestamp &timestamp,
 
     // Otherwise, prepare this transaction for commit
     prepared[id] = make_pair(timestamp, txn);
-    /*for (const auto &write : txn.getWriteSet()) {
-      preparedWrites[write.first].insert(timestamp);
-    }*/
+    IndexPrepared(timestamp, txn);
     Debug("[%lu] PREPARED TO COMMIT", id);
 
     return REPLY_OK;
@@ -303,6 +297,12 @@ Store::Abort(uint64_t id, const Transaction &txn)
     Cleanup(id);
 }
 
+bool
+Store::Finished(uint64_t id) const
+{
+    return ongoing.find(id) == ongoing.end();
+}
+
 void
 Store::Load(const string &key, const string &value, const Timestamp &timestamp)
 {
@@ -310,38 +310,42 @@ Store::Load(const string &key, const string &value, const Timestamp &timestamp)
 }
 
 void
-Store::GetPreparedWrites(unordered_map<string, set<Timestamp>> &writes)
+Store::IndexPrepared(const Timestamp &timestamp, const Transaction &txn)
 {
-    // gather up the set of all writes that are currently prepared
-    for (auto &t : prepared) {
-        for (auto &write : t.second.second.getWriteSet()) {
-            writes[write.first].insert(t.second.first);
-        }
+    for (auto &read : txn.getReadSet()) {
+        preparedReads[read.first].insert(timestamp);
+    }
+    for (auto &write : txn.getWriteSet()) {
+        preparedWrites[write.first].insert(timestamp);
     }
 }
 
 void
-Store::GetPreparedReads(unordered_map<string, set<Timestamp>> &reads)
+Store::UnindexPrepared(const Timestamp &timestamp, const Transaction &txn)
 {
-    // gather up the set of all writes that are currently prepared
-    for (auto &t : prepared) {
-        for (auto &read : t.second.second.getReadSet()) {
-            reads[read.first].insert(t.second.first);
+    for (auto &read : txn.getReadSet()) {
+        auto itr = preparedReads.find(read.first);
+        UW_ASSERT(itr != preparedReads.end());
+        itr->second.erase(itr->second.find(timestamp));
+        if (itr->second.empty()) {
+            preparedReads.erase(itr);
+        }
+    }
+    for (auto &write : txn.getWriteSet()) {
+        auto itr = preparedWrites.find(write.first);
+        UW_ASSERT(itr != preparedWrites.end());
+        itr->second.erase(itr->second.find(timestamp));
+        if (itr->second.empty()) {
+            preparedWrites.erase(itr);
         }
     }
 }
 
 void Store::Cleanup(uint64_t txnId) {
-  /*const auto &txn = prepared[txnId];
-  for (const auto &write : txn.second.getWriteSet()) {
-    auto itr = preparedWrites.find(write.first);
-    if (itr != preparedWrites.end()) {
-      itr->second.erase(txn.first);
-      if (itr->second.size() == 0) {
-        preparedWrites.erase(itr);
-      }
-    }
-  }*/
+  auto itr = prepared.find(txnId);
+  if (itr != prepared.end()) {
+    UnindexPrepared(itr->second.first, itr->second.second);
+  }
   Debug("Removing txn %lu from prepared and ongoing.", txnId);
   prepared.erase(txnId);
   ongoing.erase(txnId);
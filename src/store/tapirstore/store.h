@@ -61,6 +61,10 @@ public:
     void Abort(uint64_t id, const Transaction &txn = Transaction());
     void Load(const std::string &key, const std::string &value, const Timestamp &timestamp);
 
+    // Whether transaction id has been committed or aborted (or was never
+    // prepared here).
+    bool Finished(uint64_t id) const;
+
 private:
     // Are we running in linearizable (vs serializable) mode?
     bool linearizable;
@@ -68,13 +72,18 @@ private:
     // Data store
     VersionedKVStore<Timestamp, std::string> store;
 
-    // TODO: comment this.
+    // Prepared transactions with their prepare timestamp, and every
+    // transaction we have seen a Prepare for that is not yet finished.
     std::unordered_map<uint64_t, std::pair<Timestamp, Transaction>> prepared;
     std::unordered_map<uint64_t, Transaction> ongoing;
-    //std::unordered_map<std::string, std::set<Timestamp>> preparedWrites;
+    // Per-key prepare timestamps of the prepared transactions that read or
+    // write the key. Kept in step with prepared so the OCC check only looks
+    // at the keys of the transaction being prepared.
+    std::unordered_map<std::string, std::multiset<Timestamp>> preparedReads;
+    std::unordered_map<std::string, std::multiset<Timestamp>> preparedWrites;
 
-    void GetPreparedWrites(std::unordered_map< std::string, std::set<Timestamp> > &writes);
-    void GetPreparedReads(std::unordered_map< std::string, std::set<Timestamp> > &reads);
+    void IndexPrepared(const Timestamp &timestamp, const Transaction &txn);
+    void UnindexPrepared(const Timestamp &timestamp, const Transaction &txn);
     void Commit(const Timestamp &timestamp, const Transaction &txn);
     void Cleanup(uint64_t txnId);
 };